@@ -22,7 +22,7 @@ along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
 using namespace std;
 #include <cstdio>
 #include <cstdlib>
-#include "sim.h"
+#include "gui.h"
 #include "CBoard.h"
 #include "CBoardDeviceGroup.h"
 #include "CBoardDevice.h"
@@ -53,6 +53,10 @@ CBoard::CBoard()
 	//lcd_hWnd = NULL;
 	lcd_name = "";
 	lcd_available = false;
+	lcd_text_view = NULL;
+	mapped_lcd = NULL;
+
+	initialized = false;
 }
 
 /*
@@ -78,11 +82,22 @@ void CBoard::CleanUp()
 	for(UINT i=0; i<device_groups.size(); i++)
 		delete device_groups[i];
 	device_groups.clear();
+	device_group_names.clear();
 
 	// No lcd available
 	lcd_available = false;
+	mapped_lcd = NULL;
 	
-	//FIXME remove all objects in GtkFixed
+	// Remove the images and the lcd control from the window
+	if(initialized)
+	{
+		GList *children = gtk_container_get_children(GTK_CONTAINER(board_area));
+		for(GList *it = children; it != NULL; it = it->next)
+			gtk_widget_destroy(GTK_WIDGET(it->data));
+		g_list_free(children);
+		lcd_text_view = NULL;
+		initialized = false;
+	}
 }
 
 /*
@@ -90,28 +105,28 @@ void CBoard::CleanUp()
  *
  *  Parses an AddDeviceGroup command from the .board file
  *
- *	Parameters: line - A C string that contails the line with the AddDeviceGroup command
+ *	Parameters: args - The arguments of the AddDeviceGroup command
+ *				board - The board the device group is added to
  *
  *	Returns:	True if the parsing was successful and false if an error occured.
  */
-bool CBoard::ParseDeviceGroup(const ParsedRowArguments& args)
+bool CBoard::ParseDeviceGroup(const ParsedRowArguments& args, CompiledBoard& board)
 {
-	CBoardDeviceGroup *d_group;
+	CompiledBoard::DeviceGroup d_group;
 
 	if(!ArgsMatches(args, "ss"))
 		return false;
 
-	// Allocate memory for a new device group
-	d_group = new CBoardDeviceGroup;
-
-	d_group->SetName(args[0].second.c_str());
-	d_group->SetType(args[1].second.c_str());
+	// The name must be unique
+	if(board.device_group_indices.count(args[0].str))
+		return false;
 
-	// Set this device group to be compatible with a PIO interface
-	d_group->SetPIO(true);
+	d_group.name = args[0].str;
+	d_group.type = args[1].str;
 
-	// Add the device group to our vector
-	device_groups.push_back(d_group);
+	// Add the device group to the vector and map
+	board.device_group_indices[d_group.name] = board.device_groups.size();
+	board.device_groups.push_back(d_group);
 
 	return true;
 }
@@ -121,53 +136,41 @@ bool CBoard::ParseDeviceGroup(const ParsedRowArguments& args)
  *
  *  Parses an AddDevice command from the .board file
  *
- *	Parameters: line - A C string that contails the line with the AddDevice command
+ *	Parameters: args - The arguments of the AddDevice command
+ *				board - The board the device is added to
  *
  *	Returns:	True if the parsing was successful and false if an error occured.
  */
-bool CBoard::ParseDevice(const ParsedRowArguments& args)
+bool CBoard::ParseDevice(const ParsedRowArguments& args, CompiledBoard& board)
 {
-	string type, group, image;
-	POINT coords;
-	UINT bit;
+	CompiledBoard::Device device;
+	map<string, UINT>::iterator it;
 
 	if(!ArgsMatches(args, "ssnsnn"))
 		return false;
 
-	// Type
-	type = args[0].second;
-	// Device group name
-	group = args[1].second;
+	// Type, return false if it is invalid
+	device.type = args[0].str;
+	if(!CBoardDeviceGroup::IsValidDeviceType(device.type.c_str()))
+		return false;
+	// Device group name, return false if the device group wasn't found
+	it = board.device_group_indices.find(args[1].str);
+	if(it == board.device_group_indices.end())
+		return false;
+	device.group = it->second;
 	// Bit
-	bit = atoi(args[2].second.c_str());
+	device.bit = args[2].number;
 	// Image filename
-	image = args[3].second;
-	fix_filename(image);
+	device.image = args[3].str;
+	fix_filename(device.image);
 	// x-coord
-	coords.x = atoi(args[4].second.c_str());
+	device.coords.x = args[4].number;
 	// y-coord
-	coords.y = atoi(args[5].second.c_str());
+	device.coords.y = args[5].number;
 
-	// Loop through all device groups to find the one we are looking for
-	bool found = false;
-	for(UINT i=0; i<device_groups.size(); i++)
-	{
-		// Check the name to see if it matches
-		if(!strcmp(group.c_str(), device_groups[i]->GetName()))
-		{
-			// Add the device to the device group
-			if(!device_groups[i]->AddDevice(type, group, bit, image, coords))
-			{
-				// Return false if the device counldn't be added
-				return false;
-			}
-
-			return true;
-		}
-	}
+	board.devices.push_back(device);
 
-	// Return false if the device group wasn't found
-	return false;
+	return true;
 }
 
 /*
@@ -175,28 +178,117 @@ bool CBoard::ParseDevice(const ParsedRowArguments& args)
  *
  *  Parses an AddLCD command from the .board file
  *
- *	Parameters: line - A C string that contails the line with the AddLCD command
+ *	Parameters: args - The arguments of the AddLCD command
+ *				board - The board the lcd is added to
  *
  *	Returns:	True if the parsing was successful and false if an error occured.
  */
-bool CBoard::ParseLCD(const ParsedRowArguments& args)
+bool CBoard::ParseLCD(const ParsedRowArguments& args, CompiledBoard& board)
 {
-	// Destroy the lcd window if it already exists
-	//FIXME ?
-	
 	if(!ArgsMatches(args, "snn"))
 		return false;
 
-	lcd_name = args[0].second;
-	lcd_coords.x = atoi(args[1].second.c_str());
-	lcd_coords.y = atoi(args[2].second.c_str());
+	board.lcd_name = args[0].str;
+	board.lcd_coords.x = args[1].number;
+	board.lcd_coords.y = args[2].number;
 
 	// Signal that we have an lcd on the board
-	lcd_available = true;
+	board.lcd_available = true;
 
 	return true;
 }
 
+/*
+ *	CBoard::CompileBoard()
+ *
+ *  Parses and checks a .board file. Throws a ParsingError if it has errors.
+ *
+ *	Parameters: file - The file path and name of the .board file
+ *				board - Receives the parsed board
+ */
+void CBoard::CompileBoard(const char *file, CompiledBoard& board)
+{
+	ParsedFile board_file(file);
+
+	for(UINT c=0; c<board_file.commands.size(); c++)
+	{
+		const ParsedCommand& command = board_file.commands[c];
+		const ParsedRowArguments& args = command.args;
+		if(!strcmp(command.keyword, "SetName"))
+		{
+			if(!ArgsMatches(args, "s"))
+				throw board_file.Error(command, "Error while parsing SetName");
+			board.name = args[0].str;
+		}
+		else if(!strcmp(command.keyword, "SetBackgroundImage"))
+		{
+			if(!ArgsMatches(args, "s"))
+				throw board_file.Error(command, "Error while parsing SetBackgroundImage");
+			board.bg_file = args[0].str;
+			fix_filename(board.bg_file);
+		}
+		else if(!strcmp(command.keyword, "AddDeviceGroup"))
+		{
+			if(!ParseDeviceGroup(args, board))
+				throw board_file.Error(command, "Error while parsing AddDeviceGroup");
+		}
+		else if(!strcmp(command.keyword, "AddDevice"))
+		{
+			if(!ParseDevice(args, board))
+				throw board_file.Error(command, "Error while parsing AddDevice");
+		}
+		else if(!strcmp(command.keyword, "AddLCD"))
+		{
+			if(!ParseLCD(args, board))
+				throw board_file.Error(command, "Error while parsing AddLCD");
+		}
+		else
+		{
+			throw board_file.Error(command, string("Unknown command \'") + command.keyword + "\'");
+		}
+	}
+}
+
+/*
+ *	CBoard::BuildBoard()
+ *
+ *  Creates the device groups and devices of a parsed board
+ *
+ *	Parameters: board - The parsed board
+ */
+void CBoard::BuildBoard(const CompiledBoard& board)
+{
+	name = board.name;
+	bg_file = board.bg_file;
+
+	for(UINT i=0; i<board.device_groups.size(); i++)
+	{
+		CBoardDeviceGroup *d_group = new CBoardDeviceGroup;
+
+		d_group->SetName(board.device_groups[i].name.c_str());
+		d_group->SetType(board.device_groups[i].type.c_str());
+
+		// Set this device group to be compatible with a PIO interface
+		d_group->SetPIO(true);
+
+		device_groups.push_back(d_group);
+		device_group_names[d_group->GetName()] = d_group;
+	}
+
+	// The types and device groups were checked when the board was parsed
+	for(UINT i=0; i<board.devices.size(); i++)
+	{
+		const CompiledBoard::Device& device = board.devices[i];
+		CBoardDeviceGroup *d_group = device_groups[device.group];
+
+		d_group->AddDevice(device.type, d_group->GetName(), device.bit, device.image, device.coords);
+	}
+
+	lcd_available = board.lcd_available;
+	lcd_name = board.lcd_name;
+	lcd_coords = board.lcd_coords;
+}
+
 /*
  *	CBoard::LoadBoard()
  *
@@ -206,72 +298,46 @@ bool CBoard::ParseLCD(const ParsedRowArguments& args)
  *
  *	Returns:	True if the .board file was loaded and false if an error occured.
  */
-void CBoard::LoadBoard(char *file)
+void CBoard::LoadBoard(const char *file)
 {
 	char err_str[1024];
+	string path = file;
 
 	// Wipe everything on the board before we start parsing
 	CleanUp();
 	
 	// Make it work in Linux too
-	for(int i=0; i<strlen(file); i++)
-		if(file[i] == '\\')
-			file[i] = '/';
+	fix_filename(path);
+	file = path.c_str();
 	
 	try
 	{
-		ParsedFile board_file = ParseFile(file);
-	
-		for(ParsedFile::iterator it = board_file.begin(); it != board_file.end(); ++it)
+		// Parse the file unless it has been parsed before and hasn't been modified since then.
+		// Embedded boards have no modification time and are only parsed once.
+		guint64 modified = CFile(file).get_modification_time();
+		map<string, CompiledBoard>::iterator it = compiled_boards.find(path);
+		if(it == compiled_boards.end() || it->second.modified != modified)
 		{
-			const string& command = it->first;
-			if(command == "SetName")
-			{
-				if(!ArgsMatches(it->second, "s"))
-				{
-					sprintf(err_str, "Error while parsing SetName in \'%s\'", file);
-					throw ParsingError(err_str);
-				}
-				name = it->second[0].second;
-			}
-			else if(command == "SetBackgroundImage")
-			{
-				if(!ArgsMatches(it->second, "s"))
-				{
-					sprintf(err_str, "Error while parsing SetBackgroundImage in \'%s\'", file);
-					throw ParsingError(err_str);
-				}
-				bg_file = it->second[0].second;
-				fix_filename(bg_file);
-			}
-			else if(command == "AddDeviceGroup")
-			{
-				if(!ParseDeviceGroup(it->second))
-				{
-					sprintf(err_str, "Error while parsing AddDeviceGroup in \'%s\'", file);
-					throw ParsingError(err_str);
-				}
-			}
-			else if(command == "AddDevice")
-			{
-				if(!ParseDevice(it->second))
-				{
-					sprintf(err_str, "Error while parsing AddDevice in \'%s\'", file);
-					throw ParsingError(err_str);
-				}
-			}
-			else if(command == "AddLCD")
-			{
-				if(!ParseLCD(it->second))
-				{
-					sprintf(err_str, "Error while parsing AddLCD in \'%s\'", file);
-					throw ParsingError(err_str);
-				}
-			}
+			CompiledBoard board;
+
+			if(it != compiled_boards.end())
+				compiled_boards.erase(it);
+
+			CompileBoard(file, board);
+			board.modified = modified;
+			it = compiled_boards.insert(make_pair(path, board)).first;
 		}
 
-		// Initialize the board
-		if(!Init())
+		BuildBoard(it->second);
+
+		// Decode the images that have been modified again
+		images.RemoveModified();
+
+		// Set the window title
+		gtk_window_set_title(GTK_WINDOW(board_window), name.c_str());
+
+		// The images are created when the board window is shown, unless it already is
+		if(gtk_widget_get_visible(board_window) && !Init())
 		{
 			// Initializing failed, display error message and return false
 			sprintf(err_str, "Error while trying to initialize the board!");
@@ -287,14 +353,21 @@ void CBoard::LoadBoard(char *file)
 /*
  *	CBoard::Init()
  *
- *  Initializes the board
+ *  Creates the images of the board and the lcd control. Does nothing if they have already
+ *  been created since the board was loaded.
  *
  *	Returns:	True if the initializing was successful and false if it failed.
  */
 bool CBoard::Init()
 {
+	if(initialized)
+		return true;
+
+	// Also set if the initializing fails, so that CleanUp() removes what was created
+	initialized = true;
+
 	// Load the background image
-	GdkPixbuf *bg_pixbuf = gdk_pixbuf_new_from_stream(CFile(bg_file.c_str()).get_input_stream(), NULL, NULL);
+	GdkPixbuf *bg_pixbuf = images.GetImage(bg_file);
 	if(bg_pixbuf == NULL)
 		return false;
 	
@@ -308,12 +381,11 @@ bool CBoard::Init()
 	GtkWidget *bg_image = gtk_image_new_from_pixbuf(bg_pixbuf);
 	gtk_fixed_put(board_area, bg_image, 0, 0);
 	gtk_widget_show(bg_image);
-	g_object_unref(bg_pixbuf);
 
 	// Initialize all device groups
 	for(UINT i=0; i<device_groups.size(); i++)
 	{
-		if(!device_groups[i]->Init(board_area))
+		if(!device_groups[i]->Init(board_area, images))
 			return false;
 	}
 
@@ -330,8 +402,6 @@ bool CBoard::Init()
 		gtk_widget_show((GtkWidget*)lcd_text_view);
 	}
 
-	// Set the window title
-	gtk_window_set_title(GTK_WINDOW(board_window), name.c_str());
 	return true;
 }
 
@@ -357,64 +427,60 @@ void CBoard::ShowCorrectImages()
  */
 CBoardDeviceGroup *CBoard::GetDeviceGroup(const char *gname)
 {
-	// Loop through all device groups
-	for(UINT i=0; i<device_groups.size(); i++)
-	{
-		// Check if the name matches
-		if(!strcmp(device_groups[i]->GetName(), gname))
-			return device_groups[i];
-	}
+	map<string, CBoardDeviceGroup*>::iterator it = device_group_names.find(gname);
 
 	// No matches, return NULL
-	return NULL;
+	if(it == device_group_names.end())
+		return NULL;
+
+	return it->second;
 }
 
 /*
- *	CBoard::UpdateLCDText()
+ *	CBoard::MapPio()
  *
- *  Updates the lcd text buffer with new text
+ *  Maps a pio interface to a device group with a specific name
  *
- *	Parameters: text - The text to print on the lcd
+ *	Parameters: gname - The name of the device group
+ *				pio - The pio interface
+ *
+ *	Returns:	False if there is no device group with the same type that can be mapped to a pio interface
  */
-void CBoard::UpdateLCDText(char *text)
+bool CBoard::MapPio(const char *gname, CPio *pio)
 {
-	lcd_text_buf = "";
+	CBoardDeviceGroup *device_group = GetDeviceGroup(gname);
 
-	for(int i=0; i<LCD_TEXT_LEN; i++)
-	{
-		// Insert a new line
-		if(i == LCD_TEXT_LEN/2)
-			lcd_text_buf += '\n';
+	// Check if the device group can be mapped to a pio interface
+	if(!device_group || !device_group->IsPIO())
+		return false;
 
-		if(text[i])
-		{
-			// Replace illegal characters by a space
-			if(text[i] >= '!' && text[i] <= '}')
-				lcd_text_buf += text[i];
-			else
-				lcd_text_buf += ' ';
-		}
-	}
+	// Type must match
+	if(strcmp(pio->GetType(), device_group->GetType()))
+		return false;
 
-	lcd_text_updated = true;
+	// Save a pointer to the pio interface in the device group
+	device_group->SetPIOInterface(pio);
+	// Map the pio interface to the device group
+	pio->SetBoardDeviceGroup(device_group);
+
+	return true;
 }
 
 /*
  *	CBoard::WriteTextToLCD()
  *
- *  Writes the text from the lcd text buffer to the lcd window
+ *  Writes the text of the mapped lcd interface to the lcd window if it has changed.
+ *  Called once per frame.
  */
 void CBoard::WriteTextToLCD()
 {
 	// Check if there is an lcd window created before we add the text
-	//if(lcd_hWnd)
-	//	SetWindowText(lcd_hWnd, lcd_text_buf.c_str());
-	//FIXME
-	
-	if(lcd_available)
-	{
-		gtk_text_buffer_set_text(gtk_text_view_get_buffer(lcd_text_view), lcd_text_buf.c_str(), lcd_text_buf.length());
-	}
+	if(!lcd_available || !mapped_lcd || !lcd_text_view)
+		return;
+
+	// Check if the text has changed since the last frame
+	if(!mapped_lcd->TakeDisplayText(&lcd_text_buf))
+		return;
 
-	lcd_text_updated = false;
+	gtk_text_buffer_set_text(gtk_text_view_get_buffer(lcd_text_view), lcd_text_buf.c_str(), lcd_text_buf.length());
 }
@@ -24,9 +24,12 @@ along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
 
 //#include <windows.h>
 #include <string>
+#include <map>
 using namespace std;
 #include "fileparser.h"
+#include "CFrontEnd.h"
 #include "CBoardDeviceGroup.h"
+#include "CBoardDevice.h"
 #include "CLcd.h"
 
 struct InitBoardError
@@ -35,7 +38,42 @@ struct InitBoardError
 	InitBoardError(const string& str) : msg(str) {}
 };
 
-class CBoard
+// A .board file that has been parsed and checked. It is kept until the file is modified,
+// so that loading the same board again doesn't parse it again.
+struct CompiledBoard
+{
+	struct DeviceGroup
+	{
+		string name;
+		string type;
+	};
+
+	struct Device
+	{
+		string type;
+		UINT group;			// Index in device_groups
+		UINT bit;
+		string image;
+		POINT coords;
+	};
+
+	guint64 modified;		// Modification time of the file when it was parsed
+
+	string name;
+	string bg_file;
+
+	vector<DeviceGroup> device_groups;
+	map<string, UINT> device_group_indices;		// Index of each device group by name
+	vector<Device> devices;
+
+	bool lcd_available;
+	string lcd_name;
+	POINT lcd_coords;
+
+	CompiledBoard() : modified(0), lcd_available(false) { lcd_coords.x = lcd_coords.y = 0; }
+};
+
+class CBoard : public CBoardInterface
 {
 private:
 	string bg_file;		// Name of the background file
@@ -46,6 +84,7 @@ private:
 	POINT coords;		// Position of the board inside the window
 
 	vector<CBoardDeviceGroup*> device_groups;		// List of all device groups on the board
+	map<string, CBoardDeviceGroup*> device_group_names;	// The device groups by name
 
 	CBoardDeviceGroup *clicked_device_group;		// Pointer to the device group that was clicked
 	UINT clicked_device_group_bit;					// The bit index in the device group that was clicked
@@ -57,13 +96,20 @@ private:
 	string lcd_name;
 	bool lcd_available;
 	//HFONT lcd_font;
-	bool lcd_text_updated;
 	string lcd_text_buf;
+	CLcd *mapped_lcd;		// Pointer to the lcd interface mapped to the lcd control
+
+	bool initialized;		// True when the images of the board have been created
+
+	CBoardImages images;	// The decoded images, kept when another board is loaded
+	map<string, CompiledBoard> compiled_boards;	// The parsed .board files by path
 
-	// Private functions for the lcd control
-	bool ParseDeviceGroup(const ParsedRowArguments& args);
-	bool ParseDevice(const ParsedRowArguments& args);
-	bool ParseLCD(const ParsedRowArguments& args);
+	// Private functions for parsing the .board file
+	static bool ParseDeviceGroup(const ParsedRowArguments& args, CompiledBoard& board);
+	static bool ParseDevice(const ParsedRowArguments& args, CompiledBoard& board);
+	static bool ParseLCD(const ParsedRowArguments& args, CompiledBoard& board);
+	static void CompileBoard(const char *file, CompiledBoard& board);
+	void BuildBoard(const CompiledBoard& board);
 public:
 	CBoard();
 	~CBoard();
@@ -73,14 +119,14 @@ public:
 	void ShowCorrectImages(void);
 
 	bool Init();
-	void LoadBoard(char *file);
-	void UpdateLCDText(char *text);
+	void LoadBoard(const char *file);
 
 	const char*GetLCDName() {return lcd_name.c_str();};
-	bool GetLCDTextUpdate() {return lcd_text_updated;};
+	void SetLCD(CLcd *lcd) {mapped_lcd = lcd;};
 	void WriteTextToLCD();
 
 	CBoardDeviceGroup *GetDeviceGroup(const char *gname);
+	bool MapPio(const char *gname, CPio *pio);
 };
 
 #endif
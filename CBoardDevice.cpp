@@ -19,7 +19,7 @@ You should have received a copy of the GNU General Public License
 along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-#include "sim.h"
+#include "gui.h"
 #include "CBoardDevice.h"
 #include "CBoardDeviceGroup.h"
 #include "CFile.h"
@@ -56,7 +56,9 @@ CBoardDevice::CBoardDevice()
 
 	coords.x = coords.y = 0;
 
+	viewport = NULL;
 	bitmap_x = bitmap_y = 0;
+	width = height = 0;
 }
 
 /*
@@ -73,33 +75,41 @@ CBoardDevice::~CBoardDevice()
  *
  *  Initializes the device
  *
+ *	Parameters: board_area - The area the image is put in
+ *				device_group - The device group of the device
+ *				images - The images shared by all devices on the board
+ *
  *	Returns:	True if the initializing was successful and false if it failed.
  */
-bool CBoardDevice::Init(GtkFixed *board_area, CBoardDeviceGroup *device_group)
+bool CBoardDevice::Init(GtkFixed *board_area, CBoardDeviceGroup *device_group, CBoardImages& images)
 {
+	GdkPixbuf *bg_pixbuf;
+
 	this->device_group = device_group;
 
-	// Load the bitmap
-	GdkPixbuf *bg_pixbuf = gdk_pixbuf_new_from_stream(CFile(image_file.c_str()).get_input_stream(), NULL, NULL);
+	// Get the bitmap, a LED shows all brightness levels instead of the off and on images
+	if(!strcmp(type.c_str(), "LED"))
+		bg_pixbuf = images.GetLEDImage(image_file);
+	else
+		bg_pixbuf = images.GetImage(image_file);
 	if(bg_pixbuf == NULL)
 		return false;
 
-	bitmap_x = bitmap_y = 0;
-	
 	width = gdk_pixbuf_get_width(bg_pixbuf);
 	height = gdk_pixbuf_get_height(bg_pixbuf);
 
-	// Check if the type is LED, PUSH or TOGGLE
-	if(!strcmp(type.c_str(), "LED") ||
-	   !strcmp(type.c_str(), "PUSH") ||
+	// Check if the type is LED
+	if(!strcmp(type.c_str(), "LED"))
+	{
+		// Set the appropriate width and height of the bitmap
+		width = width / LED_BRIGHTNESS_LEVELS;
+	}
+	// Check if the type is PUSH or TOGGLE
+	else if(!strcmp(type.c_str(), "PUSH") ||
 	   !strcmp(type.c_str(), "TOGGLE"))
 	{
 		// Set the appropriate width and height of the bitmap
 		width = width / 2;
-
-		// Check if PUSH because pushbuttons have the value 1 if they are up
-		if(!strcmp(type.c_str(), "PUSH"))
-			bitmap_x = 1;
 	}
 	// Check if the type is SSLED
 	else if(!strcmp(type.c_str(), "SSLED"))
@@ -121,12 +131,10 @@ bool CBoardDevice::Init(GtkFixed *board_area, CBoardDeviceGroup *device_group)
 	gtk_container_add((GtkContainer*)bg_viewport, bg_image);
 	gtk_viewport_set_shadow_type((GtkViewport*)bg_viewport, GTK_SHADOW_NONE);
 	gtk_widget_set_size_request(bg_viewport, width, height);
-	gtk_adjustment_set_upper(gtk_viewport_get_hadjustment((GtkViewport*)bg_viewport), width);
-	gtk_adjustment_set_upper(gtk_viewport_get_vadjustment((GtkViewport*)bg_viewport), height);
+	gtk_adjustment_set_upper(gtk_viewport_get_hadjustment((GtkViewport*)bg_viewport), gdk_pixbuf_get_width(bg_pixbuf));
+	gtk_adjustment_set_upper(gtk_viewport_get_vadjustment((GtkViewport*)bg_viewport), gdk_pixbuf_get_height(bg_pixbuf));
 	gtk_fixed_put(board_area, bg_viewport, coords.x, coords.y);
 	
-	g_object_unref(bg_pixbuf);
-	
 	viewport = (GtkViewport*)bg_viewport;
 	
 	ShowCorrectImage();
@@ -134,37 +142,206 @@ bool CBoardDevice::Init(GtkFixed *board_area, CBoardDeviceGroup *device_group)
 	return true;
 }
 
+/*
+ *	CBoardImages::~CBoardImages()
+ *
+ *  Destructor for the CBoardImages class.
+ */
+CBoardImages::~CBoardImages()
+{
+	Clear();
+}
+
+/*
+ *	CBoardImages::Clear()
+ *
+ *  Releases all images. The widgets showing them keep their own references.
+ */
+void CBoardImages::Clear()
+{
+	for(map<string, GdkPixbuf*>::iterator it = images.begin(); it != images.end(); ++it)
+		g_object_unref(it->second);
+	images.clear();
+
+	for(map<string, GdkPixbuf*>::iterator it = led_images.begin(); it != led_images.end(); ++it)
+		g_object_unref(it->second);
+	led_images.clear();
+
+	image_times.clear();
+}
+
+/*
+ *	CBoardImages::RemoveModified()
+ *
+ *  Releases the images whose files have been modified or removed since they were decoded,
+ *  so that they are decoded again the next time they are used
+ */
+void CBoardImages::RemoveModified()
+{
+	map<string, guint64>::iterator it = image_times.begin();
+
+	while(it != image_times.end())
+	{
+		guint64 time;
+		map<string, GdkPixbuf*>::iterator led_it;
+
+		try
+		{
+			time = CFile(it->first.c_str()).get_modification_time();
+		}
+		catch(FileDoesNotExistError&)
+		{
+			time = ~0ULL;
+		}
+
+		if(time == it->second)
+		{
+			++it;
+			continue;
+		}
+
+		g_object_unref(images[it->first]);
+		images.erase(it->first);
+		led_it = led_images.find(it->first);
+		if(led_it != led_images.end())
+		{
+			g_object_unref(led_it->second);
+			led_images.erase(led_it);
+		}
+		image_times.erase(it++);
+	}
+}
+
+/*
+ *	CBoardImages::GetImage()
+ *
+ *  Gets an image, which is decoded the first time
+ *
+ *	Parameters: file - The filename of the image
+ *
+ *	Returns:	The image, owned by CBoardImages, or NULL if it couldn't be loaded
+ */
+GdkPixbuf *CBoardImages::GetImage(const string& file)
+{
+	map<string, GdkPixbuf*>::iterator it = images.find(file);
+	GdkPixbuf *pixbuf;
+
+	if(it != images.end())
+		return it->second;
+
+	CFile image_file(file.c_str());
+	pixbuf = gdk_pixbuf_new_from_stream(image_file.get_input_stream(), NULL, NULL);
+	if(pixbuf)
+	{
+		images[file] = pixbuf;
+		image_times[file] = image_file.get_modification_time();
+	}
+	return pixbuf;
+}
+
+/*
+ *	CBoardImages::GetLEDImage()
+ *
+ *  Gets the image of a LED with all brightness levels, which is created the first time
+ *
+ *	Parameters: file - The filename of the LED image, containing the off and on subimages
+ *
+ *	Returns:	The image, owned by CBoardImages, or NULL if it couldn't be loaded
+ */
+GdkPixbuf *CBoardImages::GetLEDImage(const string& file)
+{
+	map<string, GdkPixbuf*>::iterator it = led_images.find(file);
+	GdkPixbuf *pixbuf;
+
+	if(it != led_images.end())
+		return it->second;
+
+	pixbuf = GetImage(file);
+	if(!pixbuf)
+		return NULL;
+
+	pixbuf = CreateBrightnessLevels(pixbuf);
+	led_images[file] = pixbuf;
+	return pixbuf;
+}
+
+/*
+ *	CBoardImages::CreateBrightnessLevels()
+ *
+ *  Creates an image with LED_BRIGHTNESS_LEVELS subimages side by side, going from the off image 
+ *  to the on image by blending the on image over the off image with increasing opacity.
+ *
+ *	Parameters: pixbuf - The LED image, containing the off and on subimages
+ *
+ *	Returns:	The new image
+ */
+GdkPixbuf *CBoardImages::CreateBrightnessLevels(GdkPixbuf *pixbuf)
+{
+	GdkPixbuf *levels;
+	int width = gdk_pixbuf_get_width(pixbuf) / 2;
+	int height = gdk_pixbuf_get_height(pixbuf);
+
+	levels = gdk_pixbuf_new(GDK_COLORSPACE_RGB, gdk_pixbuf_get_has_alpha(pixbuf), 8, width*LED_BRIGHTNESS_LEVELS, height);
+
+	for(UINT i=0; i<LED_BRIGHTNESS_LEVELS; i++)
+	{
+		// Start with the off image
+		gdk_pixbuf_copy_area(pixbuf, 0, 0, width, height, levels, i*width, 0);
+		// Blend the on image over it
+		gdk_pixbuf_composite(pixbuf, levels, i*width, 0, width, height, (double)i*width - width, 0, 1, 1,
+			GDK_INTERP_NEAREST, 255*i/(LED_BRIGHTNESS_LEVELS - 1));
+	}
+
+	return levels;
+}
+
 /*
  *	CBoardDevice::SetData()
  *
- *  Updates the bitmap when the PIO interface this device group is mapped to has changed its data
+ *  Updates the bitmap when the PIO interface this device group is mapped to has changed its data.
+ *  Only called from the GUI thread, and the image is only redrawn if it has changed.
  *
- *	Parameters: data - The new data to this device from the PIO interface
+ *	Parameters: data - The new data to this device from the PIO interface.
+ *					   For a LED this is the brightness level, for a SSLED the segments
+ *					   and for a PUSH or TOGGLE the value of its bit.
  */
 void CBoardDevice::SetData(UINT data)
 {
+	UINT x, y;
+
 	// Check if the type is LED
 	if(!strcmp(type.c_str(), "LED"))
 	{
-		// Update the bitmap coordinates
-		bitmap_x = data;
-		bitmap_y = 0;
+		// Calculate the bitmap coordinates
+		x = data;
+		y = 0;
 	}
 	// Check if the type is SSLED
 	else if(!strcmp(type.c_str(), "SSLED"))
 	{
-		// Update the bitmap coordinates
-		bitmap_x = data & 0x7;
-		bitmap_y = data >> 3;
+		// Calculate the bitmap coordinates
+		x = data & 0x7;
+		y = data >> 3;
+	}
+	// Check if the type is PUSH or TOGGLE
+	else if(!strcmp(type.c_str(), "PUSH") || !strcmp(type.c_str(), "TOGGLE"))
+	{
+		// Calculate the bitmap coordinates
+		x = data & 0x1;
+		y = 0;
 	}
 	else
 	{
 		return;
 	}
-	
-	/*done_adjusting = false;
-	g_idle_add(show_correct_image, this);
-	while(!done_adjusting);*/
+
+	// Return if the correct image is already shown
+	if(x == bitmap_x && y == bitmap_y)
+		return;
+
+	bitmap_x = x;
+	bitmap_y = y;
+	ShowCorrectImage();
 }
 
 /*
@@ -222,6 +399,10 @@ void CBoardDevice::ReleaseClick()
  */
 void CBoardDevice::ShowCorrectImage()
 {
+	// The image hasn't been created yet
+	if(!viewport)
+		return;
+
 	gtk_adjustment_set_value(gtk_viewport_get_hadjustment(viewport), bitmap_x*width);
 	gtk_adjustment_set_value(gtk_viewport_get_vadjustment(viewport), bitmap_y*height);
 }
@@ -23,10 +23,33 @@ along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
 
 //#include <windows.h>
 #include <string>
+#include <map>
 using namespace std;
 
+// Number of images a LED is rendered with, from off to fully on
+#define LED_BRIGHTNESS_LEVELS 8
+
 class CBoardDeviceGroup;
 
+// The images of the board. Each file is decoded once and the image is shared by all devices using it,
+// and the brightness levels of a LED image are also only created once.
+class CBoardImages
+{
+private:
+	map<string, GdkPixbuf*> images;		// Decoded images by filename
+	map<string, GdkPixbuf*> led_images;	// LED images with all brightness levels by filename
+	map<string, guint64> image_times;	// Modification time of each decoded file
+
+	GdkPixbuf *CreateBrightnessLevels(GdkPixbuf *pixbuf);
+public:
+	~CBoardImages();
+
+	GdkPixbuf *GetImage(const string& file);
+	GdkPixbuf *GetLEDImage(const string& file);
+	void RemoveModified();
+	void Clear();
+};
+
 class CBoardDevice
 {
 private:
@@ -67,7 +90,7 @@ public:
 	POINT GetCoords() { return coords; };
 	void SetCoords(POINT p) {coords.x = p.x; coords.y = p.y; };
 
-	bool Init(GtkFixed *board_area, CBoardDeviceGroup *device_group);
+	bool Init(GtkFixed *board_area, CBoardDeviceGroup *device_group, CBoardImages& images);
 	//void Draw(HDC hDC, POINT pos);
 	//RECT GetRect();
 	void Click();
@@ -19,7 +19,7 @@ You should have received a copy of the GNU General Public License
 along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-#include "sim.h"
+#include "gui.h"
 #include "CPio.h"
 #include "CBoardDevice.h"
 #include "CBoardDeviceGroup.h"
@@ -38,6 +38,7 @@ CBoardDeviceGroup::CBoardDeviceGroup()
 	is_pio = false;
 
 	mapped_pio = NULL;
+	last_dirty = 0;
 }
 
 /*
@@ -88,14 +89,16 @@ bool CBoardDeviceGroup::AddDevice(string t, string g, UINT b, string i, POINT c)
 
 	device->SetGroup(g.c_str());
 	// Check for invalid device type
-	if(strcmp(t.c_str(), "LED") && strcmp(t.c_str(), "SSLED") &&
-	   strcmp(t.c_str(), "PUSH") && strcmp(t.c_str(), "TOGGLE"))
+	if(!IsValidDeviceType(t.c_str()))
 	{
 		// Return false if there was an invalid type
 		delete device;
 		return false;
 	}
 	device->SetType(t.c_str());
+	// Pushbuttons have the value 1 when they are up
+	if(!strcmp(t.c_str(), "PUSH"))
+		device->SetData(1);
 	device->SetBit(b);
 	// If the type is SSLED (a seven segment LED) set the bit span to 7
 	if(!strcmp(t.c_str(), "SSLED"))
@@ -112,28 +115,85 @@ bool CBoardDeviceGroup::AddDevice(string t, string g, UINT b, string i, POINT c)
 	return true;
 }
 
+/*
+ *	CBoardDeviceGroup::IsValidDeviceType()
+ *
+ *  Checks if a device type can be added to a device group
+ *
+ *	Parameters: t - The type of device
+ *
+ *	Returns:	True if the type is LED, SSLED, PUSH or TOGGLE
+ */
+bool CBoardDeviceGroup::IsValidDeviceType(const char *t)
+{
+	return !strcmp(t, "LED") || !strcmp(t, "SSLED") ||
+		   !strcmp(t, "PUSH") || !strcmp(t, "TOGGLE");
+}
+
 /*
  *	CBoardDeviceGroup::Init()
  *
  *  Initializes the devices in this device group
  *
+ *	Parameters: board_area - The area the images are put in
+ *				images - The images shared by all devices on the board
+ *
  *	Returns:	True if the initializing was successful, otherwise false
  */
-bool CBoardDeviceGroup::Init(GtkFixed *board_area)
+bool CBoardDeviceGroup::Init(GtkFixed *board_area, CBoardImages& images)
 {
 	// Loop through all devices and initialize them
 	for(UINT i=0; i<devices.size(); i++)
 	{
 		// Return false if a device couldn't be initialized
-		if(!devices[i]->Init(board_area, this))
+		if(!devices[i]->Init(board_area, this, images))
 			return false;
 	}
 
 	return true;
 }
 
+/*
+ *	CBoardDeviceGroup::ShowCorrectImages()
+ *
+ *  Called once per frame by the GUI thread. For an "out" device group the output activity 
+ *  of the mapped PIO interface since the previous frame is collected and only the devices 
+ *  whose image has changed are redrawn. An "in" device group follows the data register of 
+ *  the mapped PIO interface, which may have been changed by an input script. 
+ *  Other device groups redraw all their devices.
+ */
 void CBoardDeviceGroup::ShowCorrectImages()
 {
+	CPio::OutputSnapshot snapshot;
+	UINT data;
+
+	// Check if this is an "in" device group mapped to a PIO interface.
+	// Wait until any clicks have reached the PIO interface
+	if(mapped_pio && !strcmp(type.c_str(), "in"))
+	{
+		if(main_system.HasQueuedInputEvents())
+			return;
+
+		data = mapped_pio->GetData();
+		for(UINT i=0; i<devices.size(); i++)
+			devices[i]->SetData((data >> devices[i]->GetBit()) & 0x1);
+		return;
+	}
+
+	// Check if this is an "out" device group mapped to a PIO interface
+	if(mapped_pio && !strcmp(type.c_str(), "out"))
+	{
+		mapped_pio->TakeOutputSnapshot(&snapshot);
+
+		// Nothing changed during this frame nor the previous one, so all images are still correct
+		if(!snapshot.dirty && !last_dirty)
+			return;
+		last_dirty = snapshot.dirty;
+
+		SetData(&snapshot);
+		return;
+	}
+
 	for(UINT i=0; i<devices.size(); i++)
 		devices[i]->ShowCorrectImage();
 }
@@ -142,64 +202,52 @@ void CBoardDeviceGroup::ShowCorrectImages()
  *	CBoardDeviceGroup::SetData()
  *
  *  Calls the SetData function of all devices in this device group.
- *  This function is called whenever the PIO interface this device group is mapped to 
- *  has changed its data register.
+ *  A LED gets a brightness level proportional to the time it has been on during the frame, 
+ *  so that a pulse width modulated LED is shown dimmed instead of flickering.
+ *  A segment of a SSLED is shown as set if it was set for at least half of the frame, 
+ *  so that multiplexed displays show a steady digit.
  *
- *	Parameters: data - The new data from the PIO interface
+ *	Parameters: snapshot - The output activity of the PIO interface since the previous frame
  */
-void CBoardDeviceGroup::SetData(UINT data)
+void CBoardDeviceGroup::SetData(CPio::OutputSnapshot *snapshot)
 {
-	UINT d;
+	UINT d, bit;
 
-	// Return if the device group is of type "out"
-	if(strcmp(type.c_str(), "out"))
-		return;
-	
 	// Loop through all devices
 	for(UINT i=0; i<devices.size(); i++)
 	{
+		bit = devices[i]->GetBit();
+
 		// Check for type LED
 		if(!strcmp(devices[i]->GetType(), "LED"))
 		{
-			devices[i]->SetData((data >> devices[i]->GetBit()) & 0x1);
+			// If no time has passed, use the current value
+			if(snapshot->elapsed == 0)
+				d = ((snapshot->data >> bit) & 0x1) ? LED_BRIGHTNESS_LEVELS - 1 : 0;
+			else
+				d = (UINT)(((__int64)snapshot->on_cycles[bit] * (LED_BRIGHTNESS_LEVELS - 1) + snapshot->elapsed / 2) / snapshot->elapsed);
+			devices[i]->SetData(d);
 		}
 		// Check for type SSLED
 		else if(!strcmp(devices[i]->GetType(), "SSLED"))
 		{
-			devices[i]->SetData((data >> devices[i]->GetBit()) & 0x7F);
-		}
-	}
-
-#if 0 // Slower algorithm:
-	// Loop through all 32 bits in the 4 byte data register
-	for(int i=0; i<32; i++)
-	{
-		d = data >> i;
-
-		// Loop through all devices
-		for(UINT j=0; j<devices.size(); j++)
-		{
-			// Check if the device is mapped to bit i
-			if(devices[j]->GetBit() == i)
+			// If no time has passed, use the current value
+			if(snapshot->elapsed == 0)
 			{
-				// Check for type LED
-				if(!strcmp(devices[j]->GetType(), "LED"))
-				{
-					devices[j]->SetData(d & 0x1);
-					break;
-				}
-				// Check for type SSLED
-				else if(!strcmp(devices[j]->GetType(), "SSLED"))
+				d = (snapshot->data >> bit) & 0x7F;
+			}
+			else
+			{
+				d = 0;
+				for(UINT j=0; j<7 && bit+j<32; j++)
 				{
-					devices[j]->SetData(d & 0x7F);
-					// Increment i by 6 since an SSLED has a bit span of 7
-					i+=6;
-					break;
+					if((__int64)snapshot->on_cycles[bit+j] * 2 >= snapshot->elapsed)
+						d |= 1 << j;
 				}
 			}
+			devices[i]->SetData(d);
 		}
 	}
-#endif
 }
 
 /*
@@ -250,5 +298,5 @@ void CBoardDeviceGroup::UpdatedByClick(CBoardDevice *device)
 	// If a PIO interface if mapped to this device group, 
 	// notify it that the data has been changed
 	if(mapped_pio)
-		mapped_pio->UpdateData(GetData(), device->GetBit());
+		main_system.QueueInputEvent(mapped_pio, device->GetBit(), device->GetData());
 }
@@ -24,12 +24,14 @@ along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
 #include <string>
 using namespace std;
 #include "CPio.h"
+#include "CFrontEnd.h"
 
 class CBoardDevice;
+class CBoardImages;
 
 class CPio;
 
-class CBoardDeviceGroup
+class CBoardDeviceGroup : public CDeviceGroupInterface
 {
 private:
 	string name;		// Name of the device group
@@ -38,6 +40,7 @@ private:
 	bool is_pio;		// Set to true if this device group is mapped to a pio interface
 
 	CPio *mapped_pio;	// Pointer to the pio interface this device group is mapped to
+	UINT last_dirty;	// Bits that changed during the previous frame
 
 	vector<CBoardDevice*> devices;		// List of devices in this device group
 public:
@@ -45,10 +48,11 @@ public:
 	~CBoardDeviceGroup();
 
 	void CleanUp();
-	bool Init(GtkFixed *board_area);
+	bool Init(GtkFixed *board_area, CBoardImages& images);
 	//void Draw(HDC hDC, POINT pos);
 	void ShowCorrectImages();
 	bool AddDevice(string t, string g, UINT b, string i, POINT c);
+	static bool IsValidDeviceType(const char *t);
 	bool HasPoint(UINT x, UINT y, UINT *bit);
 	void Click(UINT bit);
 	void ReleaseClick(UINT bit);
@@ -65,7 +69,7 @@ public:
 
 	void SetPIOInterface(CPio *p) {mapped_pio = p;};
 
-	void SetData(UINT data);
+	void SetData(CPio::OutputSnapshot *snapshot);
 	UINT GetData();
 };
 
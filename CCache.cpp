@@ -0,0 +1,334 @@
+/*
+NIISim - Nios II Simulator, A simulator that is capable of simulating various systems containing Nios II cpus.
+
+This file is part of NIISim.
+
+NIISim is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+NIISim is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstring>
+#include "CCache.h"
+
+// Flags of a cache line
+#define LINE_VALID	0x1
+#define LINE_DIRTY	0x2
+
+/*
+ *	CCache::CCache()
+ *
+ *  Constructor for the CCache class.
+ */
+CCache::CCache()
+{
+	size = line_size = ways = 0;
+	replacement = CACHE_REPLACE_LRU;
+	write_policy = CACHE_WRITE_BACK;
+	line_shift = set_mask = 0;
+
+	lines = NULL;
+	flags = NULL;
+	stamps = NULL;
+
+	Reset();
+}
+
+/*
+ *	CCache::~CCache()
+ *
+ *  Destructor for the CCache class.
+ */
+CCache::~CCache()
+{
+	delete[] lines;
+	delete[] flags;
+	delete[] stamps;
+}
+
+/*
+ *	CCache::Configure()
+ *
+ *  Sets the geometry and policies of the cache and empties it.
+ *
+ *	Parameters: size - The size of the cache in bytes
+ *				line_size - The size of a cache line in bytes
+ *				ways - The associativity, 1 for a direct mapped cache
+ *				replacement - The replacement policy (CACHE_REPLACE_*)
+ *				write_policy - The write policy (CACHE_WRITE_*)
+ *
+ *	Returns:	False if the sizes are not powers of two or don't fit together
+ */
+bool CCache::Configure(UINT size, UINT line_size, UINT ways, UINT replacement, UINT write_policy)
+{
+	UINT sets;
+
+	// All sizes must be powers of two
+	if(!size || (size & (size - 1)) || line_size < 4 || (line_size & (line_size - 1)) ||
+	   !ways || (ways & (ways - 1)) || size < line_size * ways)
+		return false;
+
+	this->size = size;
+	this->line_size = line_size;
+	this->ways = ways;
+	this->replacement = replacement;
+	this->write_policy = write_policy;
+
+	line_shift = __builtin_ctz(line_size);
+	sets = size / (line_size * ways);
+	set_mask = sets - 1;
+
+	delete[] lines;
+	delete[] flags;
+	delete[] stamps;
+	lines = new UINT[sets * ways];
+	flags = new UCHAR[sets * ways];
+	stamps = new UINT[sets * ways];
+
+	Reset();
+
+	return true;
+}
+
+/*
+ *	CCache::Reset()
+ *
+ *  Invalidates all lines and clears the statistics
+ */
+void CCache::Reset()
+{
+	if(flags)
+		memset(flags, 0, (set_mask + 1) * ways);
+
+	time = 0;
+	random_state = 0x12345678;
+	last_valid = false;
+
+	memset(&stats, 0, sizeof(stats));
+}
+
+/*
+ *	CCache::Victim()
+ *
+ *  Selects the way to replace in a set. An invalid way is used if there is one.
+ *
+ *	Parameters: set - The set
+ *
+ *	Returns:	The index of the line to replace
+ */
+UINT CCache::Victim(UINT set)
+{
+	UINT base, victim;
+
+	base = set * ways;
+
+	for(UINT w=0; w<ways; w++)
+	{
+		if(!(flags[base + w] & LINE_VALID))
+			return base + w;
+	}
+
+	if(replacement == CACHE_REPLACE_RANDOM)
+	{
+		// xorshift
+		random_state ^= random_state << 13;
+		random_state ^= random_state >> 17;
+		random_state ^= random_state << 5;
+		return base + random_state % ways;
+	}
+
+	// LRU and FIFO both replace the oldest stamp
+	victim = base;
+	for(UINT w=1; w<ways; w++)
+	{
+		if(time - stamps[base + w] > time - stamps[victim])
+			victim = base + w;
+	}
+	return victim;
+}
+
+/*
+ *	CCache::Evict()
+ *
+ *  Removes a line from the cache, writing it back if it is dirty
+ *
+ *	Parameters: index - The index of the line
+ */
+void CCache::Evict(UINT index)
+{
+	if((flags[index] & (LINE_VALID | LINE_DIRTY)) == (LINE_VALID | LINE_DIRTY))
+		stats.writebacks++;
+	flags[index] = 0;
+	last_valid = false;
+}
+
+/*
+ *	CCache::Access()
+ *
+ *  Looks up an address in the cache and updates it and the statistics
+ *
+ *	Parameters: addr - The address that is accessed
+ *				write - True for a store, false for a load or an instruction fetch
+ *
+ *	Returns:	True if the access was a hit
+ */
+bool CCache::Access(UINT addr, bool write)
+{
+	UINT line, base, index;
+
+	line = addr >> line_shift;
+
+	// Sequential accesses often hit the same line as the last time, which is already the most recently used one
+	if(last_valid && line == last_line)
+	{
+		if(write)
+		{
+			if(write_policy == CACHE_WRITE_BACK)
+				flags[last_index] |= LINE_DIRTY;
+			stats.write_hits++;
+		}
+		else
+		{
+			stats.read_hits++;
+		}
+		return true;
+	}
+
+	// Look in all ways of the set
+	base = (line & set_mask) * ways;
+	for(UINT w=0; w<ways; w++)
+	{
+		index = base + w;
+		if((flags[index] & LINE_VALID) && lines[index] == line)
+		{
+			if(replacement == CACHE_REPLACE_LRU)
+				stamps[index] = ++time;
+			if(write)
+			{
+				if(write_policy == CACHE_WRITE_BACK)
+					flags[index] |= LINE_DIRTY;
+				stats.write_hits++;
+			}
+			else
+			{
+				stats.read_hits++;
+			}
+
+			last_line = line;
+			last_index = index;
+			last_valid = true;
+			return true;
+		}
+	}
+
+	// Miss. A write-through cache doesn't allocate lines on writes
+	if(write)
+	{
+		stats.write_misses++;
+		if(write_policy == CACHE_WRITE_THROUGH)
+			return false;
+	}
+	else
+	{
+		stats.read_misses++;
+	}
+
+	// Fill a line
+	index = Victim(line & set_mask);
+	Evict(index);
+	lines[index] = line;
+	flags[index] = LINE_VALID | ((write && write_policy == CACHE_WRITE_BACK) ? LINE_DIRTY : 0);
+	stamps[index] = ++time;
+
+	last_line = line;
+	last_index = index;
+	last_valid = true;
+	return false;
+}
+
+/*
+ *	CCache::InitIndex()
+ *
+ *  Invalidates all lines of the set the address maps to, without writing them back.
+ *  Implements initd and initi.
+ *
+ *	Parameters: addr - The address
+ */
+void CCache::InitIndex(UINT addr)
+{
+	UINT base;
+
+	base = ((addr >> line_shift) & set_mask) * ways;
+	for(UINT w=0; w<ways; w++)
+		flags[base + w] = 0;
+	last_valid = false;
+}
+
+/*
+ *	CCache::InitAddress()
+ *
+ *  Invalidates the line caching the address if there is one, without writing it back.
+ *  Implements initda.
+ *
+ *	Parameters: addr - The address
+ */
+void CCache::InitAddress(UINT addr)
+{
+	UINT line, base;
+
+	line = addr >> line_shift;
+	base = (line & set_mask) * ways;
+	for(UINT w=0; w<ways; w++)
+	{
+		if(lines[base + w] == line)
+			flags[base + w] = 0;
+	}
+	last_valid = false;
+}
+
+/*
+ *	CCache::FlushIndex()
+ *
+ *  Writes back and invalidates all lines of the set the address maps to.
+ *  Implements flushd and flushi.
+ *
+ *	Parameters: addr - The address
+ */
+void CCache::FlushIndex(UINT addr)
+{
+	UINT base;
+
+	base = ((addr >> line_shift) & set_mask) * ways;
+	for(UINT w=0; w<ways; w++)
+		Evict(base + w);
+}
+
+/*
+ *	CCache::FlushAddress()
+ *
+ *  Writes back and invalidates the line caching the address if there is one.
+ *  Implements flushda.
+ *
+ *	Parameters: addr - The address
+ */
+void CCache::FlushAddress(UINT addr)
+{
+	UINT line, base;
+
+	line = addr >> line_shift;
+	base = (line & set_mask) * ways;
+	for(UINT w=0; w<ways; w++)
+	{
+		if(lines[base + w] == line)
+			Evict(base + w);
+	}
+}
@@ -0,0 +1,89 @@
+/*
+NIISim - Nios II Simulator, A simulator that is capable of simulating various systems containing Nios II cpus.
+
+This file is part of NIISim.
+
+NIISim is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+NIISim is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _CCACHE_H_
+#define _CCACHE_H_
+
+#include "types.h"
+
+// Constants defining the replacement policy
+#define CACHE_REPLACE_LRU		0
+#define CACHE_REPLACE_FIFO		1
+#define CACHE_REPLACE_RANDOM	2
+
+// Constants defining the write policy
+#define CACHE_WRITE_BACK		0	// Write-back with write-allocate
+#define CACHE_WRITE_THROUGH		1	// Write-through without write-allocate
+
+// Hit and miss statistics of a cache
+struct CacheStats
+{
+	UINT read_hits, read_misses;
+	UINT write_hits, write_misses;
+	UINT writebacks;		// Dirty lines written back to memory
+	UINT bypasses;			// Accesses that bypassed the cache (io instructions and bit 31 set)
+};
+
+// Model of a set associative cache. Only the tags are modelled, the data always comes from memory.
+class CCache
+{
+private:
+	UINT size;				// Size in bytes
+	UINT line_size;			// Size of a line in bytes
+	UINT ways;				// Associativity
+	UINT replacement;		// Replacement policy (CACHE_REPLACE_*)
+	UINT write_policy;		// Write policy (CACHE_WRITE_*)
+
+	UINT line_shift;		// log2(line_size)
+	UINT set_mask;			// Number of sets - 1
+
+	UINT *lines;			// The line address cached in each way of each set
+	UCHAR *flags;			// Valid and dirty flags of each way of each set
+	UINT *stamps;			// Time of the last access (LRU) or of the fill (FIFO) of each way of each set
+	UINT time;				// Counter used for the stamps
+	UINT random_state;		// State of the random replacement generator
+
+	UINT last_line;			// Line of the last access, checked first
+	UINT last_index;		// Index of last_line
+	bool last_valid;		// True if last_line is still cached
+
+	CacheStats stats;
+
+	UINT Victim(UINT set);
+	void Evict(UINT index);
+public:
+	CCache();
+	~CCache();
+
+	bool Configure(UINT size, UINT line_size, UINT ways, UINT replacement, UINT write_policy);
+	void Reset();
+
+	bool Access(UINT addr, bool write);
+	void Bypass() { stats.bypasses++; };
+
+	void InitIndex(UINT addr);
+	void InitAddress(UINT addr);
+	void FlushIndex(UINT addr);
+	void FlushAddress(UINT addr);
+
+	const CacheStats& GetStats() { return stats; };
+	UINT GetSize() { return size; };
+};
+
+#endif
@@ -22,7 +22,7 @@ along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
 #include <cstdlib>
 #include <gtk/gtk.h>
 #include <string>
-#include "sim.h"
+#include "gui.h"
 #include "CConsole.h"
 #include "CFile.h"
 
@@ -91,6 +91,11 @@ static gboolean key_press(GtkWidget *widget, GdkEvent *event, gpointer user_data
  */
 CConsole::CConsole(int console_id) : console_id(console_id)
 {
+	window = NULL;
+	text_view = NULL;
+	text_buffer = NULL;
+	window_icon = NULL;
+	close_window_function = NULL;
 	buf = "";
 
 	is_editing = false;
@@ -104,6 +109,8 @@ CConsole::CConsole(int console_id) : console_id(console_id)
  */
 CConsole::~CConsole()
 {
+	if(window_icon)
+		g_object_unref(window_icon);
 }
 
 /*
@@ -125,16 +132,43 @@ void CConsole::Clear(CConsole *self)
 /*
  *  CConsole::Init()
  *
- *  Initializes a console window from a GtkBuilder ui file.
+ *  Remembers how the console window is set up. The window itself is created by GetWindow()
+ *  the first time it is needed, text written before that is kept in the buffer.
  */
 void CConsole::Init(gboolean (*close_window_function)(gpointer sender, gpointer user_data), GdkPixbuf *window_icon)
+{
+	this->close_window_function = close_window_function;
+	this->window_icon = GDK_PIXBUF(g_object_ref(window_icon));
+}
+
+/*
+ *  CConsole::GetWindow()
+ *
+ *  Returns the console window, which is created on the first call
+ */
+GtkWidget *CConsole::GetWindow()
+{
+	if(!window)
+	{
+		CreateWindow();
+		Update();
+	}
+	return window;
+}
+
+/*
+ *  CConsole::CreateWindow()
+ *
+ *  Creates the console window from a GtkBuilder ui file.
+ */
+void CConsole::CreateWindow()
 {
 	GtkButton* clear_button;
 	GtkBuilder *builder = gtk_builder_new();
 	
 	GError *error = NULL;
 	
-	pair<char*, size_t> console_xml = CFile("console.xml.gz").decompress().read_whole_file();
+	pair<char*, size_t> console_xml = CFile("console.xml").read_whole_file();
 	if (!gtk_builder_add_from_string(builder, console_xml.first, console_xml.second, &error)){
 		g_print("Msg: %s\n", error->message);
 		g_free(error);
@@ -300,6 +334,10 @@ void CConsole::Update()
 	UINT len;
 	string text;
 
+	// The text stays in the buffer until the window is created
+	if(!window)
+		return;
+
 	// Check if the buffer has text
 	if(buf.length() > 0)
 	{
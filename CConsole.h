@@ -26,6 +26,7 @@ along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
 #include <string>
 using namespace std;
 #include "CThread.h"
+#include "CFrontEnd.h"
 
 enum {
 	CONSOLE_JTAG,
@@ -33,12 +34,14 @@ enum {
 	CONSOLE_UART1
 };
 
-class CConsole
+class CConsole : public CConsoleInterface
 {
 private:
-	GtkWidget *window;
+	GtkWidget *window;		// NULL until the console is shown the first time
 	GtkTextView *text_view;
 	GtkTextBuffer *text_buffer;
+	GdkPixbuf *window_icon;
+	gboolean (*close_window_function)(gpointer sender, gpointer user_data);
 	string buf;				//
 
 	bool is_editing;		// True if the user is typing new text in the console
@@ -46,13 +49,15 @@ private:
 	int console_id;
 
 	CMutex lock;			// Handle to a lock that will protect the buffer buf
+
+	void CreateWindow();
 public:
 	CConsole(int console_id);
 	~CConsole();
 	
 	void Init(gboolean (*close_window_function)(gpointer sender, gpointer user_data), GdkPixbuf *window_icon);
 	
-	GtkWidget *GetWindow() { return window; }
+	GtkWidget *GetWindow();
 
 	static void Clear(CConsole *self);
 	void AddText(const string& t, bool update = true);
@@ -22,6 +22,52 @@ along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
 #include "sim.h"
 #include "CCpu.h"
 
+// Timing classes of the instructions
+#define TIMING_ALU			0
+#define TIMING_SHIFT		1	// Shifts and rotates
+#define TIMING_MUL			2
+#define TIMING_DIV			3
+#define TIMING_LOAD			4
+#define TIMING_STORE		5
+#define TIMING_BRANCH		6	// Conditional branches
+#define TIMING_JUMP			7	// call, jmpi and br
+#define TIMING_JUMP_REG		8	// Jumps to an address in a register, and trap, break, eret and bret
+#define TIMING_CLASSES		9
+
+#define INSTRUCTION_TIMING(name, encoding, mnemonic, handler, timing, format) TIMING_##timing,
+#define RESERVED_TIMING(encoding) TIMING_ALU,
+
+// Timing class of each OP encoding
+static const UCHAR op_timing[64] = { OP_INSTRUCTIONS(INSTRUCTION_TIMING, RESERVED_TIMING) };
+
+// Timing class of each OPX encoding of the R-type instructions
+static const UCHAR opx_timing[64] = { OPX_INSTRUCTIONS(INSTRUCTION_TIMING, RESERVED_TIMING) };
+
+// Cycles taken by each timing class on each core, approximated from the performance tables
+// in the Nios II Processor Reference Handbook. Conditional branches are handled separately.
+// Nios II/e emulates mul and div in software, that is not modelled.
+static const UCHAR timing_cycles[4][TIMING_CLASSES] = {
+//	 ALU SHIFT MUL DIV LOAD STORE BRANCH JUMP JUMP_REG
+	{1,  1,    1,  1,  1,   1,    1,     1,   1},	// CPU_CORE_NONE
+	{6,  7,    6,  6,  6,   6,    6,     6,   6},	// CPU_CORE_E, shifts take one more cycle per bit
+	{1,  3,    3,  32, 1,   1,    1,     2,   3},	// CPU_CORE_S
+	{1,  1,    1,  1,  1,   1,    1,     2,   3}	// CPU_CORE_F
+};
+
+// Extra cycles before the result of each timing class can be used by the next instruction
+static const UCHAR timing_latency[4][TIMING_CLASSES] = {
+//	 ALU SHIFT MUL DIV LOAD STORE BRANCH JUMP JUMP_REG
+	{0,  0,    0,  0,  0,   0,    0,     0,   0},	// CPU_CORE_NONE
+	{0,  0,    0,  0,  0,   0,    0,     0,   0},	// CPU_CORE_E
+	{0,  0,    0,  0,  1,   0,    0,     0,   0},	// CPU_CORE_S
+	{0,  2,    2,  35, 2,   0,    0,     0,   0}	// CPU_CORE_F
+};
+
+// Cycles taken by a conditional branch on Nios II/s and /f
+#define BRANCH_NOT_TAKEN_CYCLES	1
+#define BRANCH_TAKEN_CYCLES		2
+#define BRANCH_MISPREDICT_CYCLES	4
+
 /*
  *	CCpu::CCpu()
  *
@@ -30,6 +76,10 @@ along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
  */
 CCpu::CCpu()
 {
+	num_register_sets = 1;
+	register_sets = new UINT[32];
+	reg = register_sets;
+
 	for(int i=0; i<32; i++)
 	{
 		reg[i] = 0;
@@ -37,8 +87,27 @@ CCpu::CCpu()
 	}
 
 	reset_addr = exception_addr = pc = 0;
-	name[0] = '\0';
+	pending_irq = 0;
+	name = 0;
 	freq = 0;
+
+	wave_pending_irq = wave_ienable = 0;
+
+	icache = dcache = NULL;
+
+	core = CPU_CORE_NONE;
+	ready_clk = hazard_reg = hazard_clk = 0;
+
+	profiler = NULL;
+
+	eic = NULL;
+
+	for(int i=0; i<CUSTOM_INSTRUCTIONS; i++)
+		custom_instructions[i].func = NULL;
+
+	mpu = enabled_mpu = NULL;
+
+	trace_entry = trace.Last();
 }
 
 /*
@@ -48,6 +117,26 @@ CCpu::CCpu()
  */
 CCpu::~CCpu()
 {
+	delete icache;
+	delete dcache;
+	delete profiler;
+	delete mpu;
+	delete[] register_sets;
+}
+
+/*
+ *	CCpu::SetShadowRegisterSets()
+ *
+ *  Sets the number of shadow register sets. Must be called before Reset().
+ *
+ *  Paramters:	n - The number of shadow register sets, 0 - CPU_MAX_SHADOW_SETS
+ */
+void CCpu::SetShadowRegisterSets(UINT n)
+{
+	delete[] register_sets;
+	num_register_sets = n + 1;
+	register_sets = new UINT[num_register_sets * 32];
+	reg = register_sets;
 }
 
 /*
@@ -58,30 +147,69 @@ CCpu::~CCpu()
  */
 void CCpu::Reset()
 {	
-	// Loop through all registers and set them to 0
+	// Loop through all registers and set them to 0. The normal register set is the current one
+	for(UINT i=0; i<num_register_sets*32; i++)
+		register_sets[i] = 0;
+	reg = register_sets;
 	for(int i=0; i<32; i++)
-	{
-		reg[i] = 0;
 		ctrl_reg[i] = 0;
+
+	// With an EIC, interrupts to the current register set are enabled after a reset
+	if(eic)
+		ctrl_reg[0] = STATUS_RSIE;
+
+	// The MPU is enabled from the start if the .sdf file sets up regions
+	enabled_mpu = NULL;
+	if(mpu)
+	{
+		mpu->Reset();
+		if(mpu->HasInitRegions())
+			SetCtrlReg(13, CONFIG_PE);
 	}
 
 	// Reset the PC
 	pc = reset_addr;
+
+	if(icache)
+		icache->Reset();
+	if(dcache)
+		dcache->Reset();
+
+	// Reset the timing model. The branch predictors start as weakly not taken
+	ready_clk = hazard_reg = hazard_clk = 0;
+	memset(branch_history, 1, sizeof(branch_history));
+
+	if(profiler)
+		profiler->Reset(pc);
+
+	trace.Reset();
+	trace_entry = trace.Last();
+
+	main_system.RecordWave(wave_ienable, ctrl_reg[3]);
 }
 
 /*
  *	CCpu::OnClock()
  *
- *  Executes one instruction and checks for hardware interrupts
+ *  Executes one instruction and checks for hardware interrupts.
+ *  Sets ready_clk to the clock cycle at which the next instruction is executed.
  */
 void CCpu::OnClock()
 {
-	UINT instr;
+	UINT instr, instr_pc;
 	Instruction s_instr;
 
+	ready_clk = main_system.GetClk() + 1;
+
 	// Check for hardware interrupts	
+	// With an EIC the interrupts come from the controller
+	if(eic)
+	{
+		if(eic->HasRequest())
+			CheckExternalInterrupt();
+	}
 	// Check if the PIE bit is 1
-	if(ctrl_reg[0] & 0x1)
+	else if(ctrl_reg[0] & 0x1)
 	{
 		// Check ipending to see if there are any hardware interrupts pending
 		if(ctrl_reg[4])
@@ -105,17 +233,19 @@ void CCpu::OnClock()
 	}
 	catch(const StopError& e)
 	{
-		ReportError(e.msg);
+		string msg = e.Format();
+		main_system.DumpTraceOnCrash(msg.c_str());
+		ReportError(msg.c_str());
 		goto do_break;
 	}
 		
 	// Handle breakpoints for debugging
-	if(main_debug.AddressIsBreakpoint(pc))
+	if(main_system.GetDebugger()->AddressIsBreakpoint(pc))
 	{
 		// Ugly label, I know...
 		do_break:
 		main_system.PauseSimulationThread();
-		main_debug.BreakFromThread(pc);
+		main_system.GetDebugger()->BreakFromThread(pc);
 		
 		while(main_system.IsSimulationRunning() && main_system.IsSimulationPaused())
 		{
@@ -138,15 +268,30 @@ void CCpu::OnClock()
 		}
 		catch(const StopError& e)
 		{
-			ReportError(e.msg);
+			string msg = e.Format();
+			main_system.DumpTraceOnCrash(msg.c_str());
+			ReportError(msg.c_str());
 			goto do_break;
 		}
 	}
 	
 	try
 	{
+		// Check that the MPU allows the instruction to be executed
+		if(enabled_mpu && !enabled_mpu->CheckFetch(pc, (ctrl_reg[0] & STATUS_U) != 0))
+		{
+			IssueMpuException(pc + 4, EXCEPTION_MPU_INSTRUCTION, pc);
+			return;
+		}
+
 		// Fetch the instruction from memory
 		instr = main_system.Read(pc, 32, false, true);
+		if(icache)
+			icache->Access(pc, false);
+		instr_pc = pc;
+		if(profiler)
+			profiler->Count(pc);
+		trace_entry = trace.Record(pc, instr);
 		
 		// Update PC to point to the next instruction
 		UpdatePC(pc+4);
@@ -163,261 +308,122 @@ void CCpu::OnClock()
 		s_instr.rC = (instr >> 17) & 0x1F;
 
 		// Execute the instruction
-		if(s_instr.OP == INSTR_R_TYPE)
+		(this->*op_handlers[s_instr.OP])(&s_instr);
+
+		// Record the destination register in the trace
+		trace_entry->result = reg[DestinationRegister(instr)];
+
+		// Charge the cycles of the instruction
+		if(core != CPU_CORE_NONE)
+			ready_clk += InstructionCycles(&s_instr, instr_pc) - 1;
+	}
+	catch(const StopError& e)
+	{
+		string msg = e.Format();
+		main_system.DumpTraceOnCrash(msg.c_str());
+		ReportError(msg.c_str());
+		goto do_break;
+	}
+}
+
+/*
+ *	CCpu::InstructionCycles()
+ *
+ *  Calculates the number of clock cycles an executed instruction takes on the selected core,
+ *  including stalls waiting for the result of the previous instruction and mispredicted branches.
+ *
+ *  Paramters:	instr - A pointer to a structure that describes the instruction
+ *				instr_pc - The address of the instruction
+ *
+ *	Returns:	The number of clock cycles
+ */
+UINT CCpu::InstructionCycles(Instruction *instr, UINT instr_pc)
+{
+	UINT timing, cycles, clk;
+	bool taken, predicted;
+
+	timing = instr->OP == INSTR_R_TYPE ? opx_timing[instr->OPX_1] : op_timing[instr->OP];
+	cycles = timing_cycles[core][timing];
+	clk = main_system.GetClk();
+
+	// Nios II/e shifts one bit per cycle. The register variants have bit 0 of OPX set
+	if(core == CPU_CORE_E && timing == TIMING_SHIFT)
+	{
+		if(instr->OPX_1 & 1)
+			cycles += reg[instr->rB] & 0x1F;
+		else
+			cycles += instr->OPX_2;
+	}
+
+	// Conditional branches on Nios II/s and /f are predicted
+	if(timing == TIMING_BRANCH && core != CPU_CORE_E)
+	{
+		taken = pc != instr_pc + 4;
+
+		if(core == CPU_CORE_S)
 		{
-			switch(s_instr.OPX_1)
-			{
-			case INSTR_R_AND:
-				ExecAnd(&s_instr);
-				break;
-
-			case INSTR_R_OR:
-				ExecOr(&s_instr);
-				break;
-
-			case INSTR_R_XOR:
-				ExecXor(&s_instr);
-				break;
-
-			case INSTR_R_NOR:
-				ExecNor(&s_instr);
-				break;
-
-			case INSTR_R_ADD:
-				ExecAdd(&s_instr);
-				break;
-
-			case INSTR_R_SUB:
-				ExecSub(&s_instr);
-				break;
-
-			case INSTR_R_MUL:
-			case INSTR_R_MULXUU:
-			case INSTR_R_MULXSU:
-			case INSTR_R_MULXSS:
-				ExecMul(&s_instr);
-				break;
-
-			case INSTR_R_DIV:
-			case INSTR_R_DIVU:
-				ExecDiv(&s_instr);
-				break;
-
-			case INSTR_R_CMPGE:
-			case INSTR_R_CMPLT:
-			case INSTR_R_CMPNE:
-			case INSTR_R_CMPEQ:
-			case INSTR_R_CMPGEU:
-			case INSTR_R_CMPLTU:
-				ExecCmp(&s_instr);
-				break;
-
-			case INSTR_R_ROLI:
-			case INSTR_R_ROL:
-			case INSTR_R_ROR:
-				ExecRotate(&s_instr);
-				break;
-
-			case INSTR_R_SLLI:
-			case INSTR_R_SLL:
-			case INSTR_R_SRLI:
-			case INSTR_R_SRL:
-			case INSTR_R_SRAI:
-			case INSTR_R_SRA:
-				ExecShift(&s_instr);
-				break;
-
-			case INSTR_R_CALLR:
-				ExecCall(&s_instr);
-				break;
-
-			case INSTR_R_ERET:
-			case INSTR_R_RET:
-			case INSTR_R_BRET:
-				ExecRet(&s_instr);
-				break;
-
-			case INSTR_R_JMP:
-				ExecJmp(&s_instr);
-				break;
-
-			case INSTR_R_TRAP:
-				ExecTrap(&s_instr);
-				break;
-
-			case INSTR_R_BREAK:
-				ExecBreak(&s_instr);
-				break;
-
-			case INSTR_R_RDCTL:
-				ExecReadControl(&s_instr);
-				break;
-
-			case INSTR_R_WRCTL:
-				ExecWriteControl(&s_instr);
-				break;
-
-			case INSTR_R_FLUSHI:
-			case INSTR_R_INITI:
-				ExecCache(&s_instr);
-				break;
-
-			case INSTR_R_FLUSHP:
-				ExecFlushPipeline(&s_instr);
-				break;
-
-			case INSTR_R_SYNC:
-				ExecSync(&s_instr);
-				break;
-
-			case INSTR_R_NEXTPC:
-				ExecNextPC(&s_instr);
-				break;
-
-			case INSTR_R_WRPRS:
-				ExecWrprs(&s_instr);
-				break;
-
-			// Unimplemented instruction
-			default:
-				IssueException(pc);
-				break;
-			}
+			// Static prediction, backward branches are predicted taken
+			predicted = (instr->IMM16 & 0x8000) != 0;
 		}
 		else
 		{
-			switch(s_instr.OP)
-			{
-			case INSTR_LDBU:
-			case INSTR_LDB:
-			case INSTR_LDHU:
-			case INSTR_LDH:
-			case INSTR_LDW:
-				ExecLoad(&s_instr, false);
-				break;
-
-			case INSTR_LDBUIO:
-			case INSTR_LDBIO:
-			case INSTR_LDHUIO:
-			case INSTR_LDHIO:
-			case INSTR_LDWIO:
-				ExecLoad(&s_instr, true);
-				break;
-
-			case INSTR_STB:
-			case INSTR_STH:
-			case INSTR_STW:
-				ExecStore(&s_instr, false);
-				break;
-
-			case INSTR_STBIO:
-			case INSTR_STHIO:
-			case INSTR_STWIO:
-				ExecStore(&s_instr, true);
-				break;
-
-			case INSTR_ANDI:
-			case INSTR_ANDHI:
-				ExecAnd(&s_instr);
-				break;
-
-			case INSTR_ORI:
-			case INSTR_ORHI:
-				ExecOr(&s_instr);
-				break;
-
-			case INSTR_XORI:
-			case INSTR_XORHI:
-				ExecXor(&s_instr);
-				break;
-
-			case INSTR_ADDI:
-				ExecAdd(&s_instr);
-				break;
-
-			case INSTR_MULI:
-				ExecMul(&s_instr);
-				break;
-
-			case INSTR_CMPGEI:
-			case INSTR_CMPLTI:
-			case INSTR_CMPNEI:
-			case INSTR_CMPEQI:
-			case INSTR_CMPGEUI:
-			case INSTR_CMPLTUI:
-				ExecCmp(&s_instr);
-				break;
-
-			case INSTR_CALL:
-				ExecCall(&s_instr);
-				break;
-
-			case INSTR_JMPI:
-				ExecJmp(&s_instr);
-				break;
-
-			case INSTR_BR:
-			case INSTR_BGE:
-			case INSTR_BLT:
-			case INSTR_BNE:
-			case INSTR_BEQ:
-			case INSTR_BGEU:
-			case INSTR_BLTU:
-				ExecBr(&s_instr);
-				break;
-
-			case INSTR_INITDA:
-			case INSTR_INITD:
-			case INSTR_FLUSHDA:
-			case INSTR_FLUSHD:
-				ExecCache(&s_instr);
-				break;
-
-			case INSTR_CUSTOM:
-				ExecCustom(&s_instr);
-				break;
-
-			case INSTR_RDPRS:
-				ExecRdprs(&s_instr);
-				break;
-
-			// Unimplemented instruction
-			default:
-				IssueException(pc);
-				break;
-			}
+			// Dynamic prediction with 2-bit counters
+			UCHAR *counter = &branch_history[(instr_pc >> 2) % CPU_BRANCH_HISTORY_SIZE];
+			predicted = *counter >= 2;
+			if(taken && *counter < 3)
+				(*counter)++;
+			else if(!taken && *counter > 0)
+				(*counter)--;
 		}
+
+		if(taken != predicted)
+			cycles = BRANCH_MISPREDICT_CYCLES;
+		else
+			cycles = taken ? BRANCH_TAKEN_CYCLES : BRANCH_NOT_TAKEN_CYCLES;
 	}
-	catch(const StopError& e)
+
+	// Stall if a source register is the result of an instruction that hasn't finished yet
+	if(hazard_reg && (int)(hazard_clk - clk) > 0)
 	{
-		ReportError(e.msg);
-		goto do_break;
+		if(instr->rA == hazard_reg ||
+		   (instr->rB == hazard_reg && (instr->OP == INSTR_R_TYPE || timing == TIMING_STORE || timing == TIMING_BRANCH)))
+			cycles += hazard_clk - clk;
 	}
+
+	// Remember the destination register of an instruction with a result latency
+	hazard_reg = 0;
+	if(timing_latency[core][timing])
+	{
+		hazard_reg = instr->OP == INSTR_R_TYPE ? instr->rC : instr->rB;
+		hazard_clk = clk + cycles + timing_latency[core][timing];
+	}
+
+	return cycles;
 }
 
 /*
  *	CCpu::ExecLoad()
  *
- *  Executes loads instructions.
+ *  Executes loads instructions. The size, the sign extension and if the data cache is
+ *  bypassed (the io variants) follow from OP.
  *
  *  Paramters:	instr - A pointer to a structure that describes the instruction
- *				io - A boolean that determines if this instruction should load data 
- *					 from the cache. False means data from cache, true means data from
- *					 the device.
  */
-void CCpu::ExecLoad(Instruction *instr, bool io)
+template<UINT OP, UINT OPX>
+void CCpu::ExecLoad(Instruction *instr)
 {
 	UINT addr, data, size;
+	const bool io = OP == INSTR_LDBUIO || OP == INSTR_LDBIO || OP == INSTR_LDHUIO || OP == INSTR_LDHIO || OP == INSTR_LDWIO;
 
 	// Compute the address
 	addr = reg[instr->rA] + SignExtend(instr->IMM16, 16);
 
 	// Check the size
-	if(instr->OP == INSTR_LDBU || instr->OP == INSTR_LDB || 
-	   instr->OP == INSTR_LDBUIO || instr->OP == INSTR_LDBIO)
+	if(OP == INSTR_LDBU || OP == INSTR_LDB || 
+	   OP == INSTR_LDBUIO || OP == INSTR_LDBIO)
 		size = 8;
-	else if(instr->OP == INSTR_LDHU || instr->OP == INSTR_LDH || 
-			instr->OP == INSTR_LDHUIO || instr->OP == INSTR_LDHIO)
+	else if(OP == INSTR_LDHU || OP == INSTR_LDH || 
+			OP == INSTR_LDHUIO || OP == INSTR_LDHIO)
 		size = 16;
 	else
 		size = 32;
@@ -432,6 +438,13 @@ void CCpu::ExecLoad(Instruction *instr, bool io)
 		return;
 	}
 
+	// Check that the MPU allows the load
+	if(enabled_mpu && !enabled_mpu->CheckLoad(addr, (ctrl_reg[0] & STATUS_U) != 0))
+	{
+		IssueMpuException(pc, EXCEPTION_MPU_DATA, addr);
+		return;
+	}
+
 	// Check if address is valid
 	if(!main_system.IsAddressValid(addr))
 	{
@@ -445,8 +458,8 @@ void CCpu::ExecLoad(Instruction *instr, bool io)
 	data = MemLoad(addr, size, io, false);
 
 	// Sign extend if needed
-	if(instr->OP == INSTR_LDB || instr->OP == INSTR_LDH || 
-	   instr->OP == INSTR_LDBIO || instr->OP == INSTR_LDHIO)
+	if(OP == INSTR_LDB || OP == INSTR_LDH || 
+	   OP == INSTR_LDBIO || OP == INSTR_LDHIO)
 		data = SignExtend(data, size);
 
 	// Write back to register
@@ -456,16 +469,16 @@ void CCpu::ExecLoad(Instruction *instr, bool io)
 /*
  *	CCpu::ExecStore()
  *
- *  Executes store instructions.
+ *  Executes store instructions. The size and if the data cache is bypassed (the io variants)
+ *  follow from OP.
  *
  *  Paramters:	instr - A pointer to a structure that describes the instruction
- *				io - A boolean that determines if this instruction should store data 
- *					 to the cache. False means data to cache, true means data to
- *					 the device.
  */
-void CCpu::ExecStore(Instruction *instr, bool io)
+template<UINT OP, UINT OPX>
+void CCpu::ExecStore(Instruction *instr)
 {
 	UINT addr, size, data;
+	const bool io = OP == INSTR_STBIO || OP == INSTR_STHIO || OP == INSTR_STWIO;
 
 	// Compute the address
 	addr = reg[instr->rA] + SignExtend(instr->IMM16, 16);
@@ -474,12 +487,12 @@ void CCpu::ExecStore(Instruction *instr, bool io)
 	data = reg[instr->rB];
 
 	// Check the size
-	if(instr->OP == INSTR_STB || instr->OP == INSTR_STBIO)
+	if(OP == INSTR_STB || OP == INSTR_STBIO)
 	{
 		size = 8;
 		data = data & 0xFF;
 	}
-	else if(instr->OP == INSTR_STH || instr->OP == INSTR_STHIO)
+	else if(OP == INSTR_STH || OP == INSTR_STHIO)
 	{
 		size = 16;
 		data = data & 0xFFFF;
@@ -499,6 +512,13 @@ void CCpu::ExecStore(Instruction *instr, bool io)
 		return;
 	}
 
+	// Check that the MPU allows the store
+	if(enabled_mpu && !enabled_mpu->CheckStore(addr, (ctrl_reg[0] & STATUS_U) != 0))
+	{
+		IssueMpuException(pc, EXCEPTION_MPU_DATA, addr);
+		return;
+	}
+
 	// Check if address is valid
 	if(!main_system.IsAddressValid(addr))
 	{
@@ -519,17 +539,18 @@ void CCpu::ExecStore(Instruction *instr, bool io)
  *
  *  Paramters:	instr - A pointer to a structure that describes the instruction
  */
+template<UINT OP, UINT OPX>
 void CCpu::ExecAnd(Instruction *instr)
 {
 	UINT data, r;
 
 	// Perform the specific AND operation
-	if(instr->OP == INSTR_R_TYPE && instr->OPX_1 == INSTR_R_AND)
+	if(OP == INSTR_R_TYPE && OPX == INSTR_R_AND)
 	{
 		data = reg[instr->rA] & reg[instr->rB];
 		r = instr->rC;
 	}
-	else if(instr->OP == INSTR_ANDHI)
+	else if(OP == INSTR_ANDHI)
 	{
 		data = reg[instr->rA] & ((instr->IMM16 << 16) & 0xFFFF0000);
 		r = instr->rB;
@@ -551,17 +572,18 @@ void CCpu::ExecAnd(Instruction *instr)
  *
  *  Paramters:	instr - A pointer to a structure that describes the instruction
  */
+template<UINT OP, UINT OPX>
 void CCpu::ExecOr(Instruction *instr)
 {
 	UINT data, r;
 
 	// Perform the specific OR operation
-	if(instr->OP == INSTR_R_TYPE && instr->OPX_1 == INSTR_R_OR)
+	if(OP == INSTR_R_TYPE && OPX == INSTR_R_OR)
 	{
 		data = reg[instr->rA] | reg[instr->rB];
 		r = instr->rC;
 	}
-	else if(instr->OP == INSTR_ORHI)
+	else if(OP == INSTR_ORHI)
 	{
 		data = reg[instr->rA] | ((instr->IMM16 << 16) & 0xFFFF0000);
 		r = instr->rB;
@@ -583,17 +605,18 @@ void CCpu::ExecOr(Instruction *instr)
  *
  *  Paramters:	instr - A pointer to a structure that describes the instruction
  */
+template<UINT OP, UINT OPX>
 void CCpu::ExecXor(Instruction *instr)
 {
 	UINT data, r;
 
 	// Perform the specific XOR operation
-	if(instr->OP == INSTR_R_TYPE && instr->OPX_1 == INSTR_R_XOR)
+	if(OP == INSTR_R_TYPE && OPX == INSTR_R_XOR)
 	{
 		data = reg[instr->rA] ^ reg[instr->rB];
 		r = instr->rC;
 	}
-	else if(instr->OP == INSTR_XORHI)
+	else if(OP == INSTR_XORHI)
 	{
 		data = reg[instr->rA] ^ ((instr->IMM16 << 16) & 0xFFFF0000);
 		r = instr->rB;
@@ -615,6 +638,7 @@ void CCpu::ExecXor(Instruction *instr)
  *
  *  Paramters:	instr - A pointer to a structure that describes the instruction
  */
+template<UINT OP, UINT OPX>
 void CCpu::ExecNor(Instruction *instr)
 {
 	UINT data;
@@ -633,17 +657,18 @@ void CCpu::ExecNor(Instruction *instr)
  *
  *  Paramters:	instr - A pointer to a structure that describes the instruction
  */
+template<UINT OP, UINT OPX>
 void CCpu::ExecAdd(Instruction *instr)
 {
 	UINT data, r;
 
 	// Perform the specific ADD operation
-	if(instr->OP == INSTR_R_TYPE && instr->OPX_1 == INSTR_R_ADD)
+	if(OP == INSTR_R_TYPE && OPX == INSTR_R_ADD)
 	{
 		data = reg[instr->rA] + reg[instr->rB];
 		r = instr->rC;
 	}
-	else if(instr->OP == INSTR_ADDI)
+	else if(OP == INSTR_ADDI)
 	{
 		data = reg[instr->rA] + SignExtend(instr->IMM16, 16);
 		r = instr->rB;
@@ -660,6 +685,7 @@ void CCpu::ExecAdd(Instruction *instr)
  *
  *  Paramters:	instr - A pointer to a structure that describes the instruction
  */
+template<UINT OP, UINT OPX>
 void CCpu::ExecSub(Instruction *instr)
 {
 	UINT data;
@@ -679,6 +705,7 @@ void CCpu::ExecSub(Instruction *instr)
  *
  *  Paramters:	instr - A pointer to a structure that describes the instruction
  */
+template<UINT OP, UINT OPX>
 void CCpu::ExecMul(Instruction *instr)
 {
 	UINT data, r;
@@ -686,30 +713,30 @@ void CCpu::ExecMul(Instruction *instr)
 
 	// Perform the specific MUL operation
 	
-	if(instr->OP == INSTR_R_TYPE)
+	if(OP == INSTR_R_TYPE)
 	{
-		if(instr->OPX_1 == INSTR_R_MUL)
+		if(OPX == INSTR_R_MUL)
 		{
 			data = (INT)reg[instr->rA] * (INT)reg[instr->rB];
 		}
-		else if(instr->OPX_1 == INSTR_R_MULXSS)
+		else if(OPX == INSTR_R_MULXSS)
 		{
 			data_64 = (__int64)(INT)reg[instr->rA] * (__int64)(INT)reg[instr->rB];
 			data = (data_64 >> 32) & 0xFFFFFFFF;
 		}
-		else if(instr->OPX_1 == INSTR_R_MULXSU)
+		else if(OPX == INSTR_R_MULXSU)
 		{
 			data_64 = (__int64)(INT)reg[instr->rA] * (__int64)reg[instr->rB];
 			data = (data_64 >> 32) & 0xFFFFFFFF;
 		}
-		else if(instr->OPX_1 == INSTR_R_MULXUU)
+		else if(OPX == INSTR_R_MULXUU)
 		{
 			data_64 = (__int64)reg[instr->rA] * (__int64)reg[instr->rB];
 			data = (data_64 >> 32) & 0xFFFFFFFF;
 		}
 		r = instr->rC;
 	}
-	else if(instr->OP == INSTR_MULI)
+	else if(OP == INSTR_MULI)
 	{
 		data = (INT)reg[instr->rA] * (INT)SignExtend(instr->IMM16, 16);
 		r = instr->rB;
@@ -726,20 +753,27 @@ void CCpu::ExecMul(Instruction *instr)
  *
  *  Paramters:	instr - A pointer to a structure that describes the instruction
  */
+template<UINT OP, UINT OPX>
 void CCpu::ExecDiv(Instruction *instr)
 {
 	UINT data;
 
+	// The results of division by zero and of 0x80000000 / -1 are undefined. Neither may
+	// be computed on the host, where they trap.
+	data = 0;
+
 	// Perform the specific DIV operation	
-	if(instr->OPX_1 == INSTR_R_DIV)
+	if(OPX == INSTR_R_DIV)
 	{
-		if(reg[instr->rB] != 0)
+		if(reg[instr->rB] == 0xFFFFFFFF)
+			data = 0 - reg[instr->rA];
+		else if(reg[instr->rB] != 0)
 			data = (INT)reg[instr->rA] / (INT)reg[instr->rB];
 	}
 	else
 	{
 		if(reg[instr->rB] != 0)
-			data = reg[instr->rA] * reg[instr->rB];
+			data = reg[instr->rA] / reg[instr->rB];
 	}
 
 	// Write back to register
@@ -753,41 +787,42 @@ void CCpu::ExecDiv(Instruction *instr)
  *
  *  Paramters:	instr - A pointer to a structure that describes the instruction
  */
+template<UINT OP, UINT OPX>
 void CCpu::ExecCmp(Instruction *instr)
 {
 	UINT data, r;
 
 	data = 0;
 	// Perform the specific cmp operation
-	if(instr->OP == INSTR_R_TYPE)
+	if(OP == INSTR_R_TYPE)
 	{
 		r = instr->rC;
-		if(instr->OPX_1 == INSTR_R_CMPGE)
+		if(OPX == INSTR_R_CMPGE)
 		{
 			if((INT)reg[instr->rA] >= (INT)reg[instr->rB])
 				data = 1;
 		}
-		else if(instr->OPX_1 == INSTR_R_CMPGEU)
+		else if(OPX == INSTR_R_CMPGEU)
 		{
 			if(reg[instr->rA] >= reg[instr->rB])
 				data = 1;
 		}
-		else if(instr->OPX_1 == INSTR_R_CMPLT)
+		else if(OPX == INSTR_R_CMPLT)
 		{
 			if((INT)reg[instr->rA] < (INT)reg[instr->rB])
 				data = 1;
 		}
-		else if(instr->OPX_1 == INSTR_R_CMPLTU)
+		else if(OPX == INSTR_R_CMPLTU)
 		{
 			if(reg[instr->rA] < reg[instr->rB])
 				data = 1;
 		}
-		else if(instr->OPX_1 == INSTR_R_CMPNE)
+		else if(OPX == INSTR_R_CMPNE)
 		{
 			if(reg[instr->rA] != reg[instr->rB])
 				data = 1;
 		}
-		else if(instr->OPX_1 == INSTR_R_CMPEQ)
+		else if(OPX == INSTR_R_CMPEQ)
 		{
 			if(reg[instr->rA] == reg[instr->rB])
 				data = 1;
@@ -796,32 +831,32 @@ void CCpu::ExecCmp(Instruction *instr)
 	else
 	{
 		r = instr->rB;
-		if(instr->OP == INSTR_CMPGEI)
+		if(OP == INSTR_CMPGEI)
 		{
 			if((INT)reg[instr->rA] >= (INT)SignExtend(instr->IMM16, 16))
 				data = 1;
 		}
-		else if(instr->OP == INSTR_CMPGEUI)
+		else if(OP == INSTR_CMPGEUI)
 		{
 			if(reg[instr->rA] >= instr->IMM16)
 				data = 1;
 		}
-		else if(instr->OP == INSTR_CMPLTI)
+		else if(OP == INSTR_CMPLTI)
 		{
 			if((INT)reg[instr->rA] < (INT)SignExtend(instr->IMM16, 16))
 				data = 1;
 		}
-		else if(instr->OP == INSTR_CMPLTUI)
+		else if(OP == INSTR_CMPLTUI)
 		{
-			if(reg[instr->rA] < SignExtend(instr->IMM16, 16))
+			if(reg[instr->rA] < instr->IMM16)
 				data = 1;
 		}
-		else if(instr->OP == INSTR_CMPNEI)
+		else if(OP == INSTR_CMPNEI)
 		{
 			if(reg[instr->rA] != SignExtend(instr->IMM16, 16))
 				data = 1;
 		}
-		else if(instr->OP == INSTR_CMPEQI)
+		else if(OP == INSTR_CMPEQI)
 		{
 			if(reg[instr->rA] == SignExtend(instr->IMM16, 16))
 				data = 1;
@@ -839,19 +874,20 @@ void CCpu::ExecCmp(Instruction *instr)
  *
  *  Paramters:	instr - A pointer to a structure that describes the instruction
  */
+template<UINT OP, UINT OPX>
 void CCpu::ExecRotate(Instruction *instr)
 {
 	UINT data, rots;
 
 	data = 0;
 	// Determine the number of rotations
-	if(instr->OPX_1 == INSTR_R_ROL || instr->OPX_1 == INSTR_R_ROR)
+	if(OPX == INSTR_R_ROL || OPX == INSTR_R_ROR)
 		rots = reg[instr->rB] & 0x1F;
 	else
 		rots = instr->OPX_2;
 
 	// Perform the rotation
-	if(instr->OPX_1 == INSTR_R_ROLI || instr->OPX_1 == INSTR_R_ROL)
+	if(OPX == INSTR_R_ROLI || OPX == INSTR_R_ROL)
 		data = (reg[instr->rA] << rots) | (reg[instr->rA] >> (32-rots));
 	else
 		data = (reg[instr->rA] >> rots) | (reg[instr->rA] << (32-rots));
@@ -867,21 +903,22 @@ void CCpu::ExecRotate(Instruction *instr)
  *
  *  Paramters:	instr - A pointer to a structure that describes the instruction
  */
+template<UINT OP, UINT OPX>
 void CCpu::ExecShift(Instruction *instr)
 {
 	UINT data, shifts;
 
 	data = 0;
 	// Determine the number of shifts
-	if(instr->OPX_1 == INSTR_R_SLL || instr->OPX_1 == INSTR_R_SRL || instr->OPX_1 == INSTR_R_SRA)
+	if(OPX == INSTR_R_SLL || OPX == INSTR_R_SRL || OPX == INSTR_R_SRA)
 		shifts = reg[instr->rB] & 0x1F;
 	else
 		shifts = instr->OPX_2;
 
 	// Perform the shift
-	if(instr->OPX_1 == INSTR_R_SLLI || instr->OPX_1 == INSTR_R_SLL)
+	if(OPX == INSTR_R_SLLI || OPX == INSTR_R_SLL)
 		data = reg[instr->rA] << shifts;
-	else if(instr->OPX_1 == INSTR_R_SRLI || instr->OPX_1 == INSTR_R_SRL)
+	else if(OPX == INSTR_R_SRLI || OPX == INSTR_R_SRL)
 		data = reg[instr->rA] >> shifts;
 	else
 		data = (INT)reg[instr->rA] >> shifts;
@@ -897,12 +934,13 @@ void CCpu::ExecShift(Instruction *instr)
  *
  *  Paramters:	instr - A pointer to a structure that describes the instruction
  */
+template<UINT OP, UINT OPX>
 void CCpu::ExecCall(Instruction *instr)
 {
 	UINT addr;
 
 	// Calculate the new pc
-	if(instr->OP == INSTR_R_TYPE && instr->OPX_1 == INSTR_R_CALLR)
+	if(OP == INSTR_R_TYPE && OPX == INSTR_R_CALLR)
 		addr = reg[instr->rA];
 	else
 		addr = (pc & 0xF0000000) | (instr->IMM26 << 2);
@@ -919,7 +957,9 @@ void CCpu::ExecCall(Instruction *instr)
 	reg[31] = pc;
 	
 	// Tell the debugger we enter a new function with the return address and current sp
-	main_debug.EnterFunctionFromThread(pc, reg[27]);
+	main_system.GetDebugger()->EnterFunctionFromThread(pc, reg[27]);
+	if(profiler)
+		profiler->Call(addr, main_system.GetClk());
 
 	// Update the PC
 	UpdatePC(addr);
@@ -932,20 +972,25 @@ void CCpu::ExecCall(Instruction *instr)
  *
  *  Paramters:	instr - A pointer to a structure that describes the instruction
  */
+template<UINT OP, UINT OPX>
 void CCpu::ExecRet(Instruction *instr)
 {
 	UINT addr;
 
 	// Return from an exception
-	if(instr->OPX_1 == INSTR_R_ERET)
+	if(OPX == INSTR_R_ERET)
 	{
-		// Copy estatus to status
-		//ctrl_reg[0] = ctrl_reg[1];
-		SetCtrlReg(0, ctrl_reg[1]);
-
-		// Retrieve the return address
+		// Retrieve the return address, before the register set is switched
 		addr = reg[29];
 
+		// Copy estatus to status. Handlers running in a shadow register set have
+		// the status saved in sstatus (r30) instead
+		//ctrl_reg[0] = ctrl_reg[1];
+		if(ctrl_reg[0] & STATUS_CRS)
+			SetCtrlReg(0, reg[30]);
+		else
+			SetCtrlReg(0, ctrl_reg[1]);
+
 		// Check if address is word aligned
 		if((addr & 0x3) != 0)
 		{
@@ -955,12 +1000,15 @@ void CCpu::ExecRet(Instruction *instr)
 		}
 
 		//jtag_console.AddText("Leaving exception handler\n", false);
+		main_system.GetDebugger()->RetFromExceptionFromThread(addr, reg[27]);
+		if(profiler)
+			profiler->Return(main_system.GetClk());
 
 		// Update the PC
 		UpdatePC(addr);
 	}
 	// Return from a call
-	else if(instr->OPX_1 == INSTR_R_RET)
+	else if(OPX == INSTR_R_RET)
 	{
 		// Retrieve the return address
 		addr = reg[31];
@@ -974,13 +1022,15 @@ void CCpu::ExecRet(Instruction *instr)
 		}
 		
 		// Tell the debugger we are returning from a function to addr with current sp
-		main_debug.RetFromThread(addr, reg[27]);
+		main_system.GetDebugger()->RetFromThread(addr, reg[27]);
+		if(profiler)
+			profiler->Return(main_system.GetClk());
 
 		// Update the PC
 		UpdatePC(addr);
 	}
 	// Return from a break
-	else if(instr->OPX_1 == INSTR_R_BRET)
+	else if(OPX == INSTR_R_BRET)
 	{
 		// Not implemented
 	}
@@ -993,12 +1043,13 @@ void CCpu::ExecRet(Instruction *instr)
  *
  *  Paramters:	instr - A pointer to a structure that describes the instruction
  */
+template<UINT OP, UINT OPX>
 void CCpu::ExecJmp(Instruction *instr)
 {
 	UINT addr;
 
 	// Calculate the new pc
-	if(instr->OP == INSTR_R_TYPE && instr->OPX_1 == INSTR_R_JMP)
+	if(OP == INSTR_R_TYPE && OPX == INSTR_R_JMP)
 		addr = reg[instr->rA];
 	else
 		addr = (pc & 0xF0000000) | (instr->IMM26 << 2);
@@ -1022,6 +1073,7 @@ void CCpu::ExecJmp(Instruction *instr)
  *
  *  Paramters:	instr - A pointer to a structure that describes the instruction
  */
+template<UINT OP, UINT OPX>
 void CCpu::ExecBr(Instruction *instr)
 {
 	UINT addr;
@@ -1029,32 +1081,32 @@ void CCpu::ExecBr(Instruction *instr)
 
 	// Determine what kind of branch instruction we have 
 	// and check if we are going to do a jump
-	if(instr->OP == INSTR_BEQ)
+	if(OP == INSTR_BEQ)
 	{
 		if(reg[instr->rA] == reg[instr->rB])
 			jump = true;
 	}
-	else if(instr->OP == INSTR_BGE)
+	else if(OP == INSTR_BGE)
 	{
 		if((INT)reg[instr->rA] >= (INT)reg[instr->rB])
 			jump = true;
 	}
-	else if(instr->OP == INSTR_BGEU)
+	else if(OP == INSTR_BGEU)
 	{
 		if(reg[instr->rA] >= reg[instr->rB])
 			jump = true;
 	}
-	else if(instr->OP == INSTR_BLT)
+	else if(OP == INSTR_BLT)
 	{
 		if((INT)reg[instr->rA] < (INT)reg[instr->rB])
 			jump = true;
 	}
-	else if(instr->OP == INSTR_BLTU)
+	else if(OP == INSTR_BLTU)
 	{
 		if(reg[instr->rA] < reg[instr->rB])
 			jump = true;
 	}
-	else if(instr->OP == INSTR_BNE)
+	else if(OP == INSTR_BNE)
 	{
 		if(reg[instr->rA] != reg[instr->rB])
 			jump = true;
@@ -1087,6 +1139,7 @@ void CCpu::ExecBr(Instruction *instr)
  *
  *  Paramters:	instr - A pointer to a structure that describes the instruction
  */
+template<UINT OP, UINT OPX>
 void CCpu::ExecTrap(Instruction *instr)
 {
 	// Issue an exception
@@ -1100,6 +1153,7 @@ void CCpu::ExecTrap(Instruction *instr)
  *
  *  Paramters:	instr - A pointer to a structure that describes the instruction
  */
+template<UINT OP, UINT OPX>
 void CCpu::ExecBreak(Instruction *instr)
 {
 	// Not implemented
@@ -1113,6 +1167,7 @@ void CCpu::ExecBreak(Instruction *instr)
  *
  *  Paramters:	instr - A pointer to a structure that describes the instruction
  */
+template<UINT OP, UINT OPX>
 void CCpu::ExecReadControl(Instruction *instr)
 {
 	// Write the data from a control register to a general purpose register
@@ -1126,11 +1181,20 @@ void CCpu::ExecReadControl(Instruction *instr)
  *
  *  Paramters:	instr - A pointer to a structure that describes the instruction
  */
+template<UINT OP, UINT OPX>
 void CCpu::ExecWriteControl(Instruction *instr)
 {
 	// Write the data from a general purpose register to a control register
 	//ctrl_reg[instr->OPX_2] = reg[instr->rA];
-	SetCtrlReg(instr->OPX_2, reg[instr->rA]);
+	if(instr->OPX_2 == 0)
+	{
+		// The CRS field of status is read only
+		SetCtrlReg(0, (reg[instr->rA] & ~STATUS_CRS) | (ctrl_reg[0] & STATUS_CRS));
+	}
+	else
+	{
+		SetCtrlReg(instr->OPX_2, reg[instr->rA]);
+	}
 }
 
 /*
@@ -1140,9 +1204,38 @@ void CCpu::ExecWriteControl(Instruction *instr)
  *
  *  Paramters:	instr - A pointer to a structure that describes the instruction
  */
+template<UINT OP, UINT OPX>
 void CCpu::ExecCache(Instruction *instr)
 {
-	// To be implemented
+	UINT addr;
+
+	if(OP == INSTR_R_TYPE)
+	{
+		// flushi and initi both invalidate the line of the instruction cache with the index of rA
+		if(icache)
+			icache->InitIndex(reg[instr->rA]);
+		return;
+	}
+
+	if(!dcache)
+		return;
+
+	addr = reg[instr->rA] + SignExtend(instr->IMM16, 16);
+	switch(OP)
+	{
+		case INSTR_INITD:
+			dcache->InitIndex(addr);
+			break;
+		case INSTR_INITDA:
+			dcache->InitAddress(addr);
+			break;
+		case INSTR_FLUSHD:
+			dcache->FlushIndex(addr);
+			break;
+		case INSTR_FLUSHDA:
+			dcache->FlushAddress(addr);
+			break;
+	}
 }
 
 /*
@@ -1152,6 +1245,7 @@ void CCpu::ExecCache(Instruction *instr)
  *
  *  Paramters:	instr - A pointer to a structure that describes the instruction
  */
+template<UINT OP, UINT OPX>
 void CCpu::ExecFlushPipeline(Instruction *instr)
 {
 	// Not implemented. We have no pipelined ISS
@@ -1164,6 +1258,7 @@ void CCpu::ExecFlushPipeline(Instruction *instr)
  *
  *  Paramters:	instr - A pointer to a structure that describes the instruction
  */
+template<UINT OP, UINT OPX>
 void CCpu::ExecSync(Instruction *instr)
 {
 	// Not implemented since memory accesses take 0 cycles
@@ -1177,6 +1272,7 @@ void CCpu::ExecSync(Instruction *instr)
  *
  *  Paramters:	instr - A pointer to a structure that describes the instruction
  */
+template<UINT OP, UINT OPX>
 void CCpu::ExecNextPC(Instruction *instr)
 {
 	// Write PC + 4 to a register
@@ -1190,10 +1286,68 @@ void CCpu::ExecNextPC(Instruction *instr)
  *
  *  Paramters:	instr - A pointer to a structure that describes the instruction
  */
+template<UINT OP, UINT OPX>
 void CCpu::ExecCustom(Instruction *instr)
 {
-	// Not implemented
-	IssueException(pc);
+	const CustomInstruction *custom;
+	UINT n, a, b, data;
+
+	// N is bits 7:0 of IMM16, followed by the writerc, readrb and readra bits
+	n = instr->IMM16 & 0xFF;
+	custom = &custom_instructions[n];
+
+	// Unbound custom instructions are unimplemented
+	if(!custom->func)
+	{
+		IssueException(pc);
+		return;
+	}
+
+	// Registers of the internal register file of the custom logic are passed as register numbers
+	a = (instr->IMM16 & 0x400) ? reg[instr->rA] : instr->rA;
+	b = (instr->IMM16 & 0x200) ? reg[instr->rB] : instr->rB;
+
+	data = custom->func(n - custom->base, a, b);
+
+	// Write back to register
+	if(instr->IMM16 & 0x100)
+		SetReg(instr->rC, data);
+
+	// Multi-cycle custom instructions stall the cpu
+	if(core != CPU_CORE_NONE && custom->latency > 1)
+		ready_clk += custom->latency - 1;
+}
+
+/*
+ *	CCpu::AddCustomInstruction()
+ *
+ *  Binds a range of custom instruction numbers to a handler
+ *
+ *  Paramters:	n - The first N of the range
+ *				count - The number of custom instructions in the range
+ *				func - The handler
+ *				latency - The number of clock cycles the instructions take, 0 or 1 for combinational logic
+ *
+ *	Returns:	False if the range is invalid or overlaps custom instructions added before
+ */
+bool CCpu::AddCustomInstruction(UINT n, UINT count, CustomInstructionFunc func, UINT latency)
+{
+	if(!count || n >= CUSTOM_INSTRUCTIONS || count > CUSTOM_INSTRUCTIONS - n)
+		return false;
+
+	for(UINT i=n; i<n+count; i++)
+	{
+		if(custom_instructions[i].func)
+			return false;
+	}
+
+	for(UINT i=n; i<n+count; i++)
+	{
+		custom_instructions[i].func = func;
+		custom_instructions[i].base = n;
+		custom_instructions[i].latency = latency;
+	}
+	return true;
 }
 
 /*
@@ -1203,10 +1357,19 @@ void CCpu::ExecCustom(Instruction *instr)
  *
  *  Paramters:	instr - A pointer to a structure that describes the instruction
  */
+template<UINT OP, UINT OPX>
 void CCpu::ExecWrprs(Instruction *instr)
 {
-	// Not implemented
-	IssueException(pc);
+	// Only cpus with shadow register sets implement wrprs
+	if(num_register_sets == 1)
+	{
+		IssueException(pc);
+		return;
+	}
+
+	// Write rA to rC in the previous register set
+	if(instr->rC != 0)
+		PreviousRegisterSet()[instr->rC] = reg[instr->rA];
 }
 
 /*
@@ -1216,12 +1379,71 @@ void CCpu::ExecWrprs(Instruction *instr)
  *
  *  Paramters:	instr - A pointer to a structure that describes the instruction
  */
+template<UINT OP, UINT OPX>
 void CCpu::ExecRdprs(Instruction *instr)
 {
-	// Not implemented
+	// Only cpus with shadow register sets implement rdprs
+	if(num_register_sets == 1)
+	{
+		IssueException(pc);
+		return;
+	}
+
+	// Read rA in the previous register set plus the immediate value to rB
+	SetReg(instr->rB, PreviousRegisterSet()[instr->rA] + SignExtend(instr->IMM16, 16));
+}
+
+/*
+ *	CCpu::ExecRType()
+ *
+ *  Executes an R-type instruction with the handler of its OPX encoding.
+ *
+ *  Paramters:	instr - A pointer to a structure that describes the instruction
+ */
+template<UINT OP, UINT OPX>
+void CCpu::ExecRType(Instruction *instr)
+{
+	(this->*opx_handlers[instr->OPX_1])(instr);
+}
+
+/*
+ *	CCpu::ExecIllegal()
+ *
+ *  Executes an unimplemented instruction.
+ *
+ *  Paramters:	instr - A pointer to a structure that describes the instruction
+ */
+template<UINT OP, UINT OPX>
+void CCpu::ExecIllegal(Instruction *instr)
+{
 	IssueException(pc);
 }
 
+#define INSTRUCTION_HANDLER(name, encoding, mnemonic, handler, timing, format) &CCpu::Exec##handler<encoding, 0>,
+#define RESERVED_HANDLER(encoding) &CCpu::ExecIllegal<encoding, 0>,
+#define R_INSTRUCTION_HANDLER(name, encoding, mnemonic, handler, timing, format) &CCpu::Exec##handler<INSTR_R_TYPE, encoding>,
+#define R_RESERVED_HANDLER(encoding) &CCpu::ExecIllegal<INSTR_R_TYPE, encoding>,
+
+// Handler of each OP encoding
+const CCpu::ExecFunc CCpu::op_handlers[64] = { OP_INSTRUCTIONS(INSTRUCTION_HANDLER, RESERVED_HANDLER) };
+
+// Handler of each OPX encoding of the R-type instructions
+const CCpu::ExecFunc CCpu::opx_handlers[64] = { OPX_INSTRUCTIONS(R_INSTRUCTION_HANDLER, R_RESERVED_HANDLER) };
+
+/*
+ *	CCpu::PreviousRegisterSet()
+ *
+ *  Returns the register set selected by the PRS field of status
+ */
+UINT *CCpu::PreviousRegisterSet()
+{
+	UINT prs = (ctrl_reg[0] & STATUS_PRS) >> STATUS_PRS_SHIFT;
+
+	if(prs >= num_register_sets)
+		prs = 0;
+	return register_sets + prs*32;
+}
+
 /*
  *	CCpu::GetReg()
  *
@@ -1286,6 +1508,7 @@ void CCpu::SetCtrlReg(UINT r, UINT data)
 		// We are writing to ienable so we must also update ipending
 		ctrl_reg[3] = data;
 		ctrl_reg[4] = pending_irq & ctrl_reg[3];
+		main_system.RecordWave(wave_ienable, data);
 		
 		/*// incase some irqs have been disabled
 		// We update ipending by ANDing it with ienable
@@ -1301,6 +1524,38 @@ void CCpu::SetCtrlReg(UINT r, UINT data)
 		// This is done by ANDing the data with ienable
 		ctrl_reg[r] = data & ctrl_reg[3];*/
 	}
+	// Check if we are writing to status
+	else if(r == 0)
+	{
+		// Switch to the register set selected by CRS
+		UINT crs = (data & STATUS_CRS) >> STATUS_CRS_SHIFT;
+		if(crs >= num_register_sets)
+		{
+			crs = 0;
+			data &= ~STATUS_CRS;
+		}
+		ctrl_reg[0] = data;
+		reg = register_sets + crs*32;
+	}
+	// Check if we are writing to config
+	else if(r == 13)
+	{
+		ctrl_reg[13] = data;
+		enabled_mpu = (data & CONFIG_PE) ? mpu : NULL;
+	}
+	// Check if we are writing to mpuacc
+	else if(r == 15)
+	{
+		// The RD and WR bits read and write the region selected by mpubase
+		ctrl_reg[15] = data & ~(MPUACC_RD | MPUACC_WR);
+		if(mpu)
+		{
+			if(data & MPUACC_WR)
+				mpu->WriteRegion(ctrl_reg[14], data);
+			else if(data & MPUACC_RD)
+				mpu->ReadRegion(&ctrl_reg[14], &ctrl_reg[15]);
+		}
+	}
 	else
 	{
 		ctrl_reg[r] = data;
@@ -1337,12 +1592,113 @@ void CCpu::IssueException(UINT old_pc)
 {
 	// Copy status to estatus
 	SetCtrlReg(1, ctrl_reg[0]);
-	// Clear the PIE bit
-	SetCtrlReg(0, ctrl_reg[0] &= 0xFFFFFFFE);
+	// Clear the PIE and U bits. Exceptions are handled in the normal register set, so
+	// CRS is copied to PRS and cleared
+	SetCtrlReg(0, ((ctrl_reg[0] & ~(STATUS_PIE | STATUS_U | STATUS_CRS | STATUS_PRS)) |
+		((ctrl_reg[0] & STATUS_CRS) << (STATUS_PRS_SHIFT - STATUS_CRS_SHIFT))));
 	// Write the old PC to reg29 (ea)
 	reg[29] = old_pc;
 	// Write the exception address to pc
 	UpdatePC(exception_addr);
+
+	// Tell the debugger we enter the exception handler
+	main_system.GetDebugger()->EnterExceptionFromThread(old_pc, reg[27]);
+
+	// The profiler shows the exception handler as called by the interrupted function
+	if(profiler)
+		profiler->Call(exception_addr, main_system.GetClk());
+}
+
+/*
+ *	CCpu::IssueMpuException()
+ *
+ *  Issues an exception for an access that the MPU doesn't allow, with the cause in the
+ *  exception control register and the address in badaddr
+ *
+ *  Paramters:	old_pc - The value of the pc that are to be written to r29 (ea)
+ *				cause - The exception cause (EXCEPTION_MPU_*)
+ *				addr - The address of the instruction or the data
+ */
+void CCpu::IssueMpuException(UINT old_pc, UINT cause, UINT addr)
+{
+	ctrl_reg[7] = cause << EXCEPTION_CAUSE_SHIFT;
+	ctrl_reg[12] = addr;
+
+	// Programs may use MPU exceptions for paging or guard pages, so the reason is only
+	// formatted when the trace is dumped
+	if(main_system.IsDumpingTraceOnCrash())
+	{
+		char reason[128];
+
+		sprintf(reason, "MPU region violation at 0x%.8X (%s)", addr, cause == EXCEPTION_MPU_INSTRUCTION ? "instruction" : "data");
+		main_system.DumpTraceOnCrash(reason);
+	}
+	IssueException(old_pc);
+}
+
+/*
+ *	CCpu::CheckExternalInterrupt()
+ *
+ *  Takes the interrupt requested by the EIC if it isn't masked. A non-maskable interrupt
+ *  is always taken, except by the handler of another one. Other interrupts are taken if PIE
+ *  is set and their level is above the current interrupt level, and if they use the current
+ *  register set only if RSIE is set.
+ *
+ *  The handler runs in the register set requested by the EIC. The status is saved in estatus
+ *  if that is the normal register set, and in sstatus (r30) of the shadow register set otherwise.
+ *  PIE is cleared in the normal register set. Shadow register sets keep PIE set and clear RSIE,
+ *  so the handler can be preempted by higher levels using other register sets.
+ */
+void CCpu::CheckExternalInterrupt()
+{
+	UINT status, crs, rrs, new_status, old_pc, sp;
+	bool nmi;
+
+	status = ctrl_reg[0];
+	crs = (status & STATUS_CRS) >> STATUS_CRS_SHIFT;
+	rrs = eic->GetRequestSet();
+	nmi = eic->GetRequestNMI();
+
+	if(status & STATUS_NMI)
+		return;
+	if(!nmi)
+	{
+		if(!(status & STATUS_PIE))
+			return;
+		if(eic->GetRequestLevel() <= (status & STATUS_IL) >> STATUS_IL_SHIFT)
+			return;
+		if(rrs == crs && !(status & STATUS_RSIE))
+			return;
+	}
+
+	// A register set the cpu doesn't have is handled in the normal register set
+	if(rrs >= num_register_sets)
+		rrs = 0;
+
+	new_status = (status & ~(STATUS_PIE | STATUS_U | STATUS_IL | STATUS_CRS | STATUS_PRS | STATUS_NMI)) |
+		(eic->GetRequestLevel() << STATUS_IL_SHIFT) | (rrs << STATUS_CRS_SHIFT) | (crs << STATUS_PRS_SHIFT);
+	if(nmi)
+		new_status |= STATUS_NMI;
+	else if(rrs != 0)
+		new_status = (new_status | STATUS_PIE) & ~STATUS_RSIE;
+
+	// The instruction at PC got interrupted so PC + 4, the next instruction, is written to ea
+	old_pc = pc + 4;
+	sp = reg[27];
+
+	if(rrs == 0)
+		SetCtrlReg(1, status);
+	else
+		register_sets[rrs*32 + 30] = status;
+	SetCtrlReg(0, new_status);
+	reg[29] = old_pc;
+	UpdatePC(eic->GetRequestHandler());
+
+	// Tell the debugger we enter the interrupt handler
+	main_system.GetDebugger()->EnterExceptionFromThread(old_pc, sp);
+
+	if(profiler)
+		profiler->Call(pc, main_system.GetClk());
 }
 
 /*
@@ -1373,6 +1729,17 @@ void CCpu::UpdatePC(UINT new_pc)
  */
 UINT CCpu::MemLoad(UINT addr, UINT size, bool io, bool fetch)
 {
+	trace_entry->addr = addr;
+
+	// Bit 31 of the address bypasses the data cache too
+	if(dcache)
+	{
+		if(io || (addr & 0x80000000))
+			dcache->Bypass();
+		else
+			dcache->Access(addr, false);
+	}
+
 	// Call the Read function of main_system
 	return main_system.Read(addr, size, io, fetch);
 }
@@ -1389,6 +1756,16 @@ UINT CCpu::MemLoad(UINT addr, UINT size, bool io, bool fetch)
  */
 void CCpu::MemStore(UINT addr, UINT size, UINT data, bool io)
 {
+	trace_entry->addr = addr;
+
+	if(dcache)
+	{
+		if(io || (addr & 0x80000000))
+			dcache->Bypass();
+		else
+			dcache->Access(addr, true);
+	}
+
 	// Call the Write function of main_system
 	main_system.Write(addr, size, data, io);
 }
@@ -1404,6 +1781,9 @@ void CCpu::AssertIRQ(UINT irq)
 {
 	pending_irq |= 1 << irq;
 	ctrl_reg[4] = pending_irq & ctrl_reg[3];
+	if(eic)
+		eic->SetLines(pending_irq);
+	main_system.RecordWave(wave_pending_irq, pending_irq);
 	
 	/*UINT tmp = 1;
 
@@ -1428,6 +1808,9 @@ void CCpu::DeassertIRQ(UINT irq)
 {
 	pending_irq &= ~(1 << irq);
 	ctrl_reg[4] = pending_irq & ctrl_reg[3];
+	if(eic)
+		eic->SetLines(pending_irq);
+	main_system.RecordWave(wave_pending_irq, pending_irq);
 	/*UINT tmp = 1;
 
 	// Set the corresponding bit in the ipending control register to 0
@@ -1440,10 +1823,23 @@ void CCpu::DeassertIRQ(UINT irq)
 		SetCtrlReg(4, ctrl_reg[4] &= ~tmp);*/
 }
 
+/*
+ *	CCpu::AddWaveSignals()
+ *
+ *  Adds the pending IRQs and the ienable control register to the wave recorder
+ *
+ *	Parameters: recorder - The wave recorder
+ */
+void CCpu::AddWaveSignals(CWaveRecorder *recorder)
+{
+	wave_pending_irq = recorder->AddSignal(GetName(), "pending_irq", 32, pending_irq);
+	wave_ienable = recorder->AddSignal(GetName(), "ienable", 32, ctrl_reg[3]);
+}
+
 /*
  *	CCpu::ShowMisalignedMemError()
  *
- *  Displays an error message for misaligned addresses
+ *  Stops the simulation with an error for misaligned addresses
  *
  *  Paramters:	addr - The address of the data
  *				size - The size of the data in bits
@@ -1459,21 +1855,19 @@ void CCpu::ShowMisalignedMemError(UINT addr, UINT size, UINT data, bool read, bo
 	if(update_pc)
 		UpdatePC(pc-4);
 
-	// Set up the correct error message
-	if(read)
-		sprintf(err.msg, "Error!\nMisaligned memory address 0x%.8X. Unable to read %d bit data.\nPC: 0x%.8X\n\nPausing simulation", addr, size, pc);
-	else
-		sprintf(err.msg, "Error!\nMisaligned memory address 0x%.8X. Unable to write %d bit data 0x%X.\nPC: 0x%.8X\n\nPausing simulation", addr, size, data, pc);
-	
-	// Display the error
-	//MessageBox(hWnd, err, "Error", MB_ICONERROR);
+	err.type = STOP_MISALIGNED_ADDRESS;
+	err.addr = addr;
+	err.size = size;
+	err.data = data;
+	err.read = read;
+	err.pc = pc;
 	throw err;
 }
 
 /*
  *	CCpu::ShowInvalidMemAddressError()
  *
- *  Displays an error message for invalid memory addresses
+ *  Stops the simulation with an error for invalid memory addresses
  *
  *  Paramters:	addr - The address of the data
  *				size - The size of the data in bits
@@ -1489,13 +1883,31 @@ void CCpu::ShowInvalidMemAddressError(UINT addr, UINT size, UINT data, bool read
 	if(update_pc)
 		UpdatePC(pc-4);
 
-	// Set up the correct error message
+	err.type = STOP_INVALID_ADDRESS;
+	err.addr = addr;
+	err.size = size;
+	err.data = data;
+	err.read = read;
+	err.pc = pc;
+	throw err;
+}
+
+/*
+ *	CCpu::StopError::Format()
+ *
+ *  Formats the message of an error that stopped the simulation
+ *
+ *	Returns:	The message
+ */
+string CCpu::StopError::Format() const
+{
+	char msg[256];
+	const char *what = type == STOP_MISALIGNED_ADDRESS ? "Misaligned" : "Invalid";
+
 	if(read)
-		sprintf(err.msg, "Error!\nInvalid memory address 0x%.8X. Unable to read %d bit data.\nPC: 0x%.8X\n\nPausing simulation", addr, size, pc);
+		sprintf(msg, "Error!\n%s memory address 0x%.8X. Unable to read %d bit data.\nPC: 0x%.8X\n\nPausing simulation", what, addr, size, pc);
 	else
-		sprintf(err.msg, "Error!\nInvalid memory address 0x%.8X. Unable to write %d bit data 0x%X.\nPC: 0x%.8X\n\nPausing simulation", addr, size, data, pc);
-	
-	// Display the error
-	//MessageBox(hWnd, err, "Error", MB_ICONERROR);
-	throw err;
+		sprintf(msg, "Error!\n%s memory address 0x%.8X. Unable to write %d bit data 0x%X.\nPC: 0x%.8X\n\nPausing simulation", what, addr, size, data, pc);
+
+	return msg;
 }
@@ -25,134 +25,54 @@ along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
 //#include <windows.h>
 #include <cstdio>
 #include <cstring>
+#include <glib.h>
 
 #include "types.h"
-
-// OP Encodings (45)
-#define INSTR_CALL		0x00
-#define INSTR_JMPI		0x01
-
-#define INSTR_LDBU		0x03
-#define INSTR_ADDI		0x04
-#define INSTR_STB		0x05
-#define INSTR_BR		0x06
-#define INSTR_LDB		0x07
-#define INSTR_CMPGEI	0x08
-
-
-#define INSTR_LDHU		0x0B
-#define INSTR_ANDI		0x0C
-#define INSTR_STH		0x0D
-#define INSTR_BGE		0x0E
-#define INSTR_LDH		0x0F
-
-#define INSTR_CMPLTI	0x10
-
-#define INSTR_INITDA	0x13
-#define INSTR_ORI		0x14
-#define INSTR_STW		0x15
-#define INSTR_BLT		0x16
-#define INSTR_LDW		0x17
-#define INSTR_CMPNEI	0x18
-
-
-#define INSTR_FLUSHDA	0x1B
-#define INSTR_XORI		0x1C
-
-#define INSTR_BNE		0x1E
-
-#define INSTR_CMPEQI	0x20
-
-#define INSTR_LDBUIO	0x23
-#define INSTR_MULI		0x24
-#define INSTR_STBIO		0x25
-#define INSTR_BEQ		0x26
-#define INSTR_LDBIO		0x27
-#define INSTR_CMPGEUI	0x28
-
-
-#define INSTR_LDHUIO	0x2B
-#define INSTR_ANDHI		0x2C
-#define INSTR_STHIO		0x2D
-#define INSTR_BGEU		0x2E
-#define INSTR_LDHIO		0x2F
-
-#define INSTR_CMPLTUI	0x30
-
-#define INSTR_CUSTOM	0x32
-#define INSTR_INITD		0x33
-#define INSTR_ORHI		0x34
-#define INSTR_STWIO		0x35
-#define INSTR_BLTU		0x36
-#define INSTR_LDWIO		0x37
-#define INSTR_RDPRS		0x38
-
-#define INSTR_R_TYPE	0x3A	// Not an instruction
-#define INSTR_FLUSHD	0x3B
-#define INSTR_XORHI		0x3C
-
-// OPX Encodings for R-Type instructions (42)
-
-#define INSTR_R_ERET	0x01
-#define INSTR_R_ROLI	0x02
-#define INSTR_R_ROL		0x03
-#define INSTR_R_FLUSHP	0x04
-#define INSTR_R_RET		0x05
-#define INSTR_R_NOR		0x06
-#define INSTR_R_MULXUU	0x07
-#define INSTR_R_CMPGE	0x08
-#define INSTR_R_BRET	0x09
-
-#define INSTR_R_ROR		0x0B
-#define INSTR_R_FLUSHI	0x0C
-#define INSTR_R_JMP		0x0D
-#define INSTR_R_AND		0x0E
-
-#define INSTR_R_CMPLT	0x10
-
-#define INSTR_R_SLLI	0x12
-#define INSTR_R_SLL		0x13
-#define INSTR_R_WRPRS	0x14
-
-#define INSTR_R_OR		0x16
-#define INSTR_R_MULXSU	0x17
-#define INSTR_R_CMPNE	0x18
-
-#define INSTR_R_SRLI	0x1A
-#define INSTR_R_SRL		0x1B
-#define INSTR_R_NEXTPC	0x1C
-#define INSTR_R_CALLR	0x1D
-#define INSTR_R_XOR		0x1E
-#define INSTR_R_MULXSS	0x1F
-
-#define INSTR_R_CMPEQ	0x20
-
-
-
-#define INSTR_R_DIVU	0x24
-#define INSTR_R_DIV		0x25
-#define INSTR_R_RDCTL	0x26
-#define INSTR_R_MUL		0x27
-#define INSTR_R_CMPGEU	0x28
-#define INSTR_R_INITI	0x29
-
-
-
-#define INSTR_R_TRAP	0x2D
-#define INSTR_R_WRCTL	0x2E
-
-#define INSTR_R_CMPLTU	0x30
-#define INSTR_R_ADD		0x31
-
-
-#define INSTR_R_BREAK	0x34
-
-#define INSTR_R_SYNC	0x36
-
-
-#define INSTR_R_SUB		0x39
-#define INSTR_R_SRAI	0x3A
-#define INSTR_R_SRA		0x3B
+#include "CCache.h"
+#include "CProfiler.h"
+#include "CEic.h"
+#include "CCustomInstruction.h"
+#include "CMpu.h"
+#include "CTrace.h"
+#include "instructions.h"
+
+// Constants defining the timing model of the cpu
+#define CPU_CORE_NONE	0	// Every instruction takes one clock cycle
+#define CPU_CORE_E		1	// Nios II/e
+#define CPU_CORE_S		2	// Nios II/s
+#define CPU_CORE_F		3	// Nios II/f
+
+// Fields of the status control register
+#define STATUS_PIE			0x00000001
+#define STATUS_U			0x00000002	// User mode
+#define STATUS_IL_SHIFT		4
+#define STATUS_IL			0x000003F0	// Interrupt level, with an EIC
+#define STATUS_CRS_SHIFT	10
+#define STATUS_CRS			0x0000FC00	// Current register set
+#define STATUS_PRS_SHIFT	16
+#define STATUS_PRS			0x003F0000	// Previous register set
+#define STATUS_NMI			0x00400000	// Handling a non-maskable interrupt, with an EIC
+#define STATUS_RSIE			0x00800000	// Interrupts to the current register set are enabled, with an EIC
+
+// Fields of the config control register
+#define CONFIG_PE			0x00000001	// MPU enabled
+
+// Exception causes, in the CAUSE field of the exception control register
+#define EXCEPTION_CAUSE_SHIFT		2
+#define EXCEPTION_MPU_INSTRUCTION	16	// MPU region violation on a fetch
+#define EXCEPTION_MPU_DATA			17	// MPU region violation on a load or store
+
+// Maximum number of shadow register sets
+#define CPU_MAX_SHADOW_SETS	63
+
+// Number of entries in the branch history table of the Nios II/f timing model
+#define CPU_BRANCH_HISTORY_SIZE 256
+
+// Errors that stop the simulation
+#define STOP_MISALIGNED_ADDRESS	0
+#define STOP_INVALID_ADDRESS	1
+
+class CWaveRecorder;
 
 class CCpu
 {
@@ -168,7 +88,9 @@ private:
 		UINT OPX_1, OPX_2; 
 		UINT OP; 
 	};
-	UINT reg[32];			// The 32 registers in the cpu
+	UINT *reg;				// The 32 registers of the current register set
+	UINT *register_sets;	// The normal register set followed by the shadow register sets
+	UINT num_register_sets;	// Number of register sets, 1 if there are no shadow register sets
 	UINT ctrl_reg[32];		// The 32 control register in the cpu (not all are used!)
 	UINT pending_irq;		// 32 pending irqs. This AND ienable == ipending
 
@@ -176,53 +98,89 @@ private:
 
 	UINT reset_addr, exception_addr;	// The reset and exception addresses
 
-	char name[256];			// The name of the cpu
+	GQuark name;			// The interned name of the cpu, 0 if it has none
 
 	UINT freq;				// The frequency of the cpu
 
+	UINT wave_pending_irq, wave_ienable;	// Signals in the wave recorder
+
+	CCache *icache, *dcache;	// The instruction and data caches, NULL if the cpu has none
+
+	UINT core;				// The timing model (CPU_CORE_*)
+	UINT ready_clk;			// Clock cycle at which the next instruction is executed
+	UINT hazard_reg;		// Register written by an instruction with a result latency, 0 if none
+	UINT hazard_clk;		// Clock cycle at which the result in hazard_reg is available
+	UCHAR branch_history[CPU_BRANCH_HISTORY_SIZE];	// 2-bit branch predictors for Nios II/f
+
+	CProfiler *profiler;	// Profiler of the running program, NULL if not profiling
+
+	CEic *eic;				// The external interrupt controller, NULL if the cpu uses ienable and ipending
+
+	CustomInstruction custom_instructions[CUSTOM_INSTRUCTIONS];	// The custom instructions, indexed by N
+
+	CMpu *mpu;				// The memory protection unit, NULL if the cpu has none
+	CMpu *enabled_mpu;		// mpu if it is enabled by config.PE, otherwise NULL
+
+	CTrace trace;			// The last executed instructions
+	TraceEntry *trace_entry;	// The entry of the executing instruction
+
+	// The handlers of the instructions are instantiated for each encoding (OP, and OPX for the 
+	// R-type instructions), so that they don't need to test the encoding when executed. 
+	// They are called through tables indexed by the encoding, generated from instructions.h
+	typedef void (CCpu::*ExecFunc)(Instruction *instr);
+	static const ExecFunc op_handlers[64];
+	static const ExecFunc opx_handlers[64];
+
+	template<UINT OP, UINT OPX> void ExecRType(Instruction *instr);
+	template<UINT OP, UINT OPX> void ExecIllegal(Instruction *instr);
+
 	// Data transfer instructions
-	void ExecLoad(Instruction *instr, bool io);
-	void ExecStore(Instruction *instr, bool io);
+	template<UINT OP, UINT OPX> void ExecLoad(Instruction *instr);
+	template<UINT OP, UINT OPX> void ExecStore(Instruction *instr);
 
 	// Arithmetic and logical instructions
-	void ExecAnd(Instruction *instr);
-	void ExecOr(Instruction *instr);
-	void ExecXor(Instruction *instr);
-	void ExecNor(Instruction *instr);
+	template<UINT OP, UINT OPX> void ExecAnd(Instruction *instr);
+	template<UINT OP, UINT OPX> void ExecOr(Instruction *instr);
+	template<UINT OP, UINT OPX> void ExecXor(Instruction *instr);
+	template<UINT OP, UINT OPX> void ExecNor(Instruction *instr);
 
-	void ExecAdd(Instruction *instr);
-	void ExecSub(Instruction *instr);
-	void ExecMul(Instruction *instr);
-	void ExecDiv(Instruction *instr);
+	template<UINT OP, UINT OPX> void ExecAdd(Instruction *instr);
+	template<UINT OP, UINT OPX> void ExecSub(Instruction *instr);
+	template<UINT OP, UINT OPX> void ExecMul(Instruction *instr);
+	template<UINT OP, UINT OPX> void ExecDiv(Instruction *instr);
 
 	// Comparison instructions
-	void ExecCmp(Instruction *instr);
+	template<UINT OP, UINT OPX> void ExecCmp(Instruction *instr);
 
 	// Shift and rotate instructions
-	void ExecRotate(Instruction *instr);
-	void ExecShift(Instruction *instr);
+	template<UINT OP, UINT OPX> void ExecRotate(Instruction *instr);
+	template<UINT OP, UINT OPX> void ExecShift(Instruction *instr);
 
 	// Program control instructions
-	void ExecCall(Instruction *instr);
-	void ExecRet(Instruction *instr);
-	void ExecJmp(Instruction *instr);
-	void ExecBr(Instruction *instr);
+	template<UINT OP, UINT OPX> void ExecCall(Instruction *instr);
+	template<UINT OP, UINT OPX> void ExecRet(Instruction *instr);
+	template<UINT OP, UINT OPX> void ExecJmp(Instruction *instr);
+	template<UINT OP, UINT OPX> void ExecBr(Instruction *instr);
 
 	// Other control instructions
-	void ExecTrap(Instruction *instr);
-	void ExecBreak(Instruction *instr);
-	void ExecReadControl(Instruction *instr);
-	void ExecWriteControl(Instruction *instr);
-	void ExecCache(Instruction *instr);
-	void ExecFlushPipeline(Instruction *instr);
-	void ExecSync(Instruction *instr);
-	void ExecNextPC(Instruction *instr);
-	void ExecCustom(Instruction *instr);
-	void ExecWrprs(Instruction *instr);
-	void ExecRdprs(Instruction *instr);
+	template<UINT OP, UINT OPX> void ExecTrap(Instruction *instr);
+	template<UINT OP, UINT OPX> void ExecBreak(Instruction *instr);
+	template<UINT OP, UINT OPX> void ExecReadControl(Instruction *instr);
+	template<UINT OP, UINT OPX> void ExecWriteControl(Instruction *instr);
+	template<UINT OP, UINT OPX> void ExecCache(Instruction *instr);
+	template<UINT OP, UINT OPX> void ExecFlushPipeline(Instruction *instr);
+	template<UINT OP, UINT OPX> void ExecSync(Instruction *instr);
+	template<UINT OP, UINT OPX> void ExecNextPC(Instruction *instr);
+	template<UINT OP, UINT OPX> void ExecCustom(Instruction *instr);
+	template<UINT OP, UINT OPX> void ExecWrprs(Instruction *instr);
+	template<UINT OP, UINT OPX> void ExecRdprs(Instruction *instr);
 
 	UINT SignExtend(UINT num, UINT bits);
+	UINT *PreviousRegisterSet();
+	UINT InstructionCycles(Instruction *instr, UINT instr_pc);
 	void IssueException(UINT old_pc);
+	void CheckExternalInterrupt();
+	void IssueMpuException(UINT old_pc, UINT cause, UINT addr);
 	void UpdatePC(UINT new_pc);
 	UINT MemLoad(UINT addr, UINT size, bool io, bool fetch);
 	void MemStore(UINT addr, UINT size, UINT data, bool io);
@@ -245,12 +203,20 @@ public:
 	UINT GetPC() { return pc; };
 	void SetPC(UINT new_pc) { pc = new_pc; };
 
-	void SetName(const char *n) { strcpy(name,  n); };
-	const char *GetName() { return name; };
+	void SetName(const char *n) { name = g_quark_from_string(n); };
+	const char *GetName() { return name ? g_quark_to_string(name) : ""; };
+	GQuark GetNameId() { return name; };
 
 	void SetFrequency(UINT f) { freq = f; };
 	UINT GetFrequency() { return freq; };
 
+	void SetShadowRegisterSets(UINT n);
+	UINT GetNumRegisterSets() { return num_register_sets; };
+
+	void SetCore(UINT c) { core = c; };
+	UINT GetCore() { return core; };
+	UINT GetReadyClk() { return ready_clk; };
+
 	void SetResetAddress(UINT addr) { reset_addr = addr; };
 	UINT GetResetAddress() { return reset_addr; };
 
@@ -261,10 +227,39 @@ public:
 	void DisableIRQ(UINT irq);
 	void AssertIRQ(UINT irq);
 	void DeassertIRQ(UINT irq);
+
+	void AddWaveSignals(CWaveRecorder *recorder);
+
+	void SetInstructionCache(CCache *cache) { delete icache; icache = cache; };
+	void SetDataCache(CCache *cache) { delete dcache; dcache = cache; };
+	CCache *GetInstructionCache() { return icache; };
+	CCache *GetDataCache() { return dcache; };
+
+	void SetProfiler(CProfiler *p) { delete profiler; profiler = p; };
+	CProfiler *GetProfiler() { return profiler; };
+
+	void SetEic(CEic *e) { eic = e; };
+	CEic *GetEic() { return eic; };
+
+	bool AddCustomInstruction(UINT n, UINT count, CustomInstructionFunc func, UINT latency);
+	void SetCustomInstructionLatency(UINT n, UINT latency) { custom_instructions[n].latency = latency; };
+
+	void SetMpu(CMpu *m) { delete mpu; mpu = m; enabled_mpu = NULL; };
+	CMpu *GetMpu() { return mpu; };
+
+	CTrace& GetTrace() { return trace; };
 	
+	// An error that stops the simulation. The message is only formatted when it is shown.
 	struct StopError 
 	{
-		char msg[256];
+		UINT type;		// STOP_*
+		UINT addr;		// The address of the data
+		UINT size;		// The size of the data in bits
+		UINT data;		// The data to write
+		bool read;		// True if it was a read transfer
+		UINT pc;		// The address of the instruction
+
+		string Format() const;
 	};
 };
 
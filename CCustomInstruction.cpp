@@ -0,0 +1,283 @@
+/*
+NIISim - Nios II Simulator, A simulator that is capable of simulating various systems containing Nios II cpus.
+
+This file is part of NIISim.
+
+NIISim is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+NIISim is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <cstring>
+#include <cmath>
+#include <climits>
+#include <string>
+#include <vector>
+#include <gmodule.h>
+using namespace std;
+#include "CCustomInstruction.h"
+
+// The loaded shared objects
+static vector<GModule*> modules;
+
+/*
+ *	CustomBitSwap()
+ *
+ *  Reverses the order of the bits of a, like the bit swap custom instruction of the Nios II examples
+ */
+static unsigned int CustomBitSwap(unsigned int n, unsigned int a, unsigned int b)
+{
+	a = ((a >> 1) & 0x55555555) | ((a & 0x55555555) << 1);
+	a = ((a >> 2) & 0x33333333) | ((a & 0x33333333) << 2);
+	a = ((a >> 4) & 0x0F0F0F0F) | ((a & 0x0F0F0F0F) << 4);
+	a = ((a >> 8) & 0x00FF00FF) | ((a & 0x00FF00FF) << 8);
+	return (a >> 16) | (a << 16);
+}
+
+/*
+ *	CustomByteSwap()
+ *
+ *  Reverses the order of the bytes of a, like the endian converter custom instruction
+ */
+static unsigned int CustomByteSwap(unsigned int n, unsigned int a, unsigned int b)
+{
+	return (a >> 24) | ((a >> 8) & 0xFF00) | ((a << 8) & 0xFF0000) | (a << 24);
+}
+
+/*
+ *	CustomCrc32()
+ *
+ *  Continues the CRC-32 (IEEE 802.3, reflected) in a with the 32 bits of b, least significant byte first
+ */
+static unsigned int CustomCrc32(unsigned int n, unsigned int a, unsigned int b)
+{
+	for(int i=0; i<32; i++, b >>= 1)
+		a = (a >> 1) ^ (((a ^ b) & 1) ? 0xEDB88320 : 0);
+	return a;
+}
+
+// Operations of the floating point custom instructions, in the order of N. Floating Point
+// Hardware 2 uses N 224-255, the original floating point custom instruction N 252-255.
+#define FP_FABSS	0
+#define FP_FNEGS	1
+#define FP_FCMPNES	2
+#define FP_FCMPEQS	3
+#define FP_FCMPGES	4
+#define FP_FCMPGTS	5
+#define FP_FCMPLES	6
+#define FP_FCMPLTS	7
+#define FP_FMAXS	8
+#define FP_FMINS	9
+#define FP_ROUND	24
+#define FP_FIXSI	25
+#define FP_FLOATIS	26
+#define FP_FSQRTS	27
+#define FP_FMULS	28
+#define FP_FADDS	29
+#define FP_FSUBS	30
+#define FP_FDIVS	31
+
+// Clock cycles of the Floating Point Hardware 2 instructions
+static const UCHAR fph2_latencies[32] = {
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 4, 8, 4, 5, 5, 16
+};
+
+// Clock cycles of the original floating point custom instruction: fmuls, fadds, fsubs and fdivs
+static const UCHAR fph1_latencies[4] = {11, 14, 14, 35};
+
+/*
+ *	FloatFromBits()
+ *
+ *  Converts the bits of a single precision float to a float. The hardware has no
+ *  denormalized numbers, they are flushed to zero.
+ */
+static float FloatFromBits(unsigned int a)
+{
+	float f;
+
+	if(!(a & 0x7F800000))
+		a &= 0x80000000;
+	memcpy(&f, &a, 4);
+	return f;
+}
+
+/*
+ *	BitsFromFloat()
+ *
+ *  Converts a float to the bits of a single precision float, flushing denormalized numbers to zero
+ */
+static unsigned int BitsFromFloat(float f)
+{
+	unsigned int a;
+
+	memcpy(&a, &f, 4);
+	if(!(a & 0x7F800000))
+		a &= 0x80000000;
+	return a;
+}
+
+/*
+ *	IntFromFloat()
+ *
+ *  Converts a float that has been rounded to an integer to an int, saturating if it is out of range
+ */
+static unsigned int IntFromFloat(float f)
+{
+	if(f != f)
+		return 0;
+	if(f >= 2147483648.0f)
+		return INT_MAX;
+	if(f < -2147483648.0f)
+		return (unsigned int)INT_MIN;
+	return (unsigned int)(int)f;
+}
+
+/*
+ *	CustomFloatingPoint()
+ *
+ *  The Floating Point Hardware 2 custom instructions, using the IEEE single precision
+ *  arithmetic of the host with round to nearest
+ */
+static unsigned int CustomFloatingPoint(unsigned int n, unsigned int a, unsigned int b)
+{
+	float fa = FloatFromBits(a), fb = FloatFromBits(b);
+
+	switch(n)
+	{
+	case FP_FABSS:
+		return a & 0x7FFFFFFF;
+	case FP_FNEGS:
+		return a ^ 0x80000000;
+	case FP_FCMPNES:
+		return fa != fb;
+	case FP_FCMPEQS:
+		return fa == fb;
+	case FP_FCMPGES:
+		return fa >= fb;
+	case FP_FCMPGTS:
+		return fa > fb;
+	case FP_FCMPLES:
+		return fa <= fb;
+	case FP_FCMPLTS:
+		return fa < fb;
+	case FP_FMAXS:
+		return BitsFromFloat(fmaxf(fa, fb));
+	case FP_FMINS:
+		return BitsFromFloat(fminf(fa, fb));
+	case FP_ROUND:
+		// Rounds halfway cases away from zero
+		return IntFromFloat(roundf(fa));
+	case FP_FIXSI:
+		// Truncates
+		return IntFromFloat(truncf(fa));
+	case FP_FLOATIS:
+		return BitsFromFloat((float)(int)a);
+	case FP_FSQRTS:
+		return BitsFromFloat(sqrtf(fa));
+	case FP_FMULS:
+		return BitsFromFloat(fa * fb);
+	case FP_FADDS:
+		return BitsFromFloat(fa + fb);
+	case FP_FSUBS:
+		return BitsFromFloat(fa - fb);
+	case FP_FDIVS:
+		return BitsFromFloat(fa / fb);
+	}
+	return 0;
+}
+
+/*
+ *	CustomFloatingPointLegacy()
+ *
+ *  The original floating point custom instruction, fmuls, fadds, fsubs and fdivs at N 252-255
+ */
+static unsigned int CustomFloatingPointLegacy(unsigned int n, unsigned int a, unsigned int b)
+{
+	return CustomFloatingPoint(n + FP_FMULS, a, b);
+}
+
+/*
+ *	FindBuiltinCustomInstruction()
+ *
+ *  Looks up a built in custom instruction handler
+ *
+ *	Parameters: name - The name of the handler
+ *
+ *	Returns:	The handler, or NULL if there is none with the name
+ */
+const BuiltinCustomInstruction *FindBuiltinCustomInstruction(const char *name)
+{
+	static const BuiltinCustomInstruction builtins[] = {
+		{"bitswap", CustomBitSwap, 1, NULL},
+		{"byteswap", CustomByteSwap, 1, NULL},
+		{"crc32", CustomCrc32, 1, NULL},
+		{"fph1", CustomFloatingPointLegacy, 4, fph1_latencies},
+		{"fph2", CustomFloatingPoint, 32, fph2_latencies}
+	};
+
+	for(UINT i=0; i<sizeof(builtins)/sizeof(BuiltinCustomInstruction); i++)
+	{
+		if(!strcmp(name, builtins[i].name))
+			return &builtins[i];
+	}
+	return NULL;
+}
+
+/*
+ *	LoadCustomInstruction()
+ *
+ *  Loads a custom instruction handler from a shared object. The shared object stays
+ *  loaded until UnloadCustomInstructionModules() is called.
+ *
+ *	Parameters: file - The file name of the shared object, relative to the working directory
+ *				symbol - The name of the handler
+ *
+ *	Returns:	The handler, or NULL if it couldn't be loaded
+ */
+CustomInstructionFunc LoadCustomInstruction(const char *file, const char *symbol)
+{
+	string path = file;
+	GModule *module;
+	gpointer func;
+
+	// g_module_open() only looks in the library paths for names without a directory
+	if(path.find('/') == string::npos)
+		path = "./" + path;
+
+	module = g_module_open(path.c_str(), G_MODULE_BIND_LOCAL);
+	if(!module)
+		return NULL;
+
+	if(!g_module_symbol(module, symbol, &func) || !func)
+	{
+		g_module_close(module);
+		return NULL;
+	}
+
+	modules.push_back(module);
+	return (CustomInstructionFunc)func;
+}
+
+/*
+ *	UnloadCustomInstructionModules()
+ *
+ *  Unloads all shared objects loaded by LoadCustomInstruction(). The cpus using their
+ *  handlers must have been deleted.
+ */
+void UnloadCustomInstructionModules()
+{
+	for(UINT i=0; i<modules.size(); i++)
+		g_module_close(modules[i]);
+	modules.clear();
+}
@@ -0,0 +1,70 @@
+/*
+NIISim - Nios II Simulator, A simulator that is capable of simulating various systems containing Nios II cpus.
+
+This file is part of NIISim.
+
+NIISim is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+NIISim is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/*
+
+This file implements the handlers of custom instructions. A range of custom instruction
+numbers (N) of a cpu is bound to a handler, which is either built in or loaded from a shared
+object. Handlers in shared objects are exported with C linkage and this signature:
+
+	extern "C" unsigned int handler(unsigned int n, unsigned int a, unsigned int b);
+
+n is the offset of N in the bound range, like the n port of an extended custom instruction.
+a and b are the values of rA and rB, or the register numbers if the instruction reads the
+internal register file of the custom logic. The result is written to rC if the instruction
+writes a cpu register.
+
+*/
+
+#ifndef _CCUSTOMINSTRUCTION_H_
+#define _CCUSTOMINSTRUCTION_H_
+
+#include "types.h"
+
+// Number of custom instructions of a cpu, N is 8 bits
+#define CUSTOM_INSTRUCTIONS		256
+
+extern "C"
+{
+	typedef unsigned int (*CustomInstructionFunc)(unsigned int n, unsigned int a, unsigned int b);
+}
+
+// A custom instruction number bound to a handler
+struct CustomInstruction
+{
+	CustomInstructionFunc func;	// The handler, NULL if the number isn't bound
+	UINT base;					// The first N of the range bound to the handler
+	UINT latency;				// Clock cycles the instruction takes
+};
+
+// A custom instruction handler built into the simulator
+struct BuiltinCustomInstruction
+{
+	const char *name;
+	CustomInstructionFunc func;
+	UINT count;					// Number of n the handler implements
+	const UCHAR *latencies;		// Clock cycles of each n, NULL if the latency is set by the .sdf file
+};
+
+const BuiltinCustomInstruction *FindBuiltinCustomInstruction(const char *name);
+CustomInstructionFunc LoadCustomInstruction(const char *file, const char *symbol);
+void UnloadCustomInstructionModules();
+
+#endif
@@ -29,7 +29,7 @@ along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
 #include <gtksourceview/gtksourcemark.h>
 #include <gtk/gtk.h>
 
-#include "sim.h"
+#include "gui.h"
 #include "CDebug.h"
 #include "elf_read_debug.h"
 #include "disassembler.h"
@@ -55,18 +55,24 @@ GtkStatusbar *statusbar;
 guint statusbar_context;
 guint statusbar_message_id = 0;
 
-GtkSourceBuffer *disasm_source_buffer;
-GtkSourceView *disasm_source_view;
+// The disassembly is a list with one row per instruction. The rows aren't stored anywhere, the model
+// makes the address and text of a row when the view asks for it, and only the visible rows are rendered.
+GtkTreeModel *disasm_model;
+GtkTreeView *disasm_view;
+GtkTreeViewColumn *disasm_mark_column;
+GdkPixbuf *breakpoint_pixbuf, *implicit_breakpoint_pixbuf, *current_pixbuf;
+vector<uint> disasm_code;
+int current_disasm_line = -1;
+
+GtkListStore *backtrace_list_store;
 
 // The base address where the code starts (the .entry point always at 0x800000)
 uint instruction_base_addr;
 set<uint> instruction_breakpoints;
-multimap<int, GtkSourceMark*> implicit_instruction_breakpoints_marks;
+multiset<int> implicit_instruction_breakpoints;
 
-// Debug info from the ELF file. Store two so we can compare a reloaded file with the older version.
-DebugInfo debug_infos[2];
-int current_debug_info = 0;
-#define debug_info debug_infos[current_debug_info]
+// Debug info from the ELF file, kept by the debugger
+#define debug_info main_debug.GetDebugInfo()
 multiset<uint> all_breakpoints;
 
 bool add_breakpoint(uint addr)
@@ -358,11 +364,14 @@ void TabPage::LineMark(GtkTextIter *iter, GdkEvent *event, GtkSourceView *view,
 	// Right click -> Go to address in the disasm window
 	if(event != NULL && event->button.button == 3)
 	{
-		GtkTextIter disasm_iter;
+		GtkTreePath *path;
 		line = (debug_info.source_to_addr[matching_breakpoints[0].first.first][line-1].front() - instruction_base_addr)/4;
-		gtk_text_buffer_get_iter_at_line(GTK_TEXT_BUFFER(disasm_source_buffer), &disasm_iter, line);
-		gtk_text_view_scroll_to_iter(GTK_TEXT_VIEW(disasm_source_view), &disasm_iter, 0.04, FALSE, 0, 0);
-		gtk_text_buffer_place_cursor(GTK_TEXT_BUFFER(disasm_source_buffer), &disasm_iter);
+		if(line < 0 || line >= (int)disasm_code.size())
+			return;
+		path = gtk_tree_path_new_from_indices(line, -1);
+		gtk_tree_view_scroll_to_cell(disasm_view, path, NULL, TRUE, 0.04, 0);
+		gtk_tree_view_set_cursor(disasm_view, path, NULL, FALSE);
+		gtk_tree_path_free(path);
 		return;
 	}
 	
@@ -395,37 +404,21 @@ void TabPage::LineMark(GtkTextIter *iter, GdkEvent *event, GtkSourceView *view,
 	vector<uint>& v = debug_info.source_to_addr[matching_breakpoints[0].first.first][line-1];
 	for(size_t i=0, e=v.size(); i!=e; i++)
 	{
-		GtkTextIter iter;
 		int line0 = (v[i] - instruction_base_addr)/4;
-		multimap<int, GtkSourceMark*>& marks = implicit_instruction_breakpoints_marks;
-		
-		multimap<int, GtkSourceMark*>::iterator it = marks.find(line0);
 		
+		// The mark is shown as long as one source line has a breakpoint at the instruction
 		if(adding)
 		{
-			if(it != marks.end()){
-				// An implicit breakpoint already exists, so only update the count.
-				marks.insert(*it);
-			}
-			else
-			{
-				gtk_text_buffer_get_iter_at_line(GTK_TEXT_BUFFER(disasm_source_buffer), &iter, line0);
-				GtkSourceMark *mark = gtk_source_buffer_create_source_mark(disasm_source_buffer, NULL, "implicit_breakpoint", &iter);
-				marks.insert(make_pair(line0, mark));
-			}
+			implicit_instruction_breakpoints.insert(line0);
 		}
 		else
 		{
-			if(marks.count(line0) == 1)
-			{
-				// Only remove it when we are get to the last one.
-				gtk_text_buffer_get_iter_at_line(GTK_TEXT_BUFFER(disasm_source_buffer), &iter, line0);
-				gtk_source_buffer_remove_source_marks(disasm_source_buffer, &iter, &iter, "implicit_breakpoint");
-			}
-			marks.erase(it);
+			multiset<int>::iterator it = implicit_instruction_breakpoints.find(line0);
+			if(it != implicit_instruction_breakpoints.end())
+				implicit_instruction_breakpoints.erase(it);
 		}
 	}
-	
+	gtk_widget_queue_draw(GTK_WIDGET(disasm_view));
 }
 
 void TabPage::GoToLine(int line1)
@@ -625,26 +618,25 @@ void add_implicit_breakpoints(const vector<pair<pair<int, int>, uint> >& matchin
 
 void delete_current_executing_disasm_line_mark(void)
 {
-	GtkTextIter start_iter, end_iter;
-	gtk_text_buffer_get_start_iter(GTK_TEXT_BUFFER(disasm_source_buffer), &start_iter);
-	gtk_text_buffer_get_end_iter(GTK_TEXT_BUFFER(disasm_source_buffer), &end_iter);
-	gtk_source_buffer_remove_source_marks(disasm_source_buffer, &start_iter, &end_iter, "current");
+	current_disasm_line = -1;
+	gtk_widget_queue_draw(GTK_WIDGET(disasm_view));
 }
 
 void set_current_executing_disasm_line_mark(uint addr)
 {
-	GtkTextIter iter;
 	int line0 = (addr - instruction_base_addr)/4;
 	
 	// Remove the old one
 	delete_current_executing_disasm_line_mark();
 	
-	// Add the new one
-	gtk_text_buffer_get_iter_at_line(GTK_TEXT_BUFFER(disasm_source_buffer), &iter, line0);
-	GtkSourceMark *mark = gtk_source_buffer_create_source_mark(disasm_source_buffer, NULL, "current", &iter);
+	if(addr < instruction_base_addr || line0 >= (int)disasm_code.size())
+		return;
 	
-	// Scroll to it
-	gtk_text_view_scroll_to_mark(GTK_TEXT_VIEW(disasm_source_view), GTK_TEXT_MARK(mark), 0.07, FALSE, 0, 0);
+	// Add the new one and scroll to it
+	current_disasm_line = line0;
+	GtkTreePath *path = gtk_tree_path_new_from_indices(line0, -1);
+	gtk_tree_view_scroll_to_cell(disasm_view, path, NULL, FALSE, 0, 0);
+	gtk_tree_path_free(path);
 }
 
 gboolean later_go_to_line(gpointer user_data)
@@ -666,20 +658,8 @@ gboolean later_go_to_line(gpointer user_data)
 	return FALSE;
 }
 
-void toggle_instruction_breakpoint(GtkSourceView *view, GtkTextIter *iter, GdkEvent *event, int line)
+void toggle_instruction_breakpoint(GdkEvent *event, int line)
 {
-	// If iter == NULL then line must be set by the caller
-	GtkTextIter iter2;
-	if(iter != NULL)
-	{
-		line = gtk_text_iter_get_line(iter);
-	}
-	else
-	{
-		iter = &iter2;
-		gtk_text_buffer_get_iter_at_line(GTK_TEXT_BUFFER(disasm_source_buffer), iter, line);
-	}
-	
 	uint addr = instruction_base_addr + line*4;
 	
 	// Right click -> Go to line in source code
@@ -709,7 +689,6 @@ void toggle_instruction_breakpoint(GtkSourceView *view, GtkTextIter *iter, GdkEv
 	set<uint>::iterator it = instruction_breakpoints.find(addr);
 	if(it != instruction_breakpoints.end())
 	{
-		gtk_source_buffer_remove_source_marks(disasm_source_buffer, iter, iter, "breakpoint");
 		instruction_breakpoints.erase(it);
 		if(remove_breakpoint(addr))
 			main_debug.SetBreakpoint(addr);
@@ -717,12 +696,12 @@ void toggle_instruction_breakpoint(GtkSourceView *view, GtkTextIter *iter, GdkEv
 	}
 	else
 	{
-		GtkSourceMark *mark = gtk_source_buffer_create_source_mark(disasm_source_buffer, NULL, "breakpoint", iter);
 		instruction_breakpoints.insert(addr);
 		if(add_breakpoint(addr))
 			main_debug.SetBreakpoint(addr);
 		adding = true;
 	}
+	gtk_widget_queue_draw(GTK_WIDGET(disasm_view));
 	
 	uint addr_with_source = debug_info.GetNearestPrecedingAddrWithSourceInformation(addr);
 	if(addr_with_source == ~0)
@@ -743,6 +722,208 @@ void toggle_instruction_breakpoint(GtkSourceView *view, GtkTextIter *iter, GdkEv
 	add_implicit_breakpoints(source_matchings, 0, adding);
 }
 
+/*
+ * disasm_text()
+ *
+ * Disassembles a row in the disassembly into buffer
+ */
+void disasm_text(int line, char *buffer)
+{
+	uint addr = instruction_base_addr + line*4;
+	sprintf(buffer, "%p: %08x %s", (void*)(size_t)addr, disasm_code[line], DumpDisasm(DecompileInstruction(addr, disasm_code[line])));
+}
+
+/*
+ * DisasmModel
+ *
+ * A list model with a row for every instruction in disasm_code. Column 0 is the address
+ * and column 1 the disassembled text. An iter holds the row index in user_data, and the
+ * stamp is changed when new code is loaded so that old iters are invalid.
+ */
+#define DISASM_COLUMN_ADDR	0
+#define DISASM_COLUMN_TEXT	1
+#define DISASM_N_COLUMNS	2
+
+struct DisasmModel
+{
+	GObject parent;
+	gint stamp;
+};
+
+struct DisasmModelClass
+{
+	GObjectClass parent_class;
+};
+
+void disasm_model_tree_model_init(GtkTreeModelIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE(DisasmModel, disasm_model, G_TYPE_OBJECT,
+						G_IMPLEMENT_INTERFACE(GTK_TYPE_TREE_MODEL, disasm_model_tree_model_init))
+
+void disasm_model_init(DisasmModel *model)
+{
+	model->stamp = g_random_int();
+}
+
+void disasm_model_class_init(DisasmModelClass *klass)
+{
+}
+
+gboolean disasm_model_set_iter(GtkTreeModel *model, GtkTreeIter *iter, int line)
+{
+	if(line < 0 || line >= (int)disasm_code.size())
+		return FALSE;
+	
+	iter->stamp = ((DisasmModel*)model)->stamp;
+	iter->user_data = GINT_TO_POINTER(line);
+	return TRUE;
+}
+
+GtkTreeModelFlags disasm_model_get_flags(GtkTreeModel *model)
+{
+	return GtkTreeModelFlags(GTK_TREE_MODEL_LIST_ONLY | GTK_TREE_MODEL_ITERS_PERSIST);
+}
+
+gint disasm_model_get_n_columns(GtkTreeModel *model)
+{
+	return DISASM_N_COLUMNS;
+}
+
+GType disasm_model_get_column_type(GtkTreeModel *model, gint index)
+{
+	return index == DISASM_COLUMN_ADDR ? G_TYPE_UINT : G_TYPE_STRING;
+}
+
+gboolean disasm_model_get_iter(GtkTreeModel *model, GtkTreeIter *iter, GtkTreePath *path)
+{
+	if(gtk_tree_path_get_depth(path) != 1)
+		return FALSE;
+	return disasm_model_set_iter(model, iter, gtk_tree_path_get_indices(path)[0]);
+}
+
+GtkTreePath *disasm_model_get_path(GtkTreeModel *model, GtkTreeIter *iter)
+{
+	return gtk_tree_path_new_from_indices(GPOINTER_TO_INT(iter->user_data), -1);
+}
+
+void disasm_model_get_value(GtkTreeModel *model, GtkTreeIter *iter, gint column, GValue *value)
+{
+	int line = GPOINTER_TO_INT(iter->user_data);
+	
+	if(column == DISASM_COLUMN_ADDR)
+	{
+		g_value_init(value, G_TYPE_UINT);
+		g_value_set_uint(value, instruction_base_addr + line*4);
+	}
+	else
+	{
+		char buffer[64];
+		disasm_text(line, buffer);
+		g_value_init(value, G_TYPE_STRING);
+		g_value_set_string(value, buffer);
+	}
+}
+
+gboolean disasm_model_iter_next(GtkTreeModel *model, GtkTreeIter *iter)
+{
+	return disasm_model_set_iter(model, iter, GPOINTER_TO_INT(iter->user_data) + 1);
+}
+
+gboolean disasm_model_iter_children(GtkTreeModel *model, GtkTreeIter *iter, GtkTreeIter *parent)
+{
+	return parent ? FALSE : disasm_model_set_iter(model, iter, 0);
+}
+
+gboolean disasm_model_iter_has_child(GtkTreeModel *model, GtkTreeIter *iter)
+{
+	return FALSE;
+}
+
+gint disasm_model_iter_n_children(GtkTreeModel *model, GtkTreeIter *iter)
+{
+	return iter ? 0 : disasm_code.size();
+}
+
+gboolean disasm_model_iter_nth_child(GtkTreeModel *model, GtkTreeIter *iter, GtkTreeIter *parent, gint n)
+{
+	return parent ? FALSE : disasm_model_set_iter(model, iter, n);
+}
+
+gboolean disasm_model_iter_parent(GtkTreeModel *model, GtkTreeIter *iter, GtkTreeIter *child)
+{
+	return FALSE;
+}
+
+void disasm_model_tree_model_init(GtkTreeModelIface *iface)
+{
+	iface->get_flags = disasm_model_get_flags;
+	iface->get_n_columns = disasm_model_get_n_columns;
+	iface->get_column_type = disasm_model_get_column_type;
+	iface->get_iter = disasm_model_get_iter;
+	iface->get_path = disasm_model_get_path;
+	iface->get_value = disasm_model_get_value;
+	iface->iter_next = disasm_model_iter_next;
+	iface->iter_children = disasm_model_iter_children;
+	iface->iter_has_child = disasm_model_iter_has_child;
+	iface->iter_n_children = disasm_model_iter_n_children;
+	iface->iter_nth_child = disasm_model_iter_nth_child;
+	iface->iter_parent = disasm_model_iter_parent;
+}
+
+void disasm_mark_data_func(GtkTreeViewColumn *column, GtkCellRenderer *renderer, GtkTreeModel *model, GtkTreeIter *iter, gpointer user_data)
+{
+	uint addr;
+	gtk_tree_model_get(model, iter, DISASM_COLUMN_ADDR, &addr, -1);
+	int line = (addr - instruction_base_addr)/4;
+	
+	// The arrow is shown over breakpoints, and breakpoints over implicit breakpoints
+	GdkPixbuf *pixbuf = NULL;
+	if(line == current_disasm_line)
+		pixbuf = current_pixbuf;
+	else if(instruction_breakpoints.count(addr))
+		pixbuf = breakpoint_pixbuf;
+	else if(implicit_instruction_breakpoints.count(line))
+		pixbuf = implicit_breakpoint_pixbuf;
+	
+	g_object_set(renderer, "pixbuf", pixbuf, NULL);
+}
+
+gboolean disasm_button_press_callback(GtkWidget *widget, GdkEventButton *event, gpointer user_data)
+{
+	GtkTreePath *path;
+	GtkTreeViewColumn *column;
+	
+	// Clicks on the marks toggle breakpoints, other clicks select rows as usual
+	if(event->type != GDK_BUTTON_PRESS || (event->button != 1 && event->button != 3))
+		return FALSE;
+	if(!gtk_tree_view_get_path_at_pos(disasm_view, (gint)event->x, (gint)event->y, &path, &column, NULL, NULL))
+		return FALSE;
+	
+	int line = gtk_tree_path_get_indices(path)[0];
+	gtk_tree_path_free(path);
+	if(column != disasm_mark_column)
+		return FALSE;
+	
+	toggle_instruction_breakpoint((GdkEvent*)event, line);
+	return TRUE;
+}
+
+gboolean disasm_tooltip_callback(GtkWidget *widget, gint x, gint y, gboolean keyboard_mode, GtkTooltip *tooltip, gpointer user_data)
+{
+	GtkTreeViewColumn *column;
+	gint bin_x, bin_y;
+	
+	if(keyboard_mode)
+		return FALSE;
+	
+	gtk_tree_view_convert_widget_to_bin_window_coords(disasm_view, x, y, &bin_x, &bin_y);
+	if(!gtk_tree_view_get_path_at_pos(disasm_view, bin_x, bin_y, NULL, &column, NULL, NULL) || column != disasm_mark_column)
+		return FALSE;
+	
+	gtk_tooltip_set_text(tooltip, (const gchar*)user_data);
+	return TRUE;
+}
+
 gboolean later_line_mark(gpointer user_data)
 {
 	// Lock the GUI
@@ -780,6 +961,39 @@ gboolean update_statusbar_callback(gpointer user_data)
 	return FALSE;
 }
 
+/*
+ * add_backtrace_row()
+ *
+ * Adds a frame to the backtrace list, with the function and source line of addr
+ */
+void add_backtrace_row(const char *frame, uint addr)
+{
+	char location[16];
+	string function, source;
+	GtkTreeIter iter;
+	
+	const ELFSymbol *symbol = FindFunctionSymbol(main_debug.GetFunctionSymbols(), addr);
+	sprintf(location, "0x%08x", addr);
+	function = symbol ? symbol->name : "??";
+	source = location;
+	
+	uint addr_with_source = debug_info.GetNearestPrecedingAddrWithSourceInformation(addr);
+	if(addr_with_source != ~0)
+	{
+		const vector<pair<int, int> >& lines = debug_info.AddrToSource(addr_with_source);
+		if(!lines.empty())
+		{
+			const string& path = debug_info.source_files[lines[0].first];
+			size_t slash = path.find_last_of("/\\");
+			sprintf(location, ":%d", lines[0].second);
+			source = (slash == string::npos ? path : path.substr(slash+1)) + location;
+		}
+	}
+	
+	gtk_list_store_append(backtrace_list_store, &iter);
+	gtk_list_store_set(backtrace_list_store, &iter, 0, frame, 1, function.c_str(), 2, source.c_str(), -1);
+}
+
 gboolean break_callback(gpointer user_data)
 {
 	// The system might have been stopped by the user in the last cpu cycle
@@ -793,6 +1007,7 @@ gboolean break_callback(gpointer user_data)
 	
 	// Set arrows
 	main_debug.SetCurrentExecutingLineMarks(addr, true, true);
+	main_debug.UpdateBacktrace(addr);
 	
 	// Update the run, pause and stop buttons
 	SetSensitiveButtons(true, false, true);
@@ -819,6 +1034,7 @@ void CDebug::Init(GtkBuilder *builder)
 	tree_store = GTK_TREE_STORE(gtk_builder_get_object(builder, "debugFilesTreeStore"));
 	tab_container = GTK_NOTEBOOK(gtk_builder_get_object(builder, "tabOpenedFiles"));
 	statusbar = GTK_STATUSBAR(gtk_builder_get_object(builder, "debugStatusBar"));
+	backtrace_list_store = GTK_LIST_STORE(gtk_builder_get_object(builder, "debugBacktraceListStore"));
 	
 	g_signal_connect(G_OBJECT(tree_view), "row-activated", G_CALLBACK(open_file_from_tree), NULL);
 	
@@ -834,35 +1050,42 @@ void CDebug::Init(GtkBuilder *builder)
 	g_signal_connect_swapped(continue_button, "clicked", G_CALLBACK(&CDebug::Continue), this);
 	g_signal_connect_swapped(step_instruction_button, "clicked", G_CALLBACK(&CDebug::StepInstruction), this);
 	
-	// Init the disassembled view
+	// Init the disassembled view. All rows have the same height, so only the visible ones are measured and drawn.
 	GtkContainer *disasm_container = GTK_CONTAINER(gtk_builder_get_object(builder, "scrolledWindowDisasm"));
-	disasm_source_buffer = gtk_source_buffer_new(NULL);
-	disasm_source_view = (GtkSourceView*)gtk_source_view_new_with_buffer(disasm_source_buffer);
-	gtk_text_view_set_editable(GTK_TEXT_VIEW(disasm_source_view), FALSE);
-	
-	GdkPixbuf *red = gdk_pixbuf_new_from_stream(CFile("red.png").get_input_stream(), NULL, NULL);
-	GdkPixbuf *pink = gdk_pixbuf_new_from_stream(CFile("pink.png").get_input_stream(), NULL, NULL);
-	GdkPixbuf *arrow = gdk_pixbuf_new_from_stream(CFile("arrow.png").get_input_stream(), NULL, NULL);
-	gtk_source_view_set_mark_category_icon_from_pixbuf(disasm_source_view, "breakpoint", red);
-	gtk_source_view_set_mark_category_icon_from_pixbuf(disasm_source_view, "implicit_breakpoint", pink);
-	gtk_source_view_set_mark_category_icon_from_pixbuf(disasm_source_view, "current", arrow);
-	gtk_source_view_set_mark_category_priority(disasm_source_view, "breakpoint", 2);
-	gtk_source_view_set_mark_category_priority(disasm_source_view, "implicit_breakpoint", 1);
-	gtk_source_view_set_mark_category_priority(disasm_source_view, "current", 3);
-	g_object_unref(red);
-	g_object_unref(pink);
-	g_object_unref(arrow);
+	disasm_model = GTK_TREE_MODEL(g_object_new(disasm_model_get_type(), NULL));
+	disasm_view = GTK_TREE_VIEW(gtk_tree_view_new_with_model(disasm_model));
+	gtk_tree_view_set_headers_visible(disasm_view, FALSE);
+	
+	breakpoint_pixbuf = gdk_pixbuf_new_from_stream(CFile("red.png").get_input_stream(), NULL, NULL);
+	implicit_breakpoint_pixbuf = gdk_pixbuf_new_from_stream(CFile("pink.png").get_input_stream(), NULL, NULL);
+	current_pixbuf = gdk_pixbuf_new_from_stream(CFile("arrow.png").get_input_stream(), NULL, NULL);
+	
+	GtkCellRenderer *mark_renderer = gtk_cell_renderer_pixbuf_new();
+	disasm_mark_column = gtk_tree_view_column_new();
+	gtk_tree_view_column_set_sizing(disasm_mark_column, GTK_TREE_VIEW_COLUMN_FIXED);
+	gtk_tree_view_column_set_fixed_width(disasm_mark_column, 20);
+	gtk_tree_view_column_pack_start(disasm_mark_column, mark_renderer, TRUE);
+	gtk_tree_view_column_set_cell_data_func(disasm_mark_column, mark_renderer, disasm_mark_data_func, NULL, NULL);
+	gtk_tree_view_append_column(disasm_view, disasm_mark_column);
+	
+	GtkCellRenderer *text_renderer = gtk_cell_renderer_text_new();
+	g_object_set(text_renderer, "family", "monospace", NULL);
+	GtkTreeViewColumn *text_column = gtk_tree_view_column_new();
+	gtk_tree_view_column_set_sizing(text_column, GTK_TREE_VIEW_COLUMN_FIXED);
+	gtk_tree_view_column_set_fixed_width(text_column, 500);
+	gtk_tree_view_column_pack_start(text_column, text_renderer, TRUE);
+	gtk_tree_view_column_add_attribute(text_column, text_renderer, "text", DISASM_COLUMN_TEXT);
+	gtk_tree_view_append_column(disasm_view, text_column);
+	
+	gtk_tree_view_set_fixed_height_mode(disasm_view, TRUE);
 	
 	// Set up tooltip
-	GtkSourceGutter *gutter = gtk_source_view_get_gutter(disasm_source_view, GTK_TEXT_WINDOW_LEFT);
-	g_signal_connect(G_OBJECT(gutter), "query-tooltip", G_CALLBACK(gutter_tooltip_callback), (gpointer)"Left click: Toggle breakpoint\nRight click: Go to matching source code line");
-	gtk_widget_set_has_tooltip(GTK_WIDGET(disasm_source_view), TRUE);
+	g_signal_connect(G_OBJECT(disasm_view), "query-tooltip", G_CALLBACK(disasm_tooltip_callback), (gpointer)"Left click: Toggle breakpoint\nRight click: Go to matching source code line");
+	gtk_widget_set_has_tooltip(GTK_WIDGET(disasm_view), TRUE);
 	
-	gtk_source_view_set_show_line_numbers(disasm_source_view, TRUE);
-	gtk_source_view_set_show_line_marks(disasm_source_view, TRUE);
-	g_signal_connect(G_OBJECT(disasm_source_view), "line-mark-activated", G_CALLBACK(toggle_instruction_breakpoint), NULL);
-	gtk_widget_show(GTK_WIDGET(disasm_source_view));
-	gtk_container_add(disasm_container, (GtkWidget*)disasm_source_view);
+	g_signal_connect(G_OBJECT(disasm_view), "button-press-event", G_CALLBACK(disasm_button_press_callback), NULL);
+	gtk_widget_show(GTK_WIDGET(disasm_view));
+	gtk_container_add(disasm_container, (GtkWidget*)disasm_view);
 	
 	statusbar_context = gtk_statusbar_get_context_id(statusbar, "context");
 	
@@ -872,18 +1095,6 @@ void CDebug::Init(GtkBuilder *builder)
 	//gtk_source_view_set_mark_attributes(GTK_SOURCE_VIEW(widget), "breakpoint", attributes, 0);
 }
 
-/*
- *  CDebug::SetMemoryInfo()
- *
- *  Tell the debugger about the location and span of the sdram
- */
-void CDebug::SetMemoryInfo(uint base, uint span)
-{
-	memory_base_addr = base;
-	address_has_breakpoint.assign(span, false);
-	all_source_breakpoints.assign(span, false);
-}
-
 /*
  * CDebug::LoadELFFile()
  *
@@ -898,12 +1109,11 @@ void CDebug::LoadELFFile(const char *filedata)
 	}
 	while(!instruction_breakpoints.empty())
 	{
-		toggle_instruction_breakpoint(NULL, NULL, NULL, (*instruction_breakpoints.begin() - instruction_base_addr)/4);
+		toggle_instruction_breakpoint(NULL, (*instruction_breakpoints.begin() - instruction_base_addr)/4);
 	}
 	
 	// Load debugging info
-	current_debug_info = !current_debug_info;
-	BuildDebugInfo(debug_info, filedata);
+	CDebugger::LoadELFFile(filedata);
 	if(debug_infos[0].source_files != debug_infos[1].source_files)
 	{
 		TabPage::RemoveAllPages();
@@ -918,17 +1128,7 @@ void CDebug::LoadELFFile(const char *filedata)
 		}
 	}
 	
-	address_has_breakpoint.assign(address_has_breakpoint.size(), false);
-	all_source_breakpoints.assign(all_source_breakpoints.size(), false);
-	
-	for(size_t i=0, e=debug_info.addresses.size(); i!=e; i++)
-	{
-		all_source_breakpoints[debug_info.addresses[i] - memory_base_addr] = true;
-	}
-	
 	// Load the Disassembly
-	string disasm;
-	
 	pair<pair<uint*, size_t>, uint> entry_section = ELFReadSection(filedata, ".entry");
 	pair<pair<uint*, size_t>, uint> exceptions_section = ELFReadSection(filedata, ".exceptions");
 	pair<pair<uint*, size_t>, uint> text_section = ELFReadSection(filedata, ".text");
@@ -943,30 +1143,14 @@ void CDebug::LoadELFFile(const char *filedata)
 		puts("some failure while reading .entry, .exceptions and .text...");
 	}
 	
-	for(size_t i=0; i<code_section.first.second; i++)
-	{
-		uint instr = code_section.first.first[i];
-		uint addr = code_section.second + i*4;
-		
-		char buffer[64];
-		int len = sprintf(buffer, "%p: %08x %s\n", (void*)addr, instr, DumpDisasm(DecompileInstruction(addr, instr)));
-		if (len < 0)
-			continue;
-		disasm.append(buffer, len);
-	}
-	gtk_text_buffer_set_text(GTK_TEXT_BUFFER(disasm_source_buffer), disasm.c_str(), disasm.size());
+	// The model is detached while the code changes, and the view reads the new row count when it is attached again.
+	// The instructions are disassembled when their rows are shown.
+	gtk_tree_view_set_model(disasm_view, NULL);
 	instruction_base_addr = code_section.second;
-}
-
-/*
- * CDebug::SetBreakpoints()
- *
- * Set an instruction breakpoint at each address in the vector
- */
-void CDebug::SetBreakpoints(const vector<uint>& addrs)
-{
-	for(size_t i=0, e=addrs.size(); i!=e; i++)
-		SetBreakpoint(addrs[i]);
+	disasm_code.assign(code_section.first.first, code_section.first.first + code_section.first.second);
+	current_disasm_line = -1;
+	((DisasmModel*)disasm_model)->stamp++;
+	gtk_tree_view_set_model(disasm_view, disasm_model);
 }
 
 void CDebug::BreakFromThread(uint addr)
@@ -975,25 +1159,45 @@ void CDebug::BreakFromThread(uint addr)
 	g_idle_add_full(G_PRIORITY_DEFAULT_IDLE+10, break_callback, (gpointer)(size_t)addr, NULL);
 }
 
-void CDebug::EnterFunctionFromThread(uint pc, uint sp)
+/*
+ * CDebug::UpdateBacktrace()
+ *
+ * Shows the shadow call stack in the backtrace list. Must only be called while the simulation is paused.
+ */
+void CDebug::UpdateBacktrace(uint pc)
 {
-	//call_stack.push_back(make_pair(pc, sp));
-	call_stack_size++;
+	char frame[32];
+	int bottom = max(call_stack_size - CALL_STACK_FRAMES, 0);
+	
+	gtk_list_store_clear(backtrace_list_store);
+	add_backtrace_row("0", pc);
+	
+	for(int i=call_stack_size-1; i>=bottom; i--)
+	{
+		const StackFrame& f = call_stack[i & (CALL_STACK_FRAMES-1)];
+		
+		// Show the call instruction, or the instruction that was interrupted by the exception
+		sprintf(frame, f.exception ? "%d (exception)" : "%d", call_stack_size - i);
+		add_backtrace_row(frame, f.ret_pc - 4);
+	}
+	
+	if(bottom > 0)
+	{
+		GtkTreeIter iter;
+		sprintf(frame, "%d older frames", bottom);
+		gtk_list_store_append(backtrace_list_store, &iter);
+		gtk_list_store_set(backtrace_list_store, &iter, 0, "...", 1, frame, 2, "", -1);
+	}
 }
 
-void CDebug::RetFromThread(uint pc, uint sp)
+/*
+ * CDebug::ClearBacktrace()
+ *
+ * Empties the backtrace list when the simulation continues or stops
+ */
+void CDebug::ClearBacktrace()
 {
-	// Maybe some assert that the pair pc and sp matches call_stack.back()
-	//if(!call_stack.empty())
-	//if(call_stack_size != 0)
-	//{
-		//call_stack.pop_back();
-		call_stack_size--;
-		if(debugging_state == STEP_OVER && call_stack_size < step_over_or_return_stack_frame)
-			SetDebuggingState(STEP_INTO); // Stop at the next possible breakpoint
-		else if(debugging_state == STEP_RETURN && call_stack_size < step_over_or_return_stack_frame)
-			SetDebuggingState(STEP_INTO); // Stop at the next possible breakpoint
-	//}
+	gtk_list_store_clear(backtrace_list_store);
 }
 
 void CDebug::EnableButtons(void)
@@ -1070,6 +1274,7 @@ void CDebug::RemoveAllExecutingLineMarks()
 void CDebug::ResumeSimulation(int debug_state, bool save_stack_frame)
 {
 	RemoveAllExecutingLineMarks();
+	ClearBacktrace();
 	bool paused = main_system.IsSimulationPaused();
 	main_debug.SetDebuggingState(debug_state);
 	if(save_stack_frame)
@@ -1106,7 +1311,7 @@ void CDebug::UpdateStatusbar(const char *text)
 void CDebug::SetDebuggingState(int state)
 {
 	static const char *modes[] = {"Continue", "Step Into", "Step Over", "Step Return", "Step Instruction"};
-	debugging_state = state;
+	CDebugger::SetDebuggingState(state);
 	UpdateStatusbar(modes[state]);
 }
 void CDebug::Cleanup()
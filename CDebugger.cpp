@@ -0,0 +1,168 @@
+/*
+NIISim - Nios II Simulator, A simulator that is capable of simulating various systems containing Nios II cpus.
+Copyright (C) 2012 Emil Lenngren
+
+This file is part of NIISim.
+
+NIISim is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+NIISim is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+
+#include "CDebugger.h"
+
+using namespace std;
+
+/*
+ *  CDebugger::SetMemoryInfo()
+ *
+ *  Tell the debugger about the location and span of the sdram
+ */
+void CDebugger::SetMemoryInfo(uint base, uint span)
+{
+	memory_base_addr = base;
+	address_has_breakpoint.assign(span, false);
+	all_source_breakpoints.assign(span, false);
+}
+
+/*
+ * CDebugger::LoadELFFile()
+ *
+ * Load the debug information of a new or reloaded ELF file. All old breakpoints are removed.
+ */
+void CDebugger::LoadELFFile(const char *filedata)
+{
+	// Load debugging info
+	current_debug_info = !current_debug_info;
+	DebugInfo& debug_info = GetDebugInfo();
+	BuildDebugInfo(debug_info, filedata);
+	function_symbols = ELFReadFunctionSymbols(filedata);
+	
+	address_has_breakpoint.assign(address_has_breakpoint.size(), false);
+	all_source_breakpoints.assign(all_source_breakpoints.size(), false);
+	
+	for(size_t i=0, e=debug_info.addresses.size(); i!=e; i++)
+	{
+		all_source_breakpoints[debug_info.addresses[i] - memory_base_addr] = true;
+	}
+}
+
+/*
+ * CDebugger::SetBreakpoints()
+ *
+ * Set an instruction breakpoint at each address in the vector
+ */
+void CDebugger::SetBreakpoints(const vector<uint>& addrs)
+{
+	for(size_t i=0, e=addrs.size(); i!=e; i++)
+		SetBreakpoint(addrs[i]);
+}
+
+/*
+ * CDebugger::EnterFunctionFromThread()
+ *
+ * Pushes a frame on the shadow call stack when a function is called, with the return address and sp.
+ */
+void CDebugger::EnterFunctionFromThread(uint pc, uint sp)
+{
+	// Functions that were left without returning, e.g. by longjmp, have their frames below the current sp.
+	// An exception handler may run on another stack or register set, so the frames are only compared
+	// back to the latest exception frame, which is only popped by eret.
+	while(call_stack_size > 0)
+	{
+		const StackFrame& top = call_stack[(call_stack_size-1) & (CALL_STACK_FRAMES-1)];
+		if(top.exception || top.sp >= sp)
+			break;
+		call_stack_size--;
+	}
+	
+	StackFrame& frame = call_stack[call_stack_size & (CALL_STACK_FRAMES-1)];
+	frame.ret_pc = pc;
+	frame.sp = sp;
+	frame.exception = false;
+	call_stack_size++;
+}
+
+/*
+ * CDebugger::RetFromThread()
+ *
+ * Pops the frame that is returned to from the shadow call stack. Normally that is the top frame,
+ * otherwise the stack is resynchronized with the first frame that matches both pc and sp.
+ */
+void CDebugger::RetFromThread(uint pc, uint sp)
+{
+	int bottom = max(call_stack_size - CALL_STACK_FRAMES, 0);
+	
+	for(int i=call_stack_size-1; i>=bottom; i--)
+	{
+		const StackFrame& frame = call_stack[i & (CALL_STACK_FRAMES-1)];
+		if(frame.ret_pc == pc && frame.sp == sp)
+		{
+			PopFrames(i);
+			return;
+		}
+	}
+	
+	// No match, the return address was probably modified. Just leave the top frame
+	if(call_stack_size > 0)
+		PopFrames(call_stack_size-1);
+}
+
+/*
+ * CDebugger::EnterExceptionFromThread()
+ *
+ * Pushes a frame on the shadow call stack when an exception is issued, with the exception return address and sp.
+ */
+void CDebugger::EnterExceptionFromThread(uint pc, uint sp)
+{
+	StackFrame& frame = call_stack[call_stack_size & (CALL_STACK_FRAMES-1)];
+	frame.ret_pc = pc;
+	frame.sp = sp;
+	frame.exception = true;
+	call_stack_size++;
+}
+
+/*
+ * CDebugger::RetFromExceptionFromThread()
+ *
+ * Pops the frames up to and including the latest exception frame. The handler may return to another
+ * address than the exception return address (interrupts return to the interrupted instruction).
+ */
+void CDebugger::RetFromExceptionFromThread(uint pc, uint sp)
+{
+	int bottom = max(call_stack_size - CALL_STACK_FRAMES, 0);
+	
+	for(int i=call_stack_size-1; i>=bottom; i--)
+	{
+		if(call_stack[i & (CALL_STACK_FRAMES-1)].exception)
+		{
+			PopFrames(i);
+			return;
+		}
+	}
+}
+
+/*
+ * CDebugger::PopFrames()
+ *
+ * Shrinks the shadow call stack to size frames and stops a step over or step return that left its frame.
+ */
+void CDebugger::PopFrames(int size)
+{
+	call_stack_size = size;
+	if(debugging_state == STEP_OVER && call_stack_size < step_over_or_return_stack_frame)
+		SetDebuggingState(STEP_INTO); // Stop at the next possible breakpoint
+	else if(debugging_state == STEP_RETURN && call_stack_size < step_over_or_return_stack_frame)
+		SetDebuggingState(STEP_INTO); // Stop at the next possible breakpoint
+}
@@ -0,0 +1,117 @@
+/*
+NIISim - Nios II Simulator, A simulator that is capable of simulating various systems containing Nios II cpus.
+Copyright (C) 2012 Emil Lenngren
+
+This file is part of NIISim.
+
+NIISim is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+NIISim is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+
+This file implements the part of the debugger that runs with the simulation: the breakpoints that
+the cpus check before every instruction, the shadow call stack used for stepping and for the
+backtrace, and the debug information of the loaded ELF file. The debugger window of the GTK front
+end derives from it.
+
+*/
+
+#ifndef _CDEBUGGER_H_
+#define _CDEBUGGER_H_
+
+#include <vector>
+#include "elf_read_debug.h"
+
+using namespace std;
+
+typedef unsigned int uint;
+
+// Number of frames kept by the shadow call stack, must be a power of two. Deeper frames overwrite the oldest ones.
+#define CALL_STACK_FRAMES 256
+
+enum {
+	CONTINUE,
+	STEP_INTO,
+	STEP_OVER,
+	STEP_RETURN,
+	STEP_INSTRUCTION
+};
+
+class CDebugger
+{
+protected:
+	// A frame of the shadow call stack
+	struct StackFrame
+	{
+		uint ret_pc;		// The return address
+		uint sp;			// The stack pointer at the call, which is restored before returning
+		bool exception;		// True if the frame was entered by an exception
+	};
+	StackFrame call_stack[CALL_STACK_FRAMES];	// Ring buffer, frame i is at i % CALL_STACK_FRAMES
+	int call_stack_size;	// The call depth
+	vector<bool> all_source_breakpoints;
+	vector<bool> address_has_breakpoint;
+	uint memory_base_addr;
+	int step_over_or_return_stack_frame;
+	int debugging_state; // 0 == continue, 1 == step into, 2 == step over, 3 == step return, 4 == step instruction
+
+	// Debug info from the ELF file. Store two so we can compare a reloaded file with the older version.
+	DebugInfo debug_infos[2];
+	int current_debug_info;
+
+	// Functions from the symbol table of the ELF file, for the backtrace
+	vector<ELFSymbol> function_symbols;
+
+	void PopFrames(int size);
+	
+public:
+	CDebugger() : call_stack_size(0), memory_base_addr(0), step_over_or_return_stack_frame(0), debugging_state(0), current_debug_info(0) {}
+	virtual ~CDebugger() {}
+	
+	void SetMemoryInfo(uint base, uint span);
+	virtual void LoadELFFile(const char *filedata);
+	DebugInfo& GetDebugInfo() { return debug_infos[current_debug_info]; }
+	const vector<ELFSymbol>& GetFunctionSymbols() { return function_symbols; }
+	void SetBreakpoint(uint addr){ address_has_breakpoint[addr - memory_base_addr].flip(); }
+	void SetBreakpoints(const vector<uint>& addrs);
+	bool AddressIsBreakpoint(uint addr){
+		addr -= memory_base_addr;
+		switch(debugging_state){
+			case CONTINUE:
+			case STEP_RETURN:
+				return address_has_breakpoint[addr];
+			case STEP_OVER:
+				if(address_has_breakpoint[addr])
+					return true;
+				if(step_over_or_return_stack_frame < call_stack_size)
+					return false;
+				// Fallthrough
+			case STEP_INTO:
+				return all_source_breakpoints[addr] || address_has_breakpoint[addr];
+			case STEP_INSTRUCTION:
+				return true;
+		}
+		return false;
+	}
+	virtual void BreakFromThread(uint addr) {}
+	void EnterFunctionFromThread(uint pc, uint sp);
+	void RetFromThread(uint pc, uint sp);
+	void EnterExceptionFromThread(uint pc, uint sp);
+	void RetFromExceptionFromThread(uint pc, uint sp);
+	void ResetCallStack() { call_stack_size = 0; }
+	
+	virtual void SetDebuggingState(int state) { debugging_state = state; }
+};
+
+#endif
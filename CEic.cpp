@@ -0,0 +1,210 @@
+/*
+NIISim - Nios II Simulator, A simulator that is capable of simulating various systems containing Nios II cpus.
+
+This file is part of NIISim.
+
+NIISim is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+NIISim is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "CEic.h"
+
+/*
+ *	CEic::CEic()
+ *
+ *  Constructor for the CEic class.
+ */
+CEic::CEic()
+{
+	base = span = 0;
+	init_vector_table = 0;
+	for(UINT i=0; i<EIC_NUM_IRQS; i++)
+		init_config[i] = handlers[i] = 0;
+	lines = 0;
+
+	Reset();
+}
+
+/*
+ *	CEic::Reset()
+ *
+ *  Performs a reset operation for the CEic class. The IRQ lines are left as they are,
+ *  they belong to the devices.
+ */
+void CEic::Reset()
+{
+	for(UINT i=0; i<EIC_NUM_IRQS; i++)
+		config[i] = init_config[i];
+
+	// IRQs configured in the .sdf file are enabled from the start
+	enable = 0;
+	for(UINT i=0; i<EIC_NUM_IRQS; i++)
+	{
+		if(init_config[i] & EIC_CONFIG_RIL)
+			enable |= 1 << i;
+	}
+
+	sw_interrupt = 0;
+	vector_size = 0;
+	vector_table = init_vector_table;
+
+	Update();
+}
+
+/*
+ *	CEic::SetVector()
+ *
+ *  Configures an IRQ from the .sdf file. The IRQ is enabled after a reset.
+ *
+ *	Parameters: irq - The IRQ number, 0-31
+ *				level - The priority level, 1-63, higher levels preempt lower levels
+ *				set - The register set the handler runs in, 0 for the normal register set
+ *				nmi - True for a non-maskable interrupt
+ *				handler - The address of the handler, 0 to use the vector table
+ */
+void CEic::SetVector(UINT irq, UINT level, UINT set, bool nmi, UINT handler)
+{
+	init_config[irq] = (level & EIC_CONFIG_RIL) | ((set << EIC_CONFIG_RRS_SHIFT) & EIC_CONFIG_RRS) | (nmi ? EIC_CONFIG_RNMI : 0);
+	handlers[irq] = handler;
+}
+
+/*
+ *	CEic::Update()
+ *
+ *  Selects the request presented to the cpu: the pending and enabled IRQ with the highest
+ *  level, non-maskable IRQs before all others and the lowest IRQ number if the levels are equal.
+ */
+void CEic::Update()
+{
+	UINT pending, best_rank, rank;
+
+	request = false;
+	best_rank = 0;
+
+	pending = (lines | sw_interrupt) & enable;
+	for(UINT i=0; pending; i++, pending >>= 1)
+	{
+		if(!(pending & 1) || !(config[i] & EIC_CONFIG_RIL))
+			continue;
+
+		rank = (config[i] & EIC_CONFIG_RIL) | ((config[i] & EIC_CONFIG_RNMI) ? 0x40 : 0);
+		if(rank > best_rank)
+		{
+			best_rank = rank;
+			request_irq = i;
+		}
+	}
+
+	if(!best_rank)
+		return;
+
+	request = true;
+	request_level = config[request_irq] & EIC_CONFIG_RIL;
+	request_set = (config[request_irq] & EIC_CONFIG_RRS) >> EIC_CONFIG_RRS_SHIFT;
+	request_nmi = (config[request_irq] & EIC_CONFIG_RNMI) != 0;
+	if(handlers[request_irq])
+		request_handler = handlers[request_irq];
+	else
+		request_handler = vector_table + request_irq * (16 << vector_size);
+}
+
+/*
+ *	CEic::Read()
+ *
+ *  Reads from a register of the controller
+ *
+ *	Parameters: addr - The address
+ *				size - The size of the read in bytes
+ *
+ *	Returns:	The value of the register
+ */
+UINT CEic::Read(UINT addr, UINT size)
+{
+	UINT offset = (addr - base) & ~0x3;
+
+	if(offset < 0x80)
+		return config[offset >> 2];
+
+	switch(offset)
+	{
+	case 0x80:
+		return enable;
+	case 0x8C:
+		return (lines | sw_interrupt) & enable;
+	case 0x90:
+		return lines | sw_interrupt;
+	case 0x94:
+		return sw_interrupt;
+	case 0xA0:
+		return vector_size;
+	case 0xA4:
+		return request ? (0x80000000 | request_irq) : 0;
+	case 0xA8:
+		return vector_table;
+	case 0xAC:
+		return request ? request_handler : 0;
+	}
+	return 0;
+}
+
+/*
+ *	CEic::Write()
+ *
+ *  Writes to a register of the controller
+ *
+ *	Parameters: addr - The address
+ *				size - The size of the write in bytes
+ *				d - The data to write
+ */
+void CEic::Write(UINT addr, UINT size, UINT d)
+{
+	UINT offset = (addr - base) & ~0x3;
+
+	if(offset < 0x80)
+	{
+		config[offset >> 2] = d & (EIC_CONFIG_RIL | EIC_CONFIG_RRS | EIC_CONFIG_RNMI);
+	}
+	else
+	{
+		switch(offset)
+		{
+		case 0x80:
+			enable = d;
+			break;
+		case 0x84:
+			enable |= d;
+			break;
+		case 0x88:
+			enable &= ~d;
+			break;
+		case 0x94:
+			sw_interrupt = d;
+			break;
+		case 0x98:
+			sw_interrupt |= d;
+			break;
+		case 0x9C:
+			sw_interrupt &= ~d;
+			break;
+		case 0xA0:
+			vector_size = d & 0x7;
+			break;
+		case 0xA8:
+			vector_table = d;
+			break;
+		}
+	}
+
+	Update();
+}
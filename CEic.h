@@ -0,0 +1,101 @@
+/*
+NIISim - Nios II Simulator, A simulator that is capable of simulating various systems containing Nios II cpus.
+
+This file is part of NIISim.
+
+NIISim is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+NIISim is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+
+This file implements an external interrupt controller (EIC) modelled on the Altera vectored
+interrupt controller. The IRQ lines of a cpu with an EIC go to the controller instead of to
+ipending. Each IRQ has a priority level, a register set and a handler address, and the
+controller presents the highest priority pending IRQ to the cpu, which jumps directly to
+its handler.
+
+Register map, relative to the base address, with the offsets and fields of the Altera VIC:
+
+	0x00-0x7C	INT_CONFIG0-31	bits 5:0 level (0 disables the IRQ), bit 6 NMI, bits 12:7 register set
+	0x80		INT_ENABLE
+	0x84		INT_ENABLE_SET		writing 1 enables an IRQ
+	0x88		INT_ENABLE_CLR		writing 1 disables an IRQ
+	0x8C		INT_PENDING			pending and enabled IRQs, read only
+	0x90		INT_RAW_STATUS		pending IRQs, read only
+	0x94		SW_INTERRUPT		software interrupts, ORed with the IRQ lines
+	0x98		SW_INTERRUPT_SET
+	0x9C		SW_INTERRUPT_CLR
+	0xA0		VIC_CONFIG			bits 2:0 vector size, 16 << n bytes
+	0xA4		VIC_STATUS			bits 5:0 the requested IRQ, bit 31 set if there is a request
+	0xA8		VEC_TBL_BASE		address of the vector table
+	0xAC		VEC_TBL_ADDR		handler address of the requested IRQ, read only
+
+*/
+
+#ifndef _CEIC_H_
+#define _CEIC_H_
+
+#include "MMDevice.h"
+
+// Fields of the INT_CONFIG registers
+#define EIC_CONFIG_RIL			0x3F
+#define EIC_CONFIG_RNMI			0x40
+#define EIC_CONFIG_RRS_SHIFT	7
+#define EIC_CONFIG_RRS			0x1F80
+
+#define EIC_NUM_IRQS			32
+
+class CEic : public MMDevice
+{
+private:
+	// Reset values, set by the .sdf file
+	UINT init_config[EIC_NUM_IRQS];
+	UINT init_vector_table;
+	UINT handlers[EIC_NUM_IRQS];	// Handler addresses set by the .sdf file, used instead of the vector table if not 0
+
+	// Internal registers
+	UINT config[EIC_NUM_IRQS];
+	UINT enable, sw_interrupt;
+	UINT vector_size, vector_table;
+
+	UINT lines;				// The IRQ lines from the devices
+
+	// The request presented to the cpu, updated whenever the lines or the registers change
+	bool request;
+	UINT request_irq, request_level, request_set, request_handler;
+	bool request_nmi;
+
+	void Update();
+public:
+	CEic();
+	~CEic() {};
+
+	void Reset();
+	UINT Read(UINT addr, UINT size);
+	void Write(UINT addr, UINT size, UINT d);
+
+	void SetLines(UINT l) { lines = l; Update(); };
+
+	void SetVectorTable(UINT addr) { init_vector_table = addr; };
+	void SetVector(UINT irq, UINT level, UINT set, bool nmi, UINT handler);
+
+	bool HasRequest() { return request; };
+	UINT GetRequestIRQ() { return request_irq; };
+	UINT GetRequestLevel() { return request_level; };
+	UINT GetRequestSet() { return request_set; };
+	bool GetRequestNMI() { return request_nmi; };
+	UINT GetRequestHandler() { return request_handler; };
+};
+
+#endif
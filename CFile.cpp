@@ -221,6 +221,50 @@ pair<char*, size_t> CFile::read_whole_file(void)
 	}
 }
 
+/*
+ *  CFile::map_whole_file()
+ *
+ *  Maps the file into memory copy-on-write, so the contents can be changed without changing the file
+ *
+ *  Returns: The mapped file, which must be freed with g_mapped_file_unref, or NULL if it is an embedded resource or can't be mapped.
+ */
+GMappedFile *CFile::map_whole_file(void)
+{
+	if(file == NULL)
+		return NULL;
+	
+	char *path = g_file_get_path(file);
+	if(path == NULL)
+		return NULL;
+	
+	GMappedFile *mapped_file = g_mapped_file_new(path, TRUE, NULL);
+	g_free(path);
+	return mapped_file;
+}
+
+/*
+ *  CFile::get_modification_time()
+ *
+ *  Gets the time the file was last modified
+ *
+ *  Returns: The time in microseconds since the epoch, or 0 if it is an embedded resource or the time isn't known.
+ */
+guint64 CFile::get_modification_time(void)
+{
+	if(file == NULL)
+		return 0;
+	
+	GFileInfo *info = g_file_query_info(file, G_FILE_ATTRIBUTE_TIME_MODIFIED "," G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC,
+										G_FILE_QUERY_INFO_NONE, NULL, NULL);
+	if(info == NULL)
+		return 0;
+	
+	guint64 time = g_file_info_get_attribute_uint64(info, G_FILE_ATTRIBUTE_TIME_MODIFIED) * 1000000 +
+				   g_file_info_get_attribute_uint32(info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+	g_object_unref(info);
+	return time;
+}
+
 /*
  *  CFile::read_line()
  *
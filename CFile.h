@@ -56,6 +56,8 @@ public:
 	gssize read(void *buffer, gsize count);
 	
 	pair<char*, size_t> read_whole_file(void);
+	GMappedFile *map_whole_file(void);
+	guint64 get_modification_time(void);
 	
 	char *read_line(void);
 };
@@ -0,0 +1,70 @@
+/*
+NIISim - Nios II Simulator, A simulator that is capable of simulating various systems containing Nios II cpus.
+
+This file is part of NIISim.
+
+NIISim is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+NIISim is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+
+This file declares the interfaces that the simulator core uses to reach the front end. The GTK
+front end implements them with its consoles and its I/O board, programs without windows leave
+them unset and the devices are simply not mapped to anything.
+
+*/
+
+#ifndef _CFRONTEND_H_
+#define _CFRONTEND_H_
+
+#include "types.h"
+
+class CPio;
+class CLcd;
+
+// A console that the jtag and uart interfaces print to
+class CConsoleInterface
+{
+public:
+	virtual ~CConsoleInterface() {};
+
+	virtual void AddText(char *t, bool update = true) = 0;
+	virtual void AddText(char t, bool update = true) = 0;
+};
+
+// A device group on the board that a pio interface is mapped to
+class CDeviceGroupInterface
+{
+public:
+	virtual ~CDeviceGroupInterface() {};
+
+	virtual const char *GetType() = 0;
+	virtual UINT GetData() = 0;
+};
+
+// The I/O board that the devices of a system are mapped to
+class CBoardInterface
+{
+public:
+	virtual ~CBoardInterface() {};
+
+	virtual void CleanUp() = 0;
+	virtual void LoadBoard(const char *file) = 0;
+
+	virtual const char *GetLCDName() = 0;
+	virtual void SetLCD(CLcd *lcd) = 0;
+	virtual bool MapPio(const char *gname, CPio *pio) = 0;
+};
+
+#endif
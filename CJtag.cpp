@@ -19,7 +19,7 @@ along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include "sim.h"
-#include "CConsole.h"
+#include "CFrontEnd.h"
 #include "CJtag.h"
 
 /*
@@ -32,7 +32,6 @@ along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
  */
 CJtag::CJtag()
 {
-	name[0] = '\0';
 	base = span = irq = 0;
 	has_irq = false;
 	c_console = NULL;
@@ -145,18 +144,13 @@ UINT CJtag::Read(UINT addr, UINT size)
  */
 void CJtag::Write(UINT addr, UINT size, UINT d)
 {
-	char text[256];
-
 	// Data register
 	if(addr == base)
 	{
 		// If a console is mapped to this jtag class,
-		// print the character to the console
-		if(c_console)
-		{
-			sprintf(text, "%c", (d & 0xFF));
-			c_console->AddText(text, false);
-		}
+		// print the character to the console. NUL characters aren't printed.
+		if(c_console && (d & 0xFF))
+			c_console->AddText((char)(d & 0xFF), false);
 
 		// Disable write interrupts
 		WI = 0;
@@ -248,7 +242,7 @@ void CJtag::SendInput(const string& text)
  *
  *  Maps this jtag class to a jtag console class
  */
-void CJtag::SetConsole(CConsole *c)
+void CJtag::SetConsole(CConsoleInterface *c)
 {
 	c_console = c;
 }
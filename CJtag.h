@@ -24,7 +24,7 @@ along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "MMDevice.h"
 
-class CConsole;
+class CConsoleInterface;
 
 class CJtag : public MMDevice
 {
@@ -36,7 +36,7 @@ private:
 	UINT WE, RE, WI, RI, AC;
 	UINT w_fifo, r_fifo;
 
-	CConsole *c_console;	// Pointer to the console this interface is mapped to
+	CConsoleInterface *c_console;	// Pointer to the console this interface is mapped to
 	string buf;				// Text buffer with text that has been typed in from the console
 	CMutex lock;			// Lock for the buffer
 public:
@@ -51,7 +51,7 @@ public:
 	bool HasIRQ() { return has_irq; };
 	UINT GetIRQ() { return irq; };
 
-	void SetConsole(CConsole *c);
+	void SetConsole(CConsoleInterface *c);
 	void SendInput(const string& text);
 };
 
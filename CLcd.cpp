@@ -21,34 +21,144 @@ along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
 #include <string>
 #include "CLcd.h"
 #include "sim.h"
+#include "CCpu.h"
+#include "CFrontEnd.h"
 using namespace std;
 
 /*
  *	CLcd::CLcd()
  *
  *  Constructor for the CLcd class.
- *  Initializes all private variables to 0.
+ *  Initializes all private variables.
  */
 CLcd::CLcd()
 {
-	name[0] = '\0';
 	base = span = 0;
 
-	memset(text, 0, LCD_TEXT_LEN);
-	cursor = 0;
-
 	mapped_board = NULL;
+
+	Reset();
 }
 
 /*
  *	CLcd::Reset()
  *
- *  Performs a reset by clearing the text buffer and setting the cursor to 0
+ *  Performs a reset by clearing the display and setting the address counter to 0.
+ *  The controller starts out the way the HAL driver initializes it: two lines, display on, 
+ *  cursor off and incrementing the address counter without shifting the display.
  */
 void CLcd::Reset()
 {
-	memset(text, 0, LCD_TEXT_LEN);
-	cursor = 0;
+	lock.lock();
+
+	memset(ddram, ' ', sizeof(ddram));
+	memset(cgram, 0, sizeof(cgram));
+	address = 0;
+	cgram_selected = false;
+	shift = 0;
+
+	increment = true;
+	shift_on_entry = false;
+	display_on = true;
+	cursor_on = blink_on = false;
+	two_lines = true;
+
+	busy_until = 0;
+	display_changed = true;
+
+	lock.unlock();
+}
+
+/*
+ *	CLcd::DDRAMIndex()
+ *
+ *  Converts a display data RAM address to an index in the ddram array
+ *
+ *	Parameters: addr - The address
+ *
+ *	Returns:	The index in ddram
+ */
+UINT CLcd::DDRAMIndex(UINT addr)
+{
+	// In one line mode the addresses are 0x00-0x4F
+	if(!two_lines)
+		return addr % (2*LCD_LINE_LEN);
+
+	// In two line mode the lines start at 0x00 and 0x40
+	if(addr >= LCD_LINE2_ADDR)
+		return LCD_LINE_LEN + (addr - LCD_LINE2_ADDR) % LCD_LINE_LEN;
+	return addr % LCD_LINE_LEN;
+}
+
+/*
+ *	CLcd::MoveAddress()
+ *
+ *  Moves the address counter one step. In two line mode the display data RAM addresses wrap 
+ *  from the end of the first line to the start of the second line and vice versa.
+ *
+ *	Parameters: right - True to increment the address counter, false to decrement it
+ */
+void CLcd::MoveAddress(bool right)
+{
+	if(cgram_selected)
+	{
+		address = (address + (right ? 1 : -1)) & (LCD_CGRAM_SIZE - 1);
+	}
+	else if(two_lines)
+	{
+		if(right)
+		{
+			if(address == LCD_LINE_LEN - 1)
+				address = LCD_LINE2_ADDR;
+			else if(address >= LCD_LINE2_ADDR + LCD_LINE_LEN - 1)
+				address = 0;
+			else
+				address++;
+		}
+		else
+		{
+			if(address == 0)
+				address = LCD_LINE2_ADDR + LCD_LINE_LEN - 1;
+			else if(address == LCD_LINE2_ADDR)
+				address = LCD_LINE_LEN - 1;
+			else
+				address--;
+		}
+	}
+	else
+	{
+		address = (address + (right ? 1 : 2*LCD_LINE_LEN - 1)) % (2*LCD_LINE_LEN);
+	}
+}
+
+/*
+ *	CLcd::ShiftDisplay()
+ *
+ *  Shifts the display one step. In two line mode each line wraps around its 40 characters,
+ *  in one line mode the single line wraps around all 80.
+ *
+ *	Parameters: left - True to shift the display to the left, false to shift it to the right
+ */
+void CLcd::ShiftDisplay(bool left)
+{
+	UINT len = two_lines ? LCD_LINE_LEN : 2*LCD_LINE_LEN;
+
+	shift = (shift + (left ? 1 : len - 1)) % len;
+}
+
+/*
+ *	CLcd::SetBusy()
+ *
+ *  Sets the busy flag for the execution time of an instruction
+ *
+ *	Parameters: us - The execution time in microseconds
+ */
+void CLcd::SetBusy(UINT us)
+{
+	UINT freq;
+
+	freq = main_system.HasCPU() ? main_system.GetCPU(0)->GetFrequency() : 0;
+	busy_until = main_system.GetClk() + us * (freq / 1000000);
 }
 
 /*
@@ -65,25 +175,40 @@ UINT CLcd::Read(UINT addr, UINT size)
 {
 	UINT data;
 
+	// The address counter is also used by Write() and the display by the GUI thread
+	lock.lock();
+
 	data = 0;
-	// Instruction register
+	// Instruction register: the busy flag and the address counter
 	if(addr == base)
 	{
-		
+		if((int)(busy_until - main_system.GetClk()) > 0)
+			data = 0x80;
+		data |= address;
 	}
 	// Data register
 	else if(addr == (base + 4))
 	{
+		if(cgram_selected)
+			data = cgram[address];
+		else
+			data = ddram[DDRAMIndex(address)];
 
+		MoveAddress(increment);
+		SetBusy(LCD_EXEC_TIME_US);
 	}
 
+	lock.unlock();
+
 	return data;
 }
 
 /*
  *	CLcd::Write()
  *
- *  Performs a write operation to an address mapped to the LCD
+ *  Performs a write operation to an address mapped to the LCD.
+ *  Instructions and data are accepted even while the busy flag is set, 
+ *  since most programs don't poll it.
  *
  *	Parameters: addr - The address to write to
  *				size - Size in bits of the written data (8, 16 or 32)
@@ -91,37 +216,111 @@ UINT CLcd::Read(UINT addr, UINT size)
  */
 void CLcd::Write(UINT addr, UINT size, UINT d)
 {
+	d &= 0xFF;
+
+	lock.lock();
+
 	// Instruction register
 	if(addr == base)
 	{
-		if(d == 1)
+		// Set display data RAM address
+		if(d & 0x80)
 		{
-			memset(text, 0, LCD_TEXT_LEN);
-			cursor = 0;
-
-			if(mapped_board)
-				mapped_board->UpdateLCDText(text);
+			address = d & 0x7F;
+			cgram_selected = false;
+			SetBusy(LCD_EXEC_TIME_US);
+		}
+		// Set character generator RAM address
+		else if(d & 0x40)
+		{
+			address = d & 0x3F;
+			cgram_selected = true;
+			SetBusy(LCD_EXEC_TIME_US);
 		}
-		else if(d == 0x80)
+		// Function set
+		else if(d & 0x20)
 		{
-			cursor = 0;
+			two_lines = (d & 0x08) != 0;
+			// A shift past the first line is only possible in one line mode
+			if(two_lines)
+				shift %= LCD_LINE_LEN;
+			display_changed = true;
+			SetBusy(LCD_EXEC_TIME_US);
 		}
-		else if(d == 0xC0)
+		// Cursor or display shift
+		else if(d & 0x10)
 		{
-			cursor = LCD_TEXT_LEN/2;
+			// Shift the display
+			if(d & 0x08)
+			{
+				ShiftDisplay((d & 0x04) == 0);
+				display_changed = true;
+			}
+			// Move the cursor
+			else
+			{
+				MoveAddress((d & 0x04) != 0);
+			}
+			SetBusy(LCD_EXEC_TIME_US);
+		}
+		// Display on/off control
+		else if(d & 0x08)
+		{
+			display_on = (d & 0x04) != 0;
+			cursor_on = (d & 0x02) != 0;
+			blink_on = (d & 0x01) != 0;
+			display_changed = true;
+			SetBusy(LCD_EXEC_TIME_US);
+		}
+		// Entry mode set
+		else if(d & 0x04)
+		{
+			increment = (d & 0x02) != 0;
+			shift_on_entry = (d & 0x01) != 0;
+			SetBusy(LCD_EXEC_TIME_US);
+		}
+		// Return home
+		else if(d & 0x02)
+		{
+			address = 0;
+			cgram_selected = false;
+			shift = 0;
+			display_changed = true;
+			SetBusy(LCD_CLEAR_TIME_US);
+		}
+		// Clear display
+		else if(d & 0x01)
+		{
+			memset(ddram, ' ', sizeof(ddram));
+			address = 0;
+			cgram_selected = false;
+			shift = 0;
+			increment = true;
+			display_changed = true;
+			SetBusy(LCD_CLEAR_TIME_US);
 		}
 	}
 	// Data register
 	else if(addr == (base + 4))
 	{
-		text[cursor] = d;
-		cursor++;
-		if(cursor == LCD_TEXT_LEN)
-			cursor = 0;
+		if(cgram_selected)
+		{
+			cgram[address] = d & 0x1F;
+		}
+		else
+		{
+			ddram[DDRAMIndex(address)] = d;
 
-		if(mapped_board)
-			mapped_board->UpdateLCDText(text);
+			// Shift the display in the same direction as the cursor moves
+			if(shift_on_entry)
+				ShiftDisplay(increment);
+		}
+		MoveAddress(increment);
+		display_changed = true;
+		SetBusy(LCD_EXEC_TIME_US);
 	}
+
+	lock.unlock();
 }
 
 /*
@@ -131,7 +330,78 @@ void CLcd::Write(UINT addr, UINT size, UINT d)
  *
  *	Parameters:	b - A pointer to the board
  */
-void CLcd::SetBoard(CBoard *b)
+void CLcd::SetBoard(CBoardInterface *b)
 {
 	mapped_board = b;
-}
\ No newline at end of file
+	b->SetLCD(this);
+}
+
+/*
+ *	CLcd::TakeDisplayText()
+ *
+ *  Retrieves the visible text if it has changed since the last call.
+ *  Called by the board once per frame, so that any number of writes during a frame 
+ *  result in a single update of the lcd window.
+ *
+ *	Parameters: text - Receives the text, with the two lines separated by a new line
+ *
+ *	Returns:	True if the text has changed and was retrieved
+ */
+bool CLcd::TakeDisplayText(string *text)
+{
+	UCHAR c;
+	UINT row;
+
+	lock.lock();
+
+	if(!display_changed)
+	{
+		lock.unlock();
+		return false;
+	}
+	display_changed = false;
+
+	*text = "";
+
+	for(UINT line=0; line<2; line++)
+	{
+		// Insert a new line
+		if(line == 1)
+			*text += '\n';
+
+		// Nothing is shown when the display is off, and the second line only in two line mode
+		if(!display_on || (line == 1 && !two_lines))
+			continue;
+
+		for(UINT i=0; i<LCD_COLUMNS; i++)
+		{
+			if(two_lines)
+				c = ddram[line*LCD_LINE_LEN + (shift + i) % LCD_LINE_LEN];
+			else
+				c = ddram[(shift + i) % (2*LCD_LINE_LEN)];
+
+			// Character codes 0-15 are the custom characters in the character generator RAM,
+			// shown as a block unless the character is empty
+			if(c < 16)
+			{
+				for(row=0; row<8; row++)
+					if(cgram[(c & 7)*8 + row])
+						break;
+				*text += row < 8 ? "\xE2\x96\x88" : " ";
+			}
+			// Replace illegal characters by a space
+			else if(c >= '!' && c <= '}')
+			{
+				*text += c;
+			}
+			else
+			{
+				*text += ' ';
+			}
+		}
+	}
+
+	lock.unlock();
+
+	return true;
+}
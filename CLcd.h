@@ -22,21 +22,51 @@ along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef _CLCD_H_
 #define _CLCD_H_
 
+#include <string>
+using namespace std;
 #include "MMDevice.h"
+#include "CThread.h"
 
-class CBoard;
+class CBoardInterface;
 
-#define LCD_TEXT_LEN 32
 #define LCD_WIDTH 175
 #define LCD_HEIGHT 40
 
+// Constants for the HD44780 controller
+#define LCD_COLUMNS			16		// Visible characters on each line
+#define LCD_LINE_LEN		40		// Characters of display data RAM on each line
+#define LCD_LINE2_ADDR		0x40	// Display data RAM address of the second line
+#define LCD_CGRAM_SIZE		64		// Size of the character generator RAM
+#define LCD_EXEC_TIME_US	37		// Execution time of most instructions in microseconds
+#define LCD_CLEAR_TIME_US	1520	// Execution time of clear display and return home in microseconds
+
 class CLcd : public MMDevice
 {
 private:
-	char text[LCD_TEXT_LEN];	// The text in the lcd window
-	UINT cursor;				// Position of the cursor
+	UCHAR ddram[2*LCD_LINE_LEN];	// Display data RAM, both lines after each other
+	UCHAR cgram[LCD_CGRAM_SIZE];	// Character generator RAM, 8 custom characters of 8 rows each
+	UINT address;				// The address counter
+	bool cgram_selected;		// True if the address counter points into the character generator RAM
+	UINT shift;					// Number of characters the display is shifted to the left
+
+	bool increment;				// Entry mode: true if the address counter increments, false if it decrements
+	bool shift_on_entry;		// Entry mode: true if the display shifts on every data write
+	bool display_on;			// Display control: true if the display is turned on
+	bool cursor_on;				// Display control: true if the cursor is shown
+	bool blink_on;				// Display control: true if the cursor blinks
+	bool two_lines;				// Function set: true if two display lines are used
+
+	UINT busy_until;			// Clock cycle when the current instruction has been executed
+
+	bool display_changed;		// True if the visible text has changed since it was last retrieved
+	CMutex lock;				// Lock for the display state, read by the GUI thread
+
+	CBoardInterface *mapped_board;		// Pointer to the board that this lcd interface is mapped to
 
-	CBoard *mapped_board;		// Pointer to the board that this lcd interface is mapped to
+	UINT DDRAMIndex(UINT addr);
+	void MoveAddress(bool right);
+	void ShiftDisplay(bool left);
+	void SetBusy(UINT us);
 public:
 	CLcd();
 	~CLcd() {};
@@ -45,7 +75,8 @@ public:
 	UINT Read(UINT addr, UINT size);
 	void Write(UINT addr, UINT size, UINT d);
 
-	void SetBoard(CBoard *b);
+	void SetBoard(CBoardInterface *b);
+	bool TakeDisplayText(string *text);
 };
 
 #endif
@@ -0,0 +1,213 @@
+/*
+NIISim - Nios II Simulator, A simulator that is capable of simulating various systems containing Nios II cpus.
+
+This file is part of NIISim.
+
+NIISim is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+NIISim is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <cstring>
+#include "CMpu.h"
+
+// Access rights in supervisor and user mode of each PERM value of instruction regions
+static const UCHAR instruction_access[8][2] = {
+	{0, 0}, {MPU_READ, 0}, {MPU_READ, MPU_READ}, {0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}
+};
+
+// Access rights in supervisor and user mode of each PERM value of data regions
+static const UCHAR data_access[8][2] = {
+	{0, 0}, {MPU_READ | MPU_WRITE, 0}, {MPU_READ | MPU_WRITE, MPU_READ}, {MPU_READ | MPU_WRITE, MPU_READ | MPU_WRITE},
+	{MPU_READ, 0}, {MPU_READ, MPU_READ}, {0, 0}, {0, 0}
+};
+
+/*
+ *	CMpu::CMpu()
+ *
+ *  Constructor for the CMpu class.
+ */
+CMpu::CMpu()
+{
+	num_regions[0] = num_regions[1] = MPU_MAX_REGIONS;
+	memset(init_regions, 0, sizeof(init_regions));
+	has_init_regions = false;
+
+	Reset();
+}
+
+/*
+ *	CMpu::Configure()
+ *
+ *  Sets the number of regions
+ *
+ *	Parameters: instruction_regions - The number of instruction regions, 1-32
+ *				data_regions - The number of data regions, 1-32
+ *
+ *	Returns:	False if a number is out of range
+ */
+bool CMpu::Configure(UINT instruction_regions, UINT data_regions)
+{
+	if(instruction_regions < 1 || instruction_regions > MPU_MAX_REGIONS ||
+	   data_regions < 1 || data_regions > MPU_MAX_REGIONS)
+		return false;
+
+	num_regions[0] = instruction_regions;
+	num_regions[1] = data_regions;
+	return true;
+}
+
+/*
+ *	CMpu::SetInitRegion()
+ *
+ *  Sets a region that is written to the MPU after a reset
+ *
+ *	Parameters: data - True for a data region, false for an instruction region
+ *				index - The index of the region
+ *				base - The first address of the region
+ *				limit - The address after the region
+ *				perm - The PERM field of the region
+ *
+ *	Returns:	False if the index or the permissions are out of range
+ */
+bool CMpu::SetInitRegion(bool data, UINT index, UINT base, UINT limit, UINT perm)
+{
+	if(index >= num_regions[data] || perm > (MPUACC_PERM >> MPUACC_PERM_SHIFT))
+		return false;
+
+	init_regions[data][index].base = base & MPUBASE_BASE;
+	init_regions[data][index].acc = (limit & MPUACC_LIMIT) | (perm << MPUACC_PERM_SHIFT);
+	has_init_regions = true;
+	return true;
+}
+
+/*
+ *	CMpu::Reset()
+ *
+ *  Performs a reset operation for the CMpu class by loading the regions of the .sdf file
+ */
+void CMpu::Reset()
+{
+	memcpy(regions, init_regions, sizeof(regions));
+	InvalidateCache();
+}
+
+/*
+ *	CMpu::InvalidateCache()
+ *
+ *  Empties the region caches, called when the regions change
+ */
+void CMpu::InvalidateCache()
+{
+	memset(cache, 0, sizeof(cache));
+	next_entry[0] = next_entry[1] = 0;
+}
+
+/*
+ *	CMpu::WriteRegion()
+ *
+ *  Writes a region, when mpuacc is written with the WR bit set
+ *
+ *	Parameters: mpubase - The value of mpubase, selects the region
+ *				mpuacc - The value written to mpuacc
+ */
+void CMpu::WriteRegion(UINT mpubase, UINT mpuacc)
+{
+	bool data = (mpubase & MPUBASE_D) != 0;
+	UINT index = (mpubase & MPUBASE_INDEX) >> MPUBASE_INDEX_SHIFT;
+
+	// Writes to regions that don't exist are ignored
+	if(index >= num_regions[data])
+		return;
+
+	regions[data][index].base = mpubase & MPUBASE_BASE;
+	regions[data][index].acc = mpuacc & (MPUACC_LIMIT | MPUACC_C | MPUACC_PERM);
+	InvalidateCache();
+}
+
+/*
+ *	CMpu::ReadRegion()
+ *
+ *  Reads a region, when mpuacc is written with the RD bit set
+ *
+ *	Parameters: mpubase - The value of mpubase, selects the region. The base address is updated.
+ *				mpuacc - Set to the limit and the permissions of the region
+ */
+void CMpu::ReadRegion(UINT *mpubase, UINT *mpuacc)
+{
+	bool data = (*mpubase & MPUBASE_D) != 0;
+	UINT index = (*mpubase & MPUBASE_INDEX) >> MPUBASE_INDEX_SHIFT;
+
+	if(index >= num_regions[data])
+	{
+		*mpubase &= ~MPUBASE_BASE;
+		*mpuacc = 0;
+		return;
+	}
+
+	*mpubase = (*mpubase & ~MPUBASE_BASE) | regions[data][index].base;
+	*mpuacc = regions[data][index].acc;
+}
+
+/*
+ *	CMpu::Lookup()
+ *
+ *  Finds the region of an address and adds the range of addresses around it that belongs to
+ *  the same region to the region cache.
+ *
+ *	Parameters: data - True for a data access, false for a fetch
+ *				addr - The address
+ *				need - The access right needed (MPU_*)
+ *				user - True in user mode
+ *
+ *	Returns:	True if the access is allowed
+ */
+bool CMpu::Lookup(bool data, UINT addr, UINT need, bool user)
+{
+	UINT low = 0, high = MPUACC_LIMIT;
+
+	for(UINT i=0; i<num_regions[data]; i++)
+	{
+		UINT base = regions[data][i].base;
+		UINT limit = regions[data][i].acc & MPUACC_LIMIT;
+
+		if(addr >= base && addr < limit)
+		{
+			const UCHAR *access = (data ? data_access : instruction_access)[(regions[data][i].acc & MPUACC_PERM) >> MPUACC_PERM_SHIFT];
+			CacheEntry& entry = cache[data][next_entry[data]];
+
+			// The regions with lower indices take precedence, so the range ends where they start
+			entry.low = base > low ? base : low;
+			entry.size = (limit < high ? limit : high) - entry.low;
+			entry.access[0] = access[0];
+			entry.access[1] = access[1];
+			next_entry[data] = (next_entry[data] + 1) % MPU_CACHE_SIZE;
+
+			return (access[user] & need) != 0;
+		}
+
+		// The region doesn't cover the address, but limits the range that can be cached
+		if(limit <= addr)
+		{
+			if(limit > low)
+				low = limit;
+		}
+		else if(base < high)
+		{
+			high = base;
+		}
+	}
+
+	// No region covers the address
+	return false;
+}
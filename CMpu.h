@@ -0,0 +1,123 @@
+/*
+NIISim - Nios II Simulator, A simulator that is capable of simulating various systems containing Nios II cpus.
+
+This file is part of NIISim.
+
+NIISim is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+NIISim is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/*
+
+This file implements a model of the Nios II memory protection unit (MPU). The instruction and
+data regions are written and read with the mpubase and mpuacc control registers and use the
+limit format, a region covers base <= address < limit. The region with the lowest index that
+covers an address decides the permissions. Bit 31 of data addresses, which bypasses the data
+cache, is ignored.
+
+Every fetch and data access is checked, so the checks go through a small cache of address
+ranges that are known to belong to one region, with the permissions of that region.
+
+*/
+
+#ifndef _CMPU_H_
+#define _CMPU_H_
+
+#include "types.h"
+
+// Fields of the mpubase control register
+#define MPUBASE_D			0x00000001	// Data region
+#define MPUBASE_INDEX_SHIFT	1
+#define MPUBASE_INDEX		0x0000003E
+#define MPUBASE_BASE		0x7FFFFFC0
+
+// Fields of the mpuacc control register
+#define MPUACC_WR			0x00000001	// Write the region selected by mpubase
+#define MPUACC_RD			0x00000002	// Read the region selected by mpubase
+#define MPUACC_PERM_SHIFT	2
+#define MPUACC_PERM			0x0000001C
+#define MPUACC_C			0x00000020	// Cacheable
+#define MPUACC_LIMIT		0xFFFFFFC0
+
+// Maximum number of instruction or data regions
+#define MPU_MAX_REGIONS		32
+
+// Number of entries of the region cache of instruction and data accesses each
+#define MPU_CACHE_SIZE		2
+
+// Access rights of a region, for supervisor and user mode
+#define MPU_READ			0x1			// Read or execute
+#define MPU_WRITE			0x2
+
+class CMpu
+{
+private:
+	// A region, as written to mpubase and mpuacc
+	struct Region
+	{
+		UINT base;
+		UINT acc;
+	};
+
+	// A range of addresses that belongs to one region
+	struct CacheEntry
+	{
+		UINT low;			// The first address
+		UINT size;			// The number of addresses, 0 if the entry is unused
+		UCHAR access[2];	// Access rights in supervisor and user mode (MPU_*)
+	};
+
+	UINT num_regions[2];						// Number of instruction and data regions
+	Region regions[2][MPU_MAX_REGIONS];			// The instruction and data regions
+	Region init_regions[2][MPU_MAX_REGIONS];	// The regions after a reset, set by the .sdf file
+	bool has_init_regions;						// True if the .sdf file set any region
+
+	CacheEntry cache[2][MPU_CACHE_SIZE];		// Region caches of instruction and data accesses
+	UINT next_entry[2];							// The cache entry replaced next
+
+	void InvalidateCache();
+	bool Lookup(bool data, UINT addr, UINT need, bool user);
+
+	/*
+	 *	CMpu::Check()
+	 *
+	 *  Checks an access against the region cache, and against the regions if it misses
+	 */
+	inline bool Check(bool data, UINT addr, UINT need, bool user)
+	{
+		for(UINT i=0; i<MPU_CACHE_SIZE; i++)
+		{
+			const CacheEntry& entry = cache[data][i];
+			if(addr - entry.low < entry.size)
+				return (entry.access[user] & need) != 0;
+		}
+		return Lookup(data, addr, need, user);
+	}
+public:
+	CMpu();
+
+	bool Configure(UINT instruction_regions, UINT data_regions);
+	bool SetInitRegion(bool data, UINT index, UINT base, UINT limit, UINT perm);
+	bool HasInitRegions() { return has_init_regions; };
+	void Reset();
+
+	void WriteRegion(UINT mpubase, UINT mpuacc);
+	void ReadRegion(UINT *mpubase, UINT *mpuacc);
+
+	bool CheckFetch(UINT addr, bool user) { return Check(false, addr, MPU_READ, user); };
+	bool CheckLoad(UINT addr, bool user) { return Check(true, addr & 0x7FFFFFFF, MPU_READ, user); };
+	bool CheckStore(UINT addr, bool user) { return Check(true, addr & 0x7FFFFFFF, MPU_WRITE, user); };
+};
+
+#endif
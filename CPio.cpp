@@ -20,6 +20,7 @@ along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "sim.h"
 #include "CPio.h"
+#include "CFrontEnd.h"
 
 /*
  *	CPio::CPio()
@@ -29,7 +30,6 @@ along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
  */
 CPio::CPio()
 {
-	name[0] = '\0';
 	base = span = irq = 0;
 	has_irq = false;
 	strcpy(type, "in");
@@ -39,6 +39,12 @@ CPio::CPio()
 	data_reg = 0;
 	interrupt_mask_reg = 0;
 	edge_cap_reg = 0;
+
+	dirty_mask = 0;
+	memset(on_cycles, 0, sizeof(on_cycles));
+	last_change_clk = snapshot_clk = 0;
+
+	wave_data = wave_edge_cap = 0;
 }
 
 /*
@@ -47,14 +53,24 @@ CPio::CPio()
  *  Performs a reset by setting the data, interrupt mask and edge cap registers to 0.
  *  Then if the PIO interface is mapped to a board device group that is of type "in", 
  *  retrieve the data and store it in the data register.
+ *  The output tracking is restarted from clock cycle 0 since the system clock is reset as well.
  */
 void CPio::Reset()
 {
+	lock.lock();
+
+	// Mark the bits that were set as changed so that the board redraws them
+	dirty_mask |= data_reg;
+	memset(on_cycles, 0, sizeof(on_cycles));
+	last_change_clk = snapshot_clk = 0;
+
 	// Reset all registers
 	data_reg = 0;
 	interrupt_mask_reg = 0;
 	edge_cap_reg = 0;
 
+	lock.unlock();
+
 	// Check if a device group is mapped to this PIO
 	if(device_group)
 	{
@@ -65,6 +81,9 @@ void CPio::Reset()
 			data_reg = device_group->GetData();
 		}
 	}
+
+	main_system.RecordWave(wave_data, data_reg);
+	main_system.RecordWave(wave_edge_cap, edge_cap_reg);
 }
 
 /*
@@ -119,34 +138,35 @@ UINT CPio::Read(UINT addr, UINT size)
  *	Parameters: addr - The address to write to
  *				size - Size in bits of the written data (8, 16 or 32)
  *				d    - The data to write
+ *
+ *  Writes to the data register of an "out" PIO are only recorded here. The board device group 
+ *  collects them with TakeOutputSnapshot() once per frame, so the simulation thread never 
+ *  has to touch any GTK widgets.
  */
 void CPio::Write(UINT addr, UINT size, UINT d)
 {
-	//HDC hDC;
-
 	// Data register
 	if(addr == base)
 	{
 		// Check if type is "out"
 		if(!strcmp(type, "out"))
 		{
+			// Nothing to record if the value didn't change
+			if(d == data_reg)
+				return;
+
+			lock.lock();
+
+			// Credit the old value with the time it was held
+			AccumulateOnTime(main_system.GetClk());
+			// Remember which bits have changed
+			dirty_mask |= data_reg ^ d;
 			// Store the new data in the data register
 			data_reg = d;
 
-			// Check if this PIO interface is mapped to a board device group
-			if(device_group)
-			{
-				// Notify the device group that the data has been updates
-				device_group->SetData(d);
-				// Redraw the device group if the board window is visible
-				/*if(IsWindowVisible(hBoard))
-				{
-					hDC = GetDC(hBoard);
-					device_group->Draw(hDC, main_board.GetCoords());
-					ReleaseDC(hBoard, hDC);
-				}*/
-				//FIXME
-			}
+			lock.unlock();
+
+			main_system.RecordWave(wave_data, data_reg);
 		}
 	}
 	// Direction register
@@ -162,18 +182,24 @@ void CPio::Write(UINT addr, UINT size, UINT d)
 	// Edge capture register
 	else if(addr == (base + 12))
 	{
+		lock.lock();
+
 		// Set edge cap register to 0
 		edge_cap_reg = 0;
 		// Deassert any IRQ
 		if(has_irq)
 			main_system.DeassertIRQ(irq);
+
+		lock.unlock();
+
+		main_system.RecordWave(wave_edge_cap, edge_cap_reg);
 	}
 }
 
 /*
  *	CPio::UpdateData()
  *
- *  Signals the PIO interface that the data has been changed.
+ *  Signals the PIO interface that the data has been changed. Must be called with the lock held.
  *
  *	Parameters: data - The new data
  *				bit - The bit that was changed in the data register
@@ -192,4 +218,104 @@ void CPio::UpdateData(UINT data, UINT bit)
 		if(has_irq)
 			main_system.AssertIRQ(irq);
 	}
+}
+
+/*
+ *	CPio::SetInputBit()
+ *
+ *  Sets a single bit of the data register of an "in" pio interface, as if the device on the board 
+ *  mapped to that bit was clicked. Used by input script events.
+ *
+ *	Parameters: bit - The bit in the data register
+ *				value - The new value of the bit (0 or 1)
+ */
+void CPio::SetInputBit(UINT bit, UINT value)
+{
+	UINT data, edge_cap;
+	bool changed;
+
+	// Clicks come from the GUI thread and input script events from the simulation thread
+	lock.lock();
+
+	if(value)
+		data = data_reg | (1 << bit);
+	else
+		data = data_reg & ~(1 << bit);
+
+	// Only an actual change is an edge
+	changed = data != data_reg;
+	if(changed)
+		UpdateData(data, bit);
+	edge_cap = edge_cap_reg;
+
+	lock.unlock();
+
+	if(changed)
+	{
+		main_system.RecordWave(wave_data, data);
+		main_system.RecordWave(wave_edge_cap, edge_cap);
+	}
+}
+
+/*
+ *	CPio::AddWaveSignals()
+ *
+ *  Adds the data and edge capture registers to the wave recorder
+ *
+ *	Parameters: recorder - The wave recorder
+ */
+void CPio::AddWaveSignals(CWaveRecorder *recorder)
+{
+	wave_data = recorder->AddSignal(GetName(), "data", 32, data_reg);
+	wave_edge_cap = recorder->AddSignal(GetName(), "edge_capture", 32, edge_cap_reg);
+}
+
+/*
+ *	CPio::AccumulateOnTime()
+ *
+ *  Adds the number of clock cycles since the last change to the on time of every bit 
+ *  that is set in the data register. Must be called with the lock held.
+ *
+ *	Parameters: clk - The current clock cycle
+ */
+void CPio::AccumulateOnTime(UINT clk)
+{
+	UINT elapsed, bits;
+
+	elapsed = clk - last_change_clk;
+	last_change_clk = clk;
+
+	// Loop through the set bits only
+	for(bits = data_reg; bits; bits &= bits - 1)
+		on_cycles[__builtin_ctz(bits)] += elapsed;
+}
+
+/*
+ *	CPio::TakeOutputSnapshot()
+ *
+ *  Retrieves the output activity since the previous snapshot and starts a new measurement period.
+ *  This function is called by the board device group this PIO is mapped to, once per frame.
+ *
+ *	Parameters: snapshot - Receives the data register, the changed bits and the on time of each bit
+ */
+void CPio::TakeOutputSnapshot(OutputSnapshot *snapshot)
+{
+	UINT clk;
+
+	lock.lock();
+
+	clk = main_system.GetClk();
+	AccumulateOnTime(clk);
+
+	snapshot->data = data_reg;
+	snapshot->dirty = dirty_mask;
+	snapshot->elapsed = clk - snapshot_clk;
+	memcpy(snapshot->on_cycles, on_cycles, sizeof(on_cycles));
+
+	// Start a new measurement period
+	dirty_mask = 0;
+	memset(on_cycles, 0, sizeof(on_cycles));
+	snapshot_clk = clk;
+
+	lock.unlock();
 }
\ No newline at end of file
@@ -24,8 +24,10 @@ along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
 #include <vector>
 using namespace std;
 #include "MMDevice.h"
+#include "CThread.h"
 
-class CBoardDeviceGroup;
+class CDeviceGroupInterface;
+class CWaveRecorder;
 
 class CPio : public MMDevice
 {
@@ -37,7 +39,18 @@ private:
 	// Internal registers
 	UINT data_reg, interrupt_mask_reg, edge_cap_reg;
 
-	CBoardDeviceGroup *device_group;	// Pointer to the device group this pio is mapped to
+	CDeviceGroupInterface *device_group;	// Pointer to the device group this pio is mapped to
+
+	// Output tracking, written by the simulation thread and collected by the board once per frame
+	UINT dirty_mask;		// Bits in the data register that have changed since the last snapshot
+	UINT on_cycles[32];		// Number of clock cycles each bit has been 1 since the last snapshot
+	UINT last_change_clk;	// Clock cycle when on_cycles was last brought up to date
+	UINT snapshot_clk;		// Clock cycle when the last snapshot was taken
+	CMutex lock;			// Lock for the output tracking variables
+
+	UINT wave_data, wave_edge_cap;	// Signals in the wave recorder
+
+	void AccumulateOnTime(UINT clk);
 public:
 	CPio();
 	~CPio() {};
@@ -53,8 +66,22 @@ public:
 	void SetType(const char *t) { strcpy(type,  t); };
 	const char *GetType() { return type; };
 
-	void SetBoardDeviceGroup(CBoardDeviceGroup *dev) {device_group = dev;};
+	void SetBoardDeviceGroup(CDeviceGroupInterface *dev) {device_group = dev;};
 	void UpdateData(UINT data, UINT bit);
+	void SetInputBit(UINT bit, UINT value);
+	UINT GetData() { return data_reg; };
+
+	void AddWaveSignals(CWaveRecorder *recorder);
+
+	// Snapshot of the output activity since the previous call
+	struct OutputSnapshot
+	{
+		UINT data;			// Current value of the data register
+		UINT dirty;			// Bits that have changed since the previous snapshot
+		UINT elapsed;		// Number of clock cycles since the previous snapshot
+		UINT on_cycles[32];	// Number of clock cycles each bit has been 1 during elapsed
+	};
+	void TakeOutputSnapshot(OutputSnapshot *snapshot);
 };
 
 #endif
\ No newline at end of file
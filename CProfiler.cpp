@@ -0,0 +1,319 @@
+/*
+NIISim - Nios II Simulator, A simulator that is capable of simulating various systems containing Nios II cpus.
+
+This file is part of NIISim.
+
+NIISim is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+NIISim is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstdio>
+#include <algorithm>
+#include "CProfiler.h"
+
+/*
+ *	CompareCounts()
+ *
+ *  Orders report entries by decreasing count
+ */
+template<class T>
+static bool CompareCounts(const pair<T, unsigned long long>& a, const pair<T, unsigned long long>& b)
+{
+	return a.second > b.second;
+}
+
+/*
+ *	CProfiler::CProfiler()
+ *
+ *  Constructor for the CProfiler class.
+ */
+CProfiler::CProfiler()
+{
+	base = 0;
+	num_counts = 0;
+	Reset(0);
+}
+
+/*
+ *	CProfiler::SetCodeRange()
+ *
+ *  Sets the addresses of the instructions that are counted
+ *
+ *	Parameters: base - The address of the first instruction
+ *				size - The size of the code in bytes
+ */
+void CProfiler::SetCodeRange(UINT base, UINT size)
+{
+	this->base = base;
+	num_counts = size / 4;
+	counts.assign(num_counts, 0);
+}
+
+/*
+ *	CProfiler::Reset()
+ *
+ *  Clears the profile
+ *
+ *	Parameters: entry - The address the program starts at
+ */
+void CProfiler::Reset(UINT entry)
+{
+	StackNode root;
+
+	counts.assign(num_counts, 0);
+
+	root.parent = 0;
+	root.first_child = 0;
+	root.next_sibling = 0;
+	root.func = entry;
+	root.depth = 0;
+	root.folded = 0;
+	root.calls = 1;
+	root.cycles = 0;
+
+	nodes.clear();
+	nodes.push_back(root);
+	current = 0;
+	last_clk = 0;
+}
+
+/*
+ *	CProfiler::AddCycles()
+ *
+ *  Adds the cycles since the last call or return to the current call stack
+ *
+ *	Parameters: clk - The current clock cycle
+ */
+void CProfiler::AddCycles(UINT clk)
+{
+	nodes[current].cycles += clk - last_clk;
+	last_clk = clk;
+}
+
+/*
+ *	CProfiler::Call()
+ *
+ *  Enters a function, called by call, callr and on exceptions. The called stacks of a stack
+ *  are kept in a list with the last called first, so a call in a loop finds its stack at once.
+ *
+ *	Parameters: func - The address of the called function
+ *				clk - The current clock cycle
+ */
+void CProfiler::Call(UINT func, UINT clk)
+{
+	UINT child, prev;
+
+	AddCycles(clk);
+
+	// Recursion and too deep calls stay in the current stack until they return
+	if(nodes[current].func == func || nodes[current].depth >= MAX_STACK_DEPTH)
+	{
+		nodes[current].folded++;
+		return;
+	}
+
+	prev = 0;
+	for(child = nodes[current].first_child; child != 0; child = nodes[child].next_sibling)
+	{
+		if(nodes[child].func == func)
+			break;
+		prev = child;
+	}
+
+	if(child == 0)
+	{
+		StackNode node;
+
+		node.parent = current;
+		node.first_child = 0;
+		node.next_sibling = nodes[current].first_child;
+		node.func = func;
+		node.depth = nodes[current].depth + 1;
+		node.folded = 0;
+		node.calls = 0;
+		node.cycles = 0;
+
+		child = nodes.size();
+		nodes.push_back(node);
+		nodes[current].first_child = child;
+	}
+	else if(prev != 0)
+	{
+		// Move the stack first in the list
+		nodes[prev].next_sibling = nodes[child].next_sibling;
+		nodes[child].next_sibling = nodes[current].first_child;
+		nodes[current].first_child = child;
+	}
+
+	current = child;
+	nodes[current].calls++;
+}
+
+/*
+ *	CProfiler::Return()
+ *
+ *  Leaves the current function, called by ret and eret
+ *
+ *	Parameters: clk - The current clock cycle
+ */
+void CProfiler::Return(UINT clk)
+{
+	AddCycles(clk);
+
+	if(nodes[current].folded)
+	{
+		nodes[current].folded--;
+		return;
+	}
+
+	// Programs that return from the entry point or switch stacks may return more than they call
+	current = nodes[current].parent;
+}
+
+/*
+ *	CProfiler::FunctionName()
+ *
+ *  Looks up the function containing an address in the symbol table
+ *
+ *	Parameters: addr - The address
+ *
+ *	Returns:	The name of the function, or the address in hex if there is none
+ */
+string CProfiler::FunctionName(UINT addr)
+{
+	const ELFSymbol *symbol;
+	char text[16];
+
+	symbol = FindFunctionSymbol(symbols, addr);
+	if(symbol)
+		return symbol->name;
+
+	sprintf(text, "0x%08X", addr);
+	return text;
+}
+
+/*
+ *	CProfiler::StackName()
+ *
+ *  Formats a call stack as the function names from the outermost to the innermost,
+ *  separated with semicolons, as used by flame graph tools
+ *
+ *	Parameters: node - The call stack
+ *
+ *	Returns:	The formatted call stack
+ */
+string CProfiler::StackName(UINT node)
+{
+	string name = FunctionName(nodes[node].func);
+
+	while(node != 0)
+	{
+		node = nodes[node].parent;
+		name = FunctionName(nodes[node].func) + ";" + name;
+	}
+	return name;
+}
+
+/*
+ *	CProfiler::WriteReport()
+ *
+ *  Writes the profile to <prefix>.txt, with the instruction counts per function and per source
+ *  line and the call graph, and to <prefix>.folded, with the clock cycles of each call stack
+ *  in the folded stack format used by flame graph tools.
+ *
+ *	Parameters: prefix - The file names without extension
+ *				debug_info - The line table of the program
+ *				clk - The current clock cycle
+ *
+ *	Returns:	False if a file couldn't be created
+ */
+bool CProfiler::WriteReport(const char *prefix, DebugInfo& debug_info, UINT clk)
+{
+	map<string, unsigned long long> function_counts;
+	map<pair<int, int>, unsigned long long> line_counts;
+	map<pair<string, string>, unsigned long long> edges;
+	unsigned long long total = 0;
+	FILE *f;
+
+	AddCycles(clk);
+
+	// Sum up the instructions per function and per source line
+	for(UINT i=0; i<num_counts; i++)
+	{
+		UINT addr, addr_with_source;
+
+		if(!counts[i])
+			continue;
+		addr = base + i*4;
+		total += counts[i];
+
+		function_counts[FunctionName(addr)] += counts[i];
+
+		addr_with_source = debug_info.GetNearestPrecedingAddrWithSourceInformation(addr);
+		if(addr_with_source != ~0U)
+		{
+			const vector<pair<int, int> >& lines = debug_info.AddrToSource(addr_with_source);
+			if(!lines.empty())
+				line_counts[lines[0]] += counts[i];
+		}
+	}
+
+	// The call graph, as caller -> callee with the number of calls
+	for(UINT i=1; i<nodes.size(); i++)
+		edges[make_pair(FunctionName(nodes[nodes[i].parent].func), FunctionName(nodes[i].func))] += nodes[i].calls;
+
+	f = fopen((string(prefix) + ".txt").c_str(), "w");
+	if(!f)
+		return false;
+
+	{
+		vector<pair<string, unsigned long long> > sorted(function_counts.begin(), function_counts.end());
+		stable_sort(sorted.begin(), sorted.end(), CompareCounts<string>);
+
+		fprintf(f, "Instructions per function, %llu instructions in total\n\n", total);
+		fprintf(f, "%14s %7s  %s\n", "instructions", "%", "function");
+		for(UINT i=0; i<sorted.size(); i++)
+			fprintf(f, "%14llu %6.2f%%  %s\n", sorted[i].second, 100.0 * sorted[i].second / total, sorted[i].first.c_str());
+	}
+
+	{
+		vector<pair<pair<int, int>, unsigned long long> > sorted(line_counts.begin(), line_counts.end());
+		stable_sort(sorted.begin(), sorted.end(), CompareCounts<pair<int, int> >);
+
+		fprintf(f, "\nInstructions per source line\n\n");
+		fprintf(f, "%14s %7s  %s\n", "instructions", "%", "line");
+		for(UINT i=0; i<sorted.size(); i++)
+			fprintf(f, "%14llu %6.2f%%  %s:%d\n", sorted[i].second, 100.0 * sorted[i].second / total,
+				debug_info.source_files[sorted[i].first.first].c_str(), sorted[i].first.second);
+	}
+
+	fprintf(f, "\nCall graph\n\n");
+	fprintf(f, "%14s  %s\n", "calls", "caller -> callee");
+	for(map<pair<string, string>, unsigned long long>::iterator it = edges.begin(); it != edges.end(); ++it)
+		fprintf(f, "%14llu  %s -> %s\n", it->second, it->first.first.c_str(), it->first.second.c_str());
+
+	fclose(f);
+
+	f = fopen((string(prefix) + ".folded").c_str(), "w");
+	if(!f)
+		return false;
+
+	for(UINT i=0; i<nodes.size(); i++)
+	{
+		if(nodes[i].cycles)
+			fprintf(f, "%s %llu\n", StackName(i).c_str(), nodes[i].cycles);
+	}
+
+	fclose(f);
+	return true;
+}
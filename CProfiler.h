@@ -0,0 +1,100 @@
+/*
+NIISim - Nios II Simulator, A simulator that is capable of simulating various systems containing Nios II cpus.
+
+This file is part of NIISim.
+
+NIISim is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+NIISim is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+
+This file implements a profiler of the program running on a cpu. Every executed instruction
+increments a counter in a flat array over the code. Calls, returns and exceptions move
+through a tree of call stacks, and the clock cycles spent between them are added to the
+current call stack. Calls of a function from itself, and calls deeper than MAX_STACK_DEPTH,
+stay in the call stack of the caller, so recursion doesn't grow the tree. The report is symbolized with the ELF symbol table and the line table
+of the debug information.
+
+*/
+
+#ifndef _CPROFILER_H_
+#define _CPROFILER_H_
+
+#include <vector>
+#include <map>
+#include <string>
+using namespace std;
+#include "types.h"
+#include "elf_read_debug.h"
+
+#define MAX_STACK_DEPTH 64
+
+class CProfiler
+{
+private:
+	// A call stack, identified by its caller stack and the called function
+	struct StackNode
+	{
+		UINT parent;				// Index of the caller stack
+		UINT first_child;			// Index of the last called stack from this one, or 0 if none
+		UINT next_sibling;			// Index of the next stack with the same parent, or 0 if none
+		UINT func;					// Address of the called function
+		UINT depth;					// Number of callers
+		UINT folded;				// Number of calls folded into this stack that haven't returned
+		UINT calls;					// Number of times the function was called from the caller stack
+		unsigned long long cycles;	// Clock cycles spent in the function itself with this call stack
+	};
+
+	UINT base;						// Address of the first counted instruction
+	UINT num_counts;				// Number of counted instructions
+	vector<unsigned long long> counts;	// Execution count of each instruction
+
+	vector<StackNode> nodes;		// All call stacks seen, the first is the entry point
+	UINT current;					// The current call stack
+	UINT last_clk;					// Clock cycle of the last call or return
+
+	vector<ELFSymbol> symbols;		// Functions of the program, sorted by address
+
+	void AddCycles(UINT clk);
+	string FunctionName(UINT addr);
+	string StackName(UINT node);
+public:
+	CProfiler();
+
+	void SetCodeRange(UINT base, UINT size);
+	void SetSymbols(const vector<ELFSymbol>& s) { symbols = s; };
+	void Reset(UINT entry);
+
+	/*
+	 *	CProfiler::Count()
+	 *
+	 *  Counts an executed instruction. Instructions outside the code range are ignored.
+	 *
+	 *	Parameters: pc - The address of the instruction
+	 */
+	inline void Count(UINT pc)
+	{
+		UINT index = (pc - base) >> 2;
+
+		if(index < num_counts)
+			counts[index]++;
+	}
+
+	void Call(UINT func, UINT clk);
+	void Return(UINT clk);
+
+	bool WriteReport(const char *prefix, DebugInfo& debug_info, UINT clk);
+};
+
+#endif
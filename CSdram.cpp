@@ -32,7 +32,6 @@ using namespace std;
  */
 CSdram::CSdram()
 {
-	name[0] = '\0';
 	base = span = 0;
 	data = NULL;
 }
@@ -20,6 +20,7 @@ along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <vector>
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 using namespace std;
@@ -36,6 +37,9 @@ using namespace std;
 #include "CUart.h"
 #include "CPio.h"
 #include "CLcd.h"
+#include "CEic.h"
+#include "CCustomInstruction.h"
+#include "elf_read_debug.h"
 
 void* SimThreadFunc(void *data)
 {
@@ -44,6 +48,9 @@ void* SimThreadFunc(void *data)
 	// Infinite loop
 	while(1)
 	{
+		// Finish a stop when no instruction is being executed
+		main_system.AcknowledgeStop();
+
 		// Check if simulation is running and that it's not paused
 		if(main_system.IsSimulationRunning() && !main_system.IsSimulationPaused())
 		{
@@ -111,6 +118,7 @@ CSystem::CSystem()
 
 	sim_running = sim_paused = false;
 	sim_quitting = false;
+	stop_requests = stops_seen = 0;
 	sim_speed = SIM_FAST;
 
 	/*threadHandle = CreateThread(
@@ -124,6 +132,16 @@ CSystem::CSystem()
 
 	generating_trace = false;
 	trace_file = NULL;
+
+	next_input_event = 0;
+	inputs_queued = false;
+
+	next_event_clk = 0;
+	event_seq = 0;
+
+	debugger = &default_debugger;
+	board = NULL;
+	jtag_console = uart0_console = uart1_console = NULL;
 }
 
 /*
@@ -135,6 +153,10 @@ CSystem::CSystem()
  */
 CSystem::~CSystem()
 {
+	// Quit the simulation thread before the devices it uses are deleted,
+	// unless the program already has
+	CloseSimulationThread();
+
 	// Cleap up all loaded interfaces
 	CleanUp();
 
@@ -149,6 +171,25 @@ CSystem::~CSystem()
 	}*/
 }
 
+/*
+ *	CSystem::SetFrontEnd()
+ *
+ *  Sets the debugger, the board and the consoles of the front end that the devices are mapped to.
+ *  Must be called before an .sdf file is loaded.
+ *
+ *	Parameters: d - The debugger
+ *				b - The I/O board or NULL
+ *				jtag, uart0, uart1 - The consoles or NULL
+ */
+void CSystem::SetFrontEnd(CDebugger *d, CBoardInterface *b, CConsoleInterface *jtag, CConsoleInterface *uart0, CConsoleInterface *uart1)
+{
+	debugger = d;
+	board = b;
+	jtag_console = jtag;
+	uart0_console = uart0;
+	uart1_console = uart1;
+}
+
 /*
  *	CSystem::Cleanup()
  *
@@ -161,21 +202,40 @@ void CSystem::CleanUp()
 	for(UINT i=0; i<cpus.size(); i++)
 		delete cpus[i];
 	cpus.clear();
+
+	// The cpus used the custom instruction handlers of the modules
+	UnloadCustomInstructionModules();
 	
 	sdrams.clear();
 	uarts.clear();
 	timers.clear();
+	eics.clear();
 	
 	for(UINT i=0; i<mm_devices.size(); i++)
 		delete mm_devices[i];
 	mm_devices.clear();
+	cpu_names.clear();
+	device_names.clear();
+	device_ranges.clear();
+	device_irqs.clear();
 	
 	// Clear all mapped devices
 	mapped_jtag = NULL;
 
+	// The input events point to pio interfaces that no longer exist
+	input_events.clear();
+	next_input_event = 0;
+	queued_inputs.clear();
+	posted_events.clear();
+	inputs_queued = false;
+	scheduled_events.clear();
+
 	// Stop generating trace file
 	if(generating_trace)
 		StopGenerateTraceFile();
+
+	// Stop recording, the signals belong to the deleted devices
+	StopRecordingWaves();
 }
 
 /*
@@ -191,25 +251,319 @@ bool CSystem::ParseCpu(const ParsedRowArguments& args)
 {
 	CCpu *cpu;
 	
-	if(!ArgsMatches(args, "snnn"))
+	if(!ArgsMatches(args, "snnns?n?"))
 		return false;
 
 	cpu = new CCpu;
 
 	// Name
-	cpu->SetName(args[0].second.c_str());
+	cpu->SetName(args[0].str);
 	// Reset address
-	cpu->SetResetAddress(atoi(args[1].second.c_str()));
+	cpu->SetResetAddress(args[1].number);
 	// Exception address
-	cpu->SetExceptionAddress(atoi(args[2].second.c_str()));
+	cpu->SetExceptionAddress(args[2].number);
 	// Frequency
-	cpu->SetFrequency(atoi(args[3].second.c_str()));
+	cpu->SetFrequency(args[3].number);
+
+	// Timing model
+	if(args.size() > 4)
+	{
+		if(!strcmp(args[4].str, "none"))
+			cpu->SetCore(CPU_CORE_NONE);
+		else if(!strcmp(args[4].str, "e"))
+			cpu->SetCore(CPU_CORE_E);
+		else if(!strcmp(args[4].str, "s"))
+			cpu->SetCore(CPU_CORE_S);
+		else if(!strcmp(args[4].str, "f"))
+			cpu->SetCore(CPU_CORE_F);
+		else
+		{
+			delete cpu;
+			return false;
+		}
+	}
+
+	// Shadow register sets
+	if(args.size() > 5)
+	{
+		if(args[5].number > CPU_MAX_SHADOW_SETS)
+		{
+			delete cpu;
+			return false;
+		}
+		cpu->SetShadowRegisterSets(args[5].number);
+	}
 
 	// Add the cpu to the system
 	cpus.push_back(cpu);
 	return true;
 }
 
+/*
+ *	CSystem::ParseCache()
+ *
+ *  Parses an AddCache command from the .sdf file
+ *
+ *	Parameters: args - A vector that contains the line with the AddCache command
+ *
+ *	Returns:	True if the parsing was successful and false if an error occured.
+ */
+bool CSystem::ParseCache(const ParsedRowArguments& args)
+{
+	CCpu *cpu = NULL;
+	CCache *cache;
+	UINT replacement, write_policy;
+
+	if(!ArgsMatches(args, "ssnnns?s?"))
+		return false;
+
+	// The cpu must have been added before
+	cpu = FindCpu(args[0].str);
+	if(!cpu)
+		return false;
+
+	// Replacement policy
+	replacement = CACHE_REPLACE_LRU;
+	if(args.size() > 5)
+	{
+		if(!strcmp(args[5].str, "fifo"))
+			replacement = CACHE_REPLACE_FIFO;
+		else if(!strcmp(args[5].str, "random"))
+			replacement = CACHE_REPLACE_RANDOM;
+		else if(strcmp(args[5].str, "lru"))
+			return false;
+	}
+
+	// Write policy
+	write_policy = CACHE_WRITE_BACK;
+	if(args.size() > 6)
+	{
+		if(!strcmp(args[6].str, "writethrough"))
+			write_policy = CACHE_WRITE_THROUGH;
+		else if(strcmp(args[6].str, "writeback"))
+			return false;
+	}
+
+	// Size, line size and associativity
+	cache = new CCache;
+	if(!cache->Configure(args[2].number, args[3].number, args[4].number, replacement, write_policy))
+	{
+		delete cache;
+		return false;
+	}
+
+	if(!strcmp(args[1].str, "instruction"))
+		cpu->SetInstructionCache(cache);
+	else if(!strcmp(args[1].str, "data"))
+		cpu->SetDataCache(cache);
+	else
+	{
+		delete cache;
+		return false;
+	}
+	return true;
+}
+
+/*
+ *	CSystem::ParseEic()
+ *
+ *  Parses an AddEIC command from the .sdf file
+ *
+ *	Parameters: args - A vector that contains the line with the AddEIC command
+ *
+ *	Returns:	True if the parsing was successful and false if an error occured.
+ */
+bool CSystem::ParseEic(const ParsedRowArguments& args)
+{
+	CCpu *cpu = NULL;
+	CEic *eic;
+
+	if(!ArgsMatches(args, "snnsn?"))
+		return false;
+
+	// The cpu must have been added before and can only have one EIC
+	cpu = FindCpu(args[3].str);
+	if(!cpu || cpu->GetEic())
+		return false;
+
+	eic = new CEic;
+
+	// Name
+	eic->SetName(args[0].str);
+	// Base address
+	eic->SetBaseAddress(args[1].number);
+	// Span
+	eic->SetSpan(args[2].number);
+	// Vector table
+	if(args.size() > 4)
+		eic->SetVectorTable(args[4].number);
+
+	cpu->SetEic(eic);
+	eics.push_back(eic);
+
+	mm_devices.push_back(eic);
+	return true;
+}
+
+/*
+ *	CSystem::ParseEicVector()
+ *
+ *  Parses an AddEICVector command from the .sdf file
+ *
+ *	Parameters: args - A vector that contains the line with the AddEICVector command
+ *
+ *	Returns:	True if the parsing was successful and false if an error occured.
+ */
+bool CSystem::ParseEicVector(const ParsedRowArguments& args)
+{
+	CEic *eic;
+	UINT irq, level, set;
+
+	if(!ArgsMatches(args, "snnnn?n?"))
+		return false;
+
+	// The EIC must have been added before
+	eic = dynamic_cast<CEic*>(FindDevice(args[0].str));
+	if(!eic)
+		return false;
+
+	// IRQ, level and register set
+	irq = args[1].number;
+	level = args[2].number;
+	set = args[3].number;
+	if(irq >= EIC_NUM_IRQS || level < 1 || level > EIC_CONFIG_RIL || set > CPU_MAX_SHADOW_SETS)
+		return false;
+
+	// Handler address and non-maskable
+	eic->SetVector(irq, level, set, args.size() > 5 && args[5].number != 0,
+		args.size() > 4 ? args[4].number : 0);
+	return true;
+}
+
+/*
+ *	CSystem::ParseCustomInstruction()
+ *
+ *  Parses an AddCustomInstruction command from the .sdf file
+ *
+ *	Parameters: args - A vector that contains the line with the AddCustomInstruction command
+ *
+ *	Returns:	True if the parsing was successful and false if an error occured.
+ */
+bool CSystem::ParseCustomInstruction(const ParsedRowArguments& args)
+{
+	CCpu *cpu = NULL;
+	const BuiltinCustomInstruction *builtin = NULL;
+	CustomInstructionFunc func = NULL;
+	UINT n, count, latency;
+
+	if(!ArgsMatches(args, "snnsn?s?"))
+		return false;
+
+	// The cpu must have been added before
+	cpu = FindCpu(args[0].str);
+	if(!cpu)
+		return false;
+
+	// Latency
+	latency = 1;
+	if(args.size() > 4)
+		latency = args[4].number;
+
+	// The handler is built in, or loaded from a shared object
+	if(args.size() > 5)
+		func = LoadCustomInstruction(args[5].str, args[3].str);
+	else
+	{
+		builtin = FindBuiltinCustomInstruction(args[3].str);
+		if(builtin)
+			func = builtin->func;
+	}
+	if(!func)
+		return false;
+
+	// N and the number of custom instructions
+	n = args[1].number;
+	count = args[2].number;
+	if(!cpu->AddCustomInstruction(n, count, func, latency))
+		return false;
+
+	// Built in units have a latency for each instruction, unless the .sdf file sets it
+	if(builtin && builtin->latencies && args.size() <= 4)
+	{
+		for(UINT i=0; i<count && i<builtin->count; i++)
+			cpu->SetCustomInstructionLatency(n + i, builtin->latencies[i]);
+	}
+	return true;
+}
+
+/*
+ *	CSystem::ParseMpu()
+ *
+ *  Parses an AddMPU command from the .sdf file
+ *
+ *	Parameters: args - A vector that contains the line with the AddMPU command
+ *
+ *	Returns:	True if the parsing was successful and false if an error occured.
+ */
+bool CSystem::ParseMpu(const ParsedRowArguments& args)
+{
+	CCpu *cpu = NULL;
+	CMpu *mpu;
+
+	if(!ArgsMatches(args, "snn"))
+		return false;
+
+	// The cpu must have been added before
+	cpu = FindCpu(args[0].str);
+	if(!cpu)
+		return false;
+
+	// Number of instruction and data regions
+	mpu = new CMpu;
+	if(!mpu->Configure(args[1].number, args[2].number))
+	{
+		delete mpu;
+		return false;
+	}
+
+	cpu->SetMpu(mpu);
+	return true;
+}
+
+/*
+ *	CSystem::ParseMpuRegion()
+ *
+ *  Parses an AddMPURegion command from the .sdf file
+ *
+ *	Parameters: args - A vector that contains the line with the AddMPURegion command
+ *
+ *	Returns:	True if the parsing was successful and false if an error occured.
+ */
+bool CSystem::ParseMpuRegion(const ParsedRowArguments& args)
+{
+	CCpu *cpu = NULL;
+	bool data;
+
+	if(!ArgsMatches(args, "ssnnnn"))
+		return false;
+
+	// The cpu must have been added before, with an MPU
+	cpu = FindCpu(args[0].str);
+	if(!cpu || !cpu->GetMpu())
+		return false;
+
+	if(!strcmp(args[1].str, "instruction"))
+		data = false;
+	else if(!strcmp(args[1].str, "data"))
+		data = true;
+	else
+		return false;
+
+	// Index, base, limit and permissions
+	return cpu->GetMpu()->SetInitRegion(data, args[2].number, args[3].number,
+		args[4].number, args[5].number);
+}
+
 /*
  *	CSystem::ParseSdram()
  *
@@ -230,16 +584,16 @@ bool CSystem::ParseSdram(const ParsedRowArguments& args)
 	sdram = new CSdram;
 
 	// Name
-	sdram->SetName(args[0].second.c_str());
+	sdram->SetName(args[0].str);
 	// Base address
-	base = atoi(args[1].second.c_str());
+	base = args[1].number;
 	sdram->SetBaseAddress(base);
 	// Span
-	span = atoi(args[2].second.c_str());
+	span = args[2].number;
 	sdram->SetSpan(span);
 	
 	// Tell the debugger about the memory
-	main_debug.SetMemoryInfo(base, span);
+	debugger->SetMemoryInfo(base, span);
 
 	// Add the sdram to the system
 	sdrams.push_back(sdram);
@@ -263,23 +617,27 @@ bool CSystem::ParseUart(const ParsedRowArguments& args)
 	UINT base, span;
 	CUart *uart;
 
-	if(!ArgsMatches(args, "snnn?"))
+	if(!ArgsMatches(args, "snnn?n?"))
 		return false;
 
 	uart = new CUart;
 
 	// Name
-	uart->SetName(args[0].second.c_str());
+	uart->SetName(args[0].str);
 	// Base address
-	base = atoi(args[1].second.c_str());
+	base = args[1].number;
 	uart->SetBaseAddress(base);
 	// Span
-	span = atoi(args[2].second.c_str());
+	span = args[2].number;
 	uart->SetSpan(span);
 	
 	if (args.size() > 3)
 		// IRQ
-		uart->SetIRQ(atoi(args[3].second.c_str()));
+		uart->SetIRQ(args[3].number);
+
+	if (args.size() > 4)
+		// Baud rate, enables the timing model
+		uart->SetBaudRate(args[4].number);
 
 	// Add the uart interface to the system
 	uarts.push_back(uart);
@@ -309,17 +667,17 @@ bool CSystem::ParseJtag(const ParsedRowArguments& args)
 	jtag = new CJtag;
 
 	// Name
-	jtag->SetName(args[0].second.c_str());
+	jtag->SetName(args[0].str);
 	// Base address
-	base = atoi(args[1].second.c_str());
+	base = args[1].number;
 	jtag->SetBaseAddress(base);
 	// Span
-	span = atoi(args[2].second.c_str());
+	span = args[2].number;
 	jtag->SetSpan(span);
 	
 	if (args.size() > 3)
 		// IRQ
-		jtag->SetIRQ(atoi(args[3].second.c_str()));
+		jtag->SetIRQ(args[3].number);
 
 	//jtag->Reset();
 	mm_devices.push_back(jtag);
@@ -346,12 +704,12 @@ bool CSystem::ParseLcd(const ParsedRowArguments& args)
 	lcd = new CLcd;
 
 	// Name
-	lcd->SetName(args[0].second.c_str());
+	lcd->SetName(args[0].str);
 	// Base address
-	base = atoi(args[1].second.c_str());
+	base = args[1].number;
 	lcd->SetBaseAddress(base);
 	// Span
-	span = atoi(args[2].second.c_str());
+	span = args[2].number;
 	lcd->SetSpan(span);
 
 	//lcd->Reset();
@@ -381,24 +739,24 @@ bool CSystem::ParseTimer(const ParsedRowArguments& args)
 	timer = new CTimer;
 
 	// Name
-	timer->SetName(args[0].second.c_str());
+	timer->SetName(args[0].str);
 	// Base address
-	base = atoi(args[1].second.c_str());
+	base = args[1].number;
 	timer->SetBaseAddress(base);
 	// Span
-	span = atoi(args[2].second.c_str());
+	span = args[2].number;
 	timer->SetSpan(span);
 	// Frequency
-	timer->SetFrequency(atoi(args[3].second.c_str()));
+	timer->SetFrequency(args[3].number);
 	// Period
-	period = atoi(args[4].second.c_str());
+	period = args[4].number;
 	// Period unit
-	if(args[5].second == "ms")
+	if(!strcmp(args[5].str, "ms"))
 	{
 		UINT freq = timer->GetFrequency();
 		timer->SetPeriod(period*(freq/1000));
 	}
-	else if(args[5].second == "us")
+	else if(!strcmp(args[5].str, "us"))
 	{
 		UINT freq = timer->GetFrequency();
 		timer->SetPeriod(period*(freq/1000000));
@@ -409,14 +767,14 @@ bool CSystem::ParseTimer(const ParsedRowArguments& args)
 		return false;
 	}
 	// Fixed period
-	timer->SetFixedPeriod(atoi(args[6].second.c_str()) != 0);
+	timer->SetFixedPeriod(args[6].number != 0);
 	// Always run
-	timer->SetAlwaysRun(atoi(args[7].second.c_str()) != 0);
+	timer->SetAlwaysRun(args[7].number != 0);
 	// Has snapshot
-	timer->SetHasSnapshot(atoi(args[8].second.c_str()) != 0);
+	timer->SetHasSnapshot(args[8].number != 0);
 	if(args.size() > 9)
 		// IRQ
-		timer->SetIRQ(atoi(args[9].second.c_str()));
+		timer->SetIRQ(args[9].number);
 
 	//timer->Reset();
 	timers.push_back(timer);
@@ -445,20 +803,20 @@ bool CSystem::ParsePio(const ParsedRowArguments& args)
 	pio = new CPio;
 
 	// Name
-	pio->SetName(args[0].second.c_str());
+	pio->SetName(args[0].str);
 	// Base address
-	base = atoi(args[1].second.c_str());
+	base = args[1].number;
 	pio->SetBaseAddress(base);
 	// Span
-	span = atoi(args[2].second.c_str());
+	span = args[2].number;
 	pio->SetSpan(span);
 	// Type
-	pio->SetType(args[3].second.c_str());
+	pio->SetType(args[3].str);
 	
 	// Delimeter
 	if (args.size() > 4)
 		// IRQ
-		pio->SetIRQ(atoi(args[4].second.c_str()));
+		pio->SetIRQ(args[4].number);
 
 
 	//pio->Reset();
@@ -478,16 +836,12 @@ bool CSystem::ParsePio(const ParsedRowArguments& args)
  */
 bool CSystem::ParseImportBoard(const ParsedRowArguments& args)
 {
-	char filepath[256];
-
 	if(!ArgsMatches(args, "s"))
 		return false;
-	
-	// Name
-	strcpy(filepath, args[0].second.c_str());
 
-	// Load the board file
-	main_board.LoadBoard(filepath);
+	// Load the board file, there is no board to show without a front end
+	if(board)
+		board->LoadBoard(args[0].str);
 	return true;
 }
 
@@ -505,81 +859,57 @@ bool CSystem::ParseMap(const ParsedRowArguments& args)
 	if(!ArgsMatches(args, "ss"))
 		return false;
 	
-	const string& name = args[0].second;
-	const string& board_identifier = args[1].second;
+	MMDevice *device = FindDevice(args[0].str);
+	const char *board_identifier = args[1].str;
 	
-	for(UINT i=0; i<mm_devices.size(); i++)
-	{
-		if(name == mm_devices[i]->GetName())
-		{
-			if(board_identifier == "JTAG") if(CJtag *jtag = dynamic_cast<CJtag*>(mm_devices[i]))
-			{
-				// Save a pointer to the jtag interface
-				mapped_jtag = jtag;
-				// Map the jtag interface to the jtag console
-				jtag->SetConsole(&jtag_console);
-
-				return true;
-			}
-			if(board_identifier == "UART0") if(CUart *uart = dynamic_cast<CUart*>(mm_devices[i]))
-			{
-				// Save a pointer to the uart interface
-				mapped_uart0 = uart;
-				// Map the jtag interface to the uart0 console
-				uart->SetConsole(&uart0_console);
+	if(!device)
+		return false;
 
-				return true;
-			}
-			if(board_identifier == "UART1") if(CUart *uart = dynamic_cast<CUart*>(mm_devices[i]))
-			{
-				// Save a pointer to the uart interface
-				mapped_uart1 = uart;
-				// Map the jtag interface to the uart1 console
-				uart->SetConsole(&uart1_console);
+	if(!strcmp(board_identifier, "JTAG")) if(CJtag *jtag = dynamic_cast<CJtag*>(device))
+	{
+		// Save a pointer to the jtag interface
+		mapped_jtag = jtag;
+		// Map the jtag interface to the jtag console
+		jtag->SetConsole(jtag_console);
 
-				return true;
-			}
-			// Check if the identifier is the name of an LCD device on the board
-			if(board_identifier == main_board.GetLCDName()) if(CLcd *lcd = dynamic_cast<CLcd*>(mm_devices[i]))
-			{
-				// Map the lcd interface to the board console
-				lcd->SetBoard(&main_board);
-				
-				return true;
-			}
-		}
+		return true;
 	}
+	if(!strcmp(board_identifier, "UART0")) if(CUart *uart = dynamic_cast<CUart*>(device))
+	{
+		// Save a pointer to the uart interface
+		mapped_uart0 = uart;
+		// Map the jtag interface to the uart0 console
+		uart->SetConsole(uart0_console);
 
-	// Look for the identifier in the list of board device groups
-	CBoardDeviceGroup *device_group = main_board.GetDeviceGroup(board_identifier.c_str());
+		return true;
+	}
+	if(!strcmp(board_identifier, "UART1")) if(CUart *uart = dynamic_cast<CUart*>(device))
+	{
+		// Save a pointer to the uart interface
+		mapped_uart1 = uart;
+		// Map the jtag interface to the uart1 console
+		uart->SetConsole(uart1_console);
 
-	// Return false if no device group was found
-	if(!device_group)
+		return true;
+	}
+	// Check if the identifier is the name of an LCD device on the board
+	if(board && !strcmp(board_identifier, board->GetLCDName())) if(CLcd *lcd = dynamic_cast<CLcd*>(device))
 	{
-		puts(main_board.GetLCDName());
-		return false;
+		// Map the lcd interface to the board console
+		lcd->SetBoard(board);
+		
+		return true;
 	}
 
-	// Check if the device group can be mapped to a pio interface
-	if(device_group->IsPIO())
-	{
-		// Go through all pio interfaces to fine the one with a name that matches
-		for(UINT i=0; i<mm_devices.size(); i++)
-		{
-			if(name == mm_devices[i]->GetName()) if(CPio *pio = dynamic_cast<CPio*>(mm_devices[i]))
-			{
-				// Type must match
-				if(!strcmp(pio->GetType(), device_group->GetType()))
-				{
-					// Save a pointer to the pio interface in the device group
-					device_group->SetPIOInterface(pio);
-					// Map the pio interface to the device group
-					pio->SetBoardDeviceGroup(device_group);
+	// Without a front end there are no board devices to map to
+	if(!board)
+		return true;
 
-					return true;
-				}
-			}
-		}
+	// Map a pio interface to the board device group with a name that matches
+	if(CPio *pio = dynamic_cast<CPio*>(device))
+	{
+		if(board->MapPio(board_identifier, pio))
+			return true;
 	}
 
 	// Couldn't map, return false
@@ -593,47 +923,385 @@ bool CSystem::ParseMap(const ParsedRowArguments& args)
  *
  *	Parameters: file - Filepath to the .sdf file
  *
- *	Throws: ParsingSyntaxError, ParsingError
+ *	Throws: ParsingError
  */
 void CSystem::LoadSystemDescriptionFile(const char *file)
 {
-	char err_str[1024];
+	static const char *commands[] = {"AddCPU", "AddCache", "AddEIC", "AddEICVector", "AddCustomInstruction", "AddMPU", "AddMPURegion", "AddSDRAM", "AddUART", "AddJTAG", "AddLCD", "AddTimer", "AddPIO", "ImportBoard", "Map"};
+	static bool (CSystem::*functions[])(const ParsedRowArguments&) = {&CSystem::ParseCpu, &CSystem::ParseCache, &CSystem::ParseEic, &CSystem::ParseEicVector, &CSystem::ParseCustomInstruction, &CSystem::ParseMpu, &CSystem::ParseMpuRegion, &CSystem::ParseSdram, &CSystem::ParseUart, &CSystem::ParseJtag, &CSystem::ParseLcd, &CSystem::ParseTimer, &CSystem::ParsePio, &CSystem::ParseImportBoard, &CSystem::ParseMap};
+	const UINT num_commands = sizeof(commands)/sizeof(const char*);
 
 	// Stop the simulation if it is running
 	if(sim_running)
 		StopSimulation();
+	WaitForStop();
 
 	// Delete the current system description
 	CleanUp();
 	// Delete the board
-	main_board.CleanUp();
+	if(board)
+		board->CleanUp();
 	elf_loaded = false;
 	sdf_loaded = false;
 	
-	ParsedFile sdf_file = ParseFile(file);
+	ParsedFile sdf_file(file);
 	
-	for(ParsedFile::iterator it = sdf_file.begin(); it != sdf_file.end(); ++it)
+	for(UINT c=0; c<sdf_file.commands.size(); c++)
 	{
-		static const char *commands[] = {"AddCPU", "AddSDRAM", "AddUART", "AddJTAG", "AddLCD", "AddTimer", "AddPIO", "ImportBoard", "Map"};
-		static bool (CSystem::*functions[])(const ParsedRowArguments&) = {&CSystem::ParseCpu, &CSystem::ParseSdram, &CSystem::ParseUart, &CSystem::ParseJtag, &CSystem::ParseLcd, &CSystem::ParseTimer, &CSystem::ParsePio, &CSystem::ParseImportBoard, &CSystem::ParseMap};
+		const ParsedCommand& command = sdf_file.commands[c];
+		UINT first_cpu = cpus.size();
+		UINT first_device = mm_devices.size();
+		UINT i;
 		
-		for(int i=0; i<sizeof(commands)/sizeof(const char*); i++)
+		for(i=0; i<num_commands; i++)
 		{
-			if(it->first == commands[i])
-			{
-				if(!(this->*functions[i])(it->second))
-				{
-					sprintf(err_str, "Error while parsing \'%s\'", commands[i]);
-					throw ParsingError(string(err_str));
-				}
-			}
+			if(!strcmp(command.keyword, commands[i]))
+				break;
 		}
+		if(i == num_commands)
+			throw sdf_file.Error(command, string("Unknown command \'") + command.keyword + "\'");
+		
+		if(!(this->*functions[i])(command.args))
+			throw sdf_file.Error(command, string("Error while parsing \'") + commands[i] + "\'");
+		
+		RegisterNewDevices(sdf_file, command, first_cpu, first_device);
 	}
 
 	// The .sdf file has been loaded successfully
 	sdf_loaded = true;
 }
 
+/*
+ *	CSystem::RegisterNewDevices()
+ *
+ *  Adds the cpus and memory mapped devices created by a command of the .sdf file to the maps by name,
+ *  address and IRQ. Names must be unique, address ranges must not overlap and IRQs must not be shared.
+ *
+ *	Parameters: file - The .sdf file
+ *				command - The command that created the cpus and devices
+ *				first_cpu - The index of the first new cpu
+ *				first_device - The index of the first new memory mapped device
+ *
+ *	Throws: ParsingError
+ */
+void CSystem::RegisterNewDevices(const ParsedFile& file, const ParsedCommand& command, UINT first_cpu, UINT first_device)
+{
+	char err_str[1024];
+
+	for(UINT i=first_cpu; i<cpus.size(); i++)
+	{
+		if(!cpu_names.insert(make_pair(cpus[i]->GetNameId(), cpus[i])).second)
+			throw file.Error(command, command.args[0], string("There is already a cpu named \'") + cpus[i]->GetName() + "\'");
+	}
+
+	for(UINT i=first_device; i<mm_devices.size(); i++)
+	{
+		MMDevice *device = mm_devices[i];
+		MMDevice *overlapped = NULL;
+		UINT base = device->GetBaseAddress();
+		unsigned long long end = (unsigned long long)base + device->GetSpan();
+		map<UINT, MMDevice*>::iterator next, prev;
+
+		if(!device_names.insert(make_pair(device->GetNameId(), device)).second)
+			throw file.Error(command, command.args[0], string("There is already a device named \'") + device->GetName() + "\'");
+
+		// The next device in the address space must start after it, and the previous one must end before it
+		next = device_ranges.lower_bound(base);
+		if(next != device_ranges.end() && next->first < end)
+			overlapped = next->second;
+		if(next != device_ranges.begin())
+		{
+			prev = next;
+			--prev;
+			if((unsigned long long)prev->first + prev->second->GetSpan() > base)
+				overlapped = prev->second;
+		}
+		if(overlapped)
+		{
+			sprintf(err_str, "The addresses 0x%X-0x%X of \'%s\' overlap \'%s\'", base, (UINT)(end - 1), device->GetName(), overlapped->GetName());
+			throw file.Error(command, command.args[1], err_str);
+		}
+		device_ranges.insert(make_pair(base, device));
+
+		if(device->HasIRQ())
+		{
+			if(device->GetIRQ() > 31)
+			{
+				sprintf(err_str, "IRQ %u of \'%s\' is not 0-31", device->GetIRQ(), device->GetName());
+				throw file.Error(command, err_str);
+			}
+			if(!device_irqs.insert(make_pair(device->GetIRQ(), device)).second)
+			{
+				sprintf(err_str, "IRQ %u of \'%s\' is already used by \'%s\'", device->GetIRQ(), device->GetName(), device_irqs[device->GetIRQ()]->GetName());
+				throw file.Error(command, err_str);
+			}
+		}
+	}
+}
+
+/*
+ *	CSystem::FindCpu()
+ *
+ *  Finds a cpu by name
+ *
+ *	Parameters: name - The name of the cpu
+ *
+ *	Returns:	The cpu, or NULL if there is none with the name
+ */
+CCpu *CSystem::FindCpu(const char *name)
+{
+	// A name that was never interned can't be the name of a cpu
+	map<GQuark, CCpu*>::iterator it = cpu_names.find(g_quark_try_string(name));
+
+	return it != cpu_names.end() ? it->second : NULL;
+}
+
+/*
+ *	CSystem::FindDevice()
+ *
+ *  Finds a memory mapped device by name
+ *
+ *	Parameters: name - The name of the device
+ *
+ *	Returns:	The device, or NULL if there is none with the name
+ */
+MMDevice *CSystem::FindDevice(const char *name)
+{
+	// A name that was never interned can't be the name of a device
+	map<GQuark, MMDevice*>::iterator it = device_names.find(g_quark_try_string(name));
+
+	return it != device_names.end() ? it->second : NULL;
+}
+
+/*
+ *	InputEventCompare()
+ *
+ *  Orders input events by the clock cycle they are applied at
+ */
+static bool InputEventCompare(const InputEvent& a, const InputEvent& b)
+{
+	return a.clk < b.clk;
+}
+
+/*
+ *	CSystem::LoadInputScript()
+ *
+ *  Loads an input script file. Each line sets or clears a bit of an "in" pio interface 
+ *  at a given clock cycle, as if the corresponding switch or button on the board was used:
+ *
+ *		Set <clock cycle>, <name of pio>, <bit>
+ *		Clear <clock cycle>, <name of pio>, <bit>
+ *
+ *  The events are applied by Step() at the start of the clock cycle and are replayed after every reset.
+ *  Must be called after the system description file has been loaded.
+ *
+ *	Parameters: file - The filename of the input script
+ */
+void CSystem::LoadInputScript(const char *file)
+{
+	char err_str[1024];
+	vector<InputEvent> events;
+	InputEvent event;
+
+	ParsedFile script_file(file);
+
+	for(UINT c=0; c<script_file.commands.size(); c++)
+	{
+		const ParsedCommand& command = script_file.commands[c];
+
+		if(!strcmp(command.keyword, "Set"))
+			event.value = 1;
+		else if(!strcmp(command.keyword, "Clear"))
+			event.value = 0;
+		else
+			throw script_file.Error(command, string("Unknown command \'") + command.keyword + "\' in input script");
+
+		if(!ArgsMatches(command.args, "nsn"))
+			throw script_file.Error(command, string("Error while parsing \'") + command.keyword + "\' in input script");
+
+		event.clk = command.args[0].number;
+		event.bit = command.args[2].number;
+
+		// Find the pio interface
+		event.pio = dynamic_cast<CPio*>(FindDevice(command.args[1].str));
+
+		// Only "in" pio interfaces can be driven by the script
+		if(!event.pio || strcmp(event.pio->GetType(), "in"))
+		{
+			sprintf(err_str, "Invalid pio interface \'%s\' in input script", command.args[1].str);
+			throw script_file.Error(command, command.args[1], err_str);
+		}
+		if(event.bit > 31)
+		{
+			sprintf(err_str, "Invalid bit %u in input script", event.bit);
+			throw script_file.Error(command, command.args[2], err_str);
+		}
+
+		events.push_back(event);
+	}
+
+	// Keep the order of events at the same clock cycle
+	stable_sort(events.begin(), events.end(), InputEventCompare);
+
+	input_events.swap(events);
+	next_input_event = 0;
+}
+
+/*
+ *	CSystem::ApplyInputEvents()
+ *
+ *  Applies all input events that are scheduled for the current clock cycle
+ */
+void CSystem::ApplyInputEvents()
+{
+	while(next_input_event < input_events.size() && input_events[next_input_event].clk <= clk)
+	{
+		InputEvent& event = input_events[next_input_event];
+		event.pio->SetInputBit(event.bit, event.value);
+		next_input_event++;
+	}
+}
+
+/*
+ *	CSystem::QueueInputEvent()
+ *
+ *  Called by the GUI thread when a device on the board is clicked. While the simulation is running 
+ *  the event is applied by the simulation thread at the start of the next clock cycle, 
+ *  so that all changes to the devices are made by one thread. Otherwise it is applied directly.
+ *
+ *	Parameters: pio - The pio interface the clicked device is mapped to
+ *				bit - The bit in the data register
+ *				value - The new value of the bit (0 or 1)
+ */
+void CSystem::QueueInputEvent(CPio *pio, UINT bit, UINT value)
+{
+	InputEvent event;
+
+	if(!sim_running || sim_paused)
+	{
+		pio->SetInputBit(bit, value);
+		return;
+	}
+
+	event.clk = clk;
+	event.pio = pio;
+	event.bit = bit;
+	event.value = value;
+
+	queued_inputs_lock.lock();
+	queued_inputs.push_back(event);
+	inputs_queued = true;
+	queued_inputs_lock.unlock();
+}
+
+/*
+ *	CSystem::ApplyQueuedInputEvents()
+ *
+ *  Applies the input events queued by QueueInputEvent() and the events posted by PostEvent()
+ */
+void CSystem::ApplyQueuedInputEvents()
+{
+	vector<InputEvent> events;
+	vector<pair<MMDevice*, UINT> > device_events;
+
+	queued_inputs_lock.lock();
+	events.swap(queued_inputs);
+	device_events.swap(posted_events);
+	inputs_queued = false;
+	queued_inputs_lock.unlock();
+
+	for(UINT i=0; i<events.size(); i++)
+		events[i].pio->SetInputBit(events[i].bit, events[i].value);
+	for(UINT i=0; i<device_events.size(); i++)
+		device_events[i].first->OnEvent(device_events[i].second);
+}
+
+/*
+ *	ScheduledEventLater()
+ *
+ *  Heap ordering of scheduled events. Returns true if a is due after b, 
+ *  which puts the earliest event at the top of the heap. The clock may wrap around.
+ */
+static bool ScheduledEventLater(const ScheduledEvent& a, const ScheduledEvent& b)
+{
+	if(a.clk != b.clk)
+		return (int)(a.clk - b.clk) > 0;
+	return (int)(a.seq - b.seq) > 0;
+}
+
+/*
+ *	CSystem::ScheduleEvent()
+ *
+ *  Schedules an event for a device at a future clock cycle. The device's OnEvent() function 
+ *  is called at the start of that clock cycle. Devices use this instead of checking 
+ *  their state on every clock cycle. Must only be called from the simulation thread.
+ *
+ *	Parameters: delay - Number of clock cycles from now
+ *				device - The device to notify
+ *				event - Device specific event number passed to OnEvent()
+ */
+void CSystem::ScheduleEvent(UINT delay, MMDevice *device, UINT event)
+{
+	ScheduledEvent e;
+
+	e.clk = clk + delay;
+	e.seq = event_seq++;
+	e.device = device;
+	e.event = event;
+
+	scheduled_events.push_back(e);
+	push_heap(scheduled_events.begin(), scheduled_events.end(), ScheduledEventLater);
+
+	next_event_clk = scheduled_events.front().clk;
+}
+
+/*
+ *	CSystem::PostEvent()
+ *
+ *  Notifies a device from another thread than the simulation thread. While the simulation is 
+ *  running the device's OnEvent() function is called by the simulation thread at the start of 
+ *  the next clock cycle. Otherwise it is called directly.
+ *
+ *	Parameters: device - The device to notify
+ *				event - Device specific event number passed to OnEvent()
+ */
+void CSystem::PostEvent(MMDevice *device, UINT event)
+{
+	if(!sim_running || sim_paused)
+	{
+		device->OnEvent(event);
+		return;
+	}
+
+	queued_inputs_lock.lock();
+	posted_events.push_back(pair<MMDevice*, UINT>(device, event));
+	inputs_queued = true;
+	queued_inputs_lock.unlock();
+}
+
+/*
+ *	CSystem::RunScheduledEvents()
+ *
+ *  Notifies the devices of all scheduled events that are due
+ */
+void CSystem::RunScheduledEvents()
+{
+	ScheduledEvent e;
+
+	while(scheduled_events.size() && (int)(clk - scheduled_events.front().clk) >= 0)
+	{
+		e = scheduled_events.front();
+		pop_heap(scheduled_events.begin(), scheduled_events.end(), ScheduledEventLater);
+		scheduled_events.pop_back();
+
+		// The device may schedule new events
+		e.device->OnEvent(e.event);
+	}
+
+	if(scheduled_events.size())
+		next_event_clk = scheduled_events.front().clk;
+}
+
 /*
  *	CSystem::IsAddressValid()
  *
@@ -752,10 +1420,11 @@ void CSystem::Write(UINT addr, UINT size, UINT d, bool io)
  *  Loads an .elf file.
  *
  *	Parameters: file - Filepath to the .elf file
+ *				debug_info - False to skip the debug information, which is shown in the debug window
  *
  *	Throws: LoadELFFileError
  */
-void CSystem::LoadELFFile(const char *file)
+void CSystem::LoadELFFile(const char *file, bool debug_info)
 {
 	FILE *f;
 	size_t file_size;
@@ -767,6 +1436,7 @@ void CSystem::LoadELFFile(const char *file)
 	// Stop the simulation if it is running
 	if(sim_running)
 		StopSimulation();
+	WaitForStop();
 
 	// Display and error message if no .sdf file has been loaded
 	if(!sdf_loaded)
@@ -774,6 +1444,12 @@ void CSystem::LoadELFFile(const char *file)
 		throw LoadELFFileError("Unable to load an .elf file before the system description file (.sdf) has been loaded!");
 	}
 
+	// The program is run by the first cpu
+	if(!cpus.size())
+	{
+		throw LoadELFFileError("Unable to load an .elf file, the system description file (.sdf) has no cpu!");
+	}
+
 	// Clean up old initialization data
 	for(UINT i=0; i<sdrams.size(); i++)
 		sdrams[i]->CleanUpInitData();
@@ -890,7 +1566,30 @@ void CSystem::LoadELFFile(const char *file)
 		// Read the whole file into memory and send it for debug parsing
 		vector<char> whole_file(file_size);
 		fread(&whole_file[0], 1, file_size, f);
-		main_debug.LoadELFFile(&whole_file[0]);
+		if(debug_info)
+			debugger->LoadELFFile(&whole_file[0]);
+
+		// Profile the code in the .entry, .exceptions and .text sections
+		if(!profile_prefix.empty())
+		{
+			static const char *sections[] = {".entry", ".exceptions", ".text"};
+			CProfiler *profiler = new CProfiler;
+			UINT start = 0xFFFFFFFF, end = 0;
+
+			for(int i=0; i<3; i++)
+			{
+				pair<pair<uint*, size_t>, uint> section = ELFReadSection(&whole_file[0], sections[i]);
+				if(section.first.second)
+				{
+					start = min(start, section.second);
+					end = max(end, (UINT)(section.second + section.first.second*4));
+				}
+			}
+			if(start < end)
+				profiler->SetCodeRange(start, end - start);
+			profiler->SetSymbols(ELFReadFunctionSymbols(&whole_file[0]));
+			cpus[0]->SetProfiler(profiler);
+		}
 	}
 
 	// Assign PC to point to the entry point of the code
@@ -980,33 +1679,83 @@ void CSystem::CopyDataToMemory(char *buf, Elf32_Phdr *p_header)
  */
 void CSystem::Reset()
 {	
+	// The simulation thread must be done with a previous run
+	WaitForStop();
+
+	// Reset the clock. The recorded time continues from where it was
+	wave_recorder.AddClockOffset(clk);
+	clk = 0;
+
+	// Forget all scheduled events, the devices are reset below
+	scheduled_events.clear();
+
+	// The program starts over with an empty call stack
+	debugger->ResetCallStack();
+
 	// Reset all devices
 	for(UINT i=0; i<cpus.size(); i++)
 		cpus[i]->Reset();
 	for(UINT i=0; i<mm_devices.size(); i++)
 		mm_devices[i]->Reset();
 
-	// Reset the clock
-	clk = 0;
+	// Replay the input script from the beginning
+	next_input_event = 0;
+
+	// The pio interfaces have read the current state of the board
+	queued_inputs_lock.lock();
+	queued_inputs.clear();
+	posted_events.clear();
+	inputs_queued = false;
+	queued_inputs_lock.unlock();
 }
 
 /*
  *	CSystem::Step()
  *
- *  Performs a single simulation step by calling the OnClock() function for all CPUs and timers
+ *  Performs a single simulation step by calling the OnClock() function for all CPUs and timers.
+ *  The clock is advanced to the cycle at which the next instruction of any cpu is executed.
  */
 void CSystem::Step()
 {
-	// Call the OnClock function for all cpus
+	UINT cycles;
+
+	// Apply any input events scheduled for this clock cycle
+	if(next_input_event < input_events.size() && input_events[next_input_event].clk <= clk)
+		ApplyInputEvents();
+	// Apply any clicks on the board and events posted from the GUI thread
+	if(inputs_queued)
+		ApplyQueuedInputEvents();
+	// Run any events scheduled by the devices for this clock cycle
+	if(scheduled_events.size() && (int)(clk - next_event_clk) >= 0)
+		RunScheduledEvents();
+
+	// Call the OnClock function for all cpus that have finished their previous instruction
+	cycles = 0xFFFFFFFF;
 	for(UINT i=0; i<cpus.size(); i++)
-		cpus[i]->OnClock();
+	{
+		if((int)(cpus[i]->GetReadyClk() - clk) <= 0)
+			cpus[i]->OnClock();
+		if(cpus[i]->GetReadyClk() - clk < cycles)
+			cycles = cpus[i]->GetReadyClk() - clk;
+	}
+
+	// Don't skip past input events and scheduled events
+	if(next_input_event < input_events.size() && (int)(input_events[next_input_event].clk - clk) < (int)cycles)
+		cycles = input_events[next_input_event].clk - clk;
+	if(scheduled_events.size() && (int)(next_event_clk - clk) < (int)cycles)
+		cycles = next_event_clk - clk;
+	if((int)cycles < 1)
+		cycles = 1;
 
 	// Call the OnClock function for all timers
 	for(UINT i=0; i<timers.size(); i++)
-		timers[i]->OnClock();
+		timers[i]->OnClock(cycles);
 
-	// Update the clock by 1
-	clk++;
+	// Update the clock by the number of cycles until the next instruction
+	clk += cycles;
+	// The recorded time continues past the 32 bit clock
+	if(clk < cycles)
+		wave_recorder.ClockWrapped();
 }
 
 /*
@@ -1052,6 +1801,8 @@ void CSystem::StartSimulationThread(bool start_paused)
 		// If the simulation is not running, start it
 		if(!sim_running)
 		{
+			// A stop that isn't finished would never be, once sim_running is set again
+			WaitForStop();
 			sim_paused = start_paused;
 			sim_running = true;
 		}
@@ -1076,6 +1827,29 @@ void CSystem::PauseSimulationThread()
 	}
 }
 
+/*
+ *	CSystem::PauseSimulationAndWait()
+ *
+ *  Pauses the simulation and waits until the simulation thread is between two instructions,
+ *  so that the state of the cpus can be read. Must not be called from the simulation thread.
+ *
+ *	Returns:	True if a running simulation was paused, and should be unpaused afterwards
+ */
+bool CSystem::PauseSimulationAndWait()
+{
+	bool paused = false;
+
+	// The simulation thread may have paused itself in the middle of an instruction, so wait for it then too
+	if(sim_running)
+	{
+		paused = !sim_paused;
+		sim_paused = true;
+		g_atomic_int_inc(&stop_requests);
+	}
+	WaitForStop();
+	return paused;
+}
+
 /*
  *	CSystem::UnPauseSimulationThread()
  *
@@ -1097,7 +1871,9 @@ void CSystem::UnPauseSimulationThread()
 /*
  *	CSystem::StopSimulation()
  *
- *  Stops the simulation
+ *  Stops the simulation. The simulation thread finishes the current instruction and writes
+ *  the profile by itself, so this returns at once. Use WaitForStop() before the system is
+ *  changed.
  */
 void CSystem::StopSimulation()
 {
@@ -1109,10 +1885,55 @@ void CSystem::StopSimulation()
 		{
 			sim_running = false;
 			sim_paused = false;
+
+			g_atomic_int_inc(&stop_requests);
 		}
 	}
 }
 
+/*
+ *	CSystem::AcknowledgeStop()
+ *
+ *  Called by the simulation thread between instructions. When the simulation has been stopped
+ *  the profile is written, and then threads in WaitForStop() are woken up. A pause is
+ *  acknowledged the same way.
+ */
+void CSystem::AcknowledgeStop()
+{
+	// The request is read before sim_running, so a stop request that is seen is never
+	// acknowledged while the simulation still looks like it is running.
+	// stops_seen is only written by this thread, so it can be read without the lock.
+	gint request = g_atomic_int_get(&stop_requests);
+
+	if(request == stops_seen || (sim_running && !sim_paused))
+		return;
+
+	if(!sim_running)
+		WriteProfile();
+
+	stop_lock.lock();
+	stops_seen = request;
+	stop_finished.broadcast();
+	stop_lock.unlock();
+}
+
+/*
+ *	CSystem::WaitForStop()
+ *
+ *  Waits until the simulation thread has finished the stops requested so far, so that the
+ *  cpus and devices are no longer used by it. Returns at once if there is no such stop.
+ *  Must not be called from the simulation thread.
+ */
+void CSystem::WaitForStop()
+{
+	gint request = g_atomic_int_get(&stop_requests);
+
+	stop_lock.lock();
+	while(stops_seen - request < 0)
+		stop_finished.wait(stop_lock);
+	stop_lock.unlock();
+}
+
 /*
  *	CSystem::CloseSimulationThread()
  *
@@ -1200,3 +2021,103 @@ void CSystem::StopGenerateTraceFile()
 	generating_trace = false;
 }
 
+/*
+ *	CSystem::StartRecordingWaves()
+ *
+ *  Starts recording the PIO data and edge capture registers, the pending IRQs and ienable of 
+ *  all cpus and the TO and RUN bits of all timers to a VCD file.
+ *  The timestamps use the frequency of the first cpu.
+ *
+ *	Parameters: file - The VCD file to create
+ *
+ *	Returns:	True if the recording was started
+ */
+bool CSystem::StartRecordingWaves(const char *file)
+{
+	wave_recorder.BeginSignals();
+
+	for(UINT i=0; i<cpus.size(); i++)
+		cpus[i]->AddWaveSignals(&wave_recorder);
+	for(UINT i=0; i<timers.size(); i++)
+		timers[i]->AddWaveSignals(&wave_recorder);
+	for(UINT i=0; i<mm_devices.size(); i++)
+	{
+		if(CPio *pio = dynamic_cast<CPio*>(mm_devices[i]))
+			pio->AddWaveSignals(&wave_recorder);
+	}
+
+	return wave_recorder.Start(file, cpus.size() ? cpus[0]->GetFrequency() : 0);
+}
+
+/*
+ *	CSystem::WriteProfile()
+ *
+ *  Writes the profile of the first cpu, if profiling was enabled with SetProfileFile().
+ *  Called by the simulation thread when the simulation has been stopped.
+ */
+void CSystem::WriteProfile()
+{
+	if(!cpus.size() || !cpus[0]->GetProfiler())
+		return;
+
+	if(!cpus[0]->GetProfiler()->WriteReport(profile_prefix.c_str(), debugger->GetDebugInfo(), clk))
+		fprintf(stderr, "Could not write the profile to %s\n", profile_prefix.c_str());
+}
+
+/*
+ *	CSystem::DumpTrace()
+ *
+ *  Writes the last executed instructions of all cpus. The trace is consistent if the
+ *  simulation is stopped or paused.
+ *
+ *	Parameters: file - The filename
+ *				reason - A line describing why the trace is written
+ *
+ *	Returns:	False if the file couldn't be created
+ */
+bool CSystem::DumpTrace(const char *file, const char *reason)
+{
+	FILE *f;
+
+	f = fopen(file, "w");
+	if(!f)
+		return false;
+
+	fprintf(f, "%s\nClock cycle %u\n", reason, clk);
+	for(UINT i=0; i<cpus.size(); i++)
+	{
+		fprintf(f, "\nCpu %s, pc 0x%.8X\n", cpus[i]->GetName(), cpus[i]->GetPC());
+		cpus[i]->GetTrace().Dump(f, debugger->GetDebugInfo());
+	}
+
+	fclose(f);
+	return true;
+}
+
+/*
+ *	CSystem::DumpTraceOnCrash()
+ *
+ *  Writes the last executed instructions when the program crashes, if a file was set
+ *  with SetTraceDumpFile(). Called from the simulation thread.
+ *
+ *	Parameters: reason - The error message
+ */
+void CSystem::DumpTraceOnCrash(const char *reason)
+{
+	if(trace_dump_file.empty())
+		return;
+
+	if(!DumpTrace(trace_dump_file.c_str(), reason))
+		fprintf(stderr, "Could not write the instruction trace to %s\n", trace_dump_file.c_str());
+}
+
+/*
+ *	CSystem::StopRecordingWaves()
+ *
+ *  Stops recording and closes the VCD file
+ */
+void CSystem::StopRecordingWaves()
+{
+	wave_recorder.Stop();
+}
+
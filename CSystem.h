@@ -25,6 +25,7 @@ along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
 //#include <windows.h>
 #include <vector>
 #include <string>
+#include <map>
 using namespace std;
 //#include "sim.h"
 //#include "CCpu.h"
@@ -35,7 +36,10 @@ using namespace std;
 //#include "CPio.h"
 //#include "CLcd.h"
 #include "CThread.h"
+#include "CWaveRecorder.h"
 #include "fileparser.h"
+#include "CDebugger.h"
+#include "CFrontEnd.h"
 
 // Constants for string parsing
 #define TOKEN_UNKNOWN	0
@@ -126,6 +130,7 @@ class CTimer;
 class CPio;
 class CSdram;
 class CJtag;
+class CEic;
 
 class MMDevice;
 
@@ -157,16 +162,28 @@ struct Elf32_Phdr{
 	UINT p_align;
 };
 
-struct ParsingError
+struct LoadELFFileError
 {
 	string msg;
-	ParsingError(const string& str) : msg(str) {}
+	LoadELFFileError(const string& str) : msg(str) {}
 };
 
-struct LoadELFFileError
+// An event scheduled by a device
+struct ScheduledEvent
 {
-	string msg;
-	LoadELFFileError(const string& str) : msg(str) {}
+	UINT clk;			// The clock cycle at which the event is due
+	UINT seq;			// Sequence number, keeps events at the same clock cycle in order
+	MMDevice *device;	// The device that is notified
+	UINT event;			// Device specific event number
+};
+
+// An input event read from an input script file
+struct InputEvent
+{
+	UINT clk;		// The clock cycle at which the event is applied
+	CPio *pio;		// The pio interface the event is applied to
+	UINT bit;		// The bit in the data register
+	UINT value;		// The new value of the bit (0 or 1)
 };
 
 class CSystem
@@ -195,14 +212,27 @@ private:
 	vector<CTimer*> timers;		// List of timers in the system
 	//vector<CPio*> pios;			// List of pios in the system
 	vector<CSdram*> sdrams;		// List of sdrams in the system
+	vector<CEic*> eics;			// List of external interrupt controllers in the system
 	//vector<CJtag*> jtags;		// List of jtags in the system
 
 	vector<MMDevice*> mm_devices;	// List of memory mapped devices in the system
 
+	map<GQuark, CCpu*> cpu_names;				// The cpus by interned name
+	map<GQuark, MMDevice*> device_names;		// The memory mapped devices by interned name
+	map<UINT, MMDevice*> device_ranges;			// The memory mapped devices by base address
+	map<UINT, MMDevice*> device_irqs;			// The memory mapped devices by IRQ
+
 	CJtag *mapped_jtag;			// Pointer to the jtag interface that is mapped to the jtag console
 	CUart *mapped_uart0;		// Pointer to the uart interface that is mapped to the uart0 console
 	CUart *mapped_uart1;		// Pointer to the uart interface that is mapped to the uart1 console
 
+	CDebugger default_debugger;	// Debugger used when the front end has none
+	CDebugger *debugger;		// The debugger that the cpus report calls, returns and breakpoints to
+	CBoardInterface *board;		// The I/O board of the front end, NULL if there is none
+	CConsoleInterface *jtag_console;	// The consoles of the front end, NULL if there are none
+	CConsoleInterface *uart0_console;
+	CConsoleInterface *uart1_console;
+
 	bool elf_loaded;			// True if an elf file is loaded
 	bool sdf_loaded;			// True if an sdf file is loaded
 
@@ -211,13 +241,39 @@ private:
 	CThread thread;				// Handle to the simulation thread
 	bool sim_running, sim_paused;	// True if simulation is running and paused respectively
 	bool sim_quitting;
+	volatile gint stop_requests;	// Incremented by StopSimulation() and PauseSimulationAndWait()
+	gint stops_seen;			// The last stop request the simulation thread has finished, protected by stop_lock
+	CMutex stop_lock;
+	CCondition stop_finished;	// Signalled when stops_seen changes
 	UINT sim_speed;				// The simulation speed
 
 	bool generating_trace;		// True if a trace file is being generated
 	FILE *trace_file;			// Handle to the trace file
 
+	vector<InputEvent> input_events;	// Input events sorted by clock cycle
+	UINT next_input_event;				// Index of the next input event to apply
+
+	vector<InputEvent> queued_inputs;	// Input events from board clicks, waiting for the simulation thread
+	vector<pair<MMDevice*, UINT> > posted_events;	// Events posted from other threads, waiting for the simulation thread
+	CMutex queued_inputs_lock;			// Lock for queued_inputs and posted_events
+	volatile bool inputs_queued;		// True if queued_inputs or posted_events is not empty
+
+	vector<ScheduledEvent> scheduled_events;	// Heap of scheduled events, the earliest first
+	UINT next_event_clk;				// Clock cycle of the earliest scheduled event
+	UINT event_seq;						// Sequence number of the next scheduled event
+
+	CWaveRecorder wave_recorder;		// Recorder of device signals to a VCD file
+	string profile_prefix;				// File names of the profile written when the simulation stops, empty if not profiling
+	string trace_dump_file;				// File the instruction traces are written to on errors, empty if none
+
 	// Private functions used to parse the sdf file
 	bool ParseCpu(const ParsedRowArguments& args);
+	bool ParseCache(const ParsedRowArguments& args);
+	bool ParseEic(const ParsedRowArguments& args);
+	bool ParseEicVector(const ParsedRowArguments& args);
+	bool ParseCustomInstruction(const ParsedRowArguments& args);
+	bool ParseMpu(const ParsedRowArguments& args);
+	bool ParseMpuRegion(const ParsedRowArguments& args);
 	bool ParseSdram(const ParsedRowArguments& args);
 	bool ParseUart(const ParsedRowArguments& args);
 	bool ParseJtag(const ParsedRowArguments& args);
@@ -226,13 +282,22 @@ private:
 	bool ParsePio(const ParsedRowArguments& args);
 	bool ParseMap(const ParsedRowArguments& args);
 	bool ParseImportBoard(const ParsedRowArguments& args);
+	void RegisterNewDevices(const ParsedFile& file, const ParsedCommand& command, UINT first_cpu, UINT first_device);
+	CCpu *FindCpu(const char *name);
+	MMDevice *FindDevice(const char *name);
 
 	void CopyDataToMemory(char *buf, Elf32_Phdr *p_header);
+	void ApplyInputEvents();
+	void ApplyQueuedInputEvents();
+	void RunScheduledEvents();
 	void CleanUp();
 public:
 	CSystem();
 	~CSystem();
 
+	void SetFrontEnd(CDebugger *d, CBoardInterface *b, CConsoleInterface *jtag, CConsoleInterface *uart0, CConsoleInterface *uart1);
+	CDebugger *GetDebugger() {return debugger;};
+
 	bool IsAddressValid(UINT addr);
 	UINT Read(UINT addr, UINT size, bool io, bool fetch);
 	void Write(UINT addr, UINT size, UINT d, bool io);
@@ -241,10 +306,17 @@ public:
 	bool IsSimulationRunning() { return sim_running;};
 	bool IsSimulationPaused() { return sim_paused;};
 	bool IsSimulationQuitting() { return sim_quitting; }
+	void AcknowledgeStop();
 
 	void LoadSystemDescriptionFile(const char *file);
-	void LoadELFFile(const char *file);
+	void LoadELFFile(const char *file, bool debug_info = true);
 	bool IsELFFileLoaded() { return elf_loaded;};
+	void LoadInputScript(const char *file);
+	void QueueInputEvent(CPio *pio, UINT bit, UINT value);
+	bool HasQueuedInputEvents() { return inputs_queued; };
+
+	void ScheduleEvent(UINT delay, MMDevice *device, UINT event);
+	void PostEvent(MMDevice *device, UINT event);
 
 	void Step();
 	void AssertIRQ(UINT irq);
@@ -255,8 +327,10 @@ public:
 
 	void StartSimulationThread(bool start_paused = false);
 	void PauseSimulationThread();
+	bool PauseSimulationAndWait();
 	void UnPauseSimulationThread();
 	void StopSimulation();
+	void WaitForStop();
 	void CloseSimulationThread();
 
 	void SetSimulationSpeed(UINT speed) {sim_speed = speed;};
@@ -266,6 +340,18 @@ public:
 	void StartGenerateTraceFile(const char *file);
 	void StopGenerateTraceFile();
 
+	bool IsRecordingWaves() {return wave_recorder.IsRecording();};
+	bool StartRecordingWaves(const char *file);
+	void StopRecordingWaves();
+
+	void SetProfileFile(const char *prefix) { profile_prefix = prefix; };
+	void WriteProfile();
+	void SetTraceDumpFile(const char *file) { trace_dump_file = file; };
+	bool IsDumpingTraceOnCrash() { return !trace_dump_file.empty(); };
+	bool DumpTrace(const char *file, const char *reason);
+	void DumpTraceOnCrash(const char *reason);
+	inline void RecordWave(UINT signal, UINT value) { wave_recorder.Change(clk, signal, value); };
+
 	inline UINT GetClk() { return clk; };
 	
 	void SendInputToJTAG(const string& text);
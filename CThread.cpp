@@ -25,17 +25,17 @@ CThread::CThread(void *(*func)(void*))
 	init(func);
 }
 
-void CThread::init(void *(*func)(void*))
+void CThread::init(void *(*func)(void*), void *arg)
 {
 	inited = true;
 #ifndef WINNT
-	pthread_create(&thread, NULL, func, NULL);
+	pthread_create(&thread, NULL, func, arg);
 #else
 	thread_handle = CreateThread(
 					NULL,                   // default security attributes
 					0,                      // use default stack size  
 					(LPTHREAD_START_ROUTINE)func,       // thread function name
-					NULL,          // argument to thread function 
+					arg,           // argument to thread function 
 					0,                      // use default creation flags 
 					&threadID);   // returns the thread identifier 
 #endif
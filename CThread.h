@@ -20,7 +20,7 @@ along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
 
 /*
 
-This file implements a platform-independent wrapper around threads, mutexes and sleep.
+This file implements a platform-independent wrapper around threads, mutexes, conditions and sleep.
 
 */
 #include <pthread.h>
@@ -44,7 +44,7 @@ private:
 public:
 	CThread() : inited(false) {}
 	CThread(void *(*func)(void*));
-	void init(void *(*func)(void*));
+	void init(void *(*func)(void*), void *arg = NULL);
 	~CThread();
 	
 	static void Sleep(unsigned long ms){
@@ -61,6 +61,7 @@ public:
 
 class CMutex
 {
+	friend class CCondition;
 private:
 	GMutex *mutex;
 	bool inited;
@@ -84,4 +85,29 @@ public:
 	void unlock(){ g_mutex_unlock(mutex); }
 };
 
+// Must only be used while the mutex it is used with is locked
+class CCondition
+{
+private:
+	GCond *cond;
+public:
+	CCondition() {
+		cond = NULL;
+	}
+	~CCondition() {
+		if (cond)
+			g_cond_free(cond);
+	}
+	
+	void wait(CMutex& mutex){
+		if(!cond)
+			cond = g_cond_new();
+		g_cond_wait(cond, mutex.mutex);
+	}
+	void broadcast(){
+		if(cond)
+			g_cond_broadcast(cond);
+	}
+};
+
 #endif
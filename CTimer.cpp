@@ -29,7 +29,6 @@ along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
  */
 CTimer::CTimer()
 {
-	name[0] = '\0';
 	base = span = irq = 0;
 	has_irq = false;
 	period = init_period = 0;
@@ -40,6 +39,8 @@ CTimer::CTimer()
 	snapshot = 0;
 	TO = RUN = ITO = CONT = 0;
 	counting = false;
+
+	wave_to = wave_run = 0;
 	
 	main_system.DeassertIRQ(irq);
 }
@@ -58,6 +59,22 @@ void CTimer::Reset()
 	period = init_period;
 	counting = false;
 	counter = period;
+
+	main_system.RecordWave(wave_to, TO);
+	main_system.RecordWave(wave_run, RUN);
+}
+
+/*
+ *	CTimer::AddWaveSignals()
+ *
+ *  Adds the TO and RUN bits to the wave recorder
+ *
+ *	Parameters: recorder - The wave recorder
+ */
+void CTimer::AddWaveSignals(CWaveRecorder *recorder)
+{
+	wave_to = recorder->AddSignal(GetName(), "TO", 1, TO);
+	wave_run = recorder->AddSignal(GetName(), "RUN", 1, RUN);
 }
 
 /*
@@ -128,6 +145,7 @@ void CTimer::Write(UINT addr, UINT size, UINT d)
 	{
 		// Write to status -> clear the TO bit
 		TO = 0;
+		main_system.RecordWave(wave_to, TO);
 		// Deassert the IRQ
 		if(has_irq)
 			main_system.DeassertIRQ(irq);
@@ -177,6 +195,8 @@ void CTimer::Write(UINT addr, UINT size, UINT d)
 				counting = false;
 			}
 		}
+
+		main_system.RecordWave(wave_run, RUN);
 	}
 	// period_low register
 	else if(addr == (base+8))
@@ -221,19 +241,29 @@ void CTimer::Write(UINT addr, UINT size, UINT d)
 /*
  *	CTimer::OnClock()
  *
- *  This function should get called every time the clock is updated by one.
+ *  This function should get called every time the clock is updated.
  *	It handles the updating of the counter and resets it when it hits 0.
  *
+ *	Parameters: cycles - The number of clock cycles that have passed
  */
-void CTimer::OnClock()
+void CTimer::OnClock(UINT cycles)
 {
 	// Return if we are not counting
 	if(!counting)
 		return;
 
-	// Have we hit 0?
-	if(counter == 0)
+	while(cycles)
 	{
+		// Count down if 0 is not reached during these cycles
+		if(counter >= cycles)
+		{
+			counter -= cycles;
+			return;
+		}
+
+		// Counting down to 0 and the timeout takes counter + 1 cycles
+		cycles -= counter + 1;
+
 		// If ITO is 1, generate an interrupt
 		if(ITO && has_irq)
 			main_system.AssertIRQ(irq);
@@ -253,10 +283,11 @@ void CTimer::OnClock()
 			RUN = 1;
 			counting = true;
 		}
-	}
-	// The counter is not 0 so let's count down
-	else
-	{
-		counter--;
+
+		main_system.RecordWave(wave_to, TO);
+		main_system.RecordWave(wave_run, RUN);
+
+		if(!counting)
+			return;
 	}
 }
\ No newline at end of file
@@ -23,6 +23,8 @@ along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "MMDevice.h"
 
+class CWaveRecorder;
+
 class CTimer : public MMDevice
 {
 private:
@@ -36,6 +38,8 @@ private:
 	bool fixed_period, always_run, has_snapshot, counting;
 	UINT counter, snapshot;
 	UINT TO, RUN, ITO, CONT;
+
+	UINT wave_to, wave_run;	// Signals in the wave recorder
 public:
 	CTimer();
 	~CTimer() {};
@@ -44,9 +48,11 @@ public:
 	UINT Read(UINT addr, UINT size);
 	void Write(UINT addr, UINT size, UINT d);
 
-	void OnClock();
+	void OnClock(UINT cycles);
 	bool IsCounting() { return counting; };
 
+	void AddWaveSignals(CWaveRecorder *recorder);
+
 	void SetIRQ(UINT i) { irq = i; has_irq = true; };
 	bool HasIRQ() { return has_irq; };
 	UINT GetIRQ() { return irq; };
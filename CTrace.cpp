@@ -0,0 +1,85 @@
+/*
+NIISim - Nios II Simulator, A simulator that is capable of simulating various systems containing Nios II cpus.
+
+This file is part of NIISim.
+
+NIISim is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+NIISim is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <cstdio>
+#include "CCpu.h"
+#include "CTrace.h"
+#include "elf_read_debug.h"
+#include "disassembler.h"
+
+/*
+ *	IsLoadOrStore()
+ *
+ *  Checks if an instruction is a load or a store
+ */
+static bool IsLoadOrStore(UINT instr)
+{
+	switch(instr & 0x3F)
+	{
+	case INSTR_LDB: case INSTR_LDBU: case INSTR_LDH: case INSTR_LDHU: case INSTR_LDW:
+	case INSTR_LDBIO: case INSTR_LDBUIO: case INSTR_LDHIO: case INSTR_LDHUIO: case INSTR_LDWIO:
+	case INSTR_STB: case INSTR_STH: case INSTR_STW:
+	case INSTR_STBIO: case INSTR_STHIO: case INSTR_STWIO:
+		return true;
+	}
+	return false;
+}
+
+/*
+ *	CTrace::Dump()
+ *
+ *  Writes the trace from the oldest to the newest instruction, with the disassembly,
+ *  the register written, the address of loads and stores, and the source line.
+ *
+ *	Parameters: f - The file to write to
+ *				debug_info - The line table of the program
+ */
+void CTrace::Dump(FILE *f, DebugInfo& debug_info)
+{
+	UINT count = total < TRACE_SIZE ? (UINT)total : TRACE_SIZE;
+
+	fprintf(f, "%llu instructions executed, the last %u from the oldest:\n\n", total, count);
+	fprintf(f, "%-10s  %-8s  %-32s  %-16s  %-12s  %s\n", "pc", "instr", "disassembly", "result", "address", "source");
+
+	for(unsigned long long i = total - count; i < total; i++)
+	{
+		const TraceEntry& entry = entries[i & (TRACE_SIZE-1)];
+		char result[32] = "", addr[16] = "", source[512] = "";
+		UINT dest, addr_with_source;
+
+		dest = DestinationRegister(entry.instr);
+		if(dest)
+			sprintf(result, "r%u=0x%08X", dest, entry.result);
+
+		if(IsLoadOrStore(entry.instr))
+			sprintf(addr, "[0x%08X]", entry.addr);
+
+		addr_with_source = debug_info.GetNearestPrecedingAddrWithSourceInformation(entry.pc);
+		if(addr_with_source != ~0U)
+		{
+			const vector<pair<int, int> >& lines = debug_info.AddrToSource(addr_with_source);
+			if(!lines.empty())
+				snprintf(source, sizeof(source), "%s:%d", debug_info.source_files[lines[0].first].c_str(), lines[0].second);
+		}
+
+		fprintf(f, "0x%08X  %08X  %-32s  %-16s  %-12s  %s\n", entry.pc, entry.instr,
+			DumpDisasm(DecompileInstruction(entry.pc, entry.instr)), result, addr, source);
+	}
+}
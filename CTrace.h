@@ -0,0 +1,132 @@
+/*
+NIISim - Nios II Simulator, A simulator that is capable of simulating various systems containing Nios II cpus.
+
+This file is part of NIISim.
+
+NIISim is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+NIISim is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/*
+
+This file implements a ring buffer with the last instructions executed by a cpu. Recording an
+instruction only stores the pc, the instruction word, the value of the destination register
+and the address of a load or store, so the trace is always recorded. The trace is written
+with disassembly and source lines when the simulation stops with an error, or on demand.
+
+*/
+
+#ifndef _CTRACE_H_
+#define _CTRACE_H_
+
+#include <cstdio>
+#include "types.h"
+#include "instructions.h"
+
+struct DebugInfo;
+
+// Number of instructions in the trace, a power of two
+#define TRACE_SIZE		1024
+
+/*
+ *	DestinationRegister()
+ *
+ *  Finds the register an instruction writes to. Called for every executed instruction.
+ *
+ *	Parameters: instr - The instruction word
+ *
+ *	Returns:	The register, or 0 if the instruction doesn't write to a register
+ */
+inline UINT DestinationRegister(UINT instr)
+{
+	UINT op = instr & 0x3F;
+
+	switch(op)
+	{
+	case INSTR_CALL:
+		return 31;
+
+	// Stores, branches and cache instructions
+	case INSTR_JMPI:
+	case INSTR_STB: case INSTR_STH: case INSTR_STW:
+	case INSTR_STBIO: case INSTR_STHIO: case INSTR_STWIO:
+	case INSTR_BR: case INSTR_BGE: case INSTR_BLT: case INSTR_BNE:
+	case INSTR_BEQ: case INSTR_BGEU: case INSTR_BLTU:
+	case INSTR_INITDA: case INSTR_FLUSHDA: case INSTR_INITD: case INSTR_FLUSHD:
+		return 0;
+
+	// Custom instructions with the writerc bit set
+	case INSTR_CUSTOM:
+		return (instr & 0x4000) ? (instr >> 17) & 0x1F : 0;
+
+	case INSTR_R_TYPE:
+		switch((instr >> 11) & 0x3F)
+		{
+		case INSTR_R_ERET: case INSTR_R_BRET: case INSTR_R_RET: case INSTR_R_JMP:
+		case INSTR_R_FLUSHP: case INSTR_R_FLUSHI: case INSTR_R_INITI: case INSTR_R_SYNC:
+		case INSTR_R_TRAP: case INSTR_R_BREAK: case INSTR_R_WRCTL: case INSTR_R_WRPRS:
+			return 0;
+		}
+		return (instr >> 17) & 0x1F;
+	}
+
+	return (instr >> 22) & 0x1F;
+}
+
+// An executed instruction
+struct TraceEntry
+{
+	UINT pc;
+	UINT instr;			// The instruction word
+	UINT result;		// The value of the destination register after execution
+	UINT addr;			// The address of a load or store
+};
+
+class CTrace
+{
+private:
+	TraceEntry entries[TRACE_SIZE];
+	unsigned long long total;	// Number of instructions recorded since the reset
+public:
+	CTrace() { Reset(); };
+
+	void Reset() { total = 0; };
+
+	/*
+	 *	CTrace::Record()
+	 *
+	 *  Adds an instruction to the trace, replacing the oldest one
+	 *
+	 *	Parameters: pc - The address of the instruction
+	 *				instr - The instruction word
+	 *
+	 *	Returns:	The entry, where the result and the address are filled in during execution
+	 */
+	inline TraceEntry *Record(UINT pc, UINT instr)
+	{
+		TraceEntry *entry = &entries[total++ & (TRACE_SIZE-1)];
+
+		entry->pc = pc;
+		entry->instr = instr;
+		entry->addr = 0;
+		return entry;
+	}
+
+	// The last recorded entry
+	TraceEntry *Last() { return &entries[(total - 1) & (TRACE_SIZE-1)]; };
+
+	void Dump(FILE *f, DebugInfo& debug_info);
+};
+
+#endif
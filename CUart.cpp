@@ -21,7 +21,9 @@ along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <stdio.h>
 #include "sim.h"
+#include "CCpu.h"
 #include "CUart.h"
+#include "CFrontEnd.h"
 
 /*
  *	CUart::CUart()
@@ -31,31 +33,53 @@ along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
  */
 CUart::CUart()
 {
-	name[0] = '\0';
 	base = span = irq = 0;
 	has_irq = false;
 	c_console = NULL;
 	buf = "";
 
 	ITRDY = IRRDY = RxR = TxR = 0;
+	TOE = ROE = 0;
 	RxD = TxD = 0;
+
+	baud_rate = 0;
+	char_cycles = 0;
+	tx_shifting = rx_shifting = false;
+	tx_shift = 0;
 }
 
 /*
  *	CUart::Reset()
  *
  *  Performs a reset.
- *  Initializes registers to 0 and empties the read buffer
+ *  Initializes registers to 0 and empties the read buffer.
+ *  If a baud rate is set, the transfer time of a character is calculated from the 
+ *  frequency of the first cpu.
  */
 void CUart::Reset()
 {
+	UINT freq;
+
 	ITRDY = 0;
 	IRRDY = 0;
 	RxR = 0;
 	TxR = 1;
+	TOE = ROE = 0;
 	RxD = TxD = 0;
 
+	lock.lock();
 	buf = "";
+	lock.unlock();
+
+	// The pending events of the timing model have been removed by the system reset
+	tx_shifting = rx_shifting = false;
+	if(baud_rate)
+	{
+		freq = main_system.HasCPU() ? main_system.GetCPU(0)->GetFrequency() : 0;
+		char_cycles = (UINT)((__int64)freq * UART_BITS_PER_CHAR / baud_rate);
+		if(char_cycles == 0)
+			char_cycles = 1;
+	}
 }
 
 /*
@@ -74,8 +98,16 @@ UINT CUart::Read(UINT addr, UINT size)
 
 	data = 0;
 
+	// RxData register, with the timing model
+	if(addr == base && baud_rate)
+	{
+		// Reading clears RRDY. The next character is already being received if there is one
+		data = RxD;
+		RxR = 0;
+		UpdateIRQ();
+	}
 	// RxData register
-	if(addr == base)
+	else if(addr == base)
 	{
 		lock.lock();
 		
@@ -121,6 +153,17 @@ UINT CUart::Read(UINT addr, UINT size)
 	else if(addr == (base+8))
 	{
 		data = (TxR << 6) + (RxR << 7);
+		// Without the timing model the status is kept as it always was
+		if(baud_rate)
+		{
+			// TMT: the transmitter is empty
+			if(TxR && !tx_shifting)
+				data |= 1 << 5;
+			// TOE, ROE and E
+			data |= (TOE << 4) + (ROE << 3);
+			if(TOE || ROE)
+				data |= 1 << 8;
+		}
 	}
 	// Control register
 	else if(addr == (base+12))
@@ -142,13 +185,33 @@ UINT CUart::Read(UINT addr, UINT size)
  */
 void CUart::Write(UINT addr, UINT size, UINT d)
 {
-	char text[256];
-
 	// RxData register
 	if(addr == base)
 	{
 		// Cannot write to this reg
 	}
+	// TxData register, with the timing model
+	else if(addr == (base+4) && baud_rate)
+	{
+		// Writing a full holding register overwrites it
+		if(!TxR)
+			TOE = 1;
+
+		// Move the character directly to the shift register if it is idle
+		if(!tx_shifting)
+		{
+			tx_shift = d & 0xFF;
+			tx_shifting = true;
+			main_system.ScheduleEvent(char_cycles, this, UART_EVENT_TX_DONE);
+		}
+		else
+		{
+			TxD = d & 0xFF;
+			TxR = 0;
+		}
+
+		UpdateIRQ();
+	}
 	// TxData register
 	else if(addr == (base+4))
 	{
@@ -156,11 +219,7 @@ void CUart::Write(UINT addr, UINT size, UINT d)
 		TxD = d & 0xFF;
 
 		// Print the char to the uart console if there is one mapped to this class
-		if(c_console)
-		{
-			sprintf(text, "%c", TxD);
-			c_console->AddText(text, false);
-		}
+		OutputChar(TxD);
 
 		// Dont set TxR to 0 since we handle it here immdiately
 		// TxR = 0;
@@ -176,7 +235,15 @@ void CUart::Write(UINT addr, UINT size, UINT d)
 	// Status register
 	else if(addr == (base+8))
 	{
-		// Cannot write to this reg
+		// Writing clears the error bits
+		TOE = ROE = 0;
+	}
+	// Control register, with the timing model
+	else if(addr == (base+12) && baud_rate)
+	{
+		ITRDY = (d & 0x40) ? 1 : 0;
+		IRRDY = (d & 0x80) ? 1 : 0;
+		UpdateIRQ();
 	}
 	// Control register
 	else if(addr == (base+12))
@@ -226,6 +293,14 @@ void CUart::SendInput(const char *text)
 	// Add the text to the read buffer
 	buf += text;
 
+	// With the timing model, the characters are received one at a time by the simulation thread
+	if(baud_rate)
+	{
+		lock.unlock();
+		main_system.PostEvent(this, UART_EVENT_RX_START);
+		return;
+	}
+
 	RxD = buf[0];	
 	RxR = 1;
 
@@ -243,11 +318,116 @@ void CUart::SendInput(const char *text)
 }
 
 /*
- *	CJtag::SetConsole()
+ *	CUart::OnEvent()
+ *
+ *  Handles the events of the timing model
+ *
+ *	Parameters: event - One of the UART_EVENT constants
+ */
+void CUart::OnEvent(UINT event)
+{
+	// The shift register has sent its character
+	if(event == UART_EVENT_TX_DONE)
+	{
+		OutputChar(tx_shift);
+
+		// Continue with the character in the holding register if there is one
+		if(!TxR)
+		{
+			tx_shift = TxD;
+			TxR = 1;
+			main_system.ScheduleEvent(char_cycles, this, UART_EVENT_TX_DONE);
+		}
+		else
+		{
+			tx_shifting = false;
+		}
+		UpdateIRQ();
+	}
+	// A character has been received
+	else if(event == UART_EVENT_RX_DONE)
+	{
+		lock.lock();
+		// Overrun if the previous character hasn't been read
+		if(RxR)
+			ROE = 1;
+		RxD = buf[0];
+		RxR = 1;
+		buf.erase(0, 1);
+		lock.unlock();
+
+		rx_shifting = false;
+		StartReceive();
+		UpdateIRQ();
+	}
+	// Text has been typed in the console
+	else if(event == UART_EVENT_RX_START)
+	{
+		StartReceive();
+	}
+}
+
+/*
+ *	CUart::StartReceive()
+ *
+ *  Starts receiving the next character from the read buffer, unless a character is 
+ *  already being received or the buffer is empty
+ */
+void CUart::StartReceive()
+{
+	bool empty;
+
+	if(rx_shifting)
+		return;
+
+	lock.lock();
+	empty = buf.empty();
+	lock.unlock();
+
+	if(!empty)
+	{
+		rx_shifting = true;
+		main_system.ScheduleEvent(char_cycles, this, UART_EVENT_RX_DONE);
+	}
+}
+
+/*
+ *	CUart::UpdateIRQ()
+ *
+ *  Sets the IRQ signal of the timing model. It is asserted while TRDY or RRDY is set 
+ *  and the corresponding interrupt is enabled.
+ */
+void CUart::UpdateIRQ()
+{
+	if(!has_irq)
+		return;
+
+	if((ITRDY && TxR) || (IRRDY && RxR))
+		main_system.AssertIRQ(irq);
+	else
+		main_system.DeassertIRQ(irq);
+}
+
+/*
+ *	CUart::OutputChar()
+ *
+ *  Prints a sent character to the uart console if there is one mapped to this class.
+ *  NUL characters aren't printed.
+ *
+ *	Parameters: c - The character
+ */
+void CUart::OutputChar(UCHAR c)
+{
+	if(c_console && c)
+		c_console->AddText((char)c, false);
+}
+
+/*
+ *	CUart::SetConsole()
  *
- *  Maps this jtag class to a jtag console class
+ *  Maps this uart class to a uart console class
  */
-void CUart::SetConsole(CConsole *c)
+void CUart::SetConsole(CConsoleInterface *c)
 {
 	c_console = c;
 }
@@ -24,7 +24,15 @@ along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "MMDevice.h"
 
-class CConsole;
+class CConsoleInterface;
+
+// Events scheduled by the uart timing model
+#define UART_EVENT_TX_DONE	0	// The shift register has sent a character
+#define UART_EVENT_RX_DONE	1	// A character has been received
+#define UART_EVENT_RX_START	2	// Text has been typed in the console
+
+// Number of bits sent for each character: start bit, 8 data bits and stop bit
+#define UART_BITS_PER_CHAR	10
 
 class CUart : public MMDevice
 {
@@ -34,9 +42,17 @@ private:
 
 	// Internal registers
 	UINT RxR, TxR, ITRDY, IRRDY;
+	UINT TOE, ROE;
 	UCHAR RxD, TxD;
 
-	CConsole *c_console;	// Pointer to the console this uart interface is mapped to
+	// Timing model, only used when a baud rate is set
+	UINT baud_rate;			// The baud rate, 0 if characters are transferred instantly
+	UINT char_cycles;		// Number of clock cycles to transfer one character
+	bool tx_shifting;		// True while the shift register is sending a character
+	UCHAR tx_shift;			// The character in the shift register. TxD is the holding register
+	bool rx_shifting;		// True while a character is being received
+
+	CConsoleInterface *c_console;	// Pointer to the console this uart interface is mapped to
 	string buf;				// Text buffer with text that has been typed in from the console
 	CMutex lock;			// Lock for the buffer
 public:
@@ -51,8 +67,17 @@ public:
 	bool HasIRQ() { return has_irq; };
 	UINT GetIRQ() { return irq; };
 
-	void SetConsole(CConsole *c);
+	void SetBaudRate(UINT b) { baud_rate = b; };
+	UINT GetBaudRate() { return baud_rate; };
+
+	void SetConsole(CConsoleInterface *c);
 	void SendInput(const char *text);
+
+	void OnEvent(UINT event);
+private:
+	void OutputChar(UCHAR c);
+	void StartReceive();
+	void UpdateIRQ();
 };
 
 #endif
@@ -0,0 +1,319 @@
+/*
+NIISim - Nios II Simulator, A simulator that is capable of simulating various systems containing Nios II cpus.
+
+This file is part of NIISim.
+
+NIISim is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+NIISim is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstring>
+#include "CWaveRecorder.h"
+
+/*
+ *	CWaveRecorder::CWaveRecorder()
+ *
+ *  Constructor for the CWaveRecorder class.
+ */
+CWaveRecorder::CWaveRecorder()
+{
+	buffer = NULL;
+	buffer_used = 0;
+	file = NULL;
+	recording = false;
+	stopping = false;
+	clk_offset = 0;
+	ps_per_clk = 1;
+	last_time = 0;
+}
+
+/*
+ *	CWaveRecorder::~CWaveRecorder()
+ *
+ *  Destructor for the CWaveRecorder class.
+ *  Finishes the recording if it is still running.
+ */
+CWaveRecorder::~CWaveRecorder()
+{
+	Stop();
+}
+
+/*
+ *	CWaveRecorder::BeginSignals()
+ *
+ *  Removes all signals. Must be called before the signals of a new recording are added.
+ *  A running recording is finished first, since the writer thread uses the signals.
+ */
+void CWaveRecorder::BeginSignals()
+{
+	Stop();
+	signals.clear();
+}
+
+/*
+ *	CWaveRecorder::AddSignal()
+ *
+ *  Adds a signal to be recorded.
+ *
+ *	Parameters: scope - The name of the device the signal belongs to
+ *				name - The name of the signal
+ *				width - The width of the signal in bits (1-32)
+ *				value - The current value of the signal
+ *
+ *	Returns:	The signal number to pass to Change()
+ */
+UINT CWaveRecorder::AddSignal(const char *scope, const char *name, UINT width, UINT value)
+{
+	Signal signal;
+	UINT n, i;
+
+	signal.scope = scope;
+	signal.name = name;
+	signal.width = width;
+	signal.value = value;
+
+	// Identifier codes are numbers in base 94 using the printable characters
+	n = signals.size();
+	i = 0;
+	do
+	{
+		signal.id[i++] = '!' + n % 94;
+		n /= 94;
+	} while(n);
+	signal.id[i] = '\0';
+
+	signals.push_back(signal);
+
+	return signals.size() - 1;
+}
+
+/*
+ *	CWaveRecorder::Start()
+ *
+ *  Creates the VCD file, writes the declarations and initial values of all signals
+ *  and starts the writer thread.
+ *
+ *	Parameters: filename - The VCD file to create
+ *				frequency - The frequency of the system clock, used for the timestamps
+ *
+ *	Returns:	True if the recording was started, false if the file couldn't be created
+ */
+bool CWaveRecorder::Start(const char *filename, UINT frequency)
+{
+	string scope;
+
+	Stop();
+
+	file = fopen(filename, "w");
+	if(!file)
+		return false;
+
+	// Write the declarations. Signals of the same device are added after each other
+	fprintf(file, "$version NIISim $end\n$timescale 1ps $end\n");
+	for(UINT i=0; i<signals.size(); i++)
+	{
+		if(i == 0 || signals[i].scope != scope)
+		{
+			if(i != 0)
+				fprintf(file, "$upscope $end\n");
+			scope = signals[i].scope;
+			fprintf(file, "$scope module %s $end\n", scope.c_str());
+		}
+		fprintf(file, "$var wire %u %s %s $end\n", signals[i].width, signals[i].id, signals[i].name.c_str());
+	}
+	if(signals.size())
+		fprintf(file, "$upscope $end\n");
+	fprintf(file, "$enddefinitions $end\n");
+
+	// Write the initial values
+	fprintf(file, "#0\n$dumpvars\n");
+	for(UINT i=0; i<signals.size(); i++)
+		WriteValue(&signals[i]);
+	fprintf(file, "$end\n");
+
+	ps_per_clk = frequency ? 1000000000000ULL / frequency : 1;
+	clk_offset = 0;
+	last_time = 0;
+
+	buffer = new ValueChange[WAVE_BUFFER_SIZE];
+	buffer_used = 0;
+	stopping = false;
+	recording = true;
+
+	writer_thread.init(WriterThreadFunc, this);
+
+	return true;
+}
+
+/*
+ *	CWaveRecorder::Stop()
+ *
+ *  Stops the recording. Everything recorded so far is written before the file is closed.
+ *  Must not be called while the simulation thread is running.
+ */
+void CWaveRecorder::Stop()
+{
+	if(!recording)
+		return;
+
+	recording = false;
+	FlushBuffer();
+
+	// Let the writer thread write the remaining buffers and finish
+	lock.lock();
+	stopping = true;
+	lock.unlock();
+	writer_thread.join();
+
+	for(UINT i=0; i<free_buffers.size(); i++)
+		delete[] free_buffers[i];
+	free_buffers.clear();
+
+	fclose(file);
+	file = NULL;
+}
+
+/*
+ *	CWaveRecorder::FlushBuffer()
+ *
+ *  Hands over the current buffer to the writer thread and continues with a free one.
+ */
+void CWaveRecorder::FlushBuffer()
+{
+	lock.lock();
+
+	full_buffers.push_back(buffer);
+	full_buffer_sizes.push_back(buffer_used);
+
+	if(recording)
+	{
+		// Reuse a written buffer if there is one
+		if(free_buffers.size())
+		{
+			buffer = free_buffers.back();
+			free_buffers.pop_back();
+		}
+		else
+		{
+			buffer = new ValueChange[WAVE_BUFFER_SIZE];
+		}
+	}
+	else
+	{
+		buffer = NULL;
+	}
+	buffer_used = 0;
+
+	lock.unlock();
+}
+
+/*
+ *	CWaveRecorder::WriteValue()
+ *
+ *  Writes the current value of a signal to the file
+ *
+ *	Parameters: signal - The signal
+ */
+void CWaveRecorder::WriteValue(Signal *signal)
+{
+	char text[48];
+	int i;
+
+	if(signal->width == 1)
+	{
+		fprintf(file, "%c%s\n", (signal->value & 1) ? '1' : '0', signal->id);
+	}
+	else
+	{
+		text[0] = 'b';
+		for(i=0; i<(int)signal->width; i++)
+			text[1+i] = ((signal->value >> (signal->width - 1 - i)) & 1) ? '1' : '0';
+		text[1+i] = '\0';
+		fprintf(file, "%s %s\n", text, signal->id);
+	}
+}
+
+/*
+ *	CWaveRecorder::WriteBuffers()
+ *
+ *  Writes all full buffers to the file. Called by the writer thread.
+ *
+ *	Returns:	False when the recording has stopped and everything has been written
+ */
+bool CWaveRecorder::WriteBuffers()
+{
+	vector<ValueChange*> buffers;
+	vector<UINT> sizes;
+	bool done;
+
+	// Take over the full buffers
+	lock.lock();
+	buffers.swap(full_buffers);
+	sizes.swap(full_buffer_sizes);
+	done = stopping;
+	lock.unlock();
+
+	for(UINT i=0; i<buffers.size(); i++)
+	{
+		for(UINT j=0; j<sizes[i]; j++)
+		{
+			ValueChange *change = &buffers[i][j];
+			Signal *signal = &signals[change->signal];
+			unsigned long long time;
+
+			// Skip writes that didn't change the value
+			if(change->value == signal->value)
+				continue;
+			signal->value = change->value;
+
+			time = change->clk * ps_per_clk;
+			if(time != last_time)
+			{
+				fprintf(file, "#%llu\n", time);
+				last_time = time;
+			}
+			WriteValue(signal);
+		}
+	}
+
+	// Give the buffers back for reuse
+	lock.lock();
+	for(UINT i=0; i<buffers.size(); i++)
+	{
+		if(done)
+			delete[] buffers[i];
+		else
+			free_buffers.push_back(buffers[i]);
+	}
+	lock.unlock();
+
+	return !done;
+}
+
+/*
+ *	CWaveRecorder::WriterThreadFunc()
+ *
+ *  The writer thread. Writes full buffers until the recording is stopped.
+ */
+void *CWaveRecorder::WriterThreadFunc(void *data)
+{
+	CWaveRecorder *recorder = (CWaveRecorder*)data;
+
+	while(recorder->WriteBuffers())
+	{
+		// Buffers fill up at most a few times per second, so there is no need to hurry
+		CThread::Sleep(50);
+	}
+
+	return 0;
+}
@@ -0,0 +1,123 @@
+/*
+NIISim - Nios II Simulator, A simulator that is capable of simulating various systems containing Nios II cpus.
+
+This file is part of NIISim.
+
+NIISim is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+NIISim is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+
+This file implements a recorder of device signals to a VCD (Value Change Dump) file.
+The simulation thread only appends fixed size records to a buffer. Full buffers are
+handed over to a writer thread that formats them as text and writes them to the file.
+
+*/
+
+#ifndef _CWAVERECORDER_H_
+#define _CWAVERECORDER_H_
+
+#include <cstdio>
+#include <vector>
+#include <string>
+using namespace std;
+#include "types.h"
+#include "CThread.h"
+
+// Number of value changes in each buffer handed over to the writer thread
+#define WAVE_BUFFER_SIZE 65536
+
+class CWaveRecorder
+{
+private:
+	// A recorded signal
+	struct Signal
+	{
+		string scope;		// Name of the device the signal belongs to
+		string name;		// Name of the signal
+		UINT width;			// Width in bits
+		UINT value;			// Initial value, then the last value written to the file
+		char id[8];			// VCD identifier code
+	};
+
+	// A value change, as recorded by the simulation thread
+	struct ValueChange
+	{
+		unsigned long long clk;	// Clock cycle of the change
+		UINT signal;			// Index of the signal
+		UINT value;				// The new value
+	};
+
+	vector<Signal> signals;			// All signals, in the order they were added
+
+	ValueChange *buffer;			// Buffer being filled by the simulation thread
+	UINT buffer_used;				// Number of value changes in buffer
+
+	vector<ValueChange*> full_buffers;	// Buffers waiting to be written by the writer thread
+	vector<UINT> full_buffer_sizes;		// Number of value changes in each of full_buffers
+	vector<ValueChange*> free_buffers;	// Buffers that have been written and can be reused
+	CMutex lock;					// Lock for the buffer lists and stopping
+
+	CThread writer_thread;			// The thread writing to the file
+	FILE *file;						// Handle to the VCD file
+	bool recording;					// True while recording
+	bool stopping;					// Set to true to make the writer thread finish
+
+	unsigned long long clk_offset;	// Added to the system clock, so that time continues after a reset and when the clock wraps
+	unsigned long long ps_per_clk;	// Length of a clock cycle in picoseconds
+	unsigned long long last_time;	// Time of the last written value change
+
+	void FlushBuffer();
+	void WriteValue(Signal *signal);
+	bool WriteBuffers();
+	static void *WriterThreadFunc(void *data);
+public:
+	CWaveRecorder();
+	~CWaveRecorder();
+
+	void BeginSignals();
+	UINT AddSignal(const char *scope, const char *name, UINT width, UINT value);
+	bool Start(const char *filename, UINT frequency);
+	void Stop();
+
+	bool IsRecording() { return recording; };
+	void AddClockOffset(UINT clk) { clk_offset += clk; };
+	// Called by the system when its 32 bit clock wraps, also if no signal changes for a long time
+	void ClockWrapped() { clk_offset += 1ULL << 32; };
+
+	/*
+	 *	CWaveRecorder::Change()
+	 *
+	 *  Records a new value of a signal. This is cheap enough to be called on every register
+	 *  write; unchanged values are filtered out by the writer thread.
+	 *
+	 *	Parameters: clk - The current clock cycle
+	 *				signal - The signal returned by AddSignal()
+	 *				value - The new value
+	 */
+	inline void Change(UINT clk, UINT signal, UINT value)
+	{
+		if(!recording)
+			return;
+
+		buffer[buffer_used].clk = clk_offset + clk;
+		buffer[buffer_used].signal = signal;
+		buffer[buffer_used].value = value;
+
+		if(++buffer_used == WAVE_BUFFER_SIZE)
+			FlushBuffer();
+	}
+};
+
+#endif
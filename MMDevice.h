@@ -23,31 +23,40 @@ along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
 #define _MMDEVICE_H_
 
 #include <cstring>
+#include <glib.h>
 #include "types.h"
 
 // Base class of a memory mapped device
 class MMDevice
 {
 protected:
-	char name[256];		// The name of the interface
+	GQuark name;		// The interned name of the interface, 0 if it has none
 	UINT base;			// Base address the interface is mapped to
 	UINT span;			// Number of bytes the interface is mapped to
 public:
-	MMDevice() {}
+	MMDevice() : name(0) {}
 	virtual ~MMDevice() {};
 
 	virtual void Reset() = 0;
 	virtual UINT Read(UINT addr, UINT size) = 0;
 	virtual void Write(UINT addr, UINT size, UINT d) = 0;
 
-	void SetName(const char *n) { strcpy(name,  n); };
-	const char *GetName() const { return name; };
+	// Called when an event scheduled with CSystem::ScheduleEvent() or CSystem::PostEvent() is due
+	virtual void OnEvent(UINT event) {};
+
+	void SetName(const char *n) { name = g_quark_from_string(n); };
+	const char *GetName() const { return name ? g_quark_to_string(name) : ""; };
+	GQuark GetNameId() const { return name; };
 
 	void SetBaseAddress(UINT addr) { base = addr; };
 	UINT GetBaseAddress() const { return base; };
 
 	virtual void SetSpan(UINT s) { span = s; };
 	UINT GetSpan() const { return span; };
+
+	// Devices with an IRQ line override these
+	virtual bool HasIRQ() { return false; };
+	virtual UINT GetIRQ() { return 0; };
 };
 
 #endif
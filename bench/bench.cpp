@@ -0,0 +1,465 @@
+/*
+NIISim - Nios II Simulator, A simulator that is capable of simulating various systems containing Nios II cpus.
+
+This file is part of NIISim.
+
+NIISim is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+NIISim is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/*
+
+Benchmarks of the simulator core. Each workload is a small hand assembled Nios II program,
+or an .elf file given on the command line, that is run headless for a fixed number of
+instructions on the system in bench.sdf. The speed of each workload and the peak memory use
+of the whole process are written to stdout as JSON:
+
+	bench [--sdf <file>] [--instructions <n>] [--elf <file>]...
+
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <time.h>
+#include <sys/resource.h>
+using namespace std;
+
+#include "sim.h"
+#include "CCpu.h"
+#include "CFile.h"
+
+// Set when the simulation stops with an error, which no workload should cause
+static volatile bool failed = false;
+
+void ReportError(const char *msg)
+{
+	fprintf(stderr, "%s\n", msg);
+	failed = true;
+}
+
+// Memory map of bench.sdf
+#define RESET_ADDR		0x800000
+#define EXCEPTION_ADDR	0x800020
+#define STACK_TOP		0xFFFFF0
+#define DATA_ADDR		0x900000
+#define JTAG_ADDR		0x800
+#define LEDS_ADDR		0x810
+#define TIMER_ADDR		0x820
+#define KEYS_ADDR		0x840
+
+// Registers with special names
+#define ET	24
+#define SP	27
+#define EA	29
+#define RA	31
+
+// A program assembled into memory, one instruction at a time
+class Program
+{
+private:
+	vector<UINT> code;
+public:
+	UINT Here() { return RESET_ADDR + code.size()*4; };
+
+	// I-type instruction, rB = rA op imm16
+	void I(UINT op, UINT a, UINT b, UINT imm16) { code.push_back((a << 27) | (b << 22) | ((imm16 & 0xFFFF) << 6) | op); };
+	// R-type instruction, rC = rA opx rB
+	void R(UINT opx, UINT a, UINT b, UINT c, UINT imm5 = 0) { code.push_back((a << 27) | (b << 22) | (c << 17) | (opx << 11) | (imm5 << 6) | INSTR_R_TYPE); };
+	void Call(UINT addr) { code.push_back(((addr >> 2) << 6) | INSTR_CALL); };
+	void Movi(UINT r, UINT value) { I(INSTR_ORHI, 0, r, value >> 16); I(INSTR_ORI, r, r, value & 0xFFFF); };
+
+	// Branch to an address that has been assembled
+	void Branch(UINT op, UINT a, UINT b, UINT target) { I(op, a, b, target - (Here() + 4)); };
+	// Branch forward, the returned index is patched with Patch() at the target
+	UINT BranchForward(UINT op, UINT a, UINT b) { I(op, a, b, 0); return code.size() - 1; };
+	void Patch(UINT index) { code[index] |= ((Here() - (RESET_ADDR + index*4 + 4)) & 0xFFFF) << 6; };
+
+	void Load()
+	{
+		for(UINT i=0; i<code.size(); i++)
+			main_system.Write(RESET_ADDR + i*4, 32, code[i], false);
+	}
+};
+
+/*
+ *	BeginProgram()
+ *
+ *  Assembles the start of all workloads: a jump over the exception handler, which
+ *  acknowledges timer interrupts, and the set up of the stack pointer
+ *
+ *	Returns:	The index of the jump, patched by StartProgram()
+ */
+static UINT BeginProgram(Program& p)
+{
+	UINT start = p.BranchForward(INSTR_BR, 0, 0);
+
+	while(p.Here() < EXCEPTION_ADDR)
+		p.R(INSTR_R_ADD, 0, 0, 0);
+
+	// Clear TO of the timer, the only interrupt. eret is encoded with rA = ea and rB = 0x1E
+	p.Movi(ET, TIMER_ADDR);
+	p.I(INSTR_STWIO, ET, 0, 0);
+	p.I(INSTR_ADDI, EA, EA, -4);
+	p.R(INSTR_R_ERET, EA, 0x1E, 0);
+
+	return start;
+}
+
+static void StartProgram(Program& p, UINT start)
+{
+	p.Patch(start);
+	p.Movi(SP, STACK_TOP);
+}
+
+// Arithmetic and logic in a tight loop
+static void IntegerLoop(Program& p)
+{
+	UINT loop;
+
+	StartProgram(p, BeginProgram(p));
+	loop = p.Here();
+	p.I(INSTR_ADDI, 2, 2, 1);
+	p.R(INSTR_R_ADD, 3, 2, 3);
+	p.R(INSTR_R_XOR, 4, 3, 4);
+	p.R(INSTR_R_SLLI, 4, 0, 5, 3);
+	p.R(INSTR_R_SUB, 5, 2, 6);
+	p.I(INSTR_ANDI, 6, 7, 0xFF);
+	p.R(INSTR_R_OR, 7, 4, 8);
+	p.Branch(INSTR_BR, 0, 0, loop);
+}
+
+// Copies 64 kB a word at a time, over and over
+static void Memcpy(Program& p)
+{
+	UINT outer, inner;
+
+	StartProgram(p, BeginProgram(p));
+	outer = p.Here();
+	p.Movi(4, DATA_ADDR);
+	p.Movi(5, DATA_ADDR + 0x10000);
+	p.Movi(6, DATA_ADDR + 0x10000);
+	inner = p.Here();
+	p.I(INSTR_LDW, 4, 7, 0);
+	p.I(INSTR_STW, 5, 7, 0);
+	p.I(INSTR_ADDI, 4, 4, 4);
+	p.I(INSTR_ADDI, 5, 5, 4);
+	p.Branch(INSTR_BNE, 4, 6, inner);
+	p.Branch(INSTR_BR, 0, 0, outer);
+}
+
+// Fills 256 words with pseudo random numbers and insertion sorts them, over and over
+static void Sort(Program& p)
+{
+	UINT outer, fill, loop_i, loop_j, done_j[2];
+
+	StartProgram(p, BeginProgram(p));
+	p.Movi(9, 1103515245);
+	p.Movi(10, DATA_ADDR);
+	p.Movi(11, DATA_ADDR + 256*4);
+
+	outer = p.Here();
+	p.R(INSTR_R_ADD, 10, 0, 4);
+	fill = p.Here();
+	p.R(INSTR_R_MUL, 8, 9, 8);
+	p.I(INSTR_ADDI, 8, 8, 12345);
+	p.I(INSTR_STW, 4, 8, 0);
+	p.I(INSTR_ADDI, 4, 4, 4);
+	p.Branch(INSTR_BNE, 4, 11, fill);
+
+	// for(i = 1; i < n; i++), r4 points to a[i] and r7 is the key
+	p.I(INSTR_ADDI, 10, 4, 4);
+	loop_i = p.Here();
+	p.I(INSTR_LDW, 4, 7, 0);
+	p.I(INSTR_ADDI, 4, 5, -4);
+	// while(j >= 0 && a[j] > key), r5 points to a[j]
+	loop_j = p.Here();
+	done_j[0] = p.BranchForward(INSTR_BLT, 5, 10);
+	p.I(INSTR_LDW, 5, 8, 0);
+	done_j[1] = p.BranchForward(INSTR_BGE, 7, 8);
+	p.I(INSTR_STW, 5, 8, 4);
+	p.I(INSTR_ADDI, 5, 5, -4);
+	p.Branch(INSTR_BR, 0, 0, loop_j);
+	p.Patch(done_j[0]);
+	p.Patch(done_j[1]);
+	p.I(INSTR_STW, 5, 7, 4);
+	p.I(INSTR_ADDI, 4, 4, 4);
+	p.Branch(INSTR_BNE, 4, 11, loop_i);
+	p.Branch(INSTR_BR, 0, 0, outer);
+}
+
+// Computes fib(18) recursively, over and over
+static void Recursion(Program& p)
+{
+	UINT start, fib, recurse, outer;
+
+	start = BeginProgram(p);
+
+	// r2 = fib(r4)
+	fib = p.Here();
+	p.I(INSTR_ADDI, 0, 8, 2);
+	recurse = p.BranchForward(INSTR_BGE, 4, 8);
+	p.R(INSTR_R_ADD, 4, 0, 2);
+	p.R(INSTR_R_RET, RA, 0, 0);
+	p.Patch(recurse);
+	p.I(INSTR_ADDI, SP, SP, -12);
+	p.I(INSTR_STW, SP, RA, 8);
+	p.I(INSTR_STW, SP, 16, 4);
+	p.I(INSTR_STW, SP, 4, 0);
+	p.I(INSTR_ADDI, 4, 4, -1);
+	p.Call(fib);
+	p.R(INSTR_R_ADD, 2, 0, 16);
+	p.I(INSTR_LDW, SP, 4, 0);
+	p.I(INSTR_ADDI, 4, 4, -2);
+	p.Call(fib);
+	p.R(INSTR_R_ADD, 2, 16, 2);
+	p.I(INSTR_LDW, SP, 16, 4);
+	p.I(INSTR_LDW, SP, RA, 8);
+	p.I(INSTR_ADDI, SP, SP, 12);
+	p.R(INSTR_R_RET, RA, 0, 0);
+
+	StartProgram(p, start);
+	outer = p.Here();
+	p.I(INSTR_ADDI, 0, 4, 18);
+	p.Call(fib);
+	p.Branch(INSTR_BR, 0, 0, outer);
+}
+
+// Prints a counter in decimal to the JTAG UART, waiting for space in the write FIFO
+static void PrintJtag(Program& p)
+{
+	UINT outer, digit, write, wait;
+
+	StartProgram(p, BeginProgram(p));
+	p.Movi(9, JTAG_ADDR);
+	p.I(INSTR_ADDI, 0, 10, 10);
+	p.Movi(11, DATA_ADDR + 16);
+
+	outer = p.Here();
+	p.I(INSTR_ADDI, 2, 2, 1);
+	p.R(INSTR_R_ADD, 2, 0, 4);
+	p.R(INSTR_R_ADD, 11, 0, 5);
+	// Store the digits backwards
+	digit = p.Here();
+	p.R(INSTR_R_DIV, 4, 10, 6);
+	p.R(INSTR_R_MUL, 6, 10, 7);
+	p.R(INSTR_R_SUB, 4, 7, 7);
+	p.I(INSTR_ADDI, 7, 7, '0');
+	p.I(INSTR_ADDI, 5, 5, -1);
+	p.I(INSTR_STB, 5, 7, 0);
+	p.R(INSTR_R_ADD, 6, 0, 4);
+	p.Branch(INSTR_BNE, 4, 0, digit);
+	// Write them when the FIFO has space
+	write = p.Here();
+	p.I(INSTR_LDBU, 5, 7, 0);
+	wait = p.Here();
+	p.I(INSTR_LDWIO, 9, 8, 4);
+	p.R(INSTR_R_SRLI, 8, 0, 8, 16);
+	p.Branch(INSTR_BEQ, 8, 0, wait);
+	p.I(INSTR_STWIO, 9, 7, 0);
+	p.I(INSTR_ADDI, 5, 5, 1);
+	p.Branch(INSTR_BNE, 5, 11, write);
+	p.I(INSTR_ADDI, 0, 7, '\n');
+	p.I(INSTR_STWIO, 9, 7, 0);
+	p.Branch(INSTR_BR, 0, 0, outer);
+}
+
+// Counts while the timer interrupts every 100 clock cycles
+static void TimerInterrupts(Program& p)
+{
+	UINT loop;
+
+	StartProgram(p, BeginProgram(p));
+	p.Movi(9, TIMER_ADDR);
+	// Continuous mode with interrupts, started
+	p.I(INSTR_ADDI, 0, 8, 0x7);
+	p.I(INSTR_STWIO, 9, 8, 4);
+	// Enable the timer IRQ and interrupts
+	p.I(INSTR_ADDI, 0, 8, 0x2);
+	p.R(INSTR_R_WRCTL, 8, 0, 0, 3);
+	p.I(INSTR_ADDI, 0, 8, 0x1);
+	p.R(INSTR_R_WRCTL, 8, 0, 0, 0);
+	loop = p.Here();
+	p.I(INSTR_ADDI, 2, 2, 1);
+	p.Branch(INSTR_BR, 0, 0, loop);
+}
+
+// Copies the keys to the LEDs, polling the keys
+static void PioPolling(Program& p)
+{
+	UINT loop;
+
+	StartProgram(p, BeginProgram(p));
+	p.Movi(9, KEYS_ADDR);
+	p.Movi(10, LEDS_ADDR);
+	loop = p.Here();
+	p.I(INSTR_LDWIO, 9, 4, 0);
+	p.I(INSTR_XORI, 4, 4, 0xF);
+	p.I(INSTR_STWIO, 10, 4, 0);
+	p.I(INSTR_ADDI, 2, 2, 1);
+	p.Branch(INSTR_BR, 0, 0, loop);
+}
+
+/*
+ *	Now()
+ *
+ *  Returns the time in seconds from a monotonic clock
+ */
+static double Now()
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/*
+ *	PeakRss()
+ *
+ *  Returns the peak resident set size of the process in kB
+ */
+static long PeakRss()
+{
+	struct rusage usage;
+
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss;
+}
+
+/*
+ *	RunWorkload()
+ *
+ *  Loads the system, assembles a workload or loads an .elf file, runs it for a number of
+ *  instructions and writes the result as a JSON object
+ *
+ *	Parameters: name - The name of the workload
+ *				sdf - The system description file
+ *				assemble - The function assembling the workload, NULL to load elf
+ *				elf - The .elf file
+ *				instructions - The number of instructions to run
+ *				first - False if the object follows another one
+ *
+ *	Returns:	False if the simulation stopped with an error
+ */
+static bool RunWorkload(const char *name, const char *sdf, void (*assemble)(Program&), const char *elf,
+						unsigned long long instructions, bool first)
+{
+	unsigned long long executed = 0;
+	double start, seconds;
+	UINT last_clk;
+	CCpu *cpu;
+
+	main_system.LoadSystemDescriptionFile(sdf);
+	if(assemble)
+	{
+		Program p;
+		assemble(p);
+		p.Load();
+		main_system.Reset();
+	}
+	else
+	{
+		main_system.Reset();
+		main_system.LoadELFFile(elf, false);
+	}
+	cpu = main_system.GetCPU(0);
+
+	// Every Step() is counted as an instruction. Without a timing model that is exact, with one
+	// a step can end at a device event before the cpu is ready, so the clock cycles are reported
+	start = Now();
+	last_clk = main_system.GetClk();
+	while(executed < instructions && !failed)
+	{
+		for(int i=0; i<1000; i++)
+			main_system.Step();
+		executed += 1000;
+	}
+	seconds = Now() - start;
+
+	if(failed)
+	{
+		fprintf(stderr, "%s: the simulation stopped with an error\n", name);
+		return false;
+	}
+
+	if(cpu->GetCore() != CPU_CORE_NONE)
+		fprintf(stderr, "%s: the cpu has a timing model, %u clock cycles were simulated\n", name, main_system.GetClk() - last_clk);
+
+	printf("%s\n    {\"name\": \"%s\", \"instructions\": %llu, \"seconds\": %.6f, \"mips\": %.3f, \"ns_per_instruction\": %.3f}",
+		first ? "" : ",", name, executed, seconds, executed / seconds / 1e6, seconds * 1e9 / executed);
+	fflush(stdout);
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	static const char *names[] = {"integer_loop", "memcpy", "sort", "recursion", "printf_jtag", "timer_interrupts", "pio_polling"};
+	static void (*workloads[])(Program&) = {IntegerLoop, Memcpy, Sort, Recursion, PrintJtag, TimerInterrupts, PioPolling};
+	const char *sdf = "bench/bench.sdf";
+	unsigned long long instructions = 20000000;
+	vector<const char*> elfs;
+	bool first = true;
+	int result = 0;
+
+	for(int i=1; i<argc; i++)
+	{
+		if(!strcmp(argv[i], "--sdf") && i+1 < argc)
+			sdf = argv[++i];
+		else if(!strcmp(argv[i], "--instructions") && i+1 < argc)
+			instructions = strtoull(argv[++i], NULL, 0);
+		else if(!strcmp(argv[i], "--elf") && i+1 < argc)
+			elfs.push_back(argv[++i]);
+		else
+		{
+			fprintf(stderr, "Usage: %s [--sdf <file>] [--instructions <n>] [--elf <file>]...\n", argv[0]);
+			main_system.CloseSimulationThread();
+			return 1;
+		}
+	}
+
+	try
+	{
+		printf("{\n  \"workloads\": [");
+		for(UINT i=0; i<sizeof(names)/sizeof(const char*) && !result; i++, first = false)
+			if(!RunWorkload(names[i], sdf, workloads[i], NULL, instructions, first))
+				result = 1;
+		for(UINT i=0; i<elfs.size() && !result; i++, first = false)
+			if(!RunWorkload(elfs[i], sdf, NULL, elfs[i], instructions, first))
+				result = 1;
+		// The peak memory use is of the whole process, so it is only written once
+		if(!result)
+			printf("\n  ],\n  \"process_peak_rss_kb\": %ld\n}\n", PeakRss());
+	}
+	catch(const ParsingError& e)
+	{
+		fprintf(stderr, "%s\n", e.msg.c_str());
+		result = 1;
+	}
+	catch(const LoadELFFileError& e)
+	{
+		fprintf(stderr, "%s\n", e.msg.c_str());
+		result = 1;
+	}
+	catch(const FileDoesNotExistError& e)
+	{
+		fprintf(stderr, "The file '%s' does not exist!\n", e.path.c_str());
+		result = 1;
+	}
+
+	// The simulation thread must have quit before main_system is destroyed
+	main_system.CloseSimulationThread();
+	return result;
+}
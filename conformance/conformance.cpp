@@ -0,0 +1,1125 @@
+/*
+NIISim - Nios II Simulator, A simulator that is capable of simulating various systems containing Nios II cpus.
+
+This file is part of NIISim.
+
+NIISim is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+NIISim is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/*
+
+Conformance tests of the instruction set simulator. Directed and random instruction streams
+are run through the cpu of the simulator and through a reference model of the Nios II
+instruction set in lockstep. The registers, status, estatus, load and store addresses and
+stored data are compared after every instruction, and the data memory at the end of each
+stream. A stream that diverges is minimized by removing instructions and initial register
+values as long as it diverges at the same instruction, and printed as a reproducer.
+
+The states of the simulator can also be recorded as a golden trace, which later builds are
+compared against, to catch changes of behaviour that the reference model doesn't cover:
+
+	conformance [--sdf <file>] [--seed <n>] [--streams <n>] [--length <n>]
+				[--record <file> | --compare <file>]
+
+Results that the instruction set leaves undefined, of division by zero and of 0x80000000 / -1,
+are taken from the simulator.
+
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+using namespace std;
+
+#include "sim.h"
+#include "CCpu.h"
+#include "disassembler.h"
+#include "CFile.h"
+
+// Memory map of conformance.sdf
+#define EXCEPTION_ADDR	0x800020
+#define CODE_ADDR		0x800100
+#define CODE_END		0x810000
+#define DATA_ADDR		0x810000
+#define DATA_SIZE		0x1000
+#define MEM_BASE		0x800000
+#define MEM_SIZE		(DATA_ADDR + DATA_SIZE - MEM_BASE)
+
+// Register holding DATA_ADDR in all streams, the base of all loads and stores
+#define R_DATA		23
+// Random instructions write r1 to R_LAST_DEST
+#define R_LAST_DEST	22
+
+// Maximum number of instructions executed by a stream
+#define MAX_STEPS	100000
+
+static bool sim_stopped;		// Set when the simulation stops with an error
+
+void ReportError(const char *msg)
+{
+	sim_stopped = true;
+}
+
+// A test program: the instructions and the registers they start with
+struct Stream
+{
+	string name;
+	UINT regs[32];
+	vector<UINT> code;
+	UINT seed;				// Seed of the contents of the data memory
+
+	Stream(const string& name, UINT seed) : name(name), seed(seed)
+	{
+		memset(regs, 0, sizeof(regs));
+		regs[R_DATA] = DATA_ADDR;
+	}
+
+	UINT Here() { return CODE_ADDR + code.size()*4; };
+
+	// I-type instruction, rB = rA op imm16
+	void I(UINT op, UINT a, UINT b, UINT imm16) { code.push_back((a << 27) | (b << 22) | ((imm16 & 0xFFFF) << 6) | op); };
+	// R-type instruction, rC = rA opx rB
+	void R(UINT opx, UINT a, UINT b, UINT c, UINT imm5 = 0) { code.push_back((a << 27) | (b << 22) | (c << 17) | (opx << 11) | ((imm5 & 0x1F) << 6) | INSTR_R_TYPE); };
+	// J-type instruction
+	void J(UINT op, UINT addr) { code.push_back((((addr >> 2) & 0x3FFFFFF) << 6) | op); };
+};
+
+// The state compared after every instruction
+struct State
+{
+	UINT pc;
+	UINT regs[32];
+	UINT status, estatus;
+	UINT addr;				// Address of a load or store, 0 if none
+	bool stopped;			// Stopped by a misaligned or invalid memory access
+};
+
+/*
+ *	Random()
+ *
+ *  xorshift random number generator
+ */
+static UINT Random(UINT& state)
+{
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+/*
+ *	DataWord()
+ *
+ *  Returns the initial contents of a word of the data memory of a stream
+ */
+static UINT DataWord(UINT seed, UINT index)
+{
+	UINT state = seed * 2654435761U + index * 40503U + 1;
+
+	Random(state);
+	return Random(state);
+}
+
+/*
+ *	Disassemble()
+ *
+ *  Formats an instruction as its address, the instruction word and the disassembly
+ */
+static string Disassemble(UINT pc, UINT instr)
+{
+	char text[160];
+
+	snprintf(text, sizeof(text), "0x%08X: %08X  %s", pc, instr, DumpDisasm(DecompileInstruction(pc, instr)));
+	return text;
+}
+
+// Reference model of the Nios II instruction set, written from the processor reference
+// without regard to the simulator. Only the normal register set, no interrupts, no caches.
+class RefCpu
+{
+private:
+	State s;
+	UCHAR mem[MEM_SIZE];	// The memory from MEM_BASE
+	bool undefined;			// True if the last instruction wrote an undefined result
+
+	bool Valid(UINT addr, UINT bytes) { return addr - MEM_BASE < MEM_SIZE && addr - MEM_BASE + bytes <= MEM_SIZE; };
+	UINT Load(UINT addr, UINT bytes);
+	void Store(UINT addr, UINT bytes, UINT data);
+	void Set(UINT r, UINT data) { if(r != 0) s.regs[r] = data; };
+public:
+	void Start(const Stream& stream);
+	void Step();
+
+	const State& GetState() { return s; };
+	bool IsUndefined() { return undefined; };
+	void SetReg(UINT r, UINT data) { Set(r, data); };
+	UINT Read(UINT addr, UINT bytes) { return Load(addr, bytes); };
+};
+
+UINT RefCpu::Load(UINT addr, UINT bytes)
+{
+	UINT data = 0;
+
+	// Little endian
+	for(UINT i=0; i<bytes; i++)
+		data |= mem[addr - MEM_BASE + i] << (i*8);
+	return data;
+}
+
+void RefCpu::Store(UINT addr, UINT bytes, UINT data)
+{
+	for(UINT i=0; i<bytes; i++)
+		mem[addr - MEM_BASE + i] = (data >> (i*8)) & 0xFF;
+}
+
+/*
+ *	RefCpu::Start()
+ *
+ *  Loads a stream, with an exception handler that returns to the next instruction
+ */
+void RefCpu::Start(const Stream& stream)
+{
+	memset(mem, 0, sizeof(mem));
+	Store(EXCEPTION_ADDR, 4, (29 << 27) | (0x1E << 22) | (INSTR_R_ERET << 11) | INSTR_R_TYPE);
+	for(UINT i=0; i<stream.code.size(); i++)
+		Store(CODE_ADDR + i*4, 4, stream.code[i]);
+	for(UINT i=0; i<DATA_SIZE/4; i++)
+		Store(DATA_ADDR + i*4, 4, DataWord(stream.seed, i));
+
+	memcpy(s.regs, stream.regs, sizeof(s.regs));
+	s.regs[0] = 0;
+	s.pc = CODE_ADDR;
+	s.status = s.estatus = 0;
+	s.addr = 0;
+	s.stopped = false;
+	undefined = false;
+}
+
+/*
+ *	RefCpu::Step()
+ *
+ *  Executes one instruction
+ */
+void RefCpu::Step()
+{
+	UINT instr, op, opx, a, b, c, imm5, imm16, simm16, next, addr, bytes, data;
+	bool exception = false;
+
+	s.addr = 0;
+	undefined = false;
+
+	if(!Valid(s.pc, 4))
+	{
+		s.stopped = true;
+		return;
+	}
+	instr = Load(s.pc, 4);
+	next = s.pc + 4;
+
+	op = instr & 0x3F;
+	opx = (instr >> 11) & 0x3F;
+	a = instr >> 27;
+	b = (instr >> 22) & 0x1F;
+	c = (instr >> 17) & 0x1F;
+	imm5 = (instr >> 6) & 0x1F;
+	imm16 = (instr >> 6) & 0xFFFF;
+	simm16 = (UINT)(int)(short)imm16;
+
+	UINT ra = s.regs[a], rb = s.regs[b];
+
+	if(op == INSTR_R_TYPE)
+	{
+		switch(opx)
+		{
+		case INSTR_R_AND:		Set(c, ra & rb); break;
+		case INSTR_R_OR:		Set(c, ra | rb); break;
+		case INSTR_R_XOR:		Set(c, ra ^ rb); break;
+		case INSTR_R_NOR:		Set(c, ~(ra | rb)); break;
+		case INSTR_R_ADD:		Set(c, ra + rb); break;
+		case INSTR_R_SUB:		Set(c, ra - rb); break;
+		case INSTR_R_MUL:		Set(c, (UINT)((unsigned long long)ra * rb)); break;
+		case INSTR_R_MULXSS:	Set(c, (UINT)(((long long)(int)ra * (long long)(int)rb) >> 32)); break;
+		case INSTR_R_MULXSU:	Set(c, (UINT)(((long long)(int)ra * (long long)rb) >> 32)); break;
+		case INSTR_R_MULXUU:	Set(c, (UINT)(((unsigned long long)ra * rb) >> 32)); break;
+		case INSTR_R_DIV:
+			if(rb == 0 || (ra == 0x80000000 && rb == 0xFFFFFFFF))
+				undefined = true;
+			else
+				Set(c, (UINT)((int)ra / (int)rb));
+			break;
+		case INSTR_R_DIVU:
+			if(rb == 0)
+				undefined = true;
+			else
+				Set(c, ra / rb);
+			break;
+		case INSTR_R_CMPEQ:		Set(c, ra == rb); break;
+		case INSTR_R_CMPNE:		Set(c, ra != rb); break;
+		case INSTR_R_CMPGE:		Set(c, (int)ra >= (int)rb); break;
+		case INSTR_R_CMPLT:		Set(c, (int)ra < (int)rb); break;
+		case INSTR_R_CMPGEU:	Set(c, ra >= rb); break;
+		case INSTR_R_CMPLTU:	Set(c, ra < rb); break;
+		case INSTR_R_ROL:		Set(c, (ra << (rb & 31)) | (ra >> ((32 - (rb & 31)) & 31))); break;
+		case INSTR_R_ROLI:		Set(c, (ra << imm5) | (ra >> ((32 - imm5) & 31))); break;
+		case INSTR_R_ROR:		Set(c, (ra >> (rb & 31)) | (ra << ((32 - (rb & 31)) & 31))); break;
+		case INSTR_R_SLL:		Set(c, ra << (rb & 31)); break;
+		case INSTR_R_SLLI:		Set(c, ra << imm5); break;
+		case INSTR_R_SRL:		Set(c, ra >> (rb & 31)); break;
+		case INSTR_R_SRLI:		Set(c, ra >> imm5); break;
+		case INSTR_R_SRA:		Set(c, (UINT)((int)ra >> (rb & 31))); break;
+		case INSTR_R_SRAI:		Set(c, (UINT)((int)ra >> imm5)); break;
+		case INSTR_R_NEXTPC:	Set(c, next); break;
+		case INSTR_R_CALLR:		s.regs[31] = next; next = ra; break;
+		case INSTR_R_JMP:
+		case INSTR_R_RET:		next = ra; break;
+		case INSTR_R_ERET:		s.status = s.estatus; next = s.regs[29]; break;
+		case INSTR_R_TRAP:		exception = true; break;
+		case INSTR_R_RDCTL:
+			Set(c, imm5 == 0 ? s.status : imm5 == 1 ? s.estatus : 0);
+			break;
+		case INSTR_R_WRCTL:
+			if(imm5 == 0)
+				s.status = ra & ~STATUS_CRS;
+			else if(imm5 == 1)
+				s.estatus = ra;
+			break;
+		case INSTR_R_FLUSHI:
+		case INSTR_R_INITI:
+		case INSTR_R_FLUSHP:
+		case INSTR_R_SYNC:
+			break;
+		default:
+			// Unimplemented instruction
+			exception = true;
+			break;
+		}
+	}
+	else
+	{
+		switch(op)
+		{
+		case INSTR_ADDI:	Set(b, ra + simm16); break;
+		case INSTR_ANDI:	Set(b, ra & imm16); break;
+		case INSTR_ORI:		Set(b, ra | imm16); break;
+		case INSTR_XORI:	Set(b, ra ^ imm16); break;
+		case INSTR_ANDHI:	Set(b, ra & (imm16 << 16)); break;
+		case INSTR_ORHI:	Set(b, ra | (imm16 << 16)); break;
+		case INSTR_XORHI:	Set(b, ra ^ (imm16 << 16)); break;
+		case INSTR_MULI:	Set(b, ra * simm16); break;
+		case INSTR_CMPEQI:	Set(b, ra == simm16); break;
+		case INSTR_CMPNEI:	Set(b, ra != simm16); break;
+		case INSTR_CMPGEI:	Set(b, (int)ra >= (int)simm16); break;
+		case INSTR_CMPLTI:	Set(b, (int)ra < (int)simm16); break;
+		case INSTR_CMPGEUI:	Set(b, ra >= imm16); break;
+		case INSTR_CMPLTUI:	Set(b, ra < imm16); break;
+
+		case INSTR_LDB: case INSTR_LDBU: case INSTR_LDH: case INSTR_LDHU: case INSTR_LDW:
+		case INSTR_LDBIO: case INSTR_LDBUIO: case INSTR_LDHIO: case INSTR_LDHUIO: case INSTR_LDWIO:
+		case INSTR_STB: case INSTR_STH: case INSTR_STW:
+		case INSTR_STBIO: case INSTR_STHIO: case INSTR_STWIO:
+			// Bits 4:3 of the opcode give the size, and bits 2:0 the kind of access
+			bytes = 1 << ((op >> 3) & 0x3);
+			addr = ra + simm16;
+			if((addr & (bytes - 1)) || !Valid(addr, bytes))
+			{
+				// The simulator stops on misaligned and invalid addresses
+				s.stopped = true;
+				return;
+			}
+			s.addr = addr;
+			if((op & 0x7) == 0x5)
+			{
+				Store(addr, bytes, rb);
+			}
+			else
+			{
+				data = Load(addr, bytes);
+				// ldb and ldh sign extend
+				if((op & 0x7) == 0x7 && bytes < 4)
+					data = bytes == 1 ? (UINT)(int)(signed char)data : (UINT)(int)(short)data;
+				Set(b, data);
+			}
+			break;
+
+		case INSTR_BR:		next += simm16; break;
+		case INSTR_BEQ:		if(ra == rb) next += simm16; break;
+		case INSTR_BNE:		if(ra != rb) next += simm16; break;
+		case INSTR_BGE:		if((int)ra >= (int)rb) next += simm16; break;
+		case INSTR_BLT:		if((int)ra < (int)rb) next += simm16; break;
+		case INSTR_BGEU:	if(ra >= rb) next += simm16; break;
+		case INSTR_BLTU:	if(ra < rb) next += simm16; break;
+
+		case INSTR_CALL:	s.regs[31] = next; next = (s.pc & 0xF0000000) | ((instr >> 6) << 2); break;
+		case INSTR_JMPI:	next = (s.pc & 0xF0000000) | ((instr >> 6) << 2); break;
+
+		case INSTR_INITD:
+		case INSTR_INITDA:
+		case INSTR_FLUSHD:
+		case INSTR_FLUSHDA:
+			break;
+
+		default:
+			// Unimplemented instruction
+			exception = true;
+			break;
+		}
+	}
+
+	if(exception)
+	{
+		// The handler runs in the normal register set, with PRS set to the interrupted one
+		s.estatus = s.status;
+		s.status = (s.status & ~(STATUS_PIE | STATUS_U | STATUS_CRS | STATUS_PRS)) |
+			((s.status & STATUS_CRS) << (STATUS_PRS_SHIFT - STATUS_CRS_SHIFT));
+		s.regs[29] = next;
+		next = EXCEPTION_ADDR;
+	}
+	s.pc = next;
+}
+
+// The cpu of the simulator, running in main_system
+class SimCpu
+{
+private:
+	CCpu *cpu;
+	State s;
+
+	void Update();
+public:
+	void Start(const Stream& stream);
+	void Step();
+
+	const State& GetState() { return s; };
+	UINT Read(UINT addr, UINT bytes) { return main_system.Read(addr, bytes*8, false, false); };
+};
+
+/*
+ *	SimCpu::Start()
+ *
+ *  Resets the system and loads a stream, like RefCpu::Start()
+ */
+void SimCpu::Start(const Stream& stream)
+{
+	main_system.Reset();
+	cpu = main_system.GetCPU(0);
+
+	main_system.Write(EXCEPTION_ADDR, 32, (29 << 27) | (0x1E << 22) | (INSTR_R_ERET << 11) | INSTR_R_TYPE, false);
+	for(UINT i=0; i<stream.code.size(); i++)
+		main_system.Write(CODE_ADDR + i*4, 32, stream.code[i], false);
+	for(UINT i=0; i<DATA_SIZE/4; i++)
+		main_system.Write(DATA_ADDR + i*4, 32, DataWord(stream.seed, i), false);
+
+	for(UINT r=1; r<32; r++)
+		cpu->SetReg(r, stream.regs[r]);
+	cpu->SetPC(CODE_ADDR);
+	sim_stopped = false;
+
+	Update();
+	s.addr = 0;
+}
+
+void SimCpu::Update()
+{
+	s.pc = cpu->GetPC();
+	for(UINT r=0; r<32; r++)
+		s.regs[r] = cpu->GetReg(r);
+	s.status = cpu->GetCtrlReg(0);
+	s.estatus = cpu->GetCtrlReg(1);
+	s.addr = sim_stopped ? 0 : cpu->GetTrace().Last()->addr;
+	s.stopped = sim_stopped;
+}
+
+/*
+ *	SimCpu::Step()
+ *
+ *  Executes one instruction. Without a timing model every clock cycle executes one.
+ */
+void SimCpu::Step()
+{
+	main_system.Step();
+	Update();
+}
+
+static RefCpu reference;
+static SimCpu simulator;
+
+// Result of running a stream
+struct Result
+{
+	bool diverged;
+	UINT steps;				// Instructions executed
+	UINT pc, instr;			// The last executed instruction
+	string message;			// The differences, if diverged
+	vector<pair<UINT, UINT> > trace;	// pc and hash of the state of the simulator after each instruction
+	UINT memory_hash;		// Hash of the data memory of the simulator at the end
+};
+
+/*
+ *	Hash()
+ *
+ *  FNV-1a hash of words
+ */
+static UINT Hash(UINT hash, const UINT *words, UINT count)
+{
+	for(UINT i=0; i<count; i++)
+	{
+		for(UINT j=0; j<32; j+=8)
+			hash = (hash ^ ((words[i] >> j) & 0xFF)) * 16777619U;
+	}
+	return hash;
+}
+
+static UINT HashState(const State& s)
+{
+	UINT hash = 2166136261U;
+	UINT fields[5] = {s.pc, s.status, s.estatus, s.addr, s.stopped};
+
+	hash = Hash(hash, s.regs, 32);
+	return Hash(hash, fields, 5);
+}
+
+/*
+ *	Compare()
+ *
+ *  Describes the differences between the states of the reference model and the simulator
+ *
+ *	Returns:	One line per difference, empty if there are none
+ */
+static string Compare(const State& r, const State& s)
+{
+	string message;
+	char line[128];
+
+	if(r.stopped != s.stopped)
+	{
+		snprintf(line, sizeof(line), "\tstopped: reference %s, simulator %s\n", r.stopped ? "yes" : "no", s.stopped ? "yes" : "no");
+		message += line;
+	}
+	if(r.pc != s.pc)
+	{
+		snprintf(line, sizeof(line), "\tpc: reference 0x%08X, simulator 0x%08X\n", r.pc, s.pc);
+		message += line;
+	}
+	for(UINT i=0; i<32; i++)
+	{
+		if(r.regs[i] != s.regs[i])
+		{
+			snprintf(line, sizeof(line), "\tr%u: reference 0x%08X, simulator 0x%08X\n", i, r.regs[i], s.regs[i]);
+			message += line;
+		}
+	}
+	if(r.status != s.status)
+	{
+		snprintf(line, sizeof(line), "\tstatus: reference 0x%08X, simulator 0x%08X\n", r.status, s.status);
+		message += line;
+	}
+	if(r.estatus != s.estatus)
+	{
+		snprintf(line, sizeof(line), "\testatus: reference 0x%08X, simulator 0x%08X\n", r.estatus, s.estatus);
+		message += line;
+	}
+	if(r.addr != s.addr)
+	{
+		snprintf(line, sizeof(line), "\tmemory access: reference 0x%08X, simulator 0x%08X\n", r.addr, s.addr);
+		message += line;
+	}
+	return message;
+}
+
+/*
+ *	Running()
+ *
+ *  Returns true while the stream hasn't stopped or left its code and the exception handler
+ */
+static bool Running(const State& s, UINT end)
+{
+	return !s.stopped && ((s.pc >= CODE_ADDR && s.pc < end) || s.pc == EXCEPTION_ADDR);
+}
+
+/*
+ *	Run()
+ *
+ *  Runs a stream through the reference model and the simulator in lockstep until they diverge
+ *
+ *	Parameters: stream - The stream
+ *				record - True to record the trace of the simulator
+ */
+static Result Run(const Stream& stream, bool record)
+{
+	Result result;
+	UINT end = CODE_ADDR + stream.code.size()*4;
+	char line[128];
+
+	reference.Start(stream);
+	simulator.Start(stream);
+
+	result.diverged = false;
+	result.pc = result.instr = 0;
+	for(result.steps = 0; result.steps < MAX_STEPS && Running(reference.GetState(), end); )
+	{
+		const State& r = reference.GetState();
+		const State& s = simulator.GetState();
+
+		result.pc = r.pc;
+		result.instr = reference.Read(r.pc, 4);
+		reference.Step();
+		simulator.Step();
+		result.steps++;
+
+		// Undefined results are taken from the simulator
+		if(reference.IsUndefined())
+			reference.SetReg((result.instr >> 17) & 0x1F, s.regs[(result.instr >> 17) & 0x1F]);
+
+		if(record)
+			result.trace.push_back(make_pair(result.pc, HashState(s)));
+
+		result.message = Compare(r, s);
+		// Check the word written by a store
+		if(result.message.empty() && r.addr && (result.instr & 0x7) == 0x5 &&
+		   reference.Read(r.addr & ~3, 4) != simulator.Read(r.addr & ~3, 4))
+		{
+			snprintf(line, sizeof(line), "\tstored word at 0x%08X: reference 0x%08X, simulator 0x%08X\n",
+				r.addr & ~3, reference.Read(r.addr & ~3, 4), simulator.Read(r.addr & ~3, 4));
+			result.message = line;
+		}
+		if(!result.message.empty())
+		{
+			result.diverged = true;
+			return result;
+		}
+	}
+
+	// Compare the data memory at the end
+	result.memory_hash = 2166136261U;
+	for(UINT addr = DATA_ADDR; addr < DATA_ADDR + DATA_SIZE; addr += 4)
+	{
+		UINT word = simulator.Read(addr, 4);
+
+		result.memory_hash = Hash(result.memory_hash, &word, 1);
+		if(!result.diverged && reference.Read(addr, 4) != word)
+		{
+			snprintf(line, sizeof(line), "\tdata memory at 0x%08X: reference 0x%08X, simulator 0x%08X\n", addr, reference.Read(addr, 4), word);
+			result.message = line;
+			result.diverged = true;
+		}
+	}
+	return result;
+}
+
+/*
+ *	Minimize()
+ *
+ *  Removes instructions and initial register values from a diverging stream as long as it
+ *  diverges at the same instruction
+ *
+ *	Parameters: stream - The stream
+ *				instr - The instruction word it diverges at
+ *
+ *	Returns:	The smallest stream found
+ */
+static Stream Minimize(Stream stream, UINT instr)
+{
+	// Remove chunks of instructions, halving the size of the chunks
+	for(UINT chunk = stream.code.size()/2 ? stream.code.size()/2 : 1; chunk >= 1; chunk /= 2)
+	{
+		for(UINT i=0; i<stream.code.size(); )
+		{
+			Stream candidate = stream;
+			Result result;
+
+			candidate.code.erase(candidate.code.begin() + i, candidate.code.begin() + min(i + chunk, (UINT)candidate.code.size()));
+			result = Run(candidate, false);
+			if(result.diverged && result.instr == instr)
+				stream = candidate;
+			else
+				i += chunk;
+		}
+	}
+
+	// Clear the registers, except the base of the loads and stores
+	for(UINT r=1; r<32; r++)
+	{
+		Stream candidate = stream;
+		Result result;
+
+		if(r == R_DATA || !stream.regs[r])
+			continue;
+		candidate.regs[r] = 0;
+		result = Run(candidate, false);
+		if(result.diverged && result.instr == instr)
+			stream = candidate;
+	}
+	return stream;
+}
+
+/*
+ *	PrintStream()
+ *
+ *  Prints the initial registers and the instructions of a stream
+ */
+static void PrintStream(const Stream& stream)
+{
+	for(UINT r=1; r<32; r++)
+	{
+		if(stream.regs[r])
+			printf("\tr%u = 0x%08X\n", r, stream.regs[r]);
+	}
+	for(UINT i=0; i<stream.code.size(); i++)
+		printf("\t%s\n", Disassemble(CODE_ADDR + i*4, stream.code[i]).c_str());
+}
+
+// Values that the directed streams start with in r1 to r13
+static const UINT values[] = {0, 1, 2, 0x1F, 0x20, 0x7FFF, 0x8000, 0xFFFF, 0x7FFFFFFF, 0x80000000, 0xFFFF8000, 0xFFFFFFFF, 0x12345678};
+#define NUM_VALUES	(sizeof(values)/sizeof(UINT))
+
+static const UINT i_ops[] = {INSTR_ADDI, INSTR_ANDI, INSTR_ORI, INSTR_XORI, INSTR_ANDHI, INSTR_ORHI, INSTR_XORHI, INSTR_MULI,
+							 INSTR_CMPEQI, INSTR_CMPNEI, INSTR_CMPGEI, INSTR_CMPLTI, INSTR_CMPGEUI, INSTR_CMPLTUI};
+static const UINT r_ops[] = {INSTR_R_AND, INSTR_R_OR, INSTR_R_XOR, INSTR_R_NOR, INSTR_R_ADD, INSTR_R_SUB,
+							 INSTR_R_MUL, INSTR_R_MULXSS, INSTR_R_MULXSU, INSTR_R_MULXUU, INSTR_R_DIV, INSTR_R_DIVU,
+							 INSTR_R_CMPEQ, INSTR_R_CMPNE, INSTR_R_CMPGE, INSTR_R_CMPLT, INSTR_R_CMPGEU, INSTR_R_CMPLTU,
+							 INSTR_R_ROL, INSTR_R_ROR, INSTR_R_SLL, INSTR_R_SRL, INSTR_R_SRA};
+static const UINT shift_ops[] = {INSTR_R_ROLI, INSTR_R_SLLI, INSTR_R_SRLI, INSTR_R_SRAI};
+static const UINT load_ops[] = {INSTR_LDB, INSTR_LDBU, INSTR_LDH, INSTR_LDHU, INSTR_LDW,
+								INSTR_LDBIO, INSTR_LDBUIO, INSTR_LDHIO, INSTR_LDHUIO, INSTR_LDWIO};
+static const UINT store_ops[] = {INSTR_STB, INSTR_STH, INSTR_STW, INSTR_STBIO, INSTR_STHIO, INSTR_STWIO};
+static const UINT branch_ops[] = {INSTR_BR, INSTR_BEQ, INSTR_BNE, INSTR_BGE, INSTR_BLT, INSTR_BGEU, INSTR_BLTU};
+static const UINT reserved_ops[] = {0x02, 0x09, 0x0A, 0x11, 0x12, 0x19, 0x1A, 0x1D, 0x1F, 0x21, 0x22, 0x29, 0x2A, 0x31, 0x39, 0x3D, 0x3E, 0x3F};
+static const UINT reserved_opxs[] = {0x00, 0x0A, 0x0F, 0x11, 0x15, 0x19, 0x21, 0x22, 0x23, 0x2A, 0x2B, 0x2C, 0x2F, 0x32, 0x33, 0x35, 0x37, 0x38, 0x3C, 0x3D, 0x3E, 0x3F};
+#define COUNT(a)	(sizeof(a)/sizeof(UINT))
+
+// Size in bytes of a load or store
+#define ACCESS_SIZE(op)	(1 << (((op) >> 3) & 0x3))
+
+/*
+ *	DirectedStreams()
+ *
+ *  Adds streams covering the corner cases of immediates, sign extension, multiplication,
+ *  division, shifts, loads and stores, branches, calls and exceptions
+ */
+static void DirectedStreams(vector<Stream>& streams)
+{
+	UINT dest;
+
+	{
+		Stream s("immediates", 1);
+		static const UINT imms[] = {0, 1, 0x1234, 0x7FFF, 0x8000, 0xFFFF};
+
+		dest = 0;
+		for(UINT i=0; i<NUM_VALUES; i++)
+			s.regs[1 + i] = values[i];
+		for(UINT op=0; op<COUNT(i_ops); op++)
+			for(UINT imm=0; imm<COUNT(imms); imm++)
+				for(UINT a=1; a<=NUM_VALUES; a++)
+					s.I(i_ops[op], a, 14 + dest++ % 9, imms[imm]);
+		streams.push_back(s);
+	}
+
+	{
+		Stream s("register operations", 2);
+
+		dest = 0;
+		for(UINT i=0; i<NUM_VALUES; i++)
+			s.regs[1 + i] = values[i];
+		for(UINT op=0; op<COUNT(r_ops); op++)
+			for(UINT a=1; a<=NUM_VALUES; a++)
+				for(UINT b=1; b<=NUM_VALUES; b++)
+					s.R(r_ops[op], a, b, 14 + dest++ % 9);
+		streams.push_back(s);
+	}
+
+	{
+		Stream s("shift and rotate immediates", 3);
+
+		dest = 0;
+		for(UINT i=0; i<NUM_VALUES; i++)
+			s.regs[1 + i] = values[i];
+		for(UINT op=0; op<COUNT(shift_ops); op++)
+			for(UINT imm=0; imm<32; imm++)
+			{
+				s.R(shift_ops[op], 9, 0, 14 + dest++ % 9, imm);
+				s.R(shift_ops[op], 10, 0, 14 + dest++ % 9, imm);
+				s.R(shift_ops[op], 13, 0, 14 + dest++ % 9, imm);
+			}
+		streams.push_back(s);
+	}
+
+	{
+		Stream s("loads", 4);
+
+		// r24 points to the middle of the data memory, for negative offsets
+		dest = 0;
+		s.regs[24] = DATA_ADDR + DATA_SIZE/2;
+		for(UINT op=0; op<COUNT(load_ops); op++)
+			for(int off=-8; off<8; off += ACCESS_SIZE(load_ops[op]))
+			{
+				s.I(load_ops[op], R_DATA, 14 + dest++ % 9, off + 8);
+				s.I(load_ops[op], 24, 14 + dest++ % 9, off);
+			}
+		streams.push_back(s);
+	}
+
+	{
+		Stream s("stores", 5);
+
+		for(UINT i=0; i<NUM_VALUES; i++)
+			s.regs[1 + i] = values[i];
+		for(UINT op=0; op<COUNT(store_ops); op++)
+			for(UINT off=0; off<16; off += ACCESS_SIZE(store_ops[op]))
+			{
+				s.I(store_ops[op], R_DATA, 1 + (off + op) % NUM_VALUES, op*16 + off);
+				s.I(INSTR_LDW, R_DATA, 14, (op*16 + off) & ~3);
+			}
+		streams.push_back(s);
+	}
+
+	{
+		Stream s("branches", 6);
+		static const UINT regs[] = {1, 2, 9, 10, 12};
+
+		for(UINT i=0; i<NUM_VALUES; i++)
+			s.regs[1 + i] = values[i];
+		// Each branch skips an increment of r14 if taken
+		for(UINT op=0; op<COUNT(branch_ops); op++)
+			for(UINT a=0; a<COUNT(regs); a++)
+				for(UINT b=0; b<COUNT(regs); b++)
+				{
+					s.I(branch_ops[op], regs[a], regs[b], 4);
+					s.I(INSTR_ADDI, 14, 14, 1);
+				}
+		// Branches by zero and backwards over a forward branch
+		s.I(INSTR_BR, 0, 0, 0);
+		s.I(INSTR_BR, 0, 0, 4);
+		s.I(INSTR_BR, 0, 0, 8);
+		s.I(INSTR_BR, 0, 0, -8);
+		s.I(INSTR_ADDI, 15, 15, 1);
+		streams.push_back(s);
+	}
+
+	{
+		Stream s("calls and jumps", 7);
+
+		// 0: call 9, 1: callr r5, 2: nextpc r6, 3: jmpi 5, 5: jmp r8, 7: br 10, 9: nextpc r15, ret
+		s.regs[5] = CODE_ADDR + 9*4;
+		s.regs[8] = CODE_ADDR + 7*4;
+		s.J(INSTR_CALL, CODE_ADDR + 9*4);
+		s.R(INSTR_R_CALLR, 5, 0, 31);
+		s.R(INSTR_R_NEXTPC, 0, 0, 6);
+		s.J(INSTR_JMPI, CODE_ADDR + 5*4);
+		s.I(INSTR_ADDI, 7, 7, 1);
+		s.R(INSTR_R_JMP, 8, 0, 0);
+		s.I(INSTR_ADDI, 7, 7, 1);
+		s.I(INSTR_ADDI, 7, 7, 2);
+		s.I(INSTR_BR, 0, 0, 8);
+		s.R(INSTR_R_NEXTPC, 0, 0, 15);
+		s.R(INSTR_R_RET, 31, 0, 0);
+		s.I(INSTR_ADDI, 7, 7, 4);
+		streams.push_back(s);
+	}
+
+	{
+		Stream s("exceptions", 8);
+
+		for(UINT i=0; i<NUM_VALUES; i++)
+			s.regs[1 + i] = values[i];
+		s.R(INSTR_R_TRAP, 0, 0, 0x1D, 3);
+		s.R(INSTR_R_WRCTL, 2, 0, 0, 0);
+		s.R(INSTR_R_WRCTL, 3, 0, 0, 1);
+		s.R(INSTR_R_RDCTL, 0, 0, 14, 0);
+		s.R(INSTR_R_RDCTL, 0, 0, 15, 1);
+		s.R(INSTR_R_TRAP, 0, 0, 0x1D, 3);
+		s.R(INSTR_R_RDCTL, 0, 0, 16, 0);
+		s.R(INSTR_R_RDCTL, 0, 0, 17, 1);
+		s.R(INSTR_R_WRCTL, 12, 0, 0, 0);
+		s.R(INSTR_R_RDCTL, 0, 0, 18, 0);
+		s.R(INSTR_R_TRAP, 0, 0, 0x1D, 3);
+		s.R(INSTR_R_RDCTL, 0, 0, 19, 1);
+		s.R(INSTR_R_WRCTL, 0, 0, 0, 0);
+		// Unimplemented instructions
+		for(UINT i=0; i<COUNT(reserved_ops); i++)
+			s.I(reserved_ops[i], 1, 2, 0x1234);
+		for(UINT i=0; i<COUNT(reserved_opxs); i++)
+			s.R(reserved_opxs[i], 1, 2, 20);
+		streams.push_back(s);
+	}
+
+	{
+		Stream s("writes to r0", 9);
+
+		s.regs[1] = 0x12345678;
+		s.I(INSTR_ADDI, 1, 0, 5);
+		s.R(INSTR_R_ADD, 1, 1, 0);
+		s.I(INSTR_LDW, R_DATA, 0, 0);
+		s.R(INSTR_R_NEXTPC, 0, 0, 0);
+		s.R(INSTR_R_ADD, 0, 0, 14);
+		streams.push_back(s);
+	}
+
+	{
+		Stream s("misaligned load", 10);
+
+		s.I(INSTR_LDW, R_DATA, 14, 2);
+		s.I(INSTR_ADDI, 15, 15, 1);
+		streams.push_back(s);
+	}
+
+	{
+		Stream s("misaligned store", 11);
+
+		s.regs[1] = 0x1234;
+		s.I(INSTR_STH, R_DATA, 1, 1);
+		s.I(INSTR_ADDI, 15, 15, 1);
+		streams.push_back(s);
+	}
+}
+
+/*
+ *	RandomStream()
+ *
+ *  Generates a stream of random instructions with random initial registers. Loads and stores
+ *  stay inside the data memory and branches only go forward, so the stream always ends.
+ *
+ *	Parameters: seed - The seed of the stream
+ *				length - The number of instructions
+ */
+static Stream RandomStream(UINT seed, UINT length)
+{
+	char name[32];
+	UINT state, a, b, c, op;
+
+	snprintf(name, sizeof(name), "random %u", seed);
+	Stream s(name, seed);
+
+	state = seed * 2654435761U ^ 0x9E3779B9;
+	if(!state)
+		state = 1;
+
+	// Half of the registers start with values from the corner cases
+	for(UINT r=1; r<=R_LAST_DEST; r++)
+		s.regs[r] = (Random(state) & 1) ? values[Random(state) % NUM_VALUES] : Random(state);
+
+	while(s.code.size() < length)
+	{
+		a = Random(state) % (R_DATA + 1);
+		b = Random(state) % (R_DATA + 1);
+		c = 1 + Random(state) % R_LAST_DEST;
+
+		switch(Random(state) % 16)
+		{
+		case 0: case 1: case 2: case 3: case 4:
+			s.R(r_ops[Random(state) % COUNT(r_ops)], a, b, c);
+			break;
+		case 5:
+			s.R(shift_ops[Random(state) % COUNT(shift_ops)], a, 0, c, Random(state));
+			break;
+		case 6: case 7: case 8:
+			s.I(i_ops[Random(state) % COUNT(i_ops)], a, c, (Random(state) & 1) ? values[Random(state) % NUM_VALUES] : Random(state));
+			break;
+		case 9: case 10:
+			op = load_ops[Random(state) % COUNT(load_ops)];
+			s.I(op, R_DATA, c, Random(state) % (DATA_SIZE / ACCESS_SIZE(op)) * ACCESS_SIZE(op));
+			break;
+		case 11:
+			op = store_ops[Random(state) % COUNT(store_ops)];
+			s.I(op, R_DATA, b, Random(state) % (DATA_SIZE / ACCESS_SIZE(op)) * ACCESS_SIZE(op));
+			break;
+		case 12:
+			s.I(branch_ops[Random(state) % COUNT(branch_ops)], a, b, (Random(state) % 8) * 4);
+			break;
+		case 13:
+			switch(Random(state) % 6)
+			{
+			case 0: s.R(INSTR_R_NEXTPC, 0, 0, c); break;
+			case 1: s.R(INSTR_R_RDCTL, 0, 0, c, Random(state) % 2); break;
+			case 2: s.R(INSTR_R_WRCTL, a, 0, 0, Random(state) % 2); break;
+			case 3: s.R(INSTR_R_FLUSHP, 0, 0, 0); break;
+			case 4: s.R(INSTR_R_SYNC, 0, 0, 0); break;
+			case 5: s.I(INSTR_FLUSHDA, R_DATA, 0, Random(state) % DATA_SIZE); break;
+			}
+			break;
+		case 14:
+			s.R(INSTR_R_TRAP, 0, 0, 0x1D, 3);
+			break;
+		case 15:
+			if(Random(state) & 1)
+				s.I(reserved_ops[Random(state) % COUNT(reserved_ops)], a, b, Random(state));
+			else
+				s.R(reserved_opxs[Random(state) % COUNT(reserved_opxs)], a, b, c);
+			break;
+		}
+	}
+	return s;
+}
+
+/*
+ *	Quit()
+ *
+ *  Quits the simulation thread, which must be done before main_system is destroyed
+ *
+ *	Parameters: status - The exit status
+ *
+ *	Returns:	The exit status
+ */
+static int Quit(int status)
+{
+	main_system.CloseSimulationThread();
+	return status;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *sdf = "conformance/conformance.sdf";
+	const char *record = NULL, *compare = NULL;
+	UINT seed = 1, num_random = 2000, length = 64;
+	vector<Stream> streams;
+	unsigned long long instructions = 0;
+	UINT divergences = 0, golden_mismatches = 0;
+	FILE *golden = NULL;
+
+	for(int i=1; i<argc; i++)
+	{
+		if(!strcmp(argv[i], "--sdf") && i+1 < argc)
+			sdf = argv[++i];
+		else if(!strcmp(argv[i], "--seed") && i+1 < argc)
+			seed = strtoul(argv[++i], NULL, 0);
+		else if(!strcmp(argv[i], "--streams") && i+1 < argc)
+			num_random = strtoul(argv[++i], NULL, 0);
+		else if(!strcmp(argv[i], "--length") && i+1 < argc)
+			length = strtoul(argv[++i], NULL, 0);
+		else if(!strcmp(argv[i], "--record") && i+1 < argc)
+			record = argv[++i];
+		else if(!strcmp(argv[i], "--compare") && i+1 < argc)
+			compare = argv[++i];
+		else
+		{
+			fprintf(stderr, "Usage: %s [--sdf <file>] [--seed <n>] [--streams <n>] [--length <n>] [--record <file> | --compare <file>]\n", argv[0]);
+			return Quit(2);
+		}
+	}
+
+	try
+	{
+		main_system.LoadSystemDescriptionFile(sdf);
+	}
+	catch(const ParsingError& e)
+	{
+		fprintf(stderr, "%s\n", e.msg.c_str());
+		return Quit(2);
+	}
+	catch(const FileDoesNotExistError& e)
+	{
+		fprintf(stderr, "The file '%s' does not exist!\n", e.path.c_str());
+		return Quit(2);
+	}
+
+	// The golden trace starts with the parameters of the random streams
+	if(record)
+	{
+		golden = fopen(record, "w");
+		if(golden)
+			fprintf(golden, "niisim conformance trace %u %u %u\n", seed, num_random, length);
+	}
+	else if(compare)
+	{
+		golden = fopen(compare, "r");
+		if(golden && fscanf(golden, "niisim conformance trace %u %u %u\n", &seed, &num_random, &length) != 3)
+		{
+			fprintf(stderr, "%s is not a conformance trace\n", compare);
+			return Quit(2);
+		}
+	}
+	if((record || compare) && !golden)
+	{
+		fprintf(stderr, "Could not open %s\n", record ? record : compare);
+		return Quit(2);
+	}
+
+	DirectedStreams(streams);
+	for(UINT i=0; i<num_random; i++)
+		streams.push_back(RandomStream(seed + i, length));
+
+	for(UINT i=0; i<streams.size(); i++)
+	{
+		Result result = Run(streams[i], golden != NULL);
+
+		instructions += result.steps;
+
+		if(result.diverged)
+		{
+			divergences++;
+			printf("Stream \"%s\" diverges after %u instructions, at %s\n%s", streams[i].name.c_str(), result.steps,
+				Disassemble(result.pc, result.instr).c_str(), result.message.c_str());
+
+			Stream reproducer = Minimize(streams[i], result.instr);
+			printf("Reproducer, %u instructions:\n", (UINT)reproducer.code.size());
+			PrintStream(reproducer);
+			printf("\n");
+		}
+
+		if(record)
+		{
+			fprintf(golden, "stream %u %u %08X\n", i, (UINT)result.trace.size(), result.memory_hash);
+			for(UINT j=0; j<result.trace.size(); j++)
+				fprintf(golden, "%08X %08X\n", result.trace[j].first, result.trace[j].second);
+		}
+		else if(compare)
+		{
+			UINT index, steps, memory_hash, pc, hash, mismatch = ~0U;
+
+			if(fscanf(golden, "stream %u %u %X\n", &index, &steps, &memory_hash) != 3 || index != i)
+			{
+				fprintf(stderr, "%s ends before stream \"%s\"\n", compare, streams[i].name.c_str());
+				return Quit(2);
+			}
+			for(UINT j=0; j<steps; j++)
+			{
+				if(fscanf(golden, "%X %X\n", &pc, &hash) != 2)
+				{
+					fprintf(stderr, "%s is truncated\n", compare);
+					return Quit(2);
+				}
+				if(mismatch == ~0U && (j >= result.trace.size() || result.trace[j].first != pc || result.trace[j].second != hash))
+					mismatch = j;
+			}
+			if(mismatch == ~0U && steps != result.trace.size())
+				mismatch = steps;
+
+			if(mismatch != ~0U)
+			{
+				golden_mismatches++;
+				printf("Stream \"%s\" differs from the golden trace after %u instructions", streams[i].name.c_str(), mismatch + 1);
+				if(mismatch < result.trace.size())
+					printf(", at 0x%08X", result.trace[mismatch].first);
+				printf("\n");
+			}
+			else if(memory_hash != result.memory_hash)
+			{
+				golden_mismatches++;
+				printf("Stream \"%s\" ends with other data memory than the golden trace\n", streams[i].name.c_str());
+			}
+		}
+	}
+
+	if(golden)
+		fclose(golden);
+
+	printf("%u streams, %llu instructions, %u diverged from the reference model", (UINT)streams.size(), instructions, divergences);
+	if(compare)
+		printf(", %u differed from the golden trace", golden_mismatches);
+	printf("\n");
+
+	return Quit(divergences || golden_mismatches ? 1 : 0);
+}
@@ -27,10 +27,10 @@ data structure, which can be written to a string with the DumpDisasm function.
 
 */
 
-#include "CCpu.h"
+#include <cstdio>
+#include "instructions.h"
 
 typedef unsigned int uint;
-typedef unsigned long long int uint64;
 
 
 enum
@@ -57,19 +57,19 @@ struct Disasm
 	Operand ops[4];
 };
 
-static const char* i_instructions[] = {
-	"call", "jmpi", NULL, "ldbu", "addi", "stb", "br", "ldb", "cmpgei", NULL, NULL, "ldhu", "andi", "sth", "bge", "ldh",
-	"cmplti", NULL, NULL, "initda", "ori", "stw", "blt", "ldw", "cmpnei", NULL, NULL, "flushda", "xori", NULL, "bne", NULL,
-	"cmpeqi", NULL, NULL, "ldbuio", "muli", "stbio", "beq", "ldbio", "cmpgeui", NULL, NULL, "ldhuio", "andhi", "sthio", "bgeu", "ldhio",
-	"cmpltui", NULL, "custom", "initd", "orhi", "stwio", "bltu", "ldwio", "rdprs", NULL, "R", "flushd", "xorhi", NULL, NULL, NULL
+// The mnemonic and the operand format of an encoding
+struct InstructionFormat
+{
+	const char *mnemonic;
+	int format;
 };
 
-static const char* r_instructions[] = {
-	NULL, "eret", "roli", "rol", "flushp", "ret", "nor", "mulxuu", "cmpge", "bret", NULL, "ror", "flushi", "jmp", "and", NULL,
-	"cmplt", NULL, "slli", "sll", "wrprs", NULL, "or", "mulxsu", "cmpne", NULL, "srli", "srl", "nextpc", "callr", "xor", "mulxss",
-	"cmpeq", NULL, NULL, NULL, "divu", "div", "rdctl", "mul", "cmpgeu", "initi", NULL, NULL, NULL, "trap", "wrctl", NULL,
-	"cmpltu", "add", NULL, NULL, "break", NULL, "sync", NULL, NULL, "sub", "srai", "sra", NULL, NULL, NULL, NULL
-};
+#define INSTRUCTION_FORMAT(name, encoding, mnemonic, handler, timing, format) {mnemonic, FORMAT_##format},
+#define RESERVED_FORMAT(encoding) {NULL, FORMAT_NONE},
+
+static const InstructionFormat i_instructions[64] = { OP_INSTRUCTIONS(INSTRUCTION_FORMAT, RESERVED_FORMAT) };
+
+static const InstructionFormat r_instructions[64] = { OPX_INSTRUCTIONS(INSTRUCTION_FORMAT, RESERVED_FORMAT) };
 
 static const char* reg_names[32] = {
 	"r0", "at", "r2",  "r3",
@@ -173,135 +173,20 @@ Disasm DecompileInstruction(uint pc, uint instr)
 	uint rB = (instr >> 22) & 0x1F;
 	uint rC = (instr >> 17) & 0x1F;
 	
-	if(i_instructions[OP] == NULL)
-		FOUND_ILLEGAL;
+	const InstructionFormat *format = &i_instructions[OP];
 	
+	if(format->format == FORMAT_R_TYPE)
+		format = &r_instructions[OPX_1];
 	
-	if(OP == INSTR_R_TYPE)
-	{
-		const char *inst = r_instructions[OPX_1];
-		
-		const uint64 ABC0 = 0b0000101000000011000000011011000111001001110010010100100111001000ULL;
-		const uint64 A0CIMM5 = (1ULL<<INSTR_R_ROLI) | (1ULL<<INSTR_R_SLLI) | (1ULL<<INSTR_R_SRLI) | (1ULL<<INSTR_R_SRAI);
-		if((1ULL<<OPX_1) & ABC0)
-		{
-			if(OPX_2 != 0)
-				FOUND_ILLEGAL;
-			// Instruction is r_instructions[OPX_1] rC, rA, rB
-			return make_disasm(inst, make_op(OT_reg, rC), make_op(OT_reg, rA), make_op(OT_reg, rB));
-		}
-		else if((1ULL<<OPX_1) & A0CIMM5)
-		{
-			if(rB != 0)
-				FOUND_ILLEGAL;
-			// Instruction is r_instructions[OPX_1] rC, rA, OPX_2
-			return make_disasm(inst, make_op(OT_reg, rC), make_op(OT_reg, rA), make_op(OT_int, OPX_2));
-		}
-		else
-		{
-			switch(OPX_1)
-			{
-				case INSTR_R_ERET:
-					if(rA != 0x1d || rB != 0x1e || rC != 0 || OPX_2 != 0)
-						FOUND_ILLEGAL;
-					// Instruction is r_instructions[OPX_1]
-					return make_disasm(inst);
-					break;
-				case INSTR_R_FLUSHP:
-				case INSTR_R_SYNC:
-					if((rA | rB | rC | OPX_2) != 0)
-						FOUND_ILLEGAL;
-					// Instruction is r_instructions[OPX_1]
-					return make_disasm(inst);
-					break;
-				case INSTR_R_RET:
-					if(rA != 0x1f || (rB | rC | OPX_2) != 0)
-						FOUND_ILLEGAL;
-					// Instruction is r_instructions[OPX_1]
-					return make_disasm(inst);
-					break;
-				case INSTR_R_BRET:
-					if(rA != 0x1e || (rB | rC | OPX_2) != 0)
-						FOUND_ILLEGAL;
-					// Instruction is r_instructions[OPX_1]
-					return make_disasm(inst);
-					break;
-				case INSTR_R_FLUSHI:
-				case INSTR_R_JMP:
-				case INSTR_R_INITI:
-					if((rB | rC | OPX_2) != 0)
-						FOUND_ILLEGAL;
-					// Instruction is r_instruction[OPX_1] rA
-					return make_disasm(inst, make_op(OT_reg, rA));
-					break;
-				case INSTR_R_WRPRS:
-					if((rB | OPX_2) != 0)
-						FOUND_ILLEGAL;
-					// Instruction is r_instruction[OPX_1] rC, rA
-					return make_disasm(inst, make_op(OT_reg, rC), make_op(OT_reg, rA));
-					break;
-				case INSTR_R_NEXTPC:
-					if((rA | rB | OPX_2) != 0)
-						FOUND_ILLEGAL;
-					// Instruction is r_instruction[OPX_1] rC
-					return make_disasm(inst, make_op(OT_reg, rC));
-					break;
-				case INSTR_R_CALLR:
-					if((rB | OPX_2) != 0 || rC != 0x1f)
-						FOUND_ILLEGAL;
-					// Instruction is r_instruction[OPX_1] rA
-					return make_disasm(inst, make_op(OT_reg, rA));
-					break;
-				case INSTR_R_RDCTL:
-					if((rA | rB) != 0)
-						FOUND_ILLEGAL;
-					// Instruction is r_instruction[OPX_1] rC, ctlOPX_2
-					return make_disasm(inst, make_op(OT_reg, rC), make_op(OT_ctl_reg, OPX_2));
-					break;
-				case INSTR_R_TRAP:
-					if((rA | rB) != 0 || rC != 0x1d)
-						FOUND_ILLEGAL;
-					if(OPX_2 != 0)
-						// Instruction is r_instruction[OPX_1] OPX_2
-						return make_disasm(inst, make_op(OT_int, OPX_2));
-					else
-						// Instruction is r_instruction[OPX_1]
-						return make_disasm(inst);
-					break;
-				case INSTR_R_WRCTL:
-					if((rB | rC) != 0)
-						FOUND_ILLEGAL;
-					// Instruction is r_instruction[OPX_1] ctlOPX_2, rA
-					return make_disasm(inst, make_op(OT_ctl_reg, OPX_2), make_op(OT_reg, rA));
-					break;
-				case INSTR_R_BREAK:
-					if((rA | rB) != 0 || rC != 0x1e)
-						FOUND_ILLEGAL;
-					if(OPX_2 != 0)
-						// Instruction is r_instruction[OPX_1] OPX_2
-						return make_disasm(inst, make_op(OT_int, OPX_2));
-					else
-						// Instruction is r_instruction[OPX_1]
-						return make_disasm(inst);
-					break;
-				default:
-					FOUND_ILLEGAL;
-			}
-		}
-		
-		
-	}
-	else
+	const char *inst = format->mnemonic;
+	uint addr;
+	
+	switch(format->format)
 	{
-		const char *inst = i_instructions[OP];
-		
-		const uint64 store_load = 0b0000000010100000101010001010100000000000101000001010100010101000ULL;
-		if(OP == INSTR_CALL || OP == INSTR_JMPI)
-		{
-			// Instruction is i_instructions[OP] IMM26
+		case FORMAT_J:
+			// Instruction is inst IMM26
 			return make_disasm(inst, make_op(OT_address, IMM26<<2));
-		}
-		else if(OP == INSTR_CUSTOM)
+		case FORMAT_CUSTOM:
 		{
 			bool a = (instr>>16) & 1;
 			bool b = (instr>>15) & 1;
@@ -313,41 +198,103 @@ Disasm DecompileInstruction(uint pc, uint instr)
 				make_op(a ? OT_reg : OT_custom_reg, rA),
 				make_op(b ? OT_reg : OT_custom_reg, rB));
 		}
-		else if((OP & 3) == 0 && OP != INSTR_CALL)
-		{
-			// Instruction is i_instructions[OP] rB, rA, IMM16
+		case FORMAT_I_SIGNED:
+			// Instruction is inst rB, rA, IMM16
 			return make_disasm(inst, make_op(OT_reg, rB), make_op(OT_reg, rA), make_op(OT_int, (short)IMM16));
-		}
-		else if((1ULL<<OP) & store_load)
-		{
-			// Instruction is i_instructions[OP] rB, IMM16(rA)
+		case FORMAT_I_UNSIGNED:
+			// Instruction is inst rB, rA, IMM16
+			return make_disasm(inst, make_op(OT_reg, rB), make_op(OT_reg, rA), make_op(OT_int, IMM16));
+		case FORMAT_LOAD_STORE:
+			// Instruction is inst rB, IMM16(rA)
 			return make_disasm(inst, make_op(OT_reg, rB), make_op(OT_byte_offset, rA, (short)IMM16));
-		}
-		else if((OP & 0x07) == 0x06)
-		{
-			// Branch instruction
-			// FIXME should we check 4-byte alignment?
-			uint addr = pc + 4 + (short)IMM16;
-			if(OP == INSTR_BR)
-			{
-				if((rA | rB) != 0)
-					FOUND_ILLEGAL;
-				// Instruction is i_instructions[OP] label
-				return make_disasm(inst, make_op(OT_address, addr));
-			}
-			else
-			{
-				// Instruction is i_instructions[OP] rA, rB, label
-				return make_disasm(inst, make_op(OT_reg, rA), make_op(OT_reg, rB), make_op(OT_address, addr));
-			}
-		}
-		else
-		{
+		case FORMAT_CACHE:
 			if(rB != 0)
 				FOUND_ILLEGAL;
-			// Instruction is i_instructions[OP] IMM16(rA)
+			// Instruction is inst IMM16(rA)
 			return make_disasm(inst, make_op(OT_byte_offset, rA, (short)IMM16));
-		}
+		case FORMAT_BR:
+			// FIXME should we check 4-byte alignment?
+			addr = pc + 4 + (short)IMM16;
+			if((rA | rB) != 0)
+				FOUND_ILLEGAL;
+			// Instruction is inst label
+			return make_disasm(inst, make_op(OT_address, addr));
+		case FORMAT_BRANCH:
+			addr = pc + 4 + (short)IMM16;
+			// Instruction is inst rA, rB, label
+			return make_disasm(inst, make_op(OT_reg, rA), make_op(OT_reg, rB), make_op(OT_address, addr));
+		case FORMAT_R:
+			if(OPX_2 != 0)
+				FOUND_ILLEGAL;
+			// Instruction is inst rC, rA, rB
+			return make_disasm(inst, make_op(OT_reg, rC), make_op(OT_reg, rA), make_op(OT_reg, rB));
+		case FORMAT_R_IMM5:
+			if(rB != 0)
+				FOUND_ILLEGAL;
+			// Instruction is inst rC, rA, OPX_2
+			return make_disasm(inst, make_op(OT_reg, rC), make_op(OT_reg, rA), make_op(OT_int, OPX_2));
+		case FORMAT_R_ERET:
+			if(rA != 0x1d || rB != 0x1e || rC != 0 || OPX_2 != 0)
+				FOUND_ILLEGAL;
+			// Instruction is inst
+			return make_disasm(inst);
+		case FORMAT_R_NONE:
+			if((rA | rB | rC | OPX_2) != 0)
+				FOUND_ILLEGAL;
+			// Instruction is inst
+			return make_disasm(inst);
+		case FORMAT_R_RET:
+			if(rA != 0x1f || (rB | rC | OPX_2) != 0)
+				FOUND_ILLEGAL;
+			// Instruction is inst
+			return make_disasm(inst);
+		case FORMAT_R_BRET:
+			if(rA != 0x1e || (rB | rC | OPX_2) != 0)
+				FOUND_ILLEGAL;
+			// Instruction is inst
+			return make_disasm(inst);
+		case FORMAT_R_A:
+			if((rB | rC | OPX_2) != 0)
+				FOUND_ILLEGAL;
+			// Instruction is inst rA
+			return make_disasm(inst, make_op(OT_reg, rA));
+		case FORMAT_R_CA:
+			if((rB | OPX_2) != 0)
+				FOUND_ILLEGAL;
+			// Instruction is inst rC, rA
+			return make_disasm(inst, make_op(OT_reg, rC), make_op(OT_reg, rA));
+		case FORMAT_R_C:
+			if((rA | rB | OPX_2) != 0)
+				FOUND_ILLEGAL;
+			// Instruction is inst rC
+			return make_disasm(inst, make_op(OT_reg, rC));
+		case FORMAT_R_CALLR:
+			if((rB | OPX_2) != 0 || rC != 0x1f)
+				FOUND_ILLEGAL;
+			// Instruction is inst rA
+			return make_disasm(inst, make_op(OT_reg, rA));
+		case FORMAT_R_RDCTL:
+			if((rA | rB) != 0)
+				FOUND_ILLEGAL;
+			// Instruction is inst rC, ctlOPX_2
+			return make_disasm(inst, make_op(OT_reg, rC), make_op(OT_ctl_reg, OPX_2));
+		case FORMAT_R_TRAP:
+		case FORMAT_R_BREAK:
+			if((rA | rB) != 0 || rC != (format->format == FORMAT_R_TRAP ? 0x1d : 0x1e))
+				FOUND_ILLEGAL;
+			if(OPX_2 != 0)
+				// Instruction is inst OPX_2
+				return make_disasm(inst, make_op(OT_int, OPX_2));
+			else
+				// Instruction is inst
+				return make_disasm(inst);
+		case FORMAT_R_WRCTL:
+			if((rB | rC) != 0)
+				FOUND_ILLEGAL;
+			// Instruction is inst ctlOPX_2, rA
+			return make_disasm(inst, make_op(OT_ctl_reg, OPX_2), make_op(OT_reg, rA));
+		default:
+			FOUND_ILLEGAL;
 	}
 }
 
@@ -555,6 +555,64 @@ pair<pair<uint*, size_t>, uint> ELFReadSection(const char *filedata, const char
 	return make_pair(make_pair((uint*)NULL, 0), 0);
 }
 
+/*
+
+Reads the functions from the symbol table. Global labels in code sections are included as well,
+since assembly programs often don't mark their functions with .type.
+
+*/
+vector<ELFSymbol> ELFReadFunctionSymbols(const char *filedata)
+{
+	const Elf32_Ehdr *elf_header = (const Elf32_Ehdr*)filedata;
+	const Elf32_Shdr *section_headers = (const Elf32_Shdr*)(filedata + elf_header->e_shoff);
+	vector<ELFSymbol> ret;
+	
+	for(uint i=0; i<elf_header->e_shnum; i++){
+		if(section_headers[i].sh_type != SHT_SYMTAB)
+			continue;
+		
+		const Elf32_Sym *symbols = (const Elf32_Sym*)(filedata + section_headers[i].sh_offset);
+		const char *names = filedata + section_headers[section_headers[i].sh_link].sh_offset;
+		uint num_symbols = section_headers[i].sh_size / sizeof(Elf32_Sym);
+		
+		for(uint j=0; j<num_symbols; j++){
+			const Elf32_Sym& sym = symbols[j];
+			
+			if(sym.st_shndx == SHN_UNDEF || sym.st_shndx >= elf_header->e_shnum)
+				continue;
+			if(!(section_headers[sym.st_shndx].sh_flags & SHF_EXECINSTR))
+				continue;
+			if(ELF32_ST_TYPE(sym.st_info) != STT_FUNC &&
+			   !(ELF32_ST_TYPE(sym.st_info) == STT_NOTYPE && ELF32_ST_BIND(sym.st_info) == STB_GLOBAL))
+				continue;
+			
+			ELFSymbol s;
+			s.addr = sym.st_value;
+			s.size = sym.st_size;
+			s.name = names + sym.st_name;
+			ret.push_back(s);
+		}
+	}
+	
+	stable_sort(ret.begin(), ret.end());
+	return ret;
+}
+
+const ELFSymbol* FindFunctionSymbol(const vector<ELFSymbol>& symbols, uint addr)
+{
+	ELFSymbol key;
+	key.addr = addr;
+	
+	vector<ELFSymbol>::const_iterator it = upper_bound(symbols.begin(), symbols.end(), key);
+	if(it == symbols.begin())
+		return NULL;
+	--it;
+	// Labels without a size extend to the next symbol
+	if(it->size != 0 && addr - it->addr >= it->size)
+		return NULL;
+	return &*it;
+}
+
 static string concat_path(const char *base_path, const char *include_path, const char *filename)
 {
 	string ret;
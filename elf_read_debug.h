@@ -33,8 +33,21 @@ struct DebugInfo {
 	uint GetNearestPrecedingAddrWithSourceInformation(uint addr);
 };
 
+// A function in the symbol table
+struct ELFSymbol {
+	uint addr;
+	uint size;
+	string name;
+	
+	bool operator<(const ELFSymbol& other) const { return addr < other.addr; }
+};
+
 // <<instructions, num_instructions>, base_addr>
 pair<pair<uint*, size_t>, uint> ELFReadSection(const char *filedata, const char *section_name);
+// Function symbols sorted by address
+vector<ELFSymbol> ELFReadFunctionSymbols(const char *filedata);
+// The function containing addr, or NULL if there is none
+const ELFSymbol* FindFunctionSymbol(const vector<ELFSymbol>& symbols, uint addr);
 void BuildDebugInfo(DebugInfo& debug_info, const char *filedata);
 
 #endif
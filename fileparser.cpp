@@ -20,6 +20,7 @@ along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include "fileparser.h"
 #include "CFile.h"
@@ -36,14 +37,14 @@ along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
  *
  *	Returns:	True if the conversion was successful. False if it failed.
  */
-static bool HexToInt(const char *hex, int len, int *number)
+static bool HexToInt(const char *hex, int len, UINT *number)
 {
 	int shift = 0;
 
 	*number = 0;
 
-	// Return false if the hex string had more than 8 characters in it
-	if(len > 8)
+	// Return false if the hex string had more than 8 characters in it, or none
+	if(len > 8 || len == 0)
 		return false;
 
 	// Loop through all digits in the hex string, starting with the least significant one
@@ -52,17 +53,17 @@ static bool HexToInt(const char *hex, int len, int *number)
 		// Check for numbers 0-9
 		if(hex[i] >= '0' && hex[i] <= '9')
 		{
-			*number += ((int)(hex[i] - '0')) << shift;
+			*number += ((UINT)(hex[i] - '0')) << shift;
 		}
 		// Check for lower case A-F
 		else if(hex[i] >= 'a' && hex[i] <= 'f')
 		{
-			*number += ((int)(hex[i] - 'a' + 10)) << shift;
+			*number += ((UINT)(hex[i] - 'a' + 10)) << shift;
 		}
 		// Check for upper case A-F
 		else if(hex[i] >= 'A' && hex[i] <= 'F')
 		{
-			*number += ((int)(hex[i] - 'A' + 10)) << shift;
+			*number += ((UINT)(hex[i] - 'A' + 10)) << shift;
 		}
 		else
 		{
@@ -79,125 +80,250 @@ static bool HexToInt(const char *hex, int len, int *number)
 	return true;
 }
 
-struct ParsingSyntaxError
+/*
+ *	DecToInt()
+ *
+ *  Converts a decimal string to an integer.
+ *
+ *  Paramters:	dec - The string which contains the decimal number
+ *				len - The length of the string which contains the decimal number
+ *				number - A pointer to an integer which will hold the result.
+ *
+ *	Returns:	True if the conversion was successful. False if the string has other characters than digits
+ *				or the number doesn't fit in 32 bits.
+ */
+static bool DecToInt(const char *dec, int len, UINT *number)
+{
+	*number = 0;
+
+	for(int i=0; i<len; i++)
+	{
+		if(dec[i] < '0' || dec[i] > '9' || *number > (0xFFFFFFFF - (dec[i] - '0')) / 10)
+			return false;
+		*number = *number * 10 + (dec[i] - '0');
+	}
+
+	return true;
+}
+
+/*
+ *  ParsingError::ParsingError()
+ *
+ *  Creates an error at a position in a file. The message is prefixed with file:line:column.
+ */
+ParsingError::ParsingError(const string& file, int line, int column, const string& str) : file(file), line(line), column(column)
 {
-	int line_number;
-	string msg;
-	ParsingSyntaxError(int line_number, string msg) : line_number(line_number), msg(msg) {}
-};
+	char location[32];
+
+	if(column > 0)
+		sprintf(location, ":%d:%d: ", line, column);
+	else
+		sprintf(location, ":%d: ", line);
+	msg = file + location + str;
+}
 
 /*
- *  ParseFile()
+ *  ParsedFile::ParsedFile()
  *
- *  Parses a description file. Each line is translated to a pair<Keyword, arguments <token type, content>>.
- *  If an integer is found, its string representation in decimal format is stored.
- *  Comments (lines starting with //) are ignored.
+ *  Reads and parses a description file.
  *
- *  Throws a ParsingSyntaxError on syntax error.
+ *  Throws a ParsingError on syntax error, and a FileDoesNotExistError if the file isn't found.
  */
-vector<pair<string, vector<pair<int, string> > > > ParseFile(const char *filename)
+ParsedFile::ParsedFile(const char *filename) : filename(filename)
 {
-	string in_line;
-	const char *line;
-	vector<pair<string, vector<pair<int, string> > > > out;
-	pair<string, vector<pair<int, string> > > *cur_out;
-	int line_number, i, j;
-	int number;
-	char buf[32];
-	
-	// Free the string on next line input, on throwing an error, or returning from the function
-	struct FreeString
+	CFile file(filename);
+	char *p = NULL;
+	size_t len = 0;
+
+	text = NULL;
+
+	// Files on disk are mapped, embedded resources are copied
+	mapped_file = file.map_whole_file();
+	if(mapped_file)
 	{
-		char *str;
-		~FreeString(){ g_free(str); }
-		char *operator=(char *s){ g_free(str); return str = s; }
-	} _; _.str = NULL;
-	
-	// Open the file
-	CFile ifs(filename);
-	
-	// Go through each line
-	while((line = _ = ifs.read_line()) != NULL)
+		p = g_mapped_file_get_contents(mapped_file);
+		len = g_mapped_file_get_length(mapped_file);
+	}
+	else
 	{
-		i = 0;
-		
-		// Skip empty lines, line breaks and comments
-		if(!line[0] || (line[0] == '/' && line[1] == '/') || line[0] == '\r' || line[0] == '\n')
-			continue;
-		
-		out.push_back(pair<string, vector<pair<int, string> > >());
-		cur_out = &out.back();
-		
-		// Find keyword
-		while((line[i] >= 'a' && line[i] <= 'z') ||
-			  (line[i] >= 'A' && line[i] <= 'Z'))
-		{
-			i++;
-		}
-		
-		if(line[i] == ' ')
-		{
-			cur_out->first.assign(line, i);
-		}
-		else
+		pair<char*, size_t> data = file.read_whole_file();
+		p = text = data.first;
+		len = data.second;
+	}
+
+	// The destructor isn't called if the constructor throws
+	try
+	{
+		Tokenize(p, p + len);
+	}
+	catch(...)
+	{
+		Free();
+		throw;
+	}
+}
+
+ParsedFile::~ParsedFile()
+{
+	Free();
+}
+
+void ParsedFile::Free()
+{
+	if(mapped_file)
+		g_mapped_file_unref(mapped_file);
+	free(text);
+	mapped_file = NULL;
+	text = NULL;
+}
+
+/*
+ *  ParsedFile::Tokenize()
+ *
+ *  Splits the text into commands and arguments and converts the numbers.
+ *  The keywords and strings are terminated in place.
+ *
+ *	Paramters:	p - The start of the text
+ *				end - The end of the text
+ */
+void ParsedFile::Tokenize(char *p, char *end)
+{
+	int line = 1;
+
+	while(p < end)
+	{
+		char *line_start = p;
+		ParsedCommand command;
+		bool expect_argument = false;
+
+		while(p < end && (*p == ' ' || *p == '\t'))
+			p++;
+
+		// Skip empty lines and comments
+		if(p == end || *p == '\r' || *p == '\n' || (*p == '/' && p+1 < end && p[1] == '/'))
 		{
-			throw ParsingSyntaxError(line_number, "Expected keyword");
+			while(p < end && *p != '\n')
+				p++;
+			if(p < end)
+				p++;
+			line++;
+			continue;
 		}
-		
-		line = &line[i+1];
-		i = 0;
-		
+
+		// Find keyword
+		command.keyword = p;
+		command.line = line;
+		command.first_arg = arguments.size();
+		while(p < end && ((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z')))
+			p++;
+		if(p == command.keyword || p == end || (*p != ' ' && *p != '\t'))
+			throw ParsingError(filename, line, p - line_start + 1, "Expected keyword");
+		*p++ = '\0';
+
+		// The arguments, separated by commas
 		for(;;)
 		{
-			while(line[i] == ' ' || line[i] == '\t')
-			{
-				i++;
-			}
-			line = &line[i];
-			i = 0;
-			
-			while(line[i] != ',' && line[i] != '\r' && line[i] != '\0')
+			ParsedArgument arg;
+
+			while(p < end && (*p == ' ' || *p == '\t'))
+				p++;
+			if(p == end || *p == '\r' || *p == '\n')
 			{
-				i++;
-			}
-			
-			if(i == 0)
+				if(expect_argument)
+					throw ParsingError(filename, line, p - line_start + 1, "Expected an argument after the comma");
 				break;
-			
-			if(line[0] == '\"' && line[i-1] == '\"')
+			}
+
+			arg.column = p - line_start + 1;
+			if(*p == '\"')
 			{
-				cur_out->second.push_back(pair<int, string>(TOKEN_STRING, string(&line[1], i-2)));
+				arg.type = TOKEN_STRING;
+				arg.number = 0;
+				arg.str = ++p;
+				while(p < end && *p != '\"' && *p != '\r' && *p != '\n')
+					p++;
+				if(p == end || *p != '\"')
+					throw ParsingError(filename, line, arg.column, "Missing the closing quote of the string");
+				*p++ = '\0';
 			}
-			else if(line[0] >= '0' && line[0] <= '9')
+			else if(*p >= '0' && *p <= '9')
 			{
+				char *number = p;
+				bool valid;
+
+				arg.type = TOKEN_NUMBER;
+				arg.str = NULL;
+				while(p < end && ((*p >= '0' && *p <= '9') || (*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z')))
+					p++;
+
 				// Check for 0x which indicates a hex number
-				if(line[0] == '0' && line[1] == 'x')
+				if(p - number > 1 && number[0] == '0' && number[1] == 'x')
 				{
-					if(HexToInt(&line[2], i-2, &number) == false)
-					{
-						throw ParsingSyntaxError(line_number, "Invalid hexadecimal integer");
-					}
-					sprintf(buf, "%d", number);
-					cur_out->second.push_back(pair<int, string>(TOKEN_NUMBER, string(buf)));
+					valid = HexToInt(number + 2, p - number - 2, &arg.number);
+					if(!valid)
+						throw ParsingError(filename, line, arg.column, "Invalid hexadecimal integer");
 				}
 				else
 				{
-					for(j=1; j<i; j++)
-						if(line[j] < '0' || line[j] > '9')
-							throw ParsingSyntaxError(line_number, "Invalid integer");
-					cur_out->second.push_back(pair<int, string>(TOKEN_NUMBER, string(line, i)));
+					valid = DecToInt(number, p - number, &arg.number);
+					if(!valid)
+						throw ParsingError(filename, line, arg.column, "Invalid integer");
 				}
 			}
-			
-			if(line[i] == ',')
+			else
 			{
-				i++;
+				throw ParsingError(filename, line, arg.column, "Expected a number or a string");
 			}
+			arguments.push_back(arg);
+
+			// A comma or the end of the line follows
+			while(p < end && (*p == ' ' || *p == '\t'))
+				p++;
+			if(p == end || *p == '\r' || *p == '\n')
+				break;
+			if(*p != ',')
+				throw ParsingError(filename, line, p - line_start + 1, "Expected a comma");
+			p++;
+			expect_argument = true;
 		}
-		
-		line_number++;
+
+		commands.push_back(command);
+
+		// Skip the line break
+		while(p < end && *p != '\n')
+			p++;
+		if(p < end)
+			p++;
+		line++;
 	}
-	return out;
+
+	// The arguments don't move any more
+	for(size_t i=0; i<commands.size(); i++)
+	{
+		size_t next = i+1 < commands.size() ? commands[i+1].first_arg : arguments.size();
+		commands[i].args = ParsedRowArguments(arguments.empty() ? NULL : &arguments[commands[i].first_arg], next - commands[i].first_arg);
+	}
+}
+
+/*
+ *  ParsedFile::Error()
+ *
+ *  Creates an error at a command, or at one of its arguments
+ *
+ *	Paramters:	command - The command with the error
+ *				arg - The argument with the error
+ *				msg - The error message
+ *
+ *	Returns:	The error, with the file name and the line of the command
+ */
+ParsingError ParsedFile::Error(const ParsedCommand& command, const string& msg) const
+{
+	return ParsingError(filename, command.line, 0, msg);
+}
+
+ParsingError ParsedFile::Error(const ParsedCommand& command, const ParsedArgument& arg, const string& msg) const
+{
+	return ParsingError(filename, command.line, arg.column, msg);
 }
 
 /*
@@ -234,7 +360,7 @@ bool ArgsMatches(const ParsedRowArguments& args, const char *pattern)
 	
 	for(size_t i=0; i<args.size(); i++)
 	{
-		if(args[i].first != apattern[i])
+		if(args[i].type != apattern[i])
 			return false;
 	}
 	
@@ -248,12 +374,17 @@ bool ArgsMatches(const ParsedRowArguments& args, const char *pattern)
 #include <iostream>
 
 int main(int argc, char *argv[]){
-	vector<pair<string, vector<pair<int, string> > > > input = ParseFile(argv[1]);
+	ParsedFile input(argv[1]);
 	
-	for(int i=0; i<input.size(); i++){
-		cout << input[i].first << ": ";
-		for(int j=0; j<input[i].second.size(); j++){
-			cout << input[i].second[j].first << '.' << input[i].second[j].second << "; ";
+	for(size_t i=0; i<input.commands.size(); i++){
+		const ParsedRowArguments& args = input.commands[i].args;
+		cout << input.commands[i].keyword << ": ";
+		for(size_t j=0; j<args.size(); j++){
+			cout << args[j].type << '.';
+			if(args[j].type == TOKEN_STRING)
+				cout << args[j].str << "; ";
+			else
+				cout << args[j].number << "; ";
 		}
 		cout << endl;
 	}
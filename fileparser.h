@@ -25,6 +25,8 @@ along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
 #include <vector>
 #include <string>
 #include <utility>
+#include <glib.h>
+#include "types.h"
 
 using namespace std;
 
@@ -33,11 +35,79 @@ using namespace std;
 #define TOKEN_NUMBER	2
 #define TOKEN_STRING	3
 
-// <Keyword, arguments <token type, content>>
-typedef vector<pair<string, vector<pair<int, string> > > > ParsedFile;
-typedef vector<pair<int, string> > ParsedRowArguments;
+// An error in a description file. The message starts with the file name and the line and column of the error.
+struct ParsingError
+{
+	string msg;
+	string file;	// The file with the error, empty if it isn't known
+	int line;		// The line of the error, from 1, or 0 if it isn't known
+	int column;		// The column of the error, from 1, or 0 if it isn't known
+	ParsingError(const string& str) : msg(str), line(0), column(0) {}
+	ParsingError(const string& file, int line, int column, const string& str);
+};
+
+// An argument of a command
+struct ParsedArgument
+{
+	int type;			// TOKEN_NUMBER or TOKEN_STRING
+	UINT number;		// The value of a number
+	const char *str;	// The text of a string, without the quotes. NULL for numbers.
+	int column;			// The column the argument starts at, from 1
+};
+
+// The arguments of a command, a range of the arguments of the whole file
+class ParsedRowArguments
+{
+	const ParsedArgument *args;
+	size_t count;
+public:
+	ParsedRowArguments() : args(NULL), count(0) {}
+	ParsedRowArguments(const ParsedArgument *args, size_t count) : args(args), count(count) {}
+	
+	size_t size() const { return count; }
+	const ParsedArgument& operator[](size_t i) const { return args[i]; }
+};
+
+// A line with a command
+struct ParsedCommand
+{
+	const char *keyword;		// The name of the command
+	int line;					// The line of the command, from 1
+	size_t first_arg;			// Index of the first argument in ParsedFile::arguments
+	ParsedRowArguments args;	// The arguments
+};
+
+/*
+ *  A parsed description file. Each line is a keyword followed by arguments separated by commas,
+ *  which are integers in decimal or hexadecimal (0x) format or strings in double quotes.
+ *  Comments (lines starting with //) are ignored.
+ *
+ *  The file is read in one pass. The keywords and strings are terminated in place in the text of the
+ *  file, which is kept as long as the ParsedFile exists, so there is no allocation per token.
+ */
+class ParsedFile
+{
+	GMappedFile *mapped_file;			// The file, mapped copy-on-write so the text can be changed
+	char *text;							// A copy of the file when it can't be mapped, like an embedded resource
+	vector<ParsedArgument> arguments;	// The arguments of all commands
+	
+	void Tokenize(char *p, char *end);
+	void Free();
+	
+	// Not copyable, the commands point into the text
+	ParsedFile(const ParsedFile&);
+	ParsedFile& operator=(const ParsedFile&);
+public:
+	string filename;
+	vector<ParsedCommand> commands;		// The commands in the order of the file
+	
+	ParsedFile(const char *filename);
+	~ParsedFile();
+	
+	ParsingError Error(const ParsedCommand& command, const string& msg) const;
+	ParsingError Error(const ParsedCommand& command, const ParsedArgument& arg, const string& msg) const;
+};
 
-ParsedFile ParseFile(const char *filename);
 bool ArgsMatches(const ParsedRowArguments& args, const char *pattern);
 
 #endif
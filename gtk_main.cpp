@@ -26,7 +26,7 @@ along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "CDebug.h"
 #include "CCpu.h"
-#include "sim.h"
+#include "gui.h"
 #include "CFile.h"
 
 // Exported variables
@@ -39,7 +39,7 @@ CDebug main_debug; // The debug window
 
 GtkTreeView *reg_tree_view;
 GtkListStore *reg_list_store;
-GtkTreeIter reg_iters[19];
+GtkTreeIter reg_iters[22];
 GtkCellRendererText *col_right_regs;
 
 GtkWidget *main_window;
@@ -66,6 +66,9 @@ GtkCheckMenuItem *trace_menu_toggle;
 GtkToggleToolButton *trace_button;
 
 static string last_elf_file;
+static string input_script_file;	// Input script given on the command line, loaded with every .sdf file
+static string wave_file;			// VCD file given on the command line, recorded for every .sdf file
+static bool register_list_created;	// The rows of the register window are created when it is first shown
 
 extern "C" G_MODULE_EXPORT void MenuStop(gpointer sender, gpointer user_data);
 
@@ -82,7 +85,7 @@ static void InitRegisterListView()
 	
 	const char* text = "";
 	
-	for(int i=0; i<19; i++)
+	for(int i=0; i<22; i++)
 	{
 		if (i < 16)
 			text = reg_names[i];
@@ -92,15 +95,21 @@ static void InitRegisterListView()
 			text = "ienable";
 		else if (i == 18)
 			text = "pc";
+		else if (i == 19)
+			text = "icache hits";
+		else if (i == 20)
+			text = "dcache hits";
+		else if (i == 21)
+			text = "writebacks";
 		
 		gtk_list_store_append(reg_list_store, &reg_iters[i]);
 		gtk_list_store_set(reg_list_store, &reg_iters[i],
 			0, text,
-			1, "0x00000000",
+			1, i < 19 ? "0x00000000" : "-",
 			-1);
 		
 	}
-	for(int i=0; i<18; i++)
+	for(int i=0; i<22; i++)
 	{
 		if (i < 16)
 			text = reg_names[i+16];
@@ -108,14 +117,51 @@ static void InitRegisterListView()
 			text = "estatus";
 		else if (i == 17)
 			text = "ipending";
+		else if (i == 18)
+			continue;
+		else if (i == 19)
+			text = "icache misses";
+		else if (i == 20)
+			text = "dcache misses";
+		else if (i == 21)
+			text = "bypasses";
 		
 		gtk_list_store_set(reg_list_store, &reg_iters[i],
 			2, text,
-			3, "0x00000000",
+			3, i < 19 ? "0x00000000" : "-",
 			-1);
 	}
 }
 
+/*
+ *	update_cache_rows()
+ *
+ *  Updates the hit and miss statistics of a cache in the register list view
+ *
+ *	Parameters: cache - The cache, or NULL if the cpu has none
+ *				row - The row for the hits and misses
+ */
+static void update_cache_rows(CCache *cache, int row)
+{
+	char hits[32], misses[16];
+	UINT total_hits, total_misses;
+
+	if(!cache)
+		return;
+
+	const CacheStats& stats = cache->GetStats();
+	total_hits = stats.read_hits + stats.write_hits;
+	total_misses = stats.read_misses + stats.write_misses;
+
+	if(total_hits + total_misses)
+		sprintf(hits, "%u (%.1f%%)", total_hits, 100.0 * total_hits / ((double)total_hits + total_misses));
+	else
+		sprintf(hits, "%u", total_hits);
+	sprintf(misses, "%u", total_misses);
+
+	gtk_list_store_set(reg_list_store, &reg_iters[row], 1, hits, 3, misses, -1);
+}
+
 /*
  *	update_register_window()
  *
@@ -159,6 +205,18 @@ static void update_register_window()
 		// pc
 		sprintf(text, "0x%.8X", cpu->GetPC());
 		gtk_list_store_set(reg_list_store, &reg_iters[18], 1, text, -1);
+
+		// Cache statistics
+		update_cache_rows(cpu->GetInstructionCache(), 19);
+		update_cache_rows(cpu->GetDataCache(), 20);
+		if(cpu->GetDataCache())
+		{
+			sprintf(text, "%u", cpu->GetDataCache()->GetStats().writebacks);
+			gtk_list_store_set(reg_list_store, &reg_iters[21], 1, text, -1);
+
+			sprintf(text, "%u", cpu->GetDataCache()->GetStats().bypasses);
+			gtk_list_store_set(reg_list_store, &reg_iters[21], 3, text, -1);
+		}
 	}
 }
 
@@ -203,6 +261,11 @@ static void open_sdf_file(const char* filename)
 	{
 		main_system.LoadSystemDescriptionFile(filename);
 		main_system.Reset();
+		if(!wave_file.empty() && !main_system.StartRecordingWaves(wave_file.c_str()))
+			ShowErrorMessage(("Could not create " + wave_file).c_str());
+		// Loaded last, so the system is already reset if the script has an error
+		if(!input_script_file.empty())
+			main_system.LoadInputScript(input_script_file.c_str());
 	}
 	catch(const ParsingError& err)
 	{
@@ -214,6 +277,10 @@ static void open_sdf_file(const char* filename)
 		//puts(err.msg.c_str());
 		ShowErrorMessage(err.msg.c_str());
 	}
+	catch(const FileDoesNotExistError& err)
+	{
+		ShowErrorMessage(("File not found: " + err.path).c_str());
+	}
 }
 
 /*
@@ -231,7 +298,8 @@ void edited(GtkCellRendererText *renderer, gchar* path, gchar* new_text, gpointe
 	int col = (renderer == col_right_regs)*2+1;
 	int row = atoi(path);
 	
-	if(col == 3 && row == 18)
+	// The pc has no right column and the cache statistics can't be edited
+	if((col == 3 && row == 18) || row >= 19)
 		return;
 	
 	int val = 0;
@@ -385,6 +453,41 @@ void MenuGenerateTraceFile(gpointer sender, gpointer user_data)
 	avoid_recursion_state = false;
 }
 
+G_MODULE_EXPORT
+void MenuSaveInstructionTrace(gpointer sender, gpointer user_data)
+{
+	GtkWidget *dialog;
+	
+	if(!main_system.IsELFFileLoaded())
+	{
+		ShowErrorMessage("No .elf file loaded.");
+		return;
+	}
+	
+	dialog = gtk_file_chooser_dialog_new("Save Instruction Trace",
+		GTK_WINDOW(main_window),
+		GTK_FILE_CHOOSER_ACTION_SAVE,
+		GTK_STOCK_CANCEL, GTK_RESPONSE_CANCEL,
+		GTK_STOCK_SAVE, GTK_RESPONSE_ACCEPT,
+		NULL);
+	
+	gtk_file_chooser_set_do_overwrite_confirmation(GTK_FILE_CHOOSER(dialog), TRUE);
+	
+	if (gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT)
+	{
+		gchar *filename = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(dialog));
+		// The simulation thread writes the trace while it runs, so it is paused while the trace is saved
+		bool paused = main_system.PauseSimulationAndWait();
+		if(!main_system.DumpTrace(filename, "Saved on demand"))
+			ShowErrorMessage((string("Could not create ") + filename).c_str());
+		if(paused)
+			main_system.UnPauseSimulationThread();
+		g_free(filename);
+	}
+	
+	gtk_widget_destroy(dialog);
+}
+
 G_MODULE_EXPORT
 void MenuReloadProgramFile(gpointer sender, gpointer user_data)
 {
@@ -458,6 +561,7 @@ void MenuStop(gpointer sender, gpointer user_data)
 	{
 		main_system.StopSimulation();
 		main_debug.RemoveAllExecutingLineMarks();
+		main_debug.ClearBacktrace();
 		main_debug.DisableButtons();
 		SetSensitiveButtons(true, false, false);
 	}
@@ -474,6 +578,11 @@ G_MODULE_EXPORT
 gboolean MenuToggleIOBoardWindow(gpointer sender, gpointer user_data)
 {
 	bool visible = !gtk_widget_get_visible(board_window);
+	
+	// The images of the board are created the first time the window is shown
+	if(visible && !main_board.Init())
+		ShowErrorMessage("Error while trying to initialize the board!");
+	
 	gtk_check_menu_item_set_active(board_window_toggle, visible);
 	gtk_widget_set_visible(board_window, visible);
 	
@@ -488,6 +597,13 @@ G_MODULE_EXPORT
 gboolean MenuToggleRegisterWindow(gpointer sender, gpointer user_data)
 {
 	bool visible = !gtk_widget_get_visible(register_window);
+	
+	if(visible && !register_list_created)
+	{
+		InitRegisterListView();
+		register_list_created = true;
+	}
+	
 	gtk_check_menu_item_set_active(register_window_toggle, visible);
 	gtk_widget_set_visible(register_window, visible);
 	if(visible)
@@ -563,10 +679,7 @@ void UpdateConsolesFunc()
 		uart1_console.Update();
 	}
 	// Update the LCD if there is new text written to it
-	if(main_board.GetLCDTextUpdate())
-	{
-		main_board.WriteTextToLCD();
-	}
+	main_board.WriteTextToLCD();
 	// Update the register window if the window is visible
 	if(gtk_widget_get_visible(register_window))
 	{
@@ -634,11 +747,39 @@ int main(int argc, char *argv[]){
 	
 	gtk_init(&argc, &argv);
 	
+	// Parse the command line options that are left after gtk_init
+	for(int i=1; i<argc; i++)
+	{
+		if(!strcmp(argv[i], "--input-script") && i+1 < argc)
+		{
+			input_script_file = argv[++i];
+		}
+		else if(!strcmp(argv[i], "--vcd") && i+1 < argc)
+		{
+			wave_file = argv[++i];
+		}
+		else if(!strcmp(argv[i], "--profile") && i+1 < argc)
+		{
+			// Writes <prefix>.txt and <prefix>.folded every time the simulation is stopped
+			main_system.SetProfileFile(argv[++i]);
+		}
+		else if(!strcmp(argv[i], "--trace-dump") && i+1 < argc)
+		{
+			// Writes the last executed instructions when the program crashes
+			main_system.SetTraceDumpFile(argv[++i]);
+		}
+		else
+		{
+			g_print("Usage: %s [--input-script <file>] [--vcd <file>] [--profile <prefix>] [--trace-dump <file>]\n", argv[0]);
+			return 1;
+		}
+	}
+	
 	builder = gtk_builder_new();
 	
 	GError *error = NULL;
 	
-	pair<char*, size_t> ui_xml = CFile("ui.xml.gz").decompress().read_whole_file();
+	pair<char*, size_t> ui_xml = CFile("ui.xml").read_whole_file();
 	if (!gtk_builder_add_from_string(builder, ui_xml.first, ui_xml.second, &error)){
 		g_print("Msg: %s\n", error->message);
 		g_free(error);
@@ -723,13 +864,13 @@ int main(int argc, char *argv[]){
 	
 	main_debug.Init(builder);
 	
+	// Map the devices of the loaded systems to the windows
+	main_system.SetFrontEnd(&main_debug, &main_board, &jtag_console, &uart0_console, &uart1_console);
 	
 	g_object_unref(G_OBJECT(builder));
 	
 	g_signal_connect(G_OBJECT(about_dialog_menu_item), "activate", G_CALLBACK(show_about_dialog), NULL);
 	
-	InitRegisterListView();
-	
 	// Update the windows every 100 ms
 	g_timeout_add(100, update_consoles_func, NULL);
 	
@@ -742,6 +883,7 @@ int main(int argc, char *argv[]){
 	gdk_threads_leave();
 	
 	main_system.CloseSimulationThread();
+	main_system.StopRecordingWaves();
 	
 	main_debug.Cleanup();
 	
@@ -0,0 +1,44 @@
+/*
+NIISim - Nios II Simulator, A simulator that is capable of simulating various systems containing Nios II cpus.
+
+This file is part of NIISim.
+
+NIISim is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+NIISim is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+
+This file declares the globals of the GTK front end. The simulator core only includes sim.h and
+reaches the windows through the interfaces in CFrontEnd.h and CDebugger.h.
+
+*/
+
+#ifndef _GUI_H_
+#define _GUI_H_
+
+#include "sim.h"
+#include "CConsole.h"
+#include "CBoard.h"
+#include "CDebug.h"
+
+extern GtkWidget* board_window;
+extern GtkFixed*  board_area;
+extern CDebug main_debug;		// Handler to the debug window
+
+extern CBoard main_board;		// Handler to the board
+extern CConsole jtag_console;	// Handler to the jtag console
+extern CConsole uart0_console;	// Handler to the uart0 console
+extern CConsole uart1_console;	// Handler to the uart1 console
+
+#endif
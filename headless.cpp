@@ -0,0 +1,46 @@
+/*
+NIISim - Nios II Simulator, A simulator that is capable of simulating various systems containing Nios II cpus.
+
+This file is part of NIISim.
+
+NIISim is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+NIISim is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/*
+
+This file defines the globals and the GUI functions of gtk_main.cpp that the simulator core
+uses, for programs that run the simulator without windows. The system keeps its default debugger
+and has no board or consoles. The program defines ReportError(), which is called when the
+simulation stops with an error.
+
+*/
+
+#include <cstdio>
+#include "sim.h"
+
+CSystem main_system;
+
+void UpdateConsolesFunc(void)
+{
+}
+
+void SetSensitiveButtons(bool run, bool pause, bool stop)
+{
+}
+
+void ShowErrorMessage(const char *msg)
+{
+	fprintf(stderr, "%s\n", msg);
+}
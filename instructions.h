@@ -0,0 +1,245 @@
+/*
+NIISim - Nios II Simulator, A simulator that is capable of simulating various systems containing Nios II cpus.
+
+This file is part of NIISim.
+
+NIISim is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+NIISim is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+
+This file lists the instructions of the Nios II instruction set. It is the only description
+of the encodings: the lists are expanded with macros into the INSTR_* constants, the dispatch
+and timing tables of the cpu and the tables of the disassembler.
+
+Each list has all 64 encodings in order. An instruction is described by
+INSTRUCTION(name, encoding, mnemonic, handler, timing, format):
+
+	name		The INSTR_<name> constant
+	encoding	OP for I-type and J-type instructions, OPX for R-type instructions
+	mnemonic	The name in the disassembly
+	handler		CCpu::Exec<handler>, which is instantiated for each encoding it handles
+	timing		The timing class TIMING_<timing>, see CCpu.cpp
+	format		How the operands are disassembled, FORMAT_<format>
+
+An unused encoding is RESERVED(encoding).
+
+*/
+
+#ifndef _INSTRUCTIONS_H_
+#define _INSTRUCTIONS_H_
+
+// Instructions by OP
+#define OP_INSTRUCTIONS(INSTRUCTION, RESERVED) \
+	INSTRUCTION(CALL,		0x00, "call",		Call,		JUMP,		J) \
+	INSTRUCTION(JMPI,		0x01, "jmpi",		Jmp,		JUMP,		J) \
+	RESERVED(0x02) \
+	INSTRUCTION(LDBU,		0x03, "ldbu",		Load,		LOAD,		LOAD_STORE) \
+	INSTRUCTION(ADDI,		0x04, "addi",		Add,		ALU,		I_SIGNED) \
+	INSTRUCTION(STB,		0x05, "stb",		Store,		STORE,		LOAD_STORE) \
+	INSTRUCTION(BR,			0x06, "br",			Br,			JUMP,		BR) \
+	INSTRUCTION(LDB,		0x07, "ldb",		Load,		LOAD,		LOAD_STORE) \
+	INSTRUCTION(CMPGEI,		0x08, "cmpgei",		Cmp,		ALU,		I_SIGNED) \
+	RESERVED(0x09) \
+	RESERVED(0x0A) \
+	INSTRUCTION(LDHU,		0x0B, "ldhu",		Load,		LOAD,		LOAD_STORE) \
+	INSTRUCTION(ANDI,		0x0C, "andi",		And,		ALU,		I_UNSIGNED) \
+	INSTRUCTION(STH,		0x0D, "sth",		Store,		STORE,		LOAD_STORE) \
+	INSTRUCTION(BGE,		0x0E, "bge",		Br,			BRANCH,		BRANCH) \
+	INSTRUCTION(LDH,		0x0F, "ldh",		Load,		LOAD,		LOAD_STORE) \
+	INSTRUCTION(CMPLTI,		0x10, "cmplti",		Cmp,		ALU,		I_SIGNED) \
+	RESERVED(0x11) \
+	RESERVED(0x12) \
+	INSTRUCTION(INITDA,		0x13, "initda",		Cache,		ALU,		CACHE) \
+	INSTRUCTION(ORI,		0x14, "ori",		Or,			ALU,		I_UNSIGNED) \
+	INSTRUCTION(STW,		0x15, "stw",		Store,		STORE,		LOAD_STORE) \
+	INSTRUCTION(BLT,		0x16, "blt",		Br,			BRANCH,		BRANCH) \
+	INSTRUCTION(LDW,		0x17, "ldw",		Load,		LOAD,		LOAD_STORE) \
+	INSTRUCTION(CMPNEI,		0x18, "cmpnei",		Cmp,		ALU,		I_SIGNED) \
+	RESERVED(0x19) \
+	RESERVED(0x1A) \
+	INSTRUCTION(FLUSHDA,	0x1B, "flushda",	Cache,		ALU,		CACHE) \
+	INSTRUCTION(XORI,		0x1C, "xori",		Xor,		ALU,		I_UNSIGNED) \
+	RESERVED(0x1D) \
+	INSTRUCTION(BNE,		0x1E, "bne",		Br,			BRANCH,		BRANCH) \
+	RESERVED(0x1F) \
+	INSTRUCTION(CMPEQI,		0x20, "cmpeqi",		Cmp,		ALU,		I_SIGNED) \
+	RESERVED(0x21) \
+	RESERVED(0x22) \
+	INSTRUCTION(LDBUIO,		0x23, "ldbuio",		Load,		LOAD,		LOAD_STORE) \
+	INSTRUCTION(MULI,		0x24, "muli",		Mul,		MUL,		I_SIGNED) \
+	INSTRUCTION(STBIO,		0x25, "stbio",		Store,		STORE,		LOAD_STORE) \
+	INSTRUCTION(BEQ,		0x26, "beq",		Br,			BRANCH,		BRANCH) \
+	INSTRUCTION(LDBIO,		0x27, "ldbio",		Load,		LOAD,		LOAD_STORE) \
+	INSTRUCTION(CMPGEUI,	0x28, "cmpgeui",	Cmp,		ALU,		I_UNSIGNED) \
+	RESERVED(0x29) \
+	RESERVED(0x2A) \
+	INSTRUCTION(LDHUIO,		0x2B, "ldhuio",		Load,		LOAD,		LOAD_STORE) \
+	INSTRUCTION(ANDHI,		0x2C, "andhi",		And,		ALU,		I_UNSIGNED) \
+	INSTRUCTION(STHIO,		0x2D, "sthio",		Store,		STORE,		LOAD_STORE) \
+	INSTRUCTION(BGEU,		0x2E, "bgeu",		Br,			BRANCH,		BRANCH) \
+	INSTRUCTION(LDHIO,		0x2F, "ldhio",		Load,		LOAD,		LOAD_STORE) \
+	INSTRUCTION(CMPLTUI,	0x30, "cmpltui",	Cmp,		ALU,		I_UNSIGNED) \
+	RESERVED(0x31) \
+	INSTRUCTION(CUSTOM,		0x32, "custom",		Custom,		ALU,		CUSTOM) \
+	INSTRUCTION(INITD,		0x33, "initd",		Cache,		ALU,		CACHE) \
+	INSTRUCTION(ORHI,		0x34, "orhi",		Or,			ALU,		I_UNSIGNED) \
+	INSTRUCTION(STWIO,		0x35, "stwio",		Store,		STORE,		LOAD_STORE) \
+	INSTRUCTION(BLTU,		0x36, "bltu",		Br,			BRANCH,		BRANCH) \
+	INSTRUCTION(LDWIO,		0x37, "ldwio",		Load,		LOAD,		LOAD_STORE) \
+	INSTRUCTION(RDPRS,		0x38, "rdprs",		Rdprs,		ALU,		I_SIGNED) \
+	RESERVED(0x39) \
+	INSTRUCTION(R_TYPE,		0x3A, NULL,			RType,		ALU,		R_TYPE) \
+	INSTRUCTION(FLUSHD,		0x3B, "flushd",		Cache,		ALU,		CACHE) \
+	INSTRUCTION(XORHI,		0x3C, "xorhi",		Xor,		ALU,		I_UNSIGNED) \
+	RESERVED(0x3D) \
+	RESERVED(0x3E) \
+	RESERVED(0x3F)
+
+// R-type instructions by OPX
+#define OPX_INSTRUCTIONS(INSTRUCTION, RESERVED) \
+	RESERVED(0x00) \
+	INSTRUCTION(R_ERET,		0x01, "eret",		Ret,			JUMP_REG,	R_ERET) \
+	INSTRUCTION(R_ROLI,		0x02, "roli",		Rotate,			SHIFT,		R_IMM5) \
+	INSTRUCTION(R_ROL,		0x03, "rol",		Rotate,			SHIFT,		R) \
+	INSTRUCTION(R_FLUSHP,	0x04, "flushp",		FlushPipeline,	ALU,		R_NONE) \
+	INSTRUCTION(R_RET,		0x05, "ret",		Ret,			JUMP_REG,	R_RET) \
+	INSTRUCTION(R_NOR,		0x06, "nor",		Nor,			ALU,		R) \
+	INSTRUCTION(R_MULXUU,	0x07, "mulxuu",		Mul,			MUL,		R) \
+	INSTRUCTION(R_CMPGE,	0x08, "cmpge",		Cmp,			ALU,		R) \
+	INSTRUCTION(R_BRET,		0x09, "bret",		Ret,			JUMP_REG,	R_BRET) \
+	RESERVED(0x0A) \
+	INSTRUCTION(R_ROR,		0x0B, "ror",		Rotate,			SHIFT,		R) \
+	INSTRUCTION(R_FLUSHI,	0x0C, "flushi",		Cache,			ALU,		R_A) \
+	INSTRUCTION(R_JMP,		0x0D, "jmp",		Jmp,			JUMP_REG,	R_A) \
+	INSTRUCTION(R_AND,		0x0E, "and",		And,			ALU,		R) \
+	RESERVED(0x0F) \
+	INSTRUCTION(R_CMPLT,	0x10, "cmplt",		Cmp,			ALU,		R) \
+	RESERVED(0x11) \
+	INSTRUCTION(R_SLLI,		0x12, "slli",		Shift,			SHIFT,		R_IMM5) \
+	INSTRUCTION(R_SLL,		0x13, "sll",		Shift,			SHIFT,		R) \
+	INSTRUCTION(R_WRPRS,	0x14, "wrprs",		Wrprs,			ALU,		R_CA) \
+	RESERVED(0x15) \
+	INSTRUCTION(R_OR,		0x16, "or",			Or,				ALU,		R) \
+	INSTRUCTION(R_MULXSU,	0x17, "mulxsu",		Mul,			MUL,		R) \
+	INSTRUCTION(R_CMPNE,	0x18, "cmpne",		Cmp,			ALU,		R) \
+	RESERVED(0x19) \
+	INSTRUCTION(R_SRLI,		0x1A, "srli",		Shift,			SHIFT,		R_IMM5) \
+	INSTRUCTION(R_SRL,		0x1B, "srl",		Shift,			SHIFT,		R) \
+	INSTRUCTION(R_NEXTPC,	0x1C, "nextpc",		NextPC,			ALU,		R_C) \
+	INSTRUCTION(R_CALLR,	0x1D, "callr",		Call,			JUMP_REG,	R_CALLR) \
+	INSTRUCTION(R_XOR,		0x1E, "xor",		Xor,			ALU,		R) \
+	INSTRUCTION(R_MULXSS,	0x1F, "mulxss",		Mul,			MUL,		R) \
+	INSTRUCTION(R_CMPEQ,	0x20, "cmpeq",		Cmp,			ALU,		R) \
+	RESERVED(0x21) \
+	RESERVED(0x22) \
+	RESERVED(0x23) \
+	INSTRUCTION(R_DIVU,		0x24, "divu",		Div,			DIV,		R) \
+	INSTRUCTION(R_DIV,		0x25, "div",		Div,			DIV,		R) \
+	INSTRUCTION(R_RDCTL,	0x26, "rdctl",		ReadControl,	ALU,		R_RDCTL) \
+	INSTRUCTION(R_MUL,		0x27, "mul",		Mul,			MUL,		R) \
+	INSTRUCTION(R_CMPGEU,	0x28, "cmpgeu",		Cmp,			ALU,		R) \
+	INSTRUCTION(R_INITI,	0x29, "initi",		Cache,			ALU,		R_A) \
+	RESERVED(0x2A) \
+	RESERVED(0x2B) \
+	RESERVED(0x2C) \
+	INSTRUCTION(R_TRAP,		0x2D, "trap",		Trap,			JUMP_REG,	R_TRAP) \
+	INSTRUCTION(R_WRCTL,	0x2E, "wrctl",		WriteControl,	ALU,		R_WRCTL) \
+	RESERVED(0x2F) \
+	INSTRUCTION(R_CMPLTU,	0x30, "cmpltu",		Cmp,			ALU,		R) \
+	INSTRUCTION(R_ADD,		0x31, "add",		Add,			ALU,		R) \
+	RESERVED(0x32) \
+	RESERVED(0x33) \
+	INSTRUCTION(R_BREAK,	0x34, "break",		Break,			JUMP_REG,	R_BREAK) \
+	RESERVED(0x35) \
+	INSTRUCTION(R_SYNC,		0x36, "sync",		Sync,			ALU,		R_NONE) \
+	RESERVED(0x37) \
+	RESERVED(0x38) \
+	INSTRUCTION(R_SUB,		0x39, "sub",		Sub,			ALU,		R) \
+	INSTRUCTION(R_SRAI,		0x3A, "srai",		Shift,			SHIFT,		R_IMM5) \
+	INSTRUCTION(R_SRA,		0x3B, "sra",		Shift,			SHIFT,		R) \
+	RESERVED(0x3C) \
+	RESERVED(0x3D) \
+	RESERVED(0x3E) \
+	RESERVED(0x3F)
+
+// How the operands of an instruction are disassembled
+enum
+{							// Examples
+	FORMAT_NONE,			// A reserved encoding
+	FORMAT_J,				// call 0x800000
+	FORMAT_I_SIGNED,		// addi r2, r3, -4
+	FORMAT_I_UNSIGNED,		// andi r2, r3, 65535
+	FORMAT_LOAD_STORE,		// ldw r2, -4(r3)
+	FORMAT_CACHE,			// flushda -4(r3)
+	FORMAT_BR,				// br 0x800010
+	FORMAT_BRANCH,			// beq r2, r3, 0x800010
+	FORMAT_CUSTOM,			// custom 0, c2, r3, r4
+	FORMAT_R_TYPE,			// The OP of the R-type instructions
+	FORMAT_R,				// add r2, r3, r4
+	FORMAT_R_IMM5,			// slli r2, r3, 5
+	FORMAT_R_A,				// jmp r3
+	FORMAT_R_C,				// nextpc r2
+	FORMAT_R_CA,			// wrprs r2, r3
+	FORMAT_R_NONE,			// sync
+	FORMAT_R_ERET,			// eret, with rA = ea and rB = ba
+	FORMAT_R_RET,			// ret, with rA = ra
+	FORMAT_R_BRET,			// bret, with rA = ba
+	FORMAT_R_CALLR,			// callr r3, with rC = ra
+	FORMAT_R_TRAP,			// trap 3, with rC = ea
+	FORMAT_R_BREAK,			// break 3, with rC = ba
+	FORMAT_R_RDCTL,			// rdctl r2, status
+	FORMAT_R_WRCTL			// wrctl status, r3
+};
+
+#define INSTRUCTION_CONSTANT(name, encoding, mnemonic, handler, timing, format) INSTR_##name = encoding,
+#define RESERVED_CONSTANT(encoding)
+
+// The encodings, INSTR_<name> for OP and INSTR_R_<name> for OPX
+enum
+{
+	OP_INSTRUCTIONS(INSTRUCTION_CONSTANT, RESERVED_CONSTANT)
+	OPX_INSTRUCTIONS(INSTRUCTION_CONSTANT, RESERVED_CONSTANT)
+};
+
+#undef INSTRUCTION_CONSTANT
+#undef RESERVED_CONSTANT
+
+// Fails to compile if an instruction isn't listed at the index of its encoding
+#define INSTRUCTION_INDEX(name, encoding, mnemonic, handler, timing, format) INDEX_##name,
+#define RESERVED_INDEX(encoding) INDEX_RESERVED_##encoding,
+#define CHECK_INDEX(name, encoding, mnemonic, handler, timing, format) \
+	typedef char CHECK_INDEX_##name[INDEX_##name == encoding ? 1 : -1];
+#define CHECK_RESERVED_INDEX(encoding)
+
+namespace op_instructions
+{
+	enum { OP_INSTRUCTIONS(INSTRUCTION_INDEX, RESERVED_INDEX) COUNT };
+	typedef char CHECK_COUNT[COUNT == 64 ? 1 : -1];
+	OP_INSTRUCTIONS(CHECK_INDEX, CHECK_RESERVED_INDEX)
+}
+
+namespace opx_instructions
+{
+	enum { OPX_INSTRUCTIONS(INSTRUCTION_INDEX, RESERVED_INDEX) COUNT };
+	typedef char CHECK_COUNT[COUNT == 64 ? 1 : -1];
+	OPX_INSTRUCTIONS(CHECK_INDEX, CHECK_RESERVED_INDEX)
+}
+
+#undef INSTRUCTION_INDEX
+#undef RESERVED_INDEX
+#undef CHECK_INDEX
+#undef CHECK_RESERVED_INDEX
+
+#endif
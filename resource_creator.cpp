@@ -19,7 +19,9 @@ along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <string>
+#include <vector>
 #include <iostream>
+#include "resources.h"
 
 using namespace std;
 
@@ -87,75 +89,117 @@ static void escaped_string(const char* str, string& out){
 #define UNDERSCORE ""
 #endif
 
+// Starts a global object in the current section
+static void begin_object(const char *name, string& out){
+	out += ".globl " UNDERSCORE;
+	out += name;
+	out += '\n';
+#ifdef __linux
+	out += "	.type	";
+	out += name;
+	out += ", @object\n";
+#endif
+	out += UNDERSCORE;
+	out += name;
+	out += ":\n";
+}
+
+// Ends a global object started with begin_object
+static void end_object(const char *name, string& out){
+#ifdef __linux
+	out += "	.size	";
+	out += name;
+	out += ", .-";
+	out += name;
+	out += '\n';
+#endif
+}
+
+/*
+ *	main()
+ *
+ *  Writes an assembly file that embeds the files given as arguments, see resources.h.
+ *  Everything is read-only and addressed with offsets, so nothing needs to be relocated.
+ */
 int main(int argc, char *argv[]){
-	const char *word = (sizeof(void*) == 8) ? "	.quad	" : "	.long	";
+	unsigned int table_size = 1;
+	vector<unsigned int> table;
+
+	// Build the hash table. It has at least twice as many slots as there are files,
+	// so a lookup of a missing file always reaches an empty slot.
+	while(table_size < 2U * (argc-1))
+		table_size *= 2;
+	table.assign(table_size, 0);
+	for(int i=1; i<argc; i++){
+		unsigned int slot = ResourceHash(argv[i]) & (table_size - 1);
+		while(table[slot] != 0)
+			slot = (slot + 1) & (table_size - 1);
+		table[slot] = i;
+	}
+
 	string out =
-	".globl " UNDERSCORE "resource_file_names\n"
-#ifndef __posix
+#ifndef __linux
 	"	.section	.rdata,\"dr\"\n"
 #else
 	"	.section	.rodata\n"
 #endif
-	"	.align 16\n"
-#ifdef __posix
-	"	.type	resource_file_names, @object\n"
-	"	.size	resource_file_names, ";
-	int_to_string(sizeof(void*) * (argc-1+1), out)
-#endif
-	;
-	out += "\n" UNDERSCORE "resource_file_names:\n";
-	
+	"	.align 16\n";
+
+	begin_object("resource_hash_mask", out);
+	out += "	.long	";
+	int_to_string(table_size - 1, out);
+	out += '\n';
+	end_object("resource_hash_mask", out);
+
+	begin_object("resource_hash_table", out);
+	for(unsigned int slot=0; slot<table_size; slot++){
+		out += "	.long	";
+		int_to_string(table[slot], out);
+		out += '\n';
+	}
+	end_object("resource_hash_table", out);
+
+	begin_object("resource_name_offsets", out);
 	for(int i=1; i<argc; i++){
-		out += word;
-		out += PERIOD "Lresource_file_name_";
+		out += "	.long	" PERIOD "Lresource_file_name_";
 		int_to_string(i, out);
-		out += '\n';
+		out += "-" PERIOD "Lresource_names\n";
 	}
-	out += word;
-	out += "0\n";
-	
-	out += ".globl " UNDERSCORE "resource_data\n"
-#ifdef __linux
-	"	.type	resource_data, @object\n"
-	"	.size	resource_data, ";
-	int_to_string(sizeof(void*) * (argc-1), out)
-#endif
-	;
-	out += "\n" UNDERSCORE "resource_data:\n";
+	end_object("resource_name_offsets", out);
+
+	begin_object("resource_data_offsets", out);
 	for(int i=1; i<argc; i++){
-		out += word;
-		out += PERIOD "Lresource_file_data_";
+		out += "	.long	" PERIOD "Lresource_file_data_";
 		int_to_string(i, out);
-		out += '\n';
+		out += "-" PERIOD "Lresource_blob\n";
 	}
-	
-	out += ".globl " UNDERSCORE "resource_data_len\n"
-#ifdef __posix
-	"	.type	resource_data_len, @object\n"
-	"	.size	resource_data_len, ";
-	int_to_string(sizeof(void*) * (argc-1), out)
-#endif
-	;
-	out += "\n" UNDERSCORE "resource_data_len:\n";
+	end_object("resource_data_offsets", out);
+
+	begin_object("resource_data_len", out);
 	for(int i=1; i<argc; i++){
-		out += word;
-		out += PERIOD "Lresource_file_data_end_";
+		out += "	.long	" PERIOD "Lresource_file_data_end_";
 		int_to_string(i, out);
 		out += "-" PERIOD "Lresource_file_data_";
 		int_to_string(i, out);
 		out += '\n';
 	}
-	
+	end_object("resource_data_len", out);
+
+	begin_object("resource_names", out);
+	out += PERIOD "Lresource_names:\n";
 	for(int i=1; i<argc; i++){
-		string resource_file_name_id = PERIOD "Lresource_file_name_";
-		int_to_string(i, resource_file_name_id);
-		
-		out += resource_file_name_id + ":\n"
-		"	.string	";
+		out += PERIOD "Lresource_file_name_";
+		int_to_string(i, out);
+		out += ":\n	.string	";
 		escaped_string(argv[i], out);
 		out += '\n';
 	}
-	
+	end_object("resource_names", out);
+
+	// All files in one blob
+	out += "	.align 16\n";
+	begin_object("resource_blob", out);
+	out += PERIOD "Lresource_blob:\n";
 	for(int i=1; i<argc; i++){
 		out += "	.align 8\n"
 		PERIOD "Lresource_file_data_";
@@ -166,10 +210,11 @@ int main(int argc, char *argv[]){
 		int_to_string(i, out);
 		out += ":\n";
 	}
+	end_object("resource_blob", out);
 
-#ifdef __posix
+#ifdef __linux
 	out += "	.section	.note.GNU-stack,\"\",@progbits\n";
 #endif
 	
 	cout << out;
-}
\ No newline at end of file
+}
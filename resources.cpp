@@ -20,25 +20,43 @@ along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <cstring>
 #include <utility>
+#include "resources.h"
 
 using namespace std;
 
+// Generated by resource_creator
 extern "C"
 {
-	extern const char* const resource_file_names[];
-	extern const char* const resource_data[];
-	extern const size_t resource_data_len[];
+	extern const unsigned int resource_hash_mask;
+	extern const unsigned int resource_hash_table[];	// Index + 1 of the file in each slot, 0 if empty
+	extern const char resource_names[];
+	extern const unsigned int resource_name_offsets[];	// Offset of each file name in resource_names
+	extern const unsigned int resource_data_offsets[];	// Offset of each file in resource_blob
+	extern const unsigned int resource_data_len[];
+	extern const char resource_blob[];
 }
 
+/*
+ *	ResourceFind()
+ *
+ *  Finds an embedded file. Collisions in the hash table are resolved by linear probing,
+ *  and the table is at most half full.
+ *
+ *	Parameters: path - The file name, as given to resource_creator
+ *
+ *	Returns:	The data and length of the file, or NULL and 0 if there is no such file
+ */
 pair<const char*, size_t> ResourceFind(const char *path)
 {
-	for(size_t i=0; resource_file_names[i] != NULL; i++)
+	unsigned int slot = ResourceHash(path) & resource_hash_mask;
+
+	while(resource_hash_table[slot] != 0)
 	{
-		if(!strcmp(resource_file_names[i], path))
-		{
-			return pair<const char*, size_t>(resource_data[i], resource_data_len[i]);
-		}
+		unsigned int i = resource_hash_table[slot] - 1;
+
+		if(!strcmp(resource_names + resource_name_offsets[i], path))
+			return pair<const char*, size_t>(resource_blob + resource_data_offsets[i], resource_data_len[i]);
+		slot = (slot + 1) & resource_hash_mask;
 	}
-	pair<const char*, size_t> ret = pair<const char*, size_t>((const char*)0, 0);
-	return ret;
-}
\ No newline at end of file
+	return pair<const char*, size_t>((const char*)0, 0);
+}
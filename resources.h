@@ -18,8 +18,40 @@ You should have received a copy of the GNU General Public License
 along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+/*
+
+The files listed in the build files are embedded in the program by resource_creator, which
+generates resource_data.s. The file data is stored in one read-only blob, indexed by a hash
+table over the file names that is built at compile time, so no relocations are needed and
+a lookup is a hash and usually a single string comparison.
+
+*/
+
+#ifndef _RESOURCES_H_
+#define _RESOURCES_H_
+
 #include <utility>
 
 using namespace std;
 
-pair<const char*, size_t> ResourceFind(const char *path);
\ No newline at end of file
+/*
+ *	ResourceHash()
+ *
+ *  Hashes a file name with FNV-1a. Also used by resource_creator to build the table.
+ *
+ *	Parameters: path - The file name
+ *
+ *	Returns:	The hash
+ */
+inline unsigned int ResourceHash(const char *path)
+{
+	unsigned int hash = 2166136261U;
+
+	while(*path)
+		hash = (hash ^ (unsigned char)*path++) * 16777619U;
+	return hash;
+}
+
+pair<const char*, size_t> ResourceFind(const char *path);
+
+#endif
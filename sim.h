@@ -27,9 +27,6 @@ along with NIISim.  If not, see <http://www.gnu.org/licenses/>.
 //#include <windows.h>
 #include "types.h"
 #include "CSystem.h"
-#include "CConsole.h"
-#include "CBoard.h"
-#include "CDebug.h"
 
 /*
 void				InitRegisterListView();
@@ -66,14 +63,6 @@ void ShowErrorMessage(const char *msg);
 // Same as ShowErrorMessage but can be used from the non-GUI thread
 void ReportError(const char *msg);
 
-extern GtkWidget* board_window;
-extern GtkFixed*  board_area;
-extern CDebug main_debug;
-
 extern CSystem main_system;		// Handler to the system
-extern CBoard main_board;		// Handler to the board
-extern CConsole jtag_console;	// Handler to the jtag console
-extern CConsole uart0_console;	// Handler to the uart0 console
-extern CConsole uart1_console;	// Handler to the uart1 console
 
 #endif